@@ -0,0 +1,195 @@
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/system/mem.h"
+#include "powerblocks/core/ios/ios.h"
+
+#include "powerblocks/core/graphics/video.h"
+
+#include "powerblocks/core/utils/fonts.h"
+#include "powerblocks/core/utils/console.h"
+
+#include "powerblocks/filesystem/archive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ff.h"
+
+#define ARCHIVE_PATH "assets.pba"
+#define LOOSE_PATH   "assets"
+
+// Small enough to split reads across blocks
+#define STREAM_READ_SIZE 100
+
+framebuffer_t frame_buffer ALIGN(512);
+
+void retrace_callback() {
+    // Make it so we can see the framebuffer changes
+    system_flush_dcache(&frame_buffer, sizeof(frame_buffer));
+}
+
+FATFS fs;
+archive_t archive;
+
+static uint32_t ticks_to_us(uint64_t ticks) {
+    return (uint32_t)(ticks / (SYSTEM_TB_CLOCK_HZ / 1000000));
+}
+
+static void* load_loose(const char* name, uint32_t* size) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", LOOSE_PATH, name);
+
+    FIL file;
+    if(f_open(&file, path, FA_READ) != FR_OK)
+        return NULL;
+
+    *size = f_size(&file);
+    void* data = malloc(*size ? *size : 1);
+
+    UINT read = 0;
+    if(data == NULL || f_read(&file, data, *size, &read) != FR_OK || read != *size) {
+        free(data);
+        data = NULL;
+    }
+
+    f_close(&file);
+    return data;
+}
+
+static void list_entries() {
+    printf("  %u entries:\n", archive_count(&archive));
+
+    for(uint32_t i = 0; i < archive_count(&archive); i++) {
+        archive_info_t info;
+        archive_get_info(&archive, i, &info);
+        printf("    %s %6u -> %6u  %s\n", info.compressed ? "LZ4" : "   ", info.size, info.stored_size, info.name);
+    }
+}
+
+static void compare_loose() {
+    uint64_t archive_total = 0;
+    uint64_t loose_total = 0;
+
+    printf("  Archive vs loose:\n");
+
+    for(uint32_t i = 0; i < archive_count(&archive); i++) {
+        archive_info_t info;
+        archive_get_info(&archive, i, &info);
+
+        uint64_t start = system_get_time_base_int();
+        uint32_t size = 0;
+        void* packed = archive_load(&archive, info.name, &size);
+        uint64_t packed_time = system_get_time_base_int() - start;
+
+        start = system_get_time_base_int();
+        uint32_t loose_size = 0;
+        void* loose = load_loose(info.name, &loose_size);
+        uint64_t loose_time = system_get_time_base_int() - start;
+
+        const char* result = "OK";
+        if(packed == NULL)
+            result = "ARCHIVE FAILED";
+        else if(loose == NULL)
+            result = "NO LOOSE FILE";
+        else if(size != loose_size || memcmp(packed, loose, size) != 0)
+            result = "MISMATCH";
+
+        printf("    %6u us %6u us  %s %s\n", ticks_to_us(packed_time), ticks_to_us(loose_time), info.name, result);
+
+        archive_total += packed_time;
+        loose_total += loose_time;
+
+        if(packed)
+            mem_free(packed);
+        free(loose);
+    }
+
+    printf("    %6u us %6u us  total\n", ticks_to_us(archive_total), ticks_to_us(loose_total));
+}
+
+static void check_streaming() {
+    for(uint32_t i = 0; i < archive_count(&archive); i++) {
+        archive_info_t info;
+        archive_get_info(&archive, i, &info);
+        if(!info.compressed)
+            continue;
+
+        uint32_t size = 0;
+        uint8_t* whole = archive_load(&archive, info.name, &size);
+
+        archive_file_t file;
+        if(whole == NULL || archive_open(&archive, &file, info.name) < 0) {
+            printf("  Stream %s: failed to open\n", info.name);
+            if(whole)
+                mem_free(whole);
+            continue;
+        }
+
+        uint8_t chunk[STREAM_READ_SIZE];
+        uint32_t offset = 0;
+        bool match = true;
+
+        while(true) {
+            int read = archive_read(&file, chunk, sizeof(chunk));
+            if(read <= 0) {
+                match = match && read == 0;
+                break;
+            }
+
+            if(offset + read > size || memcmp(whole + offset, chunk, read) != 0)
+                match = false;
+            offset += read;
+        }
+
+        archive_close(&file);
+        mem_free(whole);
+
+        printf("  Stream %s in %d byte reads: %s\n", info.name, STREAM_READ_SIZE,
+               match && offset == size ? "OK" : "MISMATCH");
+    }
+}
+
+int main() {
+    // Initialize IOS. Must be done first as many thing use it
+    ios_initialize();
+
+    // Get default video mode from IOS and use it to initialize the video interface.
+    video_mode_t tv_mode = video_system_default_video_mode();
+    video_initialize(tv_mode);
+
+    console_initialize(&frame_buffer, &fonts_ibm_iso_8x16);
+    video_set_framebuffer(&frame_buffer);
+    video_set_retrace_callback(retrace_callback);
+
+    framebuffer_fill_rgba(&frame_buffer, 0x000000FF, vec2i_new(0,0), vec2i_new(VIDEO_WIDTH, VIDEO_HEIGHT));
+    console_set_text_color(0xFFFFFFFF, 0x000000FF);
+
+    printf("\n\n\n");
+    printf("  PowerBlocks SDK Asset Archive Example\n");
+
+    FRESULT fr = f_mount(&fs, "0:", 1);
+    if(fr != FR_OK) {
+        printf("Failed to mount SD card. Error: %d!\n", fr);
+        goto ERROR;
+    }
+
+    if(archive_mount(&archive, ARCHIVE_PATH) < 0) {
+        printf("Failed to mount %s.\n", ARCHIVE_PATH);
+        goto ERROR;
+    }
+
+    list_entries();
+    compare_loose();
+    check_streaming();
+
+    archive_unmount(&archive);
+
+ERROR:
+
+    while(true) {
+        // Wait for vsync
+        video_wait_vsync();
+    }
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/ios/ios.h"
+
+#include "powerblocks/core/graphics/video.h"
+
+#include "powerblocks/core/utils/fonts.h"
+#include "powerblocks/core/utils/console.h"
+
+#include "powerblocks/core/bluetooth/bltootls.h"
+#include "powerblocks/core/bluetooth/hci.h"
+#include "powerblocks/core/bluetooth/hci_sim.h"
+
+#include "powerblocks/input/wiimote/wiimote.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <string.h>
+
+framebuffer_t frame_buffer ALIGN(512);
+
+// Rates stepped through, reports per second per remote
+static const uint32_t report_rates[] = {100, 200, 500, 1000};
+
+void retrace_callback() {
+    // Make it so we can see the framebuffer changes
+    system_flush_dcache(&frame_buffer, sizeof(frame_buffer));
+}
+
+static void print_stats(uint32_t rate) {
+    hci_sim_stats_t stats;
+    hci_sim_get_stats(&stats);
+
+    uint64_t elapsed = system_get_time_base_int() - stats.start_time;
+    uint32_t elapsed_ms = (uint32_t)(elapsed / (SYSTEM_TB_CLOCK_HZ / 1000));
+    if(elapsed_ms == 0)
+        return;
+
+    uint32_t average_us = 0;
+    if(stats.reports_delivered)
+        average_us = (uint32_t)(stats.latency_total / stats.reports_delivered / (SYSTEM_TB_CLOCK_HZ / 1000000));
+    uint32_t max_us = (uint32_t)(stats.latency_max / (SYSTEM_TB_CLOCK_HZ / 1000000));
+
+    printf("%4d Hz: gen %6d/s, got %6d/s, dropped %d, latency avg %d us max %d us\n",
+        rate,
+        (uint32_t)(stats.reports_generated * 1000 / elapsed_ms),
+        (uint32_t)(stats.reports_delivered * 1000 / elapsed_ms),
+        (uint32_t)stats.reports_dropped,
+        average_us, max_us);
+
+    printf("  histogram:");
+    for(int i = 0; i < HCI_SIM_LATENCY_BUCKETS; i++) {
+        if(stats.latency_histogram[i])
+            printf(" <%dus:%d", 1 << i, stats.latency_histogram[i]);
+    }
+    printf("\n");
+
+    // What the wiimote driver is actually getting per remote
+    for(int i = 0; i < WIIMOTE_MAX_REMOTES; i++) {
+        wiimote_reporting_stats_t reporting;
+        if(wiimote_get_reporting_stats(&WIIMOTES[i], &reporting) < 0)
+            continue;
+
+        printf("  remote %d: mode %02X ir %d %s, %d reports/s, first report after %d ms%s\n", i,
+            reporting.report_type, reporting.ir_mode,
+            reporting.continuous ? "continuous" : "on change",
+            (int)reporting.rate_hz,
+            (int)(reporting.time_to_first_report / (SYSTEM_TB_CLOCK_HZ / 1000)),
+            reporting.cache_hit ? " (cached)" : "");
+    }
+}
+
+int main() {
+    // Initialize IOS. Must be done first as many thing use it
+    ios_initialize();
+
+    // Get default video mode from IOS and use it to initialize the video interface.
+    video_mode_t tv_mode = video_system_default_video_mode();
+    video_initialize(tv_mode);
+
+    console_initialize(&frame_buffer, &fonts_ibm_iso_8x16);
+    video_set_framebuffer(&frame_buffer);
+    video_set_retrace_callback(retrace_callback);
+
+    framebuffer_fill_rgba(&frame_buffer, 0x000000FF, vec2i_new(0,0), vec2i_new(VIDEO_WIDTH, VIDEO_HEIGHT));
+    console_set_text_color(0xFFFFFFFF, 0x000000FF);
+
+    printf("\n\n\n");
+    printf("  PowerBlocks SDK Bluetooth Simulator Example\n");
+
+    // Must come before the stack opens the controller
+    hci_sim_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.remotes = 4;
+    config.report_rate_hz = report_rates[0];
+
+    int ret = hci_sim_install(&config);
+    if(ret < 0) {
+        printf("Failed To Install Simulator.\n");
+    }
+
+    ret = bltools_initialize();
+    if(ret < 0) {
+        printf("Failed To Init Bluetooth.\n");
+    }
+
+    wiimotes_initialize();
+
+    // The simulated remotes are always discoverable
+    bltools_begin_discovery(HCI_INQUIRY_MODE_GENERAL_ACCESS, pdMS_TO_TICKS(5000), 4);
+
+    int rate_index = 0;
+    int seconds = 0;
+    uint64_t next_second = system_get_time_base_int() + SYSTEM_S_TO_TICKS(1);
+
+    hci_sim_reset_stats();
+
+    while(true) {
+        wiimote_poll();
+
+        uint64_t now = system_get_time_base_int();
+        if(now >= next_second) {
+            next_second += SYSTEM_S_TO_TICKS(1);
+            seconds++;
+
+            print_stats(report_rates[rate_index]);
+
+            if(seconds % 10 == 0 && rate_index + 1 < sizeof(report_rates) / sizeof(report_rates[0])) {
+                rate_index++;
+                hci_sim_set_report_rate(report_rates[rate_index]);
+                hci_sim_reset_stats();
+            }
+        }
+
+        // Wait for vsync
+        video_wait_vsync();
+    }
+
+    return 0;
+}
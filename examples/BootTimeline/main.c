@@ -0,0 +1,134 @@
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/system/boot.h"
+#include "powerblocks/core/ios/ios.h"
+
+#include "powerblocks/core/graphics/video.h"
+
+#include "powerblocks/core/utils/fonts.h"
+#include "powerblocks/core/utils/console.h"
+
+#include "powerblocks/core/bluetooth/bltootls.h"
+
+#include "powerblocks/filesystem/sd.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#define TIMELINE_MAX 32
+
+enum {
+    STEP_IOS,
+    STEP_VIDEO,
+    STEP_BLUETOOTH,
+    STEP_SD,
+    STEP_COUNT
+};
+
+framebuffer_t frame_buffer ALIGN(512);
+
+void retrace_callback() {
+    // Make it so we can see the framebuffer changes
+    system_flush_dcache(&frame_buffer, sizeof(frame_buffer));
+}
+
+static uint32_t ticks_to_us(uint64_t ticks) {
+    return (uint32_t)(ticks * 1000000 / SYSTEM_TB_CLOCK_HZ);
+}
+
+static int ios_step(void* param) {
+    // Initialize IOS. Must be done first as many thing use it
+    ios_initialize();
+    return 0;
+}
+
+static int video_step(void* param) {
+    // Get default video mode from IOS and use it to initialize the video interface.
+    video_mode_t tv_mode = video_system_default_video_mode();
+    if(tv_mode == VIDEO_MODE_UNINITIALIZED)
+        return -1;
+
+    video_initialize(tv_mode);
+
+    console_initialize(&frame_buffer, &fonts_ibm_iso_8x16);
+    video_set_framebuffer(&frame_buffer);
+    video_set_retrace_callback(retrace_callback);
+
+    framebuffer_fill_rgba(&frame_buffer, 0x000000FF, vec2i_new(0,0), vec2i_new(VIDEO_WIDTH, VIDEO_HEIGHT));
+    console_set_text_color(0xFFFFFFFF, 0x000000FF);
+
+    return 0;
+}
+
+static int bluetooth_step(void* param) {
+    return bltools_initialize();
+}
+
+static int sd_step(void* param) {
+    return sd_initialize();
+}
+
+// Only IOS has to come first, the rest overlap
+static const boot_step_t boot_steps[STEP_COUNT] = {
+    [STEP_IOS]       = { "IOS",       ios_step,       NULL, 0 },
+    [STEP_VIDEO]     = { "VIDEO",     video_step,     NULL, BOOT_AFTER(STEP_IOS) },
+    [STEP_BLUETOOTH] = { "BLUETOOTH", bluetooth_step, NULL, BOOT_AFTER(STEP_IOS) },
+    [STEP_SD]        = { "SD",        sd_step,        NULL, BOOT_AFTER(STEP_IOS) },
+};
+
+static boot_event_t timeline[TIMELINE_MAX];
+
+int main() {
+    boot_mark("MAIN");
+
+    int results[STEP_COUNT];
+    boot_run(boot_steps, STEP_COUNT, results);
+
+    printf("\n\n\n");
+    printf("  PowerBlocks SDK Boot Timeline Example\n");
+
+    // Flushed now, so it is on screen once the next retrace passes
+    system_flush_dcache(&frame_buffer, sizeof(frame_buffer));
+    video_wait_vsync();
+    boot_mark_first_frame();
+
+    uint64_t steps_total = 0;
+    uint64_t run_start = 0;
+    uint64_t run_end = 0;
+
+    int count = boot_get_timeline(timeline, TIMELINE_MAX);
+    for(int i = 0; i < count; i++) {
+        const boot_event_t* event = &timeline[i];
+
+        switch(event->type) {
+        case BOOT_EVENT_MARK:
+            printf("  %8d us  %s\n", ticks_to_us(event->time), event->name);
+            break;
+        case BOOT_EVENT_START:
+            printf("  %8d us    %s started\n", ticks_to_us(event->time), event->name);
+            steps_total -= event->time;
+            if(run_start == 0)
+                run_start = event->time;
+            break;
+        case BOOT_EVENT_END:
+            printf("  %8d us    %s finished, %d\n", ticks_to_us(event->time), event->name, event->result);
+            steps_total += event->time;
+            run_end = event->time;
+            break;
+        }
+    }
+
+    printf("  Steps took %d us added up, %d us overlapped\n", ticks_to_us(steps_total), ticks_to_us(run_end - run_start));
+    printf("  First frame on screen %d us after boot\n", ticks_to_us(boot_get_first_frame_time()));
+
+    boot_log_timeline();
+
+    while(true) {
+        // Wait for vsync
+        video_wait_vsync();
+    }
+
+    return 0;
+}
@@ -0,0 +1,290 @@
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/system/mem.h"
+#include "powerblocks/core/ios/ios.h"
+
+#include "powerblocks/core/graphics/video.h"
+
+#include "powerblocks/core/utils/fonts.h"
+#include "powerblocks/core/utils/console.h"
+
+#include "powerblocks/filesystem/disk_cache.h"
+#include "powerblocks/filesystem/image_disk.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "ff.h"
+
+#define IMAGE_SIZE (8 * 1024 * 1024)
+
+// Roughly what a command through IOS to the SD card costs
+#define SIMULATED_COMMAND_US 300
+#define SIMULATED_SECTOR_US  2
+
+#define SMALL_FILE_COUNT 64
+#define SMALL_FILE_SIZE  700
+#define LARGE_FILE_SIZE  (2 * 1024 * 1024)
+#define READ_SIZE        (4 * 1024)
+#define RANDOM_READS     256
+
+#define STRESS_TASKS      4
+#define STRESS_FILE_SIZE  (16 * 1024)
+#define STRESS_SECONDS    10
+#define STRESS_STACK_SIZE 8192
+
+typedef struct {
+    int id;
+    volatile uint32_t passes;
+    volatile uint32_t errors;
+    volatile bool done;
+
+    uint8_t pattern[STRESS_FILE_SIZE];
+    uint8_t readback[STRESS_FILE_SIZE];
+
+    StaticTask_t task_data;
+    StackType_t task_stack[STRESS_STACK_SIZE / sizeof(StackType_t)];
+} stress_task_t;
+
+framebuffer_t frame_buffer ALIGN(512);
+
+static FATFS fs;
+static uint8_t mkfs_work[FF_MAX_SS * 8] ALIGN(32);
+static uint8_t io_buffer[READ_SIZE] ALIGN(32);
+static stress_task_t stress_tasks[STRESS_TASKS];
+static volatile bool stress_stop;
+
+void retrace_callback() {
+    // Make it so we can see the framebuffer changes
+    system_flush_dcache(&frame_buffer, sizeof(frame_buffer));
+}
+
+static uint32_t elapsed_us(uint64_t start) {
+    return (uint32_t)((system_get_time_base_int() - start) / (SYSTEM_TB_CLOCK_HZ / 1000000));
+}
+
+static void print_disk_usage(const char* name, uint32_t us) {
+    disk_cache_stats_t cache;
+    image_disk_stats_t disk;
+    disk_get_cache_stats(IMAGE_DISK_DRIVE, &cache);
+    image_disk_get_stats(&disk);
+
+    uint64_t reads = cache.read_hits + cache.read_misses;
+    printf("  %-12s %7d us, %5d disk reads, %5d disk writes, %3d%% hit\n", name, us,
+        (int)disk.reads, (int)disk.writes, reads ? (int)(cache.read_hits * 100 / reads) : 0);
+
+    disk_reset_cache_stats(IMAGE_DISK_DRIVE);
+    image_disk_reset_stats();
+}
+
+static void create_files() {
+    memset(io_buffer, 'A', sizeof(io_buffer));
+
+    f_mkdir("1:/small");
+    for(int i = 0; i < SMALL_FILE_COUNT; i++) {
+        char path[32];
+        snprintf(path, sizeof(path), "1:/small/file%03d.txt", i);
+
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC);
+        write(fd, io_buffer, SMALL_FILE_SIZE);
+        close(fd);
+    }
+
+    int fd = open("1:/large.bin", O_WRONLY | O_CREAT | O_TRUNC);
+    for(int i = 0; i < LARGE_FILE_SIZE / READ_SIZE; i++)
+        write(fd, io_buffer, READ_SIZE);
+    close(fd);
+}
+
+static void run_benchmarks(bool cached) {
+    printf(" Sector cache %s:\n", cached ? "on" : "off");
+    disk_set_cache_enabled(IMAGE_DISK_DRIVE, cached);
+    disk_reset_cache_stats(IMAGE_DISK_DRIVE);
+    image_disk_reset_stats();
+
+    // Directory walk
+    uint64_t start = system_get_time_base_int();
+    DIR dir;
+    FILINFO fno;
+    int entries = 0;
+    if(f_opendir(&dir, "1:/small") == FR_OK) {
+        while(f_readdir(&dir, &fno) == FR_OK && fno.fname[0])
+            entries++;
+        f_closedir(&dir);
+    }
+    print_disk_usage("list", elapsed_us(start));
+
+    // Small file loads
+    start = system_get_time_base_int();
+    for(int i = 0; i < SMALL_FILE_COUNT; i++) {
+        char path[32];
+        snprintf(path, sizeof(path), "1:/small/file%03d.txt", i);
+
+        int fd = open(path, O_RDONLY);
+        read(fd, io_buffer, SMALL_FILE_SIZE);
+        close(fd);
+    }
+    print_disk_usage("small reads", elapsed_us(start));
+
+    // Sequential reads in small pieces
+    start = system_get_time_base_int();
+    int fd = open("1:/large.bin", O_RDONLY);
+    while(read(fd, io_buffer, 1000) > 0);
+    close(fd);
+    print_disk_usage("sequential", elapsed_us(start));
+
+    // Random reads, large.bin is big enough for fast seek
+    start = system_get_time_base_int();
+    fd = open("1:/large.bin", O_RDONLY);
+    uint32_t seed = 1;
+    for(int i = 0; i < RANDOM_READS; i++) {
+        seed = seed * 1664525 + 1013904223;
+        pread(fd, io_buffer, READ_SIZE, (seed % (LARGE_FILE_SIZE / READ_SIZE)) * READ_SIZE);
+    }
+    close(fd);
+    print_disk_usage("random", elapsed_us(start));
+}
+
+static void stress_task(void* param) {
+    stress_task_t* task = (stress_task_t*)param;
+
+    char path[32];
+    snprintf(path, sizeof(path), "1:/stress%d.bin", task->id);
+
+    uint32_t seed = task->id + 1;
+
+    while(!stress_stop) {
+        for(int i = 0; i < STRESS_FILE_SIZE; i++) {
+            seed = seed * 1664525 + 1013904223;
+            task->pattern[i] = seed >> 24;
+        }
+
+        int fd = open(path, O_RDWR | O_CREAT | O_TRUNC);
+        if(fd < 0) {
+            task->errors++;
+            continue;
+        }
+
+        // Odd sized pieces so writes straddle sectors
+        int written = 0;
+        while(written < STRESS_FILE_SIZE) {
+            int piece = 1 + (seed >> 16) % 1500;
+            if(piece > STRESS_FILE_SIZE - written)
+                piece = STRESS_FILE_SIZE - written;
+            if(write(fd, task->pattern + written, piece) != piece)
+                break;
+            written += piece;
+            seed = seed * 1664525 + 1013904223;
+        }
+
+        lseek(fd, 0, SEEK_SET);
+        memset(task->readback, 0, sizeof(task->readback));
+        int got = read(fd, task->readback, STRESS_FILE_SIZE);
+        close(fd);
+
+        if(written != STRESS_FILE_SIZE || got != STRESS_FILE_SIZE || memcmp(task->pattern, task->readback, STRESS_FILE_SIZE) != 0) {
+            task->errors++;
+        } else {
+            task->passes++;
+        }
+    }
+
+    task->done = true;
+    vTaskSuspend(NULL);
+}
+
+static void run_stress() {
+    printf(" Stress, %d tasks for %d seconds:\n", STRESS_TASKS, STRESS_SECONDS);
+    disk_set_cache_enabled(IMAGE_DISK_DRIVE, true);
+    stress_stop = false;
+
+    TaskHandle_t handles[STRESS_TASKS];
+    for(int i = 0; i < STRESS_TASKS; i++) {
+        stress_task_t* task = &stress_tasks[i];
+        task->id = i;
+        task->passes = 0;
+        task->errors = 0;
+        task->done = false;
+
+        handles[i] = xTaskCreateStatic(stress_task, "STRESS", STRESS_STACK_SIZE / sizeof(StackType_t),
+                                       task, configMAX_PRIORITIES / 2 - 1, task->task_stack, &task->task_data);
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(STRESS_SECONDS * 1000));
+    stress_stop = true;
+
+    for(int i = 0; i < STRESS_TASKS; i++) {
+        while(!stress_tasks[i].done)
+            vTaskDelay(pdMS_TO_TICKS(10));
+        vTaskDelete(handles[i]);
+
+        printf("  task %d: %d passes, %d errors\n", i, stress_tasks[i].passes, stress_tasks[i].errors);
+    }
+}
+
+int main() {
+    // Initialize IOS. Must be done first as many thing use it
+    ios_initialize();
+
+    // Get default video mode from IOS and use it to initialize the video interface.
+    video_mode_t tv_mode = video_system_default_video_mode();
+    video_initialize(tv_mode);
+
+    console_initialize(&frame_buffer, &fonts_ibm_iso_8x16);
+    video_set_framebuffer(&frame_buffer);
+    video_set_retrace_callback(retrace_callback);
+
+    framebuffer_fill_rgba(&frame_buffer, 0x000000FF, vec2i_new(0,0), vec2i_new(VIDEO_WIDTH, VIDEO_HEIGHT));
+    console_set_text_color(0xFFFFFFFF, 0x000000FF);
+
+    printf("\n\n\n");
+    printf("  PowerBlocks SDK Disk Image Example\n");
+
+    // Plenty of room in MEM2, and keeps MEM1 free for the program
+    void* image = mem2_aligned_alloc(IMAGE_SIZE, 32);
+    if(image == NULL) {
+        printf("Failed to allocate image.\n");
+        goto ERROR;
+    }
+
+    // Format with no latency, its not what is being measured
+    image_disk_attach(image, IMAGE_SIZE, NULL);
+
+    MKFS_PARM format = { .fmt = FM_ANY };
+    FRESULT fr = f_mkfs("1:", &format, mkfs_work, sizeof(mkfs_work));
+    if(fr != FR_OK) {
+        printf("Failed to format. Error: %d!\n", fr);
+        goto ERROR;
+    }
+
+    fr = f_mount(&fs, "1:", 1);
+    if(fr != FR_OK) {
+        printf("Failed to mount. Error: %d!\n", fr);
+        goto ERROR;
+    }
+
+    create_files();
+
+    image_disk_config_t config = {
+        .command_latency_us = SIMULATED_COMMAND_US,
+        .sector_latency_us = SIMULATED_SECTOR_US
+    };
+    image_disk_set_config(&config);
+
+    run_benchmarks(false);
+    run_benchmarks(true);
+    run_stress();
+
+ERROR:
+
+    while(true) {
+        // Wait for vsync
+        video_wait_vsync();
+    }
+
+    return 0;
+}
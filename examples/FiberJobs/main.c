@@ -0,0 +1,203 @@
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/ios/ios.h"
+
+#include "powerblocks/core/graphics/video.h"
+
+#include "powerblocks/core/utils/fonts.h"
+#include "powerblocks/core/utils/console.h"
+#include "powerblocks/core/utils/fiber.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#define FIBER_COUNT      8
+#define FIBER_STACK_SIZE 8192
+
+// Streamed in chunks, like level data off the SD card
+#define STREAM_CHUNK 512
+#define STREAM_SIZE  (16 * 1024)
+
+// Vertices skinned each frame, split into batches
+#define VERTEX_COUNT 8192
+#define BATCH_COUNT  8
+#define BONE_COUNT   16
+
+#define FRAMES 30
+
+typedef struct {
+    float position[3];
+    uint8_t bones[2];
+    float weight;
+} vertex_t;
+
+framebuffer_t frame_buffer ALIGN(512);
+
+static uint8_t fiber_stacks[FIBER_COUNT][FIBER_STACK_SIZE] ALIGN(32);
+static fiber_scheduler_t scheduler;
+
+static const char stream_path[IOS_MAX_PATH] ALIGN(32) = "/shared2/sys/SYSCONF";
+static uint8_t stream_buffer[STREAM_CHUNK] ALIGN(32);
+static uint32_t stream_checksum;
+
+static vertex_t vertices[VERTEX_COUNT];
+static float skinned[VERTEX_COUNT][3];
+static float bones[BONE_COUNT][3][4];
+
+void retrace_callback() {
+    // Make it so we can see the framebuffer changes
+    system_flush_dcache(&frame_buffer, sizeof(frame_buffer));
+}
+
+static uint32_t ticks_to_us(uint64_t ticks) {
+    return (uint32_t)(ticks * 1000000 / SYSTEM_TB_CLOCK_HZ);
+}
+
+static void setup_scene() {
+    for(int i = 0; i < VERTEX_COUNT; i++) {
+        vertices[i].position[0] = (float)(i % 64);
+        vertices[i].position[1] = (float)(i / 64);
+        vertices[i].position[2] = 1.0f;
+        vertices[i].bones[0] = i % BONE_COUNT;
+        vertices[i].bones[1] = (i + 1) % BONE_COUNT;
+        vertices[i].weight = 0.75f;
+    }
+
+    for(int b = 0; b < BONE_COUNT; b++) {
+        for(int r = 0; r < 3; r++) {
+            for(int c = 0; c < 4; c++)
+                bones[b][r][c] = (r == c ? 1.0f : 0.0f) + (c == 3 ? (float)b : 0.0f);
+        }
+    }
+}
+
+static void skin_batch(fiber_scheduler_t* scheduler, void* param) {
+    int batch = (int)param;
+    int first = batch * (VERTEX_COUNT / BATCH_COUNT);
+
+    for(int i = first; i < first + VERTEX_COUNT / BATCH_COUNT; i++) {
+        const vertex_t* v = &vertices[i];
+        const float (*a)[4] = bones[v->bones[0]];
+        const float (*b)[4] = bones[v->bones[1]];
+
+        for(int r = 0; r < 3; r++) {
+            float pa = a[r][0] * v->position[0] + a[r][1] * v->position[1] + a[r][2] * v->position[2] + a[r][3];
+            float pb = b[r][0] * v->position[0] + b[r][1] * v->position[1] + b[r][2] * v->position[2] + b[r][3];
+            skinned[i][r] = pa * v->weight + pb * (1.0f - v->weight);
+        }
+    }
+}
+
+// Reads the whole file a chunk at a time. From a job other jobs run
+// while each chunk is read, from anywhere else it blocks the task.
+static void stream_file(fiber_scheduler_t* scheduler) {
+    int file = fiber_ios_open(scheduler, stream_path, IOS_MODE_READ);
+    if(file < 0)
+        return;
+
+    for(int offset = 0; offset < STREAM_SIZE; offset += STREAM_CHUNK) {
+        if(fiber_ios_read(scheduler, file, stream_buffer, STREAM_CHUNK) != STREAM_CHUNK)
+            break;
+
+        for(int i = 0; i < STREAM_CHUNK; i++)
+            stream_checksum += stream_buffer[i];
+    }
+
+    fiber_ios_close(scheduler, file);
+}
+
+static void stream_job(fiber_scheduler_t* scheduler, void* param) {
+    stream_file(scheduler);
+}
+
+static void frame_job(fiber_scheduler_t* scheduler, void* param) {
+    fiber_counter_t stream = { 0 };
+    fiber_counter_t skin = { 0 };
+
+    fiber_job_t stream_jobs[1] = {{ stream_job, NULL, NULL }};
+    fiber_run_jobs(scheduler, stream_jobs, 1, &stream);
+
+    fiber_job_t skin_jobs[BATCH_COUNT];
+    for(int i = 0; i < BATCH_COUNT; i++) {
+        skin_jobs[i].function = skin_batch;
+        skin_jobs[i].param = (void*)i;
+        skin_jobs[i].dependency = NULL;
+    }
+    fiber_run_jobs(scheduler, skin_jobs, BATCH_COUNT, &skin);
+
+    fiber_wait(scheduler, &skin);
+    fiber_wait(scheduler, &stream);
+}
+
+static uint64_t run_serial() {
+    uint64_t start = system_get_time_base_int();
+
+    for(int frame = 0; frame < FRAMES; frame++) {
+        stream_file(&scheduler);
+        for(int i = 0; i < BATCH_COUNT; i++)
+            skin_batch(&scheduler, (void*)i);
+    }
+
+    return system_get_time_base_int() - start;
+}
+
+static uint64_t run_fibers() {
+    uint64_t start = system_get_time_base_int();
+
+    for(int frame = 0; frame < FRAMES; frame++)
+        fiber_scheduler_run(&scheduler, frame_job, NULL);
+
+    return system_get_time_base_int() - start;
+}
+
+int main() {
+    // Initialize IOS. Must be done first as many thing use it
+    ios_initialize();
+
+    // Get default video mode from IOS and use it to initialize the video interface.
+    video_mode_t tv_mode = video_system_default_video_mode();
+    video_initialize(tv_mode);
+
+    console_initialize(&frame_buffer, &fonts_ibm_iso_8x16);
+    video_set_framebuffer(&frame_buffer);
+    video_set_retrace_callback(retrace_callback);
+
+    framebuffer_fill_rgba(&frame_buffer, 0x000000FF, vec2i_new(0,0), vec2i_new(VIDEO_WIDTH, VIDEO_HEIGHT));
+    console_set_text_color(0xFFFFFFFF, 0x000000FF);
+
+    printf("\n\n\n");
+    printf("  PowerBlocks SDK Fiber Jobs Example\n");
+    printf("  Each frame streams %d KB and skins %d vertices, %d frames:\n", STREAM_SIZE / 1024, VERTEX_COUNT, FRAMES);
+
+    setup_scene();
+
+    if(fiber_scheduler_initialize(&scheduler, fiber_stacks, FIBER_STACK_SIZE, FIBER_COUNT) < 0) {
+        printf("  Could not set up the scheduler.\n");
+    } else {
+        uint32_t serial_us = ticks_to_us(run_serial());
+        uint32_t serial_checksum = stream_checksum;
+
+        stream_checksum = 0;
+        uint32_t fibers_us = ticks_to_us(run_fibers());
+
+        printf("  One after the other: %6d us a frame\n", serial_us / FRAMES);
+        printf("  Overlapped in jobs:  %6d us a frame\n", fibers_us / FRAMES);
+        printf("  Streamed data %s\n", serial_checksum == stream_checksum ? "matches" : "DOES NOT MATCH");
+
+        fiber_stats_t stats;
+        fiber_get_stats(&scheduler, &stats);
+        printf("  %d jobs, %d switches, %d waits, %d fibers busy at most\n",
+               stats.jobs, stats.switches, stats.waits, stats.max_fibers);
+        printf("  Blocked on IO %d times for %d us, with nothing else to do\n",
+               stats.idles, ticks_to_us(stats.idle_time));
+    }
+
+    while(true) {
+        // Wait for vsync
+        video_wait_vsync();
+    }
+
+    return 0;
+}
@@ -8,10 +8,15 @@
 #include "powerblocks/core/utils/console.h"
 
 #include "powerblocks/filesystem/sd.h"
+#include "powerblocks/filesystem/disk_cache.h"
+#include "powerblocks/filesystem/fs_stream.h"
+#include "powerblocks/filesystem/fs_syscall.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 #include "ff.h"
 
@@ -107,6 +112,229 @@ static void file_system_example() {
     printf("Read Back:\n%s", buffer);
 }
 
+#define BENCHMARK_FILE_SIZE  (4 * 1024 * 1024)
+#define BENCHMARK_CHUNK_SIZE (64 * 1024)
+
+static uint8_t benchmark_buffer[BENCHMARK_CHUNK_SIZE + 32] ALIGN(32);
+
+// Reads the whole benchmark file in big chunks and prints MB/s
+static void benchmark_read(const char* name, uint8_t* buffer) {
+    // Straight to read(), stdio would add its own copy
+    int fd = open("benchmark.bin", O_RDONLY);
+    if(fd < 0) {
+        printf("Failed to open benchmark file.\n");
+        return;
+    }
+
+    uint64_t start = system_get_time_base_int();
+
+    size_t total = 0;
+    while(true) {
+        ssize_t got = read(fd, buffer, BENCHMARK_CHUNK_SIZE);
+        if(got <= 0)
+            break;
+        total += got;
+    }
+
+    uint64_t elapsed_ms = (system_get_time_base_int() - start) / (SYSTEM_TB_CLOCK_HZ / 1000);
+    close(fd);
+
+    if(elapsed_ms == 0)
+        elapsed_ms = 1;
+
+    uint32_t kb_per_s = (uint32_t)((uint64_t)total * 1000 / 1024 / elapsed_ms);
+    printf("%s: %d KB in %d ms, %d.%02d MB/s\n", name, (int)(total / 1024), (int)elapsed_ms,
+        kb_per_s / 1024, (kb_per_s % 1024) * 100 / 1024);
+}
+
+static void read_benchmark() {
+    // Make a large file to stand in for an asset, only the first run
+    FILINFO fno;
+    if(f_stat("benchmark.bin", &fno) != FR_OK || fno.fsize != BENCHMARK_FILE_SIZE) {
+        printf("Creating benchmark.bin\n");
+        FILE* fp = fopen("benchmark.bin", "wb");
+        if(!fp) {
+            printf("Failed to create benchmark file.\n");
+            return;
+        }
+
+        for(int i = 0; i < BENCHMARK_CHUNK_SIZE; i++)
+            benchmark_buffer[i] = (uint8_t)i;
+        for(int i = 0; i < BENCHMARK_FILE_SIZE / BENCHMARK_CHUNK_SIZE; i++)
+            fwrite(benchmark_buffer, 1, BENCHMARK_CHUNK_SIZE, fp);
+        fclose(fp);
+    }
+
+    // Aligned reads go straight into the buffer, unaligned ones bounce
+    benchmark_read("aligned read", benchmark_buffer);
+    benchmark_read("unaligned read", benchmark_buffer + 1);
+}
+
+#define WRITE_PIECE_SIZE 1024
+
+// Writes the benchmark file size in small pieces, like a log or capture would
+static void write_benchmark(bool preallocate) {
+    f_unlink("capture.bin");
+
+    uint64_t start = system_get_time_base_int();
+
+    int fd = open("capture.bin", O_WRONLY | O_CREAT | O_TRUNC);
+    if(fd < 0) {
+        printf("Failed to open capture file.\n");
+        return;
+    }
+
+    if(preallocate && fs_preallocate(fd, BENCHMARK_FILE_SIZE) < 0)
+        printf("Failed to preallocate.\n");
+
+    for(int i = 0; i < BENCHMARK_FILE_SIZE / WRITE_PIECE_SIZE; i++) {
+        if(write(fd, benchmark_buffer, WRITE_PIECE_SIZE) != WRITE_PIECE_SIZE) {
+            printf("Write failed.\n");
+            break;
+        }
+    }
+
+    // Counts the final sync too
+    close(fd);
+
+    uint32_t elapsed_ms = (uint32_t)((system_get_time_base_int() - start) / (SYSTEM_TB_CLOCK_HZ / 1000));
+    if(elapsed_ms == 0)
+        elapsed_ms = 1;
+
+    uint32_t kb_per_s = (uint32_t)((uint64_t)BENCHMARK_FILE_SIZE * 1000 / 1024 / elapsed_ms);
+    printf("%s write: %d.%02d MB/s\n", preallocate ? "preallocated" : "growing",
+        kb_per_s / 1024, (kb_per_s % 1024) * 100 / 1024);
+}
+
+#define RANDOM_FILE_SIZE  (512 * 1024 * 1024)
+#define RANDOM_READ_SIZE  (4 * 1024)
+#define RANDOM_READ_COUNT 512
+
+// Random 4 KB reads across a big file, like pulling assets out of an archive
+static void random_read_benchmark() {
+    FILINFO fno;
+    if(f_stat("random.bin", &fno) != FR_OK || fno.fsize != RANDOM_FILE_SIZE) {
+        printf("Creating random.bin, this takes a while\n");
+        int fd = open("random.bin", O_WRONLY | O_CREAT | O_TRUNC);
+        if(fd < 0) {
+            printf("Failed to create random read file.\n");
+            return;
+        }
+
+        for(int i = 0; i < RANDOM_FILE_SIZE / BENCHMARK_CHUNK_SIZE; i++) {
+            if(write(fd, benchmark_buffer, BENCHMARK_CHUNK_SIZE) != BENCHMARK_CHUNK_SIZE) {
+                printf("Failed to write random read file.\n");
+                break;
+            }
+        }
+        close(fd);
+    }
+
+    // Read only and large, so it gets a fast seek map
+    int fd = open("random.bin", O_RDONLY);
+    if(fd < 0) {
+        printf("Failed to open random read file.\n");
+        return;
+    }
+
+    uint32_t seed = 12345;
+    uint64_t start = system_get_time_base_int();
+
+    for(int i = 0; i < RANDOM_READ_COUNT; i++) {
+        seed = seed * 1664525 + 1013904223;
+        off_t offset = (off_t)(seed % (RANDOM_FILE_SIZE / RANDOM_READ_SIZE)) * RANDOM_READ_SIZE;
+
+        if(pread(fd, benchmark_buffer, RANDOM_READ_SIZE, offset) != RANDOM_READ_SIZE) {
+            printf("Random read failed.\n");
+            break;
+        }
+    }
+
+    uint64_t elapsed_us = (system_get_time_base_int() - start) / (SYSTEM_TB_CLOCK_HZ / 1000000);
+    close(fd);
+
+    printf("random 4 KB reads: %d reads/s, %d us each\n",
+        (int)(RANDOM_READ_COUNT * 1000000ull / (elapsed_us ? elapsed_us : 1)),
+        (int)(elapsed_us / RANDOM_READ_COUNT));
+}
+
+#define STREAM_CHUNK_COUNT 4
+
+static fs_stream_t stream;
+static uint8_t stream_buffer[BENCHMARK_CHUNK_SIZE * STREAM_CHUNK_COUNT] ALIGN(32);
+
+// Streams the benchmark file while pretending to decode each chunk
+static void stream_benchmark(uint32_t work_ms) {
+    fs_stream_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.chunk_size = BENCHMARK_CHUNK_SIZE;
+    config.chunk_count = STREAM_CHUNK_COUNT;
+    config.buffer = stream_buffer;
+
+    if(fs_stream_open(&stream, "benchmark.bin", &config) < 0) {
+        printf("Failed to open stream.\n");
+        return;
+    }
+
+    while(true) {
+        const void* data;
+        int size = fs_stream_acquire(&stream, &data, portMAX_DELAY);
+        if(size <= 0)
+            break;
+
+        // Stand in for the consumer's work, the next chunk is loading meanwhile
+        system_delay_int(SYSTEM_MS_TO_TICKS(work_ms));
+
+        fs_stream_release(&stream);
+    }
+
+    fs_stream_stats_t stats;
+    fs_stream_get_stats(&stream, &stats);
+    fs_stream_close(&stream);
+
+    uint32_t elapsed_ms = (uint32_t)((system_get_time_base_int() - stats.start_time) / (SYSTEM_TB_CLOCK_HZ / 1000));
+    if(elapsed_ms == 0)
+        elapsed_ms = 1;
+
+    uint32_t kb_per_s = (uint32_t)(stats.bytes * 1000 / 1024 / elapsed_ms);
+    printf("stream, %d ms work per chunk: %d.%02d MB/s, %d stalls, %d ms stalled, worst %d ms\n", work_ms,
+        kb_per_s / 1024, (kb_per_s % 1024) * 100 / 1024, stats.stalls,
+        (int)(stats.stall_time / (SYSTEM_TB_CLOCK_HZ / 1000)),
+        (int)(stats.stall_max / (SYSTEM_TB_CLOCK_HZ / 1000)));
+}
+
+static void print_ioctl_latency(const char* name, ios_latency_type_t type) {
+    ios_latency_stats_t stats;
+    ios_get_latency_stats(type, &stats);
+    if(stats.calls == 0)
+        return;
+
+    printf("%s: %d calls, avg %d us, max %d us\n", name, (int)stats.calls,
+        (int)(stats.total / stats.calls / (SYSTEM_TB_CLOCK_HZ / 1000000)),
+        (int)(stats.max / (SYSTEM_TB_CLOCK_HZ / 1000000)));
+
+    printf("  histogram:");
+    for(int i = 0; i < IOS_LATENCY_BUCKETS; i++) {
+        if(stats.histogram[i])
+            printf(" <%dus:%d", 1 << i, stats.histogram[i]);
+    }
+    printf("\n");
+}
+
+static void print_cache_stats() {
+    disk_cache_stats_t stats;
+    if(disk_get_cache_stats(0, &stats) < 0)
+        return;
+
+    uint64_t reads = stats.read_hits + stats.read_misses;
+    uint64_t requests = stats.device_reads + stats.device_writes;
+
+    printf("sector cache: %d%% hit rate, %d read ahead, %d writes coalesced, %d bytes per IPC\n",
+        reads ? (int)(stats.read_hits * 100 / reads) : 0,
+        (int)stats.read_ahead, (int)stats.write_coalesced,
+        requests ? (int)((stats.bytes_read + stats.bytes_written) / requests) : 0);
+}
+
 int main() {
     // Initialize IOS. Must be done first as many thing use it
     ios_initialize();
@@ -152,6 +380,17 @@ int main() {
     printf("Game launched from: %s\n", game_dir);
     chdir(game_dir);
     file_system_example();
+    read_benchmark();
+    stream_benchmark(0);
+    stream_benchmark(10);
+    random_read_benchmark();
+    write_benchmark(false);
+    write_benchmark(true);
+
+    // How long the SD card's IOS calls took
+    print_ioctl_latency("ios_ioctl", IOS_LATENCY_IOCTL);
+    print_ioctl_latency("ios_ioctlv", IOS_LATENCY_IOCTLV);
+    print_cache_stats();
 ERROR:
 
     while(true) {
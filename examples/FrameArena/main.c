@@ -0,0 +1,191 @@
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/system/mem.h"
+#include "powerblocks/core/ios/ios.h"
+
+#include "powerblocks/core/graphics/video.h"
+
+#include "powerblocks/core/utils/fonts.h"
+#include "powerblocks/core/utils/console.h"
+#include "powerblocks/core/utils/arena.h"
+#include "powerblocks/core/utils/pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#define FRAME_COUNT        600
+#define COMMANDS_PER_FRAME 256
+#define ARENA_SIZE         (512 * 1024)
+
+#define PACKET_ROUNDS      2000
+#define PACKETS_IN_FLIGHT  32
+
+typedef struct {
+    uint32_t key;
+    uint16_t mesh;
+    uint16_t material;
+    float matrix[3][4];
+} draw_command_t;
+
+typedef struct {
+    uint16_t handle;
+    uint16_t length;
+    uint8_t data[60];
+} packet_t;
+
+framebuffer_t frame_buffer ALIGN(512);
+
+POOL_DEFINE(packet_pool, packet_t, PACKETS_IN_FLIGHT);
+
+static frame_arena_t frame_arena;
+
+void retrace_callback() {
+    // Make it so we can see the framebuffer changes
+    system_flush_dcache(&frame_buffer, sizeof(frame_buffer));
+}
+
+// Different amount of work every frame
+static uint32_t commands_in_frame(uint32_t frame) {
+    return COMMANDS_PER_FRAME / 2 + (frame * 7919) % COMMANDS_PER_FRAME;
+}
+
+static void print_cost(const char* name, uint64_t ticks, uint32_t count) {
+    uint32_t ticks_x100 = (uint32_t)(ticks * 100 / count);
+    printf("    %s: %d.%02d ticks per allocation\n", name, ticks_x100 / 100, ticks_x100 % 100);
+}
+
+static void build_frame(draw_command_t** commands, uint32_t* keys, uint32_t count) {
+    for(uint32_t i = 0; i < count; i++) {
+        commands[i]->key = i * 2654435761u;
+        keys[i] = commands[i]->key;
+    }
+}
+
+static void frames_malloc() {
+    static draw_command_t* commands[COMMANDS_PER_FRAME * 2];
+    uint32_t* keys;
+    uint32_t allocations = 0;
+
+    uint64_t start = system_get_time_base_int();
+    for(uint32_t frame = 0; frame < FRAME_COUNT; frame++) {
+        uint32_t count = commands_in_frame(frame);
+
+        for(uint32_t i = 0; i < count; i++)
+            commands[i] = malloc(sizeof(draw_command_t));
+        keys = malloc(count * sizeof(uint32_t));
+        allocations += count + 1;
+
+        build_frame(commands, keys, count);
+
+        for(uint32_t i = 0; i < count; i++)
+            free(commands[i]);
+        free(keys);
+    }
+    uint64_t elapsed = system_get_time_base_int() - start;
+
+    print_cost("malloc + free    ", elapsed, allocations);
+}
+
+static void frames_arena() {
+    static draw_command_t* commands[COMMANDS_PER_FRAME * 2];
+    uint32_t* keys;
+    uint32_t allocations = 0;
+
+    uint64_t start = system_get_time_base_int();
+    for(uint32_t frame = 0; frame < FRAME_COUNT; frame++) {
+        uint32_t count = commands_in_frame(frame);
+
+        for(uint32_t i = 0; i < count; i++)
+            commands[i] = frame_arena_alloc(&frame_arena, sizeof(draw_command_t));
+        keys = frame_arena_alloc(&frame_arena, count * sizeof(uint32_t));
+        allocations += count + 1;
+
+        build_frame(commands, keys, count);
+
+        frame_arena_next(&frame_arena);
+    }
+    uint64_t elapsed = system_get_time_base_int() - start;
+
+    print_cost("Frame arena      ", elapsed, allocations);
+
+    arena_stats_t stats;
+    arena_get_stats(frame_arena_current(&frame_arena), &stats);
+    printf("    Arena: peak %d of %d bytes, %d failed\n", stats.peak_used, stats.size, stats.failures);
+}
+
+static void packets_malloc() {
+    packet_t* packets[PACKETS_IN_FLIGHT];
+
+    uint64_t start = system_get_time_base_int();
+    for(int round = 0; round < PACKET_ROUNDS; round++) {
+        for(int i = 0; i < PACKETS_IN_FLIGHT; i++)
+            packets[i] = malloc(sizeof(packet_t));
+        for(int i = 0; i < PACKETS_IN_FLIGHT; i++)
+            free(packets[i]);
+    }
+    uint64_t elapsed = system_get_time_base_int() - start;
+
+    print_cost("Packets, malloc  ", elapsed, PACKET_ROUNDS * PACKETS_IN_FLIGHT);
+}
+
+static void packets_pool() {
+    packet_t* packets[PACKETS_IN_FLIGHT];
+
+    uint64_t start = system_get_time_base_int();
+    for(int round = 0; round < PACKET_ROUNDS; round++) {
+        for(int i = 0; i < PACKETS_IN_FLIGHT; i++)
+            packets[i] = packet_pool_alloc();
+        for(int i = 0; i < PACKETS_IN_FLIGHT; i++)
+            packet_pool_free(packets[i]);
+    }
+    uint64_t elapsed = system_get_time_base_int() - start;
+
+    print_cost("Packets, pool    ", elapsed, PACKET_ROUNDS * PACKETS_IN_FLIGHT);
+
+    pool_stats_t stats;
+    pool_get_stats(&packet_pool, &stats);
+    printf("    Pool: peak %d of %d, %d failed, %d corrupted\n", stats.peak_used, stats.count, stats.failures, stats.corrupted);
+}
+
+int main() {
+    // Initialize IOS. Must be done first as many thing use it
+    ios_initialize();
+
+    // Get default video mode from IOS and use it to initialize the video interface.
+    video_mode_t tv_mode = video_system_default_video_mode();
+    video_initialize(tv_mode);
+
+    console_initialize(&frame_buffer, &fonts_ibm_iso_8x16);
+    video_set_framebuffer(&frame_buffer);
+    video_set_retrace_callback(retrace_callback);
+
+    framebuffer_fill_rgba(&frame_buffer, 0x000000FF, vec2i_new(0,0), vec2i_new(VIDEO_WIDTH, VIDEO_HEIGHT));
+    console_set_text_color(0xFFFFFFFF, 0x000000FF);
+
+    printf("\n\n\n");
+    printf("  PowerBlocks SDK Frame Arena Example\n");
+
+    void* arena_memory = mem1_aligned_alloc(ARENA_SIZE, ARENA_GX_ALIGN);
+    if(arena_memory == NULL) {
+        printf("Failed to allocate arena.\n");
+        goto ERROR;
+    }
+    frame_arena_initialize(&frame_arena, arena_memory, ARENA_SIZE);
+
+    printf("  %d frames of %d to %d draw commands:\n", FRAME_COUNT, COMMANDS_PER_FRAME / 2, COMMANDS_PER_FRAME * 3 / 2 - 1);
+    frames_malloc();
+    frames_arena();
+
+    printf("  %d packets in flight:\n", PACKETS_IN_FLIGHT);
+    packets_malloc();
+    packets_pool();
+
+ERROR:
+
+    while(true) {
+        // Wait for vsync
+        video_wait_vsync();
+    }
+
+    return 0;
+}
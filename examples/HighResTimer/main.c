@@ -0,0 +1,118 @@
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/system/hrtimer.h"
+#include "powerblocks/core/ios/ios.h"
+
+#include "powerblocks/core/graphics/video.h"
+
+#include "powerblocks/core/utils/fonts.h"
+#include "powerblocks/core/utils/console.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+
+// Like refilling a small audio buffer
+#define PERIOD_US      250
+#define RUN_MS         2000
+
+#define SLEEP_US       100
+#define SLEEP_COUNT    200
+
+#define IDLE_MS        1000
+
+framebuffer_t frame_buffer ALIGN(512);
+
+static volatile uint32_t periodic_count;
+
+void retrace_callback() {
+    // Make it so we can see the framebuffer changes
+    system_flush_dcache(&frame_buffer, sizeof(frame_buffer));
+}
+
+static void periodic_callback(hrtimer_t* timer, void* param) {
+    periodic_count++;
+}
+
+static uint32_t ticks_to_us(uint64_t ticks) {
+    return (uint32_t)(ticks * 1000000 / SYSTEM_TB_CLOCK_HZ);
+}
+
+static void print_histogram(const hrtimer_stats_t* stats) {
+    for(int i = 0; i < HRTIMER_HISTOGRAM_BUCKETS; i++) {
+        if(stats->histogram[i] == 0)
+            continue;
+
+        if(i == HRTIMER_HISTOGRAM_BUCKETS - 1)
+            printf("    %5d us or more: %d\n", 1 << (i - 1), stats->histogram[i]);
+        else
+            printf("    under %5d us:   %d\n", 1 << i, stats->histogram[i]);
+    }
+}
+
+int main() {
+    // Initialize IOS. Must be done first as many thing use it
+    ios_initialize();
+
+    // Get default video mode from IOS and use it to initialize the video interface.
+    video_mode_t tv_mode = video_system_default_video_mode();
+    video_initialize(tv_mode);
+
+    console_initialize(&frame_buffer, &fonts_ibm_iso_8x16);
+    video_set_framebuffer(&frame_buffer);
+    video_set_retrace_callback(retrace_callback);
+
+    framebuffer_fill_rgba(&frame_buffer, 0x000000FF, vec2i_new(0,0), vec2i_new(VIDEO_WIDTH, VIDEO_HEIGHT));
+    console_set_text_color(0xFFFFFFFF, 0x000000FF);
+
+    printf("\n\n\n");
+    printf("  PowerBlocks SDK High Resolution Timer Example\n");
+
+    // Periodic timer, how late each callback ran
+    hrtimer_t periodic;
+    hrtimer_initialize(&periodic, periodic_callback, NULL);
+    hrtimer_start_us(&periodic, PERIOD_US, PERIOD_US);
+    vTaskDelay(pdMS_TO_TICKS(RUN_MS));
+    hrtimer_stop(&periodic);
+
+    hrtimer_stats_t stats;
+    hrtimer_get_stats(&periodic, &stats);
+    printf("  Every %d us for %d ms: %d callbacks, expected %d, %d missed\n",
+           PERIOD_US, RUN_MS, periodic_count, RUN_MS * 1000 / PERIOD_US, stats.missed);
+    printf("  Late by, average %d us, most %d us:\n",
+           stats.count ? ticks_to_us(stats.total_late / stats.count) : 0, ticks_to_us(stats.max_late));
+    print_histogram(&stats);
+
+    // Sleeps shorter than a tick
+    uint64_t total_over = 0;
+    uint64_t max_over = 0;
+    for(int i = 0; i < SLEEP_COUNT; i++) {
+        uint64_t start = system_get_time_base_int();
+        hrtimer_sleep_us(SLEEP_US);
+        uint64_t over = system_get_time_base_int() - start - SYSTEM_US_TO_TICKS(SLEEP_US);
+
+        total_over += over;
+        if(over > max_over)
+            max_over = over;
+    }
+    printf("  hrtimer_sleep_us(%d), over by average %d us, most %d us\n",
+           SLEEP_US, ticks_to_us(total_over / SLEEP_COUNT), ticks_to_us(max_over));
+
+    // Nothing to do, the tick should stop
+    hrtimer_tick_stats_t before, after;
+    hrtimer_get_tick_stats(&before);
+    vTaskDelay(pdMS_TO_TICKS(IDLE_MS));
+    hrtimer_get_tick_stats(&after);
+
+    printf("  Idle for %d ms: %d decrementer interrupts, %d ticks skipped\n", IDLE_MS,
+           after.interrupts - before.interrupts, (uint32_t)(after.ticks_skipped - before.ticks_skipped));
+    printf("  Ticking every millisecond would take %d.\n", IDLE_MS * configTICK_RATE_HZ / 1000);
+
+    while(true) {
+        // Wait for vsync
+        video_wait_vsync();
+    }
+
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/system/ipc.h"
+#include "powerblocks/core/system/exceptions.h"
+#include "powerblocks/core/ios/ios.h"
+
+#include "powerblocks/core/graphics/video.h"
+
+#include "powerblocks/core/utils/fonts.h"
+#include "powerblocks/core/utils/console.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Producer tasks, and how many requests each keeps in flight
+#define PRODUCER_COUNT 4
+#define PRODUCER_DEPTH 4
+
+#define PRODUCER_STACK_SIZE 4096
+#define PRODUCER_PRIORITY   (configMAX_PRIORITIES / 2 - 1) // Below main so the stats still print
+
+typedef struct producer_t producer_t;
+
+// Aligned so starlet's cache lines never share with another request
+typedef struct {
+    ipc_message message;
+    producer_t* owner;
+    volatile bool busy;
+} ALIGN(32) request_t;
+
+struct producer_t {
+    request_t requests[PRODUCER_DEPTH];
+    volatile uint32_t completed;
+    volatile uint32_t errors;
+
+    TaskHandle_t task;
+    StaticTask_t task_data;
+    StackType_t task_stack[PRODUCER_STACK_SIZE / sizeof(StackType_t)];
+} ALIGN(32);
+
+framebuffer_t frame_buffer ALIGN(512);
+
+// Nothing lives here, so starlet answers straight away
+static char stress_path[IOS_MAX_PATH] ALIGN(32) = "/dev/ipc_stress";
+
+static producer_t producers[PRODUCER_COUNT];
+
+void retrace_callback() {
+    // Make it so we can see the framebuffer changes
+    system_flush_dcache(&frame_buffer, sizeof(frame_buffer));
+}
+
+static void request_done(void* param, int return_value, BaseType_t* woken) {
+    request_t* request = (request_t*)param;
+    producer_t* producer = request->owner;
+
+    producer->completed++;
+    if(return_value >= 0) {
+        // Should not happen, but do not leak the handle
+        producer->errors++;
+    }
+
+    request->busy = false;
+    vTaskNotifyGiveFromISR(producer->task, woken);
+}
+
+static void producer_task(void* param) {
+    producer_t* producer = (producer_t*)param;
+
+    while(true) {
+        // Top back up to full depth
+        for(int i = 0; i < PRODUCER_DEPTH; i++) {
+            request_t* request = &producer->requests[i];
+            if(request->busy)
+                continue;
+
+            request->busy = true;
+            if(ios_open_async(stress_path, IOS_MODE_READ, &request->message, request_done, request) < 0) {
+                request->busy = false;
+                producer->errors++;
+            }
+        }
+
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+static void print_stats(uint32_t elapsed_ms, const uint32_t* last_completed) {
+    uint32_t total = 0;
+    uint32_t errors = 0;
+
+    printf("  ");
+    for(int i = 0; i < PRODUCER_COUNT; i++) {
+        uint32_t completed = producers[i].completed - last_completed[i];
+        total += completed;
+        errors += producers[i].errors;
+        printf("p%d %6d/s  ", i, completed * 1000 / elapsed_ms);
+    }
+    printf("total %6d/s\n", total * 1000 / elapsed_ms);
+
+    ipc_stats_t stats;
+    ipc_get_stats(&stats);
+
+    uint32_t average_batch = 0;
+    if(stats.batches)
+        average_batch = (uint32_t)(stats.completed * 10 / stats.batches);
+
+    printf("  queue depth max %d, batch avg %d.%d max %d, stalls %d, overflows %d, errors %d\n",
+        stats.max_queue_depth, average_batch / 10, average_batch % 10, stats.max_batch,
+        stats.full_stalls, stats.completion_overflows, errors);
+}
+
+int main() {
+    // Initialize IOS. Must be done first as many thing use it
+    ios_initialize();
+
+    // Get default video mode from IOS and use it to initialize the video interface.
+    video_mode_t tv_mode = video_system_default_video_mode();
+    video_initialize(tv_mode);
+
+    console_initialize(&frame_buffer, &fonts_ibm_iso_8x16);
+    video_set_framebuffer(&frame_buffer);
+    video_set_retrace_callback(retrace_callback);
+
+    framebuffer_fill_rgba(&frame_buffer, 0x000000FF, vec2i_new(0,0), vec2i_new(VIDEO_WIDTH, VIDEO_HEIGHT));
+    console_set_text_color(0xFFFFFFFF, 0x000000FF);
+
+    printf("\n\n\n");
+    printf("  PowerBlocks SDK IPC Stress Example\n");
+    printf("  %d producers, %d requests in flight each\n", PRODUCER_COUNT, PRODUCER_DEPTH);
+
+    ipc_reset_stats();
+
+    for(int i = 0; i < PRODUCER_COUNT; i++) {
+        producer_t* producer = &producers[i];
+        memset(producer, 0, sizeof(*producer));
+
+        for(int j = 0; j < PRODUCER_DEPTH; j++)
+            producer->requests[j].owner = producer;
+
+        producer->task = xTaskCreateStatic(producer_task, "STRESS", PRODUCER_STACK_SIZE / sizeof(StackType_t),
+                                           producer, PRODUCER_PRIORITY, producer->task_stack, &producer->task_data);
+    }
+
+    uint32_t last_completed[PRODUCER_COUNT] = {0};
+    uint64_t last_time = system_get_time_base_int();
+
+    while(true) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+
+        uint64_t now = system_get_time_base_int();
+        uint32_t elapsed_ms = (uint32_t)((now - last_time) / (SYSTEM_TB_CLOCK_HZ / 1000));
+        if(elapsed_ms == 0)
+            continue;
+
+        print_stats(elapsed_ms, last_completed);
+
+        for(int i = 0; i < PRODUCER_COUNT; i++)
+            last_completed[i] = producers[i].completed;
+        last_time = now;
+    }
+
+    return 0;
+}
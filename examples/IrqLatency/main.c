@@ -0,0 +1,125 @@
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/system/exceptions.h"
+#include "powerblocks/core/system/hrtimer.h"
+#include "powerblocks/core/system/deferred.h"
+#include "powerblocks/core/ios/ios.h"
+
+#include "powerblocks/core/graphics/video.h"
+
+#include "powerblocks/core/utils/fonts.h"
+#include "powerblocks/core/utils/console.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+
+// Probe timer, how late it runs is the interrupt latency
+#define PROBE_US       100
+
+// Heavy work, like mixing audio or copying out a frame
+#define WORK_PERIOD_US 5000
+#define WORK_US        300
+
+#define RUN_MS         1000
+
+framebuffer_t frame_buffer ALIGN(512);
+
+static hrtimer_t probe;
+static hrtimer_t work;
+
+void retrace_callback() {
+    // Make it so we can see the framebuffer changes
+    system_flush_dcache(&frame_buffer, sizeof(frame_buffer));
+}
+
+static uint32_t ticks_to_us(uint64_t ticks) {
+    return (uint32_t)(ticks * 1000000 / SYSTEM_TB_CLOCK_HZ);
+}
+
+static void probe_callback(hrtimer_t* timer, void* param) {
+}
+
+static void heavy_work(void* param) {
+    system_delay_int(SYSTEM_US_TO_TICKS(WORK_US));
+}
+
+static void work_inline_callback(hrtimer_t* timer, void* param) {
+    heavy_work(NULL);
+}
+
+static void work_deferred_callback(hrtimer_t* timer, void* param) {
+    deferred_call_from_isr(heavy_work, NULL);
+}
+
+static void measure(const char* name, hrtimer_callback_t work_callback) {
+    hrtimer_reset_stats(&probe);
+
+    if(work_callback != NULL) {
+        hrtimer_initialize(&work, work_callback, NULL);
+        hrtimer_start_us(&work, WORK_PERIOD_US, WORK_PERIOD_US);
+    }
+
+    hrtimer_start_us(&probe, PROBE_US, PROBE_US);
+    vTaskDelay(pdMS_TO_TICKS(RUN_MS));
+    hrtimer_stop(&probe);
+    hrtimer_stop(&work);
+
+    hrtimer_stats_t stats;
+    hrtimer_get_stats(&probe, &stats);
+    printf("  %-22s average %3d us, worst %4d us, %d missed\n", name,
+           stats.count ? ticks_to_us(stats.total_late / stats.count) : 0,
+           ticks_to_us(stats.max_late), stats.missed);
+}
+
+static void print_irq(const char* name, exception_irq_type_t type) {
+    exception_irq_stats_t stats;
+    exceptions_get_irq_stats(type, &stats);
+    printf("  %-6s %6d times, worst %4d us in handler, %4d us waiting on others\n", name, stats.count,
+           ticks_to_us(stats.max_time), ticks_to_us(stats.max_wait));
+}
+
+int main() {
+    // Initialize IOS. Must be done first as many thing use it
+    ios_initialize();
+
+    // Get default video mode from IOS and use it to initialize the video interface.
+    video_mode_t tv_mode = video_system_default_video_mode();
+    video_initialize(tv_mode);
+
+    console_initialize(&frame_buffer, &fonts_ibm_iso_8x16);
+    video_set_framebuffer(&frame_buffer);
+    video_set_retrace_callback(retrace_callback);
+
+    framebuffer_fill_rgba(&frame_buffer, 0x000000FF, vec2i_new(0,0), vec2i_new(VIDEO_WIDTH, VIDEO_HEIGHT));
+    console_set_text_color(0xFFFFFFFF, 0x000000FF);
+
+    printf("\n\n\n");
+    printf("  PowerBlocks SDK IRQ Latency Example\n");
+    printf("  Timer interrupt latency, %d us of work every %d us:\n", WORK_US, WORK_PERIOD_US);
+
+    hrtimer_initialize(&probe, probe_callback, NULL);
+    hrtimer_initialize(&work, work_inline_callback, NULL);
+
+    measure("No work:", NULL);
+    measure("Work in the interrupt:", work_inline_callback);
+    measure("Work deferred:", work_deferred_callback);
+
+    deferred_stats_t deferred;
+    deferred_get_stats(&deferred);
+    printf("  Deferred calls %d, worst start %d us after queued, %d overflowed\n",
+           deferred.completed, ticks_to_us(deferred.max_latency), deferred.overflows);
+
+    printf("  External interrupts:\n");
+    print_irq("VIDEO", EXCEPTION_IRQ_TYPE_VIDEO);
+    print_irq("IPC", EXCEPTION_IRQ_TYPE_IPC);
+    print_irq("PE", EXCEPTION_IRQ_TYPE_PE_FINISH);
+
+    while(true) {
+        // Wait for vsync
+        video_wait_vsync();
+    }
+
+    return 0;
+}
@@ -0,0 +1,202 @@
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/system/exceptions.h"
+#include "powerblocks/core/ios/ios.h"
+
+#include "powerblocks/core/graphics/video.h"
+
+#include "powerblocks/core/utils/fonts.h"
+#include "powerblocks/core/utils/console.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#define YIELD_COUNT      100000
+#define PING_PONG_COUNT  20000
+
+#define SUM_TASKS        4
+#define SUM_TERMS        2000000
+
+#define TASK_STACK_SIZE  8192
+
+// Core clock over time base clock
+#define CYCLES_PER_TICK  (SYSTEM_CORE_CLOCK_HZ / SYSTEM_TB_CLOCK_HZ)
+
+typedef struct {
+    int id;
+    double result;
+    volatile bool done;
+
+    StaticTask_t task_data;
+    StackType_t task_stack[TASK_STACK_SIZE / sizeof(StackType_t)];
+} sum_task_t;
+
+framebuffer_t frame_buffer ALIGN(512);
+
+static TaskHandle_t main_task;
+static TaskHandle_t ping_task;
+static TaskHandle_t pong_task;
+static bool ping_pong_float;
+
+static sum_task_t sum_tasks[SUM_TASKS];
+
+static StaticTask_t ping_data;
+static StaticTask_t pong_data;
+static StackType_t ping_stack[TASK_STACK_SIZE / sizeof(StackType_t)];
+static StackType_t pong_stack[TASK_STACK_SIZE / sizeof(StackType_t)];
+
+void retrace_callback() {
+    // Make it so we can see the framebuffer changes
+    system_flush_dcache(&frame_buffer, sizeof(frame_buffer));
+}
+
+// A little work between each switch, floating point or not
+static void ping_pong_work(uint32_t i) {
+    static volatile uint32_t integer_state = 1;
+    static volatile float float_state = 1.0f;
+
+    if(ping_pong_float) {
+        float_state = float_state * 1.0001f + (float)i;
+    } else {
+        integer_state = integer_state * 1103515245 + i;
+    }
+}
+
+static void ping_task_main(void* param) {
+    for(uint32_t i = 0; i < PING_PONG_COUNT; i++) {
+        ping_pong_work(i);
+        xTaskNotifyGive(pong_task);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+
+    xTaskNotifyGive(main_task);
+    vTaskSuspend(NULL);
+}
+
+static void pong_task_main(void* param) {
+    while(true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        ping_pong_work(0);
+        xTaskNotifyGive(ping_task);
+    }
+}
+
+static double harmonic_sum(int id) {
+    double sum = 0.0;
+    for(int i = 1; i <= SUM_TERMS; i++)
+        sum += 1.0 / (double)(i + id);
+    return sum;
+}
+
+static void sum_task_main(void* param) {
+    sum_task_t* task = (sum_task_t*)param;
+
+    task->result = harmonic_sum(task->id);
+    task->done = true;
+
+    vTaskSuspend(NULL);
+}
+
+static void print_cost(const char* name, uint64_t ticks, uint32_t count) {
+    uint32_t ticks_x100 = (uint32_t)(ticks * 100 / count);
+    uint32_t cycles = (uint32_t)(ticks * CYCLES_PER_TICK / count);
+
+    printf("  %s: %d.%02d ticks, ~%d cycles\n", name, ticks_x100 / 100, ticks_x100 % 100, cycles);
+}
+
+static void yield_benchmark() {
+    // Nothing else at this priority is ready, so each one is straight in and out of the exception
+    uint64_t start = system_get_time_base_int();
+    for(int i = 0; i < YIELD_COUNT; i++)
+        taskYIELD();
+    uint64_t elapsed = system_get_time_base_int() - start;
+
+    print_cost("Yield (exception entry + exit)", elapsed, YIELD_COUNT);
+}
+
+static void ping_pong_benchmark(bool use_float) {
+    ping_pong_float = use_float;
+    uint32_t switches_before = exception_fpu_switch_count;
+
+    uint64_t start = system_get_time_base_int();
+
+    ping_task = xTaskCreateStatic(ping_task_main, "PING", TASK_STACK_SIZE / sizeof(StackType_t), NULL,
+                                  configMAX_PRIORITIES / 2 + 1, ping_stack, &ping_data);
+    pong_task = xTaskCreateStatic(pong_task_main, "PONG", TASK_STACK_SIZE / sizeof(StackType_t), NULL,
+                                  configMAX_PRIORITIES / 2 + 1, pong_stack, &pong_data);
+
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    uint64_t elapsed = system_get_time_base_int() - start;
+
+    vTaskDelete(ping_task);
+    vTaskDelete(pong_task);
+
+    // Two switches per round
+    print_cost(use_float ? "Task switch, float work  " : "Task switch, integer work", elapsed, PING_PONG_COUNT * 2);
+    printf("    FPU owner changes: %d\n", exception_fpu_switch_count - switches_before);
+}
+
+static void sum_check() {
+    double expected[SUM_TASKS];
+    for(int i = 0; i < SUM_TASKS; i++)
+        expected[i] = harmonic_sum(i);
+
+    uint32_t switches_before = exception_fpu_switch_count;
+    TaskHandle_t handles[SUM_TASKS];
+
+    // Same priority as main, they time slice against each other
+    for(int i = 0; i < SUM_TASKS; i++) {
+        sum_tasks[i].id = i;
+        sum_tasks[i].done = false;
+        handles[i] = xTaskCreateStatic(sum_task_main, "SUM", TASK_STACK_SIZE / sizeof(StackType_t), &sum_tasks[i],
+                                       configMAX_PRIORITIES / 2, sum_tasks[i].task_stack, &sum_tasks[i].task_data);
+    }
+
+    int errors = 0;
+    for(int i = 0; i < SUM_TASKS; i++) {
+        while(!sum_tasks[i].done)
+            vTaskDelay(pdMS_TO_TICKS(1));
+        vTaskDelete(handles[i]);
+
+        if(sum_tasks[i].result != expected[i])
+            errors++;
+    }
+
+    printf("  %d tasks summing in parallel: %s, FPU owner changes: %d\n", SUM_TASKS,
+           errors ? "MISMATCH" : "OK", exception_fpu_switch_count - switches_before);
+}
+
+int main() {
+    // Initialize IOS. Must be done first as many thing use it
+    ios_initialize();
+
+    // Get default video mode from IOS and use it to initialize the video interface.
+    video_mode_t tv_mode = video_system_default_video_mode();
+    video_initialize(tv_mode);
+
+    console_initialize(&frame_buffer, &fonts_ibm_iso_8x16);
+    video_set_framebuffer(&frame_buffer);
+    video_set_retrace_callback(retrace_callback);
+
+    framebuffer_fill_rgba(&frame_buffer, 0x000000FF, vec2i_new(0,0), vec2i_new(VIDEO_WIDTH, VIDEO_HEIGHT));
+    console_set_text_color(0xFFFFFFFF, 0x000000FF);
+
+    printf("\n\n\n");
+    printf("  PowerBlocks SDK Lazy FPU Example\n");
+
+    main_task = xTaskGetCurrentTaskHandle();
+
+    yield_benchmark();
+    ping_pong_benchmark(false);
+    ping_pong_benchmark(true);
+    sum_check();
+
+    while(true) {
+        // Wait for vsync
+        video_wait_vsync();
+    }
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/system/mem.h"
+#include "powerblocks/core/system/cpu.h"
+#include "powerblocks/core/ios/ios.h"
+
+#include "powerblocks/core/graphics/video.h"
+
+#include "powerblocks/core/utils/fonts.h"
+#include "powerblocks/core/utils/console.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define BUFFER_SIZE     (1024 * 1024)
+
+// Each size is repeated till about this much is moved
+#define BYTES_PER_TEST  (4 * 1024 * 1024)
+
+// Core clock over time base clock
+#define CYCLES_PER_TICK (SYSTEM_CORE_CLOCK_HZ / SYSTEM_TB_CLOCK_HZ)
+
+typedef enum {
+    TEST_MEMCPY,
+    TEST_WORD_LOOP,
+    TEST_MEMSET_ZERO,
+    TEST_MEMSET_VALUE
+} test_t;
+
+framebuffer_t frame_buffer ALIGN(512);
+
+static const uint32_t sizes[] = { 64, 256, 1024, 4096, 16384, 65536, 262144, 1048576 };
+
+static uint8_t* source;
+static uint8_t* destination;
+
+void retrace_callback() {
+    // Make it so we can see the framebuffer changes
+    system_flush_dcache(&frame_buffer, sizeof(frame_buffer));
+}
+
+static void word_loop(uint32_t* d, const uint32_t* s, uint32_t size) {
+    for(uint32_t i = 0; i < size / 4; i++)
+        d[i] = s[i];
+}
+
+// Bytes per cycle, times 100
+static uint32_t run(test_t test, uint32_t size) {
+    uint32_t count = BYTES_PER_TEST / size;
+
+    uint64_t start = system_get_time_base_int();
+    for(uint32_t i = 0; i < count; i++) {
+        switch(test) {
+            case TEST_MEMCPY:       memcpy(destination, source, size); break;
+            case TEST_WORD_LOOP:    word_loop((uint32_t*)destination, (const uint32_t*)source, size); break;
+            case TEST_MEMSET_ZERO:  memset(destination, 0, size); break;
+            case TEST_MEMSET_VALUE: memset(destination, 0x5A, size); break;
+        }
+    }
+    uint64_t elapsed = system_get_time_base_int() - start;
+
+    return (uint32_t)((uint64_t)size * count * 100 / (elapsed * CYCLES_PER_TICK));
+}
+
+static void print_value(uint32_t value_x100) {
+    printf("  %3d.%02d", value_x100 / 100, value_x100 % 100);
+}
+
+int main() {
+    // Initialize IOS. Must be done first as many thing use it
+    ios_initialize();
+
+    // Get default video mode from IOS and use it to initialize the video interface.
+    video_mode_t tv_mode = video_system_default_video_mode();
+    video_initialize(tv_mode);
+
+    console_initialize(&frame_buffer, &fonts_ibm_iso_8x16);
+    video_set_framebuffer(&frame_buffer);
+    video_set_retrace_callback(retrace_callback);
+
+    framebuffer_fill_rgba(&frame_buffer, 0x000000FF, vec2i_new(0,0), vec2i_new(VIDEO_WIDTH, VIDEO_HEIGHT));
+    console_set_text_color(0xFFFFFFFF, 0x000000FF);
+
+    printf("\n\n\n");
+    printf("  PowerBlocks SDK Memory Copy Example\n");
+
+    source = mem1_aligned_alloc(BUFFER_SIZE, 32);
+    destination = mem1_aligned_alloc(BUFFER_SIZE, 32);
+    if(source == NULL || destination == NULL) {
+        printf("Failed to allocate buffers.\n");
+        goto ERROR;
+    }
+
+    for(uint32_t i = 0; i < BUFFER_SIZE; i++)
+        source[i] = (uint8_t)i;
+
+    int count = sizeof(sizes) / sizeof(sizes[0]);
+    uint32_t integer_copy[sizeof(sizes) / sizeof(sizes[0])];
+
+    // This task should not have used the FPU yet
+    uint32_t msr;
+    SYSTEM_GET_MSR(msr);
+    bool fpu_in_use = (msr & MSR_FP) != 0;
+
+    for(int i = 0; i < count; i++)
+        integer_copy[i] = run(TEST_MEMCPY, sizes[i]);
+
+    // Now it has, memcpy will move 8 bytes at a time
+    volatile double claim_fpu = 1.0;
+    claim_fpu *= 2.0;
+
+    printf("  Bytes per cycle:\n");
+    printf("     Size  memcpy  +FPU    loop  set 0   set 5A\n");
+
+    for(int i = 0; i < count; i++) {
+        printf("  %7d", sizes[i]);
+        print_value(integer_copy[i]);
+        print_value(run(TEST_MEMCPY, sizes[i]));
+        print_value(run(TEST_WORD_LOOP, sizes[i]));
+        print_value(run(TEST_MEMSET_ZERO, sizes[i]));
+        print_value(run(TEST_MEMSET_VALUE, sizes[i]));
+        printf("\n");
+    }
+
+    if(fpu_in_use)
+        printf("  The FPU was already in use, both memcpy columns used it.\n");
+
+    memcpy(destination, source, BUFFER_SIZE);
+    printf("  Copy %s\n", memcmp(source, destination, BUFFER_SIZE) == 0 ? "matches" : "DOES NOT MATCH");
+
+ERROR:
+
+    while(true) {
+        // Wait for vsync
+        video_wait_vsync();
+    }
+
+    return 0;
+}
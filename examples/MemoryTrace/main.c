@@ -0,0 +1,162 @@
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/system/mem.h"
+#include "powerblocks/core/ios/ios.h"
+
+#include "powerblocks/core/graphics/video.h"
+
+#include "powerblocks/core/utils/fonts.h"
+#include "powerblocks/core/utils/console.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define TRACE_SEED    0x12345678
+#define TRACE_LENGTH  200000
+#define TRACE_SLOTS   1024
+
+// One in this many allocations is large
+#define LARGE_CHANCE  32
+#define SMALL_MAX     512
+#define LARGE_MAX     (256 * 1024)
+
+typedef struct {
+    void* ptr;
+    uint32_t size;
+} slot_t;
+
+typedef struct {
+    uint64_t total;
+    uint32_t worst;
+    uint32_t count;
+} timing_t;
+
+framebuffer_t frame_buffer ALIGN(512);
+
+static slot_t slots[TRACE_SLOTS];
+
+void retrace_callback() {
+    // Make it so we can see the framebuffer changes
+    system_flush_dcache(&frame_buffer, sizeof(frame_buffer));
+}
+
+static uint32_t trace_random(uint32_t* state) {
+    *state = *state * 1664525 + 1013904223;
+    return *state >> 8;
+}
+
+static void timing_add(timing_t* timing, uint64_t ticks) {
+    timing->total += ticks;
+    timing->count++;
+    if(ticks > timing->worst)
+        timing->worst = (uint32_t)ticks;
+}
+
+static void print_timing(const char* name, const timing_t* timing) {
+    uint32_t average_x100 = timing->count ? (uint32_t)(timing->total * 100 / timing->count) : 0;
+    printf("    %-8s %6d: avg %d.%02d ticks, worst %d ticks\n", name, timing->count,
+           average_x100 / 100, average_x100 % 100, timing->worst);
+}
+
+static void print_stats(const char* when, mem_arena_t arena) {
+    tlsf_stats_t stats;
+    mem_get_stats(arena, &stats);
+
+    printf("    %s: used %d KB, peak %d KB, free %d KB in %d blocks, largest %d KB\n", when,
+           stats.used / 1024, stats.peak_used / 1024, stats.free / 1024, stats.free_blocks, stats.largest_free / 1024);
+}
+
+static void* arena_alloc(mem_arena_t arena, uint32_t size, uint32_t alignment) {
+    if(arena == MEM_ARENA_MEM1)
+        return alignment ? mem1_aligned_alloc(size, alignment) : mem1_alloc(size);
+    return alignment ? mem2_aligned_alloc(size, alignment) : mem2_alloc(size);
+}
+
+static void replay(mem_arena_t arena) {
+    timing_t alloc_timing = {0};
+    timing_t free_timing = {0};
+    uint32_t failures = 0;
+    uint32_t mismatches = 0;
+
+    uint32_t state = TRACE_SEED;
+    memset(slots, 0, sizeof(slots));
+
+    for(int i = 0; i < TRACE_LENGTH; i++) {
+        slot_t* slot = &slots[trace_random(&state) % TRACE_SLOTS];
+
+        if(slot->ptr) {
+            // Check nothing else wrote over it
+            if(*(uint8_t*)slot->ptr != (uint8_t)slot->size)
+                mismatches++;
+
+            uint64_t start = system_get_time_base_int();
+            mem_free(slot->ptr);
+            timing_add(&free_timing, system_get_time_base_int() - start);
+
+            slot->ptr = NULL;
+            continue;
+        }
+
+        uint32_t random = trace_random(&state);
+        uint32_t size = (random % LARGE_CHANCE) == 0 ? random % LARGE_MAX : random % SMALL_MAX;
+        uint32_t alignment = (random & 0x300) == 0 ? 32 : 0;
+
+        uint64_t start = system_get_time_base_int();
+        void* ptr = arena_alloc(arena, size + 1, alignment);
+        timing_add(&alloc_timing, system_get_time_base_int() - start);
+
+        if(ptr == NULL) {
+            failures++;
+            continue;
+        }
+
+        *(uint8_t*)ptr = (uint8_t)size;
+        slot->ptr = ptr;
+        slot->size = size;
+    }
+
+    print_timing("Alloc", &alloc_timing);
+    print_timing("Free", &free_timing);
+    printf("    Failed allocations: %d, overwritten: %d\n", failures, mismatches);
+    print_stats("End of trace", arena);
+
+    for(int i = 0; i < TRACE_SLOTS; i++) {
+        mem_free(slots[i].ptr);
+        slots[i].ptr = NULL;
+    }
+
+    print_stats("All freed   ", arena);
+    printf("    Heap check: %s\n", mem_check(arena) < 0 ? "DAMAGED" : "OK");
+}
+
+int main() {
+    // Initialize IOS. Must be done first as many thing use it
+    ios_initialize();
+
+    // Get default video mode from IOS and use it to initialize the video interface.
+    video_mode_t tv_mode = video_system_default_video_mode();
+    video_initialize(tv_mode);
+
+    console_initialize(&frame_buffer, &fonts_ibm_iso_8x16);
+    video_set_framebuffer(&frame_buffer);
+    video_set_retrace_callback(retrace_callback);
+
+    framebuffer_fill_rgba(&frame_buffer, 0x000000FF, vec2i_new(0,0), vec2i_new(VIDEO_WIDTH, VIDEO_HEIGHT));
+    console_set_text_color(0xFFFFFFFF, 0x000000FF);
+
+    printf("\n\n\n");
+    printf("  PowerBlocks SDK Memory Trace Example\n");
+
+    printf("  MEM1:\n");
+    replay(MEM_ARENA_MEM1);
+
+    printf("  MEM2:\n");
+    replay(MEM_ARENA_MEM2);
+
+    while(true) {
+        // Wait for vsync
+        video_wait_vsync();
+    }
+
+    return 0;
+}
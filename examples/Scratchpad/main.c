@@ -0,0 +1,162 @@
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/system/mem.h"
+#include "powerblocks/core/system/scratchpad.h"
+#include "powerblocks/core/ios/ios.h"
+
+#include "powerblocks/core/graphics/video.h"
+
+#include "powerblocks/core/utils/fonts.h"
+#include "powerblocks/core/utils/console.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define PARTICLE_COUNT 32768
+#define IMAGE_SIZE     (512 * 512 * 4)
+#define CHUNK_SIZE     SCRATCHPAD_STREAM_CHUNK_MAX
+
+typedef struct {
+    float position[3];
+    float velocity[3];
+    float life;
+    float padding;
+} particle_t;
+
+framebuffer_t frame_buffer ALIGN(512);
+
+void retrace_callback() {
+    // Make it so we can see the framebuffer changes
+    system_flush_dcache(&frame_buffer, sizeof(frame_buffer));
+}
+
+static void particle_kernel(const void* input, void* output, uint32_t size, void* param) {
+    const particle_t* in = (const particle_t*)input;
+    particle_t* out = (particle_t*)output;
+    float dt = *(float*)param;
+
+    for(uint32_t i = 0; i < size / sizeof(particle_t); i++) {
+        out[i].velocity[0] = in[i].velocity[0];
+        out[i].velocity[1] = in[i].velocity[1] - 9.8f * dt;
+        out[i].velocity[2] = in[i].velocity[2];
+
+        out[i].position[0] = in[i].position[0] + out[i].velocity[0] * dt;
+        out[i].position[1] = in[i].position[1] + out[i].velocity[1] * dt;
+        out[i].position[2] = in[i].position[2] + out[i].velocity[2] * dt;
+
+        out[i].life = in[i].life - dt;
+        out[i].padding = 0.0f;
+    }
+}
+
+static void argb_kernel(const void* input, void* output, uint32_t size, void* param) {
+    const uint32_t* in = (const uint32_t*)input;
+    uint32_t* out = (uint32_t*)output;
+
+    for(uint32_t i = 0; i < size / 4; i++)
+        out[i] = (in[i] >> 8) | (in[i] << 24);
+}
+
+static void fill_particles(void* memory) {
+    particle_t* particles = (particle_t*)memory;
+    for(int i = 0; i < PARTICLE_COUNT; i++) {
+        particles[i].position[0] = (float)(i % 64);
+        particles[i].position[1] = (float)(i / 64 % 64);
+        particles[i].position[2] = (float)(i / 4096);
+        particles[i].velocity[0] = (float)(i % 7) - 3.0f;
+        particles[i].velocity[1] = (float)(i % 11);
+        particles[i].velocity[2] = (float)(i % 5) - 2.0f;
+        particles[i].life = 5.0f;
+        particles[i].padding = 0.0f;
+    }
+}
+
+static void fill_image(void* memory) {
+    uint32_t* image = (uint32_t*)memory;
+    for(int i = 0; i < IMAGE_SIZE / 4; i++)
+        image[i] = i * 2654435761u;
+}
+
+static uint32_t ticks_to_us(uint64_t ticks) {
+    return (uint32_t)(ticks / (SYSTEM_TB_CLOCK_HZ / 1000000));
+}
+
+static void compare(const char* name, void (*fill)(void*), scratchpad_kernel_t kernel, void* param, uint32_t size) {
+    uint8_t* direct = mem2_aligned_alloc(size, 32);
+    uint8_t* streamed = mem2_aligned_alloc(size, 32);
+    if(direct == NULL || streamed == NULL) {
+        printf("  %s: out of memory\n", name);
+        mem_free(direct);
+        mem_free(streamed);
+        return;
+    }
+
+    fill(direct);
+    fill(streamed);
+
+    // Out of the cache both times
+    system_flush_dcache(direct, size);
+    system_flush_dcache(streamed, size);
+
+    uint64_t start = system_get_time_base_int();
+    kernel(direct, direct, size, param);
+    uint64_t direct_time = system_get_time_base_int() - start;
+
+    start = system_get_time_base_int();
+    int ret = scratchpad_stream(streamed, streamed, size, CHUNK_SIZE, kernel, param);
+    uint64_t streamed_time = system_get_time_base_int() - start;
+
+    const char* result = "OK";
+    if(ret < 0)
+        result = "FAILED";
+    else if(memcmp(direct, streamed, size) != 0)
+        result = "MISMATCH";
+
+    printf("  %s, %d KB:\n", name, size / 1024);
+    printf("    Direct:     %6d us\n", ticks_to_us(direct_time));
+    printf("    Scratchpad: %6d us  %s\n", ticks_to_us(streamed_time), result);
+
+    mem_free(direct);
+    mem_free(streamed);
+}
+
+int main() {
+    // Initialize IOS. Must be done first as many thing use it
+    ios_initialize();
+
+    // Get default video mode from IOS and use it to initialize the video interface.
+    video_mode_t tv_mode = video_system_default_video_mode();
+    video_initialize(tv_mode);
+
+    console_initialize(&frame_buffer, &fonts_ibm_iso_8x16);
+    video_set_framebuffer(&frame_buffer);
+    video_set_retrace_callback(retrace_callback);
+
+    framebuffer_fill_rgba(&frame_buffer, 0x000000FF, vec2i_new(0,0), vec2i_new(VIDEO_WIDTH, VIDEO_HEIGHT));
+    console_set_text_color(0xFFFFFFFF, 0x000000FF);
+
+    printf("\n\n\n");
+    printf("  PowerBlocks SDK Scratchpad Example\n");
+
+    if(scratchpad_enable() == NULL) {
+        printf("Failed to enable the scratchpad.\n");
+        goto ERROR;
+    }
+
+    float dt = 1.0f / 60.0f;
+    compare("Particles", fill_particles, particle_kernel, &dt, PARTICLE_COUNT * sizeof(particle_t));
+    compare("RGBA to ARGB", fill_image, argb_kernel, NULL, IMAGE_SIZE);
+
+    printf("  DMA errors: 0x%08X\n", scratchpad_get_errors());
+
+    scratchpad_disable();
+
+ERROR:
+
+    while(true) {
+        // Wait for vsync
+        video_wait_vsync();
+    }
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/ios/ios.h"
+
+#include "powerblocks/core/graphics/video.h"
+
+#include "powerblocks/core/utils/fonts.h"
+#include "powerblocks/core/utils/console.h"
+#include "powerblocks/core/utils/task_monitor.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#define TASK_STACK_SIZE  16384
+
+// The busy task runs this much of every 10 ms
+#define BUSY_MS          3
+
+// How deep the stack task goes
+#define RECURSE_DEPTH    40
+
+#define MONITOR_PERIOD_MS 1000
+
+framebuffer_t frame_buffer ALIGN(512);
+
+static StaticTask_t busy_data;
+static StaticTask_t stack_data;
+static StackType_t busy_stack[TASK_STACK_SIZE / sizeof(StackType_t)];
+static StackType_t stack_stack[TASK_STACK_SIZE / sizeof(StackType_t)];
+
+void retrace_callback() {
+    // Make it so we can see the framebuffer changes
+    system_flush_dcache(&frame_buffer, sizeof(frame_buffer));
+}
+
+// About 30% of the CPU
+static void busy_task(void* param) {
+    while(true) {
+        system_delay_int(SYSTEM_MS_TO_TICKS(BUSY_MS));
+        vTaskDelay(pdMS_TO_TICKS(10 - BUSY_MS));
+    }
+}
+
+// Uses about 200 bytes of stack a call, so the peak is easy to see
+static uint32_t recurse(uint32_t depth) {
+    volatile uint8_t frame[192];
+    frame[0] = (uint8_t)depth;
+
+    if(depth == 0)
+        return frame[0];
+    return recurse(depth - 1) + frame[0];
+}
+
+static void stack_task(void* param) {
+    while(true) {
+        recurse(RECURSE_DEPTH);
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+}
+
+int main() {
+    // Initialize IOS. Must be done first as many thing use it
+    ios_initialize();
+
+    // Get default video mode from IOS and use it to initialize the video interface.
+    video_mode_t tv_mode = video_system_default_video_mode();
+    video_initialize(tv_mode);
+
+    console_initialize(&frame_buffer, &fonts_ibm_iso_8x16);
+    video_set_framebuffer(&frame_buffer);
+    video_set_retrace_callback(retrace_callback);
+
+    framebuffer_fill_rgba(&frame_buffer, 0x000000FF, vec2i_new(0,0), vec2i_new(VIDEO_WIDTH, VIDEO_HEIGHT));
+    console_set_text_color(0xFFFFFFFF, 0x000000FF);
+
+    printf("\n\n\n");
+    printf("  PowerBlocks SDK Task Stats Example\n");
+    printf("  BUSY should use about %d%% of the CPU, STACK should peak around %d KB.\n",
+           BUSY_MS * 10, RECURSE_DEPTH * 200 / 1024);
+
+    xTaskCreateStatic(busy_task, "BUSY", TASK_STACK_SIZE / sizeof(StackType_t), NULL, 3, busy_stack, &busy_data);
+    xTaskCreateStatic(stack_task, "STACK", TASK_STACK_SIZE / sizeof(StackType_t), NULL, 3, stack_stack, &stack_data);
+
+    // Redraws every second, logging is left off so the console does not scroll over it
+    task_monitor_set_overlay(&frame_buffer, &fonts_ibm_iso_8x16, vec2i_new(24, 112));
+    task_monitor_start(MONITOR_PERIOD_MS, false);
+
+    while(true) {
+        // Wait for vsync
+        video_wait_vsync();
+    }
+
+    return 0;
+}
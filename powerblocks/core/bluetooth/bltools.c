@@ -139,7 +139,7 @@ static int bltools_start_worker() {
     bltools_worker_instance->task_queue = xQueueCreateStatic(BLTOOLS_DISCOVERY_TASK_QUEUE_SIZE, sizeof(bltools_discovery_task_queue_item_t),
         (uint8_t*)bltools_worker_instance->queue_storage_buffer, &bltools_worker_instance->queue_buffer);
     
-    bltools_worker_instance->task = xTaskCreateStatic(bltools_discovery_task, TAG, sizeof(bltools_worker_instance->task_stack),
+    bltools_worker_instance->task = xTaskCreateStatic(bltools_discovery_task, TAG, sizeof(bltools_worker_instance->task_stack) / sizeof(StackType_t),
                       bltools_worker_instance, BLTOOLS_TASK_PRIORITY, bltools_worker_instance->task_stack, &bltools_worker_instance->task_data);
 
     return 0;
@@ -261,10 +261,10 @@ static int hci_transfer(uint8_t ioctl, uint8_t endpoint, void* buffer, uint16_t
 
 static int hci_transfer_async(uint8_t ioctl, uint8_t endpoint, void* buffer, uint16_t size, uint8_t* ipc_buffer, ipc_async_handler_t handler, void* params) {
     ios_ioctlv_t* vectors = (ios_ioctlv_t*)(ipc_buffer + 0);
-    ios_ioctlv_t* vectors_buffer = (ios_ioctlv_t*)(ipc_buffer + 32);
-    uint8_t* b_endpoint_buffer = (uint8_t*)(ipc_buffer + 64);
-    uint16_t* w_length_buffer = (uint16_t*)(ipc_buffer + 96);
-    ipc_message* message = (ipc_message*)(ipc_buffer + 128);
+    ios_ioctlv_t* vectors_buffer = (ios_ioctlv_t*)(ipc_buffer + HCI_IPC_VECTORS_SIZE);
+    uint8_t* b_endpoint_buffer = (uint8_t*)(ipc_buffer + HCI_IPC_VECTORS_SIZE * 2);
+    uint16_t* w_length_buffer = (uint16_t*)(ipc_buffer + HCI_IPC_VECTORS_SIZE * 2 + 32);
+    ipc_message* message = (ipc_message*)(ipc_buffer + HCI_IPC_VECTORS_SIZE * 2 + 64);
 
     b_endpoint_buffer[0] = endpoint;
     w_length_buffer[0] = htobe16(size);
@@ -1237,10 +1237,11 @@ static void hci_task_handle_name_request_complete(const hci_event* event) {
     }
 
     hci_state.name_request_error_code = event->parameters[0];
-    memcpy(hci_state.current_name_request, event->parameters + 7, HCI_MAX_NAME_REQUEST_LENGTH);
+    // The name is the 248 bytes after the status and address, the request buffer is bigger
+    memcpy(hci_state.current_name_request, event->parameters + 7, HCI_MAX_EVENT_LENGTH - 7);
 
     // Ensure it ends in zero just in case
-    hci_state.current_name_request[HCI_MAX_NAME_REQUEST_LENGTH-1] = 0;
+    hci_state.current_name_request[HCI_MAX_EVENT_LENGTH - 7] = 0;
 
     // Alert waiter
     hci_state.current_name_request = NULL;
@@ -1365,6 +1366,6 @@ static void hci_task(void* unused_1) {
 
     xSemaphoreGive(hci_state.waiter_event);
     
-    // Return from task into infinite loop.
-    // Because this FreeRTOSs port supports that
+    // Wait to be deleted, not every port lets a task return
+    vTaskSuspend(NULL);
 }
\ No newline at end of file
@@ -78,7 +78,10 @@ typedef enum {
 #define HCI_MAX_ACL_DATA_LENGTH 512
 
 // Defines the amount of data on the stack needed for the ACL receive, used to be kept around for async
-#define HCI_ACL_RECEIVE_IPC_BUFFER_SIZE (32 + 32 + 32 + 32 + sizeof(ipc_message))
+// Each part starts on its own 32 byte line. The three vectors fit in one on the Wii,
+// they take more where pointers are wider.
+#define HCI_IPC_VECTORS_SIZE ((3 * sizeof(ios_ioctlv_t) + 31) & ~31)
+#define HCI_ACL_RECEIVE_IPC_BUFFER_SIZE (HCI_IPC_VECTORS_SIZE + HCI_IPC_VECTORS_SIZE + 32 + 32 + sizeof(ipc_message))
 
 typedef struct {
     uint16_t handle;
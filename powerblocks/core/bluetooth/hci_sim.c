@@ -0,0 +1,987 @@
+/**
+ * @file hci_sim.c
+ * @brief Simulated Bluetooth HCI Controller
+ *
+ * A software stand-in for the Wii's USB bluetooth dongle
+ * at /dev/usb/oh1/57e/305, installed as a virtual IOS device.
+ *
+ * Everything runs in one task that owns all of the simulator state.
+ * Requests coming from the stack are queued to it, reads from the event
+ * and ACL endpoints are parked until it has something to hand back.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ */
+
+#include "hci_sim.h"
+
+#include "hci.h"
+#include "l2cap.h"
+
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/ios/ios.h"
+#include "powerblocks/core/ios/ios_virtual.h"
+
+#include "powerblocks/core/utils/log.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "blerror.h"
+
+#include <string.h>
+#include <endian.h>
+
+static const char* TAG = "HCI_SIM";
+
+#define HCI_SIM_TASK_STACK_SIZE  4096
+#define HCI_SIM_TASK_PRIORITY    (configMAX_PRIORITIES - 2) // Above the stack, it plays the part of hardware
+
+#define HCI_SIM_REQUEST_QUEUE_SIZE 16
+#define HCI_SIM_EVENT_QUEUE_SIZE   32 // Power of 2
+#define HCI_SIM_ACL_QUEUE_SIZE     32 // Power of 2
+#define HCI_SIM_MAX_ACL_WAITERS    4
+
+// Wiimote traffic is tiny, so ACL packets from the simulator are
+// capped well below the 339 bytes the controller advertises.
+#define HCI_SIM_MAX_ACL_SIZE 128
+
+#define HCI_SIM_ERROR_LOGGING
+//#define HCI_SIM_INFO_LOGGING
+
+#ifdef HCI_SIM_ERROR_LOGGING
+#define HCI_SIM_LOG_ERROR(fmt, ...) LOG_ERROR(TAG, fmt, ##__VA_ARGS__)
+#else
+#define HCI_SIM_LOG_ERROR(fmt, ...)
+#endif
+
+#ifdef HCI_SIM_INFO_LOGGING
+#define HCI_SIM_LOG_INFO(fmt, ...) LOG_INFO(TAG, fmt, ##__VA_ARGS__)
+#else
+#define HCI_SIM_LOG_INFO(fmt, ...)
+#endif
+
+// What the stack sends through IOS, see hci.c
+#define IOS_COMMAND_CLOSE  2
+#define IOS_COMMAND_IOCTLV 7
+
+#define HCI_IOS_IOCTL_USB_CONTROL   0
+#define HCI_IOS_IOCTL_USB_BULK      1
+#define HCI_IOS_IOCTL_USB_INTERRUPT 2
+
+#define HCI_ENDPOINT_ACL_OUT 0x02
+#define HCI_ENDPOINT_EVENTS  0x81
+#define HCI_ENDPOINT_ACL_IN  0x82
+
+#define HCI_EVENT_INQUIRY_COMPLETE             0x01
+#define HCI_EVENT_INQUIRY_RESULT               0x02
+#define HCI_EVENT_CONNECTION_COMPLETE          0x03
+#define HCI_EVENT_DISCONNECTION_COMPLETE       0x05
+#define HCI_EVENT_REMOTE_NAME_REQUEST_COMPLETE 0x07
+#define HCI_EVENT_COMMAND_COMPLETE             0x0E
+#define HCI_EVENT_COMMAND_STATUS               0x0F
+#define HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS  0x13
+
+#define HCI_OPCODE_READ_LOCAL_VERSION_INFORMATION 0x1001
+#define HCI_OPCODE_READ_LOCAL_SUPPORTED_FEATURES  0x1003
+#define HCI_OPCODE_READ_BUFFER_SIZE               0x1005
+#define HCI_OPCODE_READ_BD_ADDR                   0x1009
+#define HCI_OPCODE_INQUIRY_START                  0x0401
+#define HCI_OPCODE_CREATE_CONNECTION              0x0405
+#define HCI_OPCODE_DISCONNECT                     0x0406
+#define HCI_OPCODE_ACCEPT_CONNECTION              0x0409
+#define HCI_OPCODE_REJECT_CONNECTION              0x040A
+#define HCI_OPCODE_REMOTE_NAME_REQUEST            0x0419
+#define HCI_OPCODE_RESET                          0x0C03
+
+#define L2CAP_SIGNAL_CODE_CONNECTION_REQUEST     0x02
+#define L2CAP_SIGNAL_CODE_CONNECTION_RESPONSE    0x03
+#define L2CAP_SIGNAL_CODE_CONFIGURE_REQUEST      0x04
+#define L2CAP_SIGNAL_CODE_CONFIGURE_RESPONSE     0x05
+#define L2CAP_SIGNAL_CODE_DISCONNECTION_REQUEST  0x06
+#define L2CAP_SIGNAL_CODE_DISCONNECTION_RESPONSE 0x07
+
+#define HID_PSM_CONTROL   0x0011
+#define HID_PSM_INTERRUPT 0x0013
+
+#define HID_INPUT_REPORT  0xA1
+#define HID_OUTPUT_REPORT 0xA2
+
+// The CIDs our synthetic remotes hand out
+#define HCI_SIM_CONTROL_CID   0x0070
+#define HCI_SIM_INTERRUPT_CID 0x0071
+
+// Handles are arbitrary, these just make them easy to spot
+#define HCI_SIM_HANDLE_BASE 0x0100
+
+typedef struct {
+    uint16_t length;
+    uint8_t data[2 + 255];
+} hci_sim_event_t;
+
+typedef struct {
+    uint64_t timestamp; // Time a synthetic report was made, 0 for anything else
+    uint16_t length;
+    uint8_t data[HCI_SIM_MAX_ACL_SIZE];
+} hci_sim_acl_t;
+
+typedef struct {
+    uint8_t address[6];
+    bool connected;
+    uint16_t handle;
+
+    uint16_t host_control_cid;
+    uint16_t host_interrupt_cid;
+
+    uint8_t leds;
+    uint8_t report_mode;
+    bool continuous; // Otherwise only sent when the report changes
+    bool streaming;
+    uint8_t last_report[2 + 21];
+    uint64_t next_report;
+    uint32_t frame;
+} hci_sim_remote_t;
+
+static struct {
+    bool running;
+    hci_sim_config_t config;
+
+    TaskHandle_t task;
+    QueueHandle_t requests;
+
+    uint64_t report_period; // Time base ticks between reports
+
+    // Reads parked until there is data
+    ipc_message* event_waiter;
+    ipc_message* acl_waiters[HCI_SIM_MAX_ACL_WAITERS];
+    int acl_waiter_count;
+
+    // Data waiting on a read
+    hci_sim_event_t events[HCI_SIM_EVENT_QUEUE_SIZE];
+    uint32_t event_head, event_tail;
+    hci_sim_acl_t acl[HCI_SIM_ACL_QUEUE_SIZE];
+    uint32_t acl_head, acl_tail;
+
+    // Trace replay
+    bool trace_active;
+    size_t trace_offset;
+    uint64_t trace_next;
+
+    uint8_t signal_id;
+    hci_sim_remote_t remotes[HCI_SIM_MAX_REMOTES];
+
+    hci_sim_stats_t stats;
+
+    StaticQueue_t request_queue_data;
+    ipc_message* request_queue_storage[HCI_SIM_REQUEST_QUEUE_SIZE];
+} hci_sim_state;
+
+static int hci_sim_open(void* user, int mode);
+static void hci_sim_submit(void* user, ipc_message* message);
+
+static const ios_virtual_device_t hci_sim_device = {
+    .path = "/dev/usb/oh1/57e/305",
+    .open = hci_sim_open,
+    .submit = hci_sim_submit,
+    .user = NULL
+};
+
+static const uint8_t hci_sim_bd_address[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+
+// Wiimote default calibration (0x0016 in EEPROM), zero G then one G
+static const uint8_t hci_sim_calibration[8] = {0x80, 0x80, 0x80, 0x00, 0x9A, 0x9A, 0x9A, 0x00};
+
+// Size of each report type starting from 0x30
+static const uint8_t hci_sim_report_lengths[] = {
+    2, 5, 10, 17, 21, 21, 21, 21, 0, 0, 0, 0, 0, 21, 21, 21
+};
+
+/* -------------------Outgoing Queues--------------------- */
+
+static bool hci_sim_push_event(uint8_t code, const uint8_t* params, uint8_t length) {
+    if(hci_sim_state.event_head - hci_sim_state.event_tail >= HCI_SIM_EVENT_QUEUE_SIZE) {
+        HCI_SIM_LOG_ERROR("Event queue full, dropping event %02X", code);
+        return false;
+    }
+
+    hci_sim_event_t* event = &hci_sim_state.events[hci_sim_state.event_head & (HCI_SIM_EVENT_QUEUE_SIZE - 1)];
+    event->data[0] = code;
+    event->data[1] = length;
+    memcpy(event->data + 2, params, length);
+    event->length = length + 2;
+
+    hci_sim_state.event_head++;
+    return true;
+}
+
+static bool hci_sim_push_acl_raw(const uint8_t* data, uint16_t length, uint64_t timestamp) {
+    if(length > HCI_SIM_MAX_ACL_SIZE)
+        return false;
+
+    if(hci_sim_state.acl_head - hci_sim_state.acl_tail >= HCI_SIM_ACL_QUEUE_SIZE)
+        return false;
+
+    hci_sim_acl_t* acl = &hci_sim_state.acl[hci_sim_state.acl_head & (HCI_SIM_ACL_QUEUE_SIZE - 1)];
+    memcpy(acl->data, data, length);
+    acl->length = length;
+    acl->timestamp = timestamp;
+
+    hci_sim_state.acl_head++;
+    return true;
+}
+
+// Wraps a L2CAP payload into a ACL packet from a remote
+static bool hci_sim_push_l2cap(const hci_sim_remote_t* remote, uint16_t cid, const uint8_t* payload, uint16_t length, uint64_t timestamp) {
+    uint8_t packet[HCI_SIM_MAX_ACL_SIZE];
+
+    if(length + 8 > sizeof(packet))
+        return false;
+
+    uint16_t handle = remote->handle | (HCI_ACL_PACKET_BOUNDARY_FLAG_FIRST_AUTOMATICALLY_FLUSHABLE_PACKET << 12);
+    uint16_t acl_length = length + 4;
+
+    packet[0] = handle & 0xFF;
+    packet[1] = handle >> 8;
+    packet[2] = acl_length & 0xFF;
+    packet[3] = acl_length >> 8;
+    packet[4] = length & 0xFF;
+    packet[5] = length >> 8;
+    packet[6] = cid & 0xFF;
+    packet[7] = cid >> 8;
+    memcpy(packet + 8, payload, length);
+
+    return hci_sim_push_acl_raw(packet, length + 8, timestamp);
+}
+
+static void hci_sim_command_complete(uint16_t opcode, const uint8_t* reply, uint8_t length) {
+    uint8_t params[64];
+    params[0] = 1; // Number of command packets we can take
+    params[1] = opcode & 0xFF;
+    params[2] = opcode >> 8;
+    memcpy(params + 3, reply, length);
+
+    hci_sim_push_event(HCI_EVENT_COMMAND_COMPLETE, params, length + 3);
+}
+
+static void hci_sim_command_status(uint16_t opcode, uint8_t status) {
+    uint8_t params[4] = {status, 1, opcode & 0xFF, opcode >> 8};
+    hci_sim_push_event(HCI_EVENT_COMMAND_STATUS, params, sizeof(params));
+}
+
+/* -------------------Stats--------------------- */
+
+static void hci_sim_record_latency(uint64_t timestamp) {
+    uint64_t latency = system_get_time_base_int() - timestamp;
+
+    hci_sim_state.stats.reports_delivered++;
+    hci_sim_state.stats.latency_total += latency;
+    if(latency > hci_sim_state.stats.latency_max)
+        hci_sim_state.stats.latency_max = latency;
+
+    uint32_t us = (uint32_t)(latency / (SYSTEM_TB_CLOCK_HZ / 1000000));
+    int bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+    if(bucket >= HCI_SIM_LATENCY_BUCKETS)
+        bucket = HCI_SIM_LATENCY_BUCKETS - 1;
+
+    hci_sim_state.stats.latency_histogram[bucket]++;
+}
+
+/* -------------------Delivery--------------------- */
+
+// Hands queued data to any parked reads
+static void hci_sim_deliver() {
+    while(hci_sim_state.event_waiter != NULL && hci_sim_state.event_tail != hci_sim_state.event_head) {
+        ipc_message* message = hci_sim_state.event_waiter;
+        hci_sim_state.event_waiter = NULL;
+
+        ios_ioctlv_t* argv = (ios_ioctlv_t*)message->ioctlv.pairs;
+        hci_sim_event_t* event = &hci_sim_state.events[hci_sim_state.event_tail & (HCI_SIM_EVENT_QUEUE_SIZE - 1)];
+        hci_sim_state.event_tail++;
+
+        uint32_t size = event->length < argv[2].size ? event->length : argv[2].size;
+        memcpy(argv[2].data, event->data, size);
+
+        hci_sim_state.stats.events_delivered++;
+        ios_virtual_complete(message, size);
+    }
+
+    while(hci_sim_state.acl_waiter_count > 0 && hci_sim_state.acl_tail != hci_sim_state.acl_head) {
+        ipc_message* message = hci_sim_state.acl_waiters[0];
+        hci_sim_state.acl_waiter_count--;
+        memmove(hci_sim_state.acl_waiters, hci_sim_state.acl_waiters + 1, sizeof(ipc_message*) * hci_sim_state.acl_waiter_count);
+
+        ios_ioctlv_t* argv = (ios_ioctlv_t*)message->ioctlv.pairs;
+        hci_sim_acl_t* acl = &hci_sim_state.acl[hci_sim_state.acl_tail & (HCI_SIM_ACL_QUEUE_SIZE - 1)];
+        hci_sim_state.acl_tail++;
+
+        uint32_t size = acl->length < argv[2].size ? acl->length : argv[2].size;
+        memcpy(argv[2].data, acl->data, size);
+
+        if(acl->timestamp != 0)
+            hci_sim_record_latency(acl->timestamp);
+
+        hci_sim_state.stats.acl_in_delivered++;
+        ios_virtual_complete(message, size);
+    }
+}
+
+/* -------------------Synthetic Remotes--------------------- */
+
+static hci_sim_remote_t* hci_sim_find_remote_by_address(const uint8_t* address) {
+    for(int i = 0; i < hci_sim_state.config.remotes; i++) {
+        if(memcmp(hci_sim_state.remotes[i].address, address, 6) == 0)
+            return &hci_sim_state.remotes[i];
+    }
+    return NULL;
+}
+
+static hci_sim_remote_t* hci_sim_find_remote_by_handle(uint16_t handle) {
+    for(int i = 0; i < hci_sim_state.config.remotes; i++) {
+        if(hci_sim_state.remotes[i].connected && hci_sim_state.remotes[i].handle == handle)
+            return &hci_sim_state.remotes[i];
+    }
+    return NULL;
+}
+
+static void hci_sim_reset_remotes() {
+    memset(hci_sim_state.remotes, 0, sizeof(hci_sim_state.remotes));
+
+    for(int i = 0; i < HCI_SIM_MAX_REMOTES; i++) {
+        hci_sim_remote_t* remote = &hci_sim_state.remotes[i];
+
+        // Nintendo OUI, stored reversed like the HCI does.
+        const uint8_t address[6] = {0x01 + i, 0x00, 0x5A, 0x17, 0x9B, 0x00};
+        memcpy(remote->address, address, sizeof(address));
+        remote->handle = HCI_SIM_HANDLE_BASE + i;
+    }
+}
+
+static void hci_sim_send_report(hci_sim_remote_t* remote, const uint8_t* report, uint16_t length, uint64_t timestamp) {
+    if(!hci_sim_push_l2cap(remote, remote->host_interrupt_cid, report, length, timestamp)) {
+        if(timestamp != 0)
+            hci_sim_state.stats.reports_dropped++;
+        else
+            HCI_SIM_LOG_ERROR("ACL queue full, dropped report %02X", report[1]);
+    }
+}
+
+static void hci_sim_send_status(hci_sim_remote_t* remote) {
+    uint8_t report[8] = {HID_INPUT_REPORT, 0x20, 0x00, 0x00, remote->leds, 0x00, 0x00, 0xC0};
+    hci_sim_send_report(remote, report, sizeof(report), 0);
+}
+
+static void hci_sim_send_acknowledge(hci_sim_remote_t* remote, uint8_t report_id) {
+    uint8_t report[6] = {HID_INPUT_REPORT, 0x22, 0x00, 0x00, report_id, 0x00};
+    hci_sim_send_report(remote, report, sizeof(report), 0);
+}
+
+static void hci_sim_send_memory(hci_sim_remote_t* remote, uint32_t address, uint16_t size) {
+    uint8_t report[23];
+    memset(report, 0, sizeof(report));
+
+    if(size == 0 || size > 16)
+        size = 16;
+
+    report[0] = HID_INPUT_REPORT;
+    report[1] = 0x21;
+    report[4] = ((size - 1) << 4);
+    report[5] = (address >> 8) & 0xFF;
+    report[6] = address & 0xFF;
+
+    // EEPROM is the only memory with anything interesting in it
+    if((address >> 24) == 0x00) {
+        for(int i = 0; i < size; i++) {
+            uint32_t a = (address & 0xFFFF) + i;
+            if(a >= 0x16 && a < 0x16 + sizeof(hci_sim_calibration))
+                report[7 + i] = hci_sim_calibration[a - 0x16];
+        }
+    }
+
+    hci_sim_send_report(remote, report, sizeof(report), 0);
+}
+
+static void hci_sim_generate_report(hci_sim_remote_t* remote, uint64_t timestamp) {
+    uint8_t report_type = remote->report_mode;
+
+    // Interleaved modes alternate between both halves
+    if(report_type == 0x3E && (remote->frame & 1))
+        report_type = 0x3F;
+
+    uint8_t report[2 + 21];
+    uint8_t length = hci_sim_report_lengths[report_type - 0x30];
+
+    report[0] = HID_INPUT_REPORT;
+    report[1] = report_type;
+
+    // IR dots are left empty, everything else sits at rest
+    memset(report + 2, 0xFF, length);
+
+    if(report_type != 0x3D) {
+        // Tap A every 64 reports so there is something to see
+        uint16_t buttons = (remote->frame & 0x20) ? 0x0008 : 0x0000;
+        report[2] = buttons >> 8;
+        report[3] = buttons & 0xFF;
+    }
+
+    if(report_type == 0x31 || report_type == 0x33 || report_type == 0x35 || report_type == 0x37) {
+        report[4] = 0x80;
+        report[5] = 0x80;
+        report[6] = 0x9A;
+    }
+
+    remote->frame++;
+
+    if(!remote->continuous && memcmp(remote->last_report, report, length + 2) == 0)
+        return;
+    memcpy(remote->last_report, report, length + 2);
+
+    hci_sim_state.stats.reports_generated++;
+    hci_sim_send_report(remote, report, length + 2, timestamp);
+}
+
+static void hci_sim_generate_reports(uint64_t now) {
+    uint64_t period = hci_sim_state.report_period;
+    if(period == 0)
+        return;
+
+    for(int i = 0; i < hci_sim_state.config.remotes; i++) {
+        hci_sim_remote_t* remote = &hci_sim_state.remotes[i];
+        if(!remote->connected || !remote->streaming)
+            continue;
+
+        // Way behind, dont try to make it all up
+        if(now - remote->next_report > period * 8 && now > remote->next_report)
+            remote->next_report = now - period * 8;
+
+        while(remote->next_report <= now) {
+            hci_sim_generate_report(remote, remote->next_report);
+            remote->next_report += period;
+        }
+    }
+}
+
+/* -------------------Incoming L2CAP--------------------- */
+
+static void hci_sim_handle_signal(hci_sim_remote_t* remote, const uint8_t* signal, uint16_t length) {
+    if(length < 4)
+        return;
+
+    uint8_t code = signal[0];
+    uint8_t id = signal[1];
+    const uint8_t* data = signal + 4;
+
+    uint8_t reply[16];
+    reply[1] = id;
+
+    switch(code) {
+        case L2CAP_SIGNAL_CODE_CONNECTION_REQUEST: {
+            uint16_t psm = data[0] | (data[1] << 8);
+            uint16_t scid = data[2] | (data[3] << 8);
+
+            uint16_t dcid = 0;
+            if(psm == HID_PSM_CONTROL) {
+                remote->host_control_cid = scid;
+                dcid = HCI_SIM_CONTROL_CID;
+            } else if(psm == HID_PSM_INTERRUPT) {
+                remote->host_interrupt_cid = scid;
+                dcid = HCI_SIM_INTERRUPT_CID;
+            }
+
+            reply[0] = L2CAP_SIGNAL_CODE_CONNECTION_RESPONSE;
+            reply[2] = 8; reply[3] = 0;
+            reply[4] = dcid & 0xFF; reply[5] = dcid >> 8;
+            reply[6] = scid & 0xFF; reply[7] = scid >> 8;
+            reply[8] = dcid ? 0x00 : 0x02; reply[9] = 0x00; // Result, PSM not supported if unknown
+            reply[10] = 0x00; reply[11] = 0x00;
+            hci_sim_push_l2cap(remote, L2CAP_CHANNEL_SIGNALS, reply, 12, 0);
+
+            if(dcid == 0)
+                break;
+
+            // Real remotes configure the hosts side right away too
+            reply[0] = L2CAP_SIGNAL_CODE_CONFIGURE_REQUEST;
+            reply[1] = ++hci_sim_state.signal_id;
+            reply[2] = 4; reply[3] = 0;
+            reply[4] = scid & 0xFF; reply[5] = scid >> 8;
+            reply[6] = 0x00; reply[7] = 0x00;
+            hci_sim_push_l2cap(remote, L2CAP_CHANNEL_SIGNALS, reply, 8, 0);
+            break;
+        }
+        case L2CAP_SIGNAL_CODE_CONFIGURE_REQUEST: {
+            uint16_t dcid = data[0] | (data[1] << 8);
+            uint16_t scid = dcid == HCI_SIM_CONTROL_CID ? remote->host_control_cid : remote->host_interrupt_cid;
+
+            reply[0] = L2CAP_SIGNAL_CODE_CONFIGURE_RESPONSE;
+            reply[2] = 6; reply[3] = 0;
+            reply[4] = scid & 0xFF; reply[5] = scid >> 8;
+            reply[6] = 0x00; reply[7] = 0x00; // Flags
+            reply[8] = 0x00; reply[9] = 0x00; // Success
+            hci_sim_push_l2cap(remote, L2CAP_CHANNEL_SIGNALS, reply, 10, 0);
+            break;
+        }
+        case L2CAP_SIGNAL_CODE_DISCONNECTION_REQUEST:
+            reply[0] = L2CAP_SIGNAL_CODE_DISCONNECTION_RESPONSE;
+            reply[2] = 4; reply[3] = 0;
+            memcpy(reply + 4, data, 4);
+            hci_sim_push_l2cap(remote, L2CAP_CHANNEL_SIGNALS, reply, 8, 0);
+            break;
+        default:
+            // Responses to our own signals, nothing to do
+            break;
+    }
+}
+
+static void hci_sim_handle_output_report(hci_sim_remote_t* remote, const uint8_t* report, uint16_t length) {
+    if(length < 3 || report[0] != HID_OUTPUT_REPORT)
+        return;
+
+    switch(report[1]) {
+        case 0x11: // LEDs
+            remote->leds = report[2] & 0xF0;
+            break;
+        case 0x12: // Report mode
+            if(length < 4)
+                break;
+            remote->report_mode = report[3];
+            remote->continuous = (report[2] & 0x04) != 0;
+            memset(remote->last_report, 0, sizeof(remote->last_report));
+            remote->streaming = report[3] >= 0x30 && report[3] <= 0x3F && hci_sim_report_lengths[report[3] - 0x30] != 0;
+            remote->next_report = system_get_time_base_int();
+            break;
+        case 0x15: // Status
+            hci_sim_send_status(remote);
+            break;
+        case 0x16: // Write memory
+            hci_sim_send_acknowledge(remote, 0x16);
+            break;
+        case 0x17: { // Read memory
+            if(length < 8)
+                break;
+            uint32_t address = ((uint32_t)report[2] << 24) | ((uint32_t)report[3] << 16) | ((uint32_t)report[4] << 8) | report[5];
+            uint16_t size = ((uint16_t)report[6] << 8) | report[7];
+            hci_sim_send_memory(remote, address, size);
+            break;
+        }
+        default:
+            // Camera and speaker, accepted silently
+            break;
+    }
+}
+
+static void hci_sim_handle_acl_out(const uint8_t* packet, uint32_t size) {
+    hci_sim_state.stats.acl_out_received++;
+
+    if(size < 8)
+        return;
+
+    uint16_t handle = (packet[0] | (packet[1] << 8)) & 0x0FFF;
+    uint16_t length = packet[4] | (packet[5] << 8);
+    uint16_t cid = packet[6] | (packet[7] << 8);
+
+    // Let the stack send the next one
+    uint8_t completed[5] = {1, handle & 0xFF, handle >> 8, 1, 0};
+    hci_sim_push_event(HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, completed, sizeof(completed));
+
+    hci_sim_remote_t* remote = hci_sim_find_remote_by_handle(handle);
+    if(remote == NULL)
+        return;
+
+    if(length > size - 8)
+        length = size - 8;
+
+    if(cid == L2CAP_CHANNEL_SIGNALS) {
+        hci_sim_handle_signal(remote, packet + 8, length);
+    } else if(cid == HCI_SIM_INTERRUPT_CID || cid == HCI_SIM_CONTROL_CID) {
+        hci_sim_handle_output_report(remote, packet + 8, length);
+    }
+}
+
+/* -------------------Incoming HCI Commands--------------------- */
+
+static void hci_sim_connection_complete(hci_sim_remote_t* remote, const uint8_t* address, uint8_t status) {
+    uint8_t params[11];
+    uint16_t handle = remote ? remote->handle : 0;
+
+    params[0] = status;
+    params[1] = handle & 0xFF;
+    params[2] = handle >> 8;
+    memcpy(params + 3, address, 6);
+    params[9] = 0x01; // ACL
+    params[10] = 0x00; // No encryption
+
+    hci_sim_push_event(HCI_EVENT_CONNECTION_COMPLETE, params, sizeof(params));
+}
+
+static void hci_sim_handle_command(const uint8_t* command, uint32_t size) {
+    hci_sim_state.stats.commands_received++;
+
+    if(size < 3)
+        return;
+
+    uint16_t opcode = command[0] | (command[1] << 8);
+    const uint8_t* params = command + 3;
+
+    switch(opcode) {
+        case HCI_OPCODE_RESET: {
+            hci_sim_reset_remotes();
+            uint8_t reply[1] = {0};
+            hci_sim_command_complete(opcode, reply, sizeof(reply));
+            break;
+        }
+        case HCI_OPCODE_READ_LOCAL_VERSION_INFORMATION: {
+            // Bluetooth 2.0, Broadcom, like the real thing
+            uint8_t reply[9] = {0, 0x03, 0x00, 0x00, 0x03, 0x0F, 0x00, 0x00, 0x00};
+            hci_sim_command_complete(opcode, reply, sizeof(reply));
+            break;
+        }
+        case HCI_OPCODE_READ_LOCAL_SUPPORTED_FEATURES: {
+            uint8_t reply[9] = {0, 0xBF, 0xFE, 0x8D, 0xFE, 0x98, 0x19, 0x00, 0x80};
+            hci_sim_command_complete(opcode, reply, sizeof(reply));
+            break;
+        }
+        case HCI_OPCODE_READ_BD_ADDR: {
+            uint8_t reply[7];
+            reply[0] = 0;
+            memcpy(reply + 1, hci_sim_bd_address, 6);
+            hci_sim_command_complete(opcode, reply, sizeof(reply));
+            break;
+        }
+        case HCI_OPCODE_READ_BUFFER_SIZE: {
+            // 339 byte ACL packets, 10 of them. Same as the wii reports.
+            uint8_t reply[8] = {0, 0x53, 0x01, 64, 10, 0, 0, 0};
+            hci_sim_command_complete(opcode, reply, sizeof(reply));
+            break;
+        }
+        case HCI_OPCODE_INQUIRY_START: {
+            hci_sim_command_status(opcode, 0);
+
+            for(int i = 0; i < hci_sim_state.config.remotes; i++) {
+                hci_sim_remote_t* remote = &hci_sim_state.remotes[i];
+                if(remote->connected)
+                    continue;
+
+                uint8_t result[15];
+                memset(result, 0, sizeof(result));
+                result[0] = 1;
+                memcpy(result + 1, remote->address, 6);
+                result[7] = 0x01; // Page scan repetition mode R1
+                result[10] = 0x04; result[11] = 0x25; result[12] = 0x00; // Wiimote class of device
+                hci_sim_push_event(HCI_EVENT_INQUIRY_RESULT, result, sizeof(result));
+            }
+
+            uint8_t complete[1] = {0};
+            hci_sim_push_event(HCI_EVENT_INQUIRY_COMPLETE, complete, sizeof(complete));
+            break;
+        }
+        case HCI_OPCODE_REMOTE_NAME_REQUEST: {
+            hci_sim_remote_t* remote = size >= 9 ? hci_sim_find_remote_by_address(params) : NULL;
+            hci_sim_command_status(opcode, 0);
+
+            uint8_t reply[255];
+            memset(reply, 0, sizeof(reply));
+            reply[0] = remote ? 0x00 : 0x04; // Page timeout
+            if(size >= 9)
+                memcpy(reply + 1, params, 6);
+            strcpy((char*)reply + 7, "Nintendo RVL-CNT-01");
+            hci_sim_push_event(HCI_EVENT_REMOTE_NAME_REQUEST_COMPLETE, reply, sizeof(reply));
+            break;
+        }
+        case HCI_OPCODE_CREATE_CONNECTION:
+        case HCI_OPCODE_ACCEPT_CONNECTION: {
+            hci_sim_remote_t* remote = size >= 9 ? hci_sim_find_remote_by_address(params) : NULL;
+            hci_sim_command_status(opcode, 0);
+
+            if(remote != NULL) {
+                remote->connected = true;
+                remote->streaming = false;
+                remote->report_mode = 0;
+            }
+
+            hci_sim_connection_complete(remote, params, remote ? 0x00 : 0x04);
+            break;
+        }
+        case HCI_OPCODE_DISCONNECT: {
+            uint16_t handle = size >= 5 ? (params[0] | (params[1] << 8)) : 0;
+            hci_sim_remote_t* remote = hci_sim_find_remote_by_handle(handle);
+            hci_sim_command_status(opcode, remote ? 0x00 : 0x02); // Unknown connection
+
+            if(remote == NULL)
+                break;
+
+            remote->connected = false;
+            remote->streaming = false;
+
+            uint8_t complete[4] = {0, handle & 0xFF, handle >> 8, 0x16}; // Terminated by local host
+            hci_sim_push_event(HCI_EVENT_DISCONNECTION_COMPLETE, complete, sizeof(complete));
+            break;
+        }
+        case HCI_OPCODE_REJECT_CONNECTION:
+            hci_sim_command_status(opcode, 0);
+            break;
+        default: {
+            // Everything else just succeeds
+            uint8_t reply[1] = {0};
+            hci_sim_command_complete(opcode, reply, sizeof(reply));
+            break;
+        }
+    }
+}
+
+/* -------------------Trace Replay--------------------- */
+
+static void hci_sim_run_trace(uint64_t now) {
+    while(hci_sim_state.trace_active && hci_sim_state.trace_next <= now) {
+        const uint8_t* trace = hci_sim_state.config.trace;
+        size_t offset = hci_sim_state.trace_offset;
+
+        if(offset + sizeof(hci_sim_trace_record_t) > hci_sim_state.config.trace_size) {
+            hci_sim_state.trace_active = false;
+            break;
+        }
+
+        hci_sim_trace_record_t record;
+        memcpy(&record, trace + offset, sizeof(record));
+        uint16_t length = le16toh(record.length);
+        const uint8_t* data = trace + offset + sizeof(record);
+
+        if(offset + sizeof(record) + length > hci_sim_state.config.trace_size) {
+            HCI_SIM_LOG_ERROR("Trace truncated at offset %d", offset);
+            hci_sim_state.trace_active = false;
+            break;
+        }
+
+        // Wait for room instead of dropping recorded traffic
+        if(record.type == HCI_SIM_TRACE_EVENT) {
+            // The event's own length has to fit in the record, it is copied out as is
+            if(length < 2 || data[1] > length - 2) {
+                HCI_SIM_LOG_ERROR("Trace event record at offset %d is shorter than its event", offset);
+            } else {
+                if(hci_sim_state.event_head - hci_sim_state.event_tail >= HCI_SIM_EVENT_QUEUE_SIZE)
+                    break;
+                hci_sim_push_event(data[0], data + 2, data[1]);
+            }
+        } else if(record.type == HCI_SIM_TRACE_ACL) {
+            if(hci_sim_state.acl_head - hci_sim_state.acl_tail >= HCI_SIM_ACL_QUEUE_SIZE)
+                break;
+            if(!hci_sim_push_acl_raw(data, length, 0))
+                HCI_SIM_LOG_ERROR("Trace ACL record too big: %d", length);
+        }
+
+        hci_sim_state.stats.trace_records++;
+        hci_sim_state.trace_offset = offset + sizeof(record) + length;
+
+        // Next record, looping if needed
+        if(hci_sim_state.trace_offset + sizeof(record) > hci_sim_state.config.trace_size) {
+            if(!hci_sim_state.config.trace_loop) {
+                hci_sim_state.trace_active = false;
+                break;
+            }
+            hci_sim_state.trace_offset = 0;
+        }
+
+        memcpy(&record, trace + hci_sim_state.trace_offset, sizeof(record));
+        hci_sim_state.trace_next += SYSTEM_US_TO_TICKS((uint64_t)le32toh(record.delay_us));
+    }
+}
+
+static void hci_sim_start_trace() {
+    hci_sim_state.trace_active = false;
+    hci_sim_state.trace_offset = 0;
+
+    if(hci_sim_state.config.trace == NULL || hci_sim_state.config.trace_size < sizeof(hci_sim_trace_record_t))
+        return;
+
+    hci_sim_trace_record_t record;
+    memcpy(&record, hci_sim_state.config.trace, sizeof(record));
+
+    hci_sim_state.trace_active = true;
+    hci_sim_state.trace_next = system_get_time_base_int() + SYSTEM_US_TO_TICKS((uint64_t)le32toh(record.delay_us));
+}
+
+/* -------------------Request Handling--------------------- */
+
+static void hci_sim_fail_waiters() {
+    if(hci_sim_state.event_waiter != NULL) {
+        ios_virtual_complete(hci_sim_state.event_waiter, -1);
+        hci_sim_state.event_waiter = NULL;
+    }
+
+    for(int i = 0; i < hci_sim_state.acl_waiter_count; i++) {
+        ios_virtual_complete(hci_sim_state.acl_waiters[i], -1);
+    }
+    hci_sim_state.acl_waiter_count = 0;
+}
+
+static void hci_sim_handle_request(ipc_message* message) {
+    if(message->command == IOS_COMMAND_CLOSE) {
+        hci_sim_state.trace_active = false;
+        hci_sim_fail_waiters();
+        ios_virtual_complete(message, 0);
+        return;
+    }
+
+    if(message->command != IOS_COMMAND_IOCTLV) {
+        ios_virtual_complete(message, -4); // IOS invalid argument
+        return;
+    }
+
+    ios_ioctlv_t* argv = (ios_ioctlv_t*)message->ioctlv.pairs;
+    int argc = message->ioctlv.argcin + message->ioctlv.argcio;
+
+    if(message->ioctlv.ioctl == HCI_IOS_IOCTL_USB_CONTROL && argc == 7) {
+        hci_sim_handle_command((const uint8_t*)argv[6].data, argv[6].size);
+        ios_virtual_complete(message, argv[6].size);
+        return;
+    }
+
+    if(argc != 3) {
+        ios_virtual_complete(message, -4);
+        return;
+    }
+
+    uint8_t endpoint = ((const uint8_t*)argv[0].data)[0];
+    switch(endpoint) {
+        case HCI_ENDPOINT_ACL_OUT:
+            hci_sim_handle_acl_out((const uint8_t*)argv[2].data, argv[2].size);
+            ios_virtual_complete(message, argv[2].size);
+            break;
+        case HCI_ENDPOINT_EVENTS:
+            if(hci_sim_state.event_waiter != NULL) {
+                ios_virtual_complete(message, -1);
+                break;
+            }
+            hci_sim_state.event_waiter = message;
+            break;
+        case HCI_ENDPOINT_ACL_IN:
+            if(hci_sim_state.acl_waiter_count >= HCI_SIM_MAX_ACL_WAITERS) {
+                ios_virtual_complete(message, -1);
+                break;
+            }
+            hci_sim_state.acl_waiters[hci_sim_state.acl_waiter_count++] = message;
+            break;
+        default:
+            ios_virtual_complete(message, -4);
+            break;
+    }
+}
+
+static bool hci_sim_busy() {
+    if(hci_sim_state.trace_active)
+        return true;
+
+    for(int i = 0; i < hci_sim_state.config.remotes; i++) {
+        if(hci_sim_state.remotes[i].streaming)
+            return true;
+    }
+
+    return false;
+}
+
+static void hci_sim_task(void* unused_1) {
+    while(hci_sim_state.running) {
+        // Only poll when theres something on a timer
+        ipc_message* message;
+        TickType_t wait = hci_sim_busy() ? 1 : portMAX_DELAY;
+
+        if(xQueueReceive(hci_sim_state.requests, &message, wait) == pdPASS) {
+            do {
+                if(message != NULL)
+                    hci_sim_handle_request(message);
+            } while(xQueueReceive(hci_sim_state.requests, &message, 0) == pdPASS);
+        }
+
+        uint64_t now = system_get_time_base_int();
+        hci_sim_run_trace(now);
+        hci_sim_generate_reports(now);
+        hci_sim_deliver();
+    }
+
+    hci_sim_fail_waiters();
+
+    // Wait to be deleted, not every port lets a task return
+    vTaskSuspend(NULL);
+}
+
+static int hci_sim_open(void* user, int mode) {
+    hci_sim_start_trace();
+    return 0;
+}
+
+static void hci_sim_submit(void* user, ipc_message* message) {
+    if(xQueueSend(hci_sim_state.requests, &message, portMAX_DELAY) != pdPASS) {
+        ios_virtual_complete(message, -1);
+    }
+}
+
+/* -------------------Public API--------------------- */
+
+int hci_sim_install(const hci_sim_config_t* config) {
+    if(config == NULL || config->remotes > HCI_SIM_MAX_REMOTES)
+        return BLERROR_ARGUMENT;
+
+    memset(&hci_sim_state, 0, sizeof(hci_sim_state));
+    memcpy(&hci_sim_state.config, config, sizeof(*config));
+
+    hci_sim_reset_remotes();
+    hci_sim_set_report_rate(config->report_rate_hz);
+    hci_sim_state.stats.start_time = system_get_time_base_int();
+
+    hci_sim_state.requests = xQueueCreateStatic(HCI_SIM_REQUEST_QUEUE_SIZE, sizeof(ipc_message*),
+        (uint8_t*)hci_sim_state.request_queue_storage, &hci_sim_state.request_queue_data);
+
+    hci_sim_state.running = true;
+    BaseType_t err = xTaskCreate(hci_sim_task, TAG, HCI_SIM_TASK_STACK_SIZE / sizeof(StackType_t), NULL, HCI_SIM_TASK_PRIORITY, &hci_sim_state.task);
+    if(err != pdPASS) {
+        HCI_SIM_LOG_ERROR("Failed to create task: %d", err);
+        return BLERROR_FREERTOS;
+    }
+
+    if(ios_virtual_register(&hci_sim_device) < 0) {
+        HCI_SIM_LOG_ERROR("Failed to register virtual device.");
+        hci_sim_remove();
+        return BLERROR_RUNTIME;
+    }
+
+    HCI_SIM_LOG_INFO("Simulating %d remotes at %d Hz", config->remotes, config->report_rate_hz);
+    return 0;
+}
+
+void hci_sim_remove() {
+    ios_virtual_unregister(&hci_sim_device);
+
+    if(hci_sim_state.task == NULL)
+        return;
+
+    // Wake it so it sees the exit
+    ipc_message* wake = NULL;
+    hci_sim_state.running = false;
+    xQueueSend(hci_sim_state.requests, &wake, portMAX_DELAY);
+
+    // Give it a chance to finish before the task goes away
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+    vTaskDelete(hci_sim_state.task);
+    hci_sim_state.task = NULL;
+}
+
+void hci_sim_set_report_rate(uint32_t report_rate_hz) {
+    if(report_rate_hz > 1000)
+        report_rate_hz = 1000;
+
+    taskENTER_CRITICAL();
+    hci_sim_state.report_period = report_rate_hz ? SYSTEM_TB_CLOCK_HZ / report_rate_hz : 0;
+    taskEXIT_CRITICAL();
+}
+
+void hci_sim_get_stats(hci_sim_stats_t* stats) {
+    taskENTER_CRITICAL();
+    memcpy(stats, &hci_sim_state.stats, sizeof(*stats));
+    taskEXIT_CRITICAL();
+}
+
+void hci_sim_reset_stats() {
+    taskENTER_CRITICAL();
+    memset(&hci_sim_state.stats, 0, sizeof(hci_sim_state.stats));
+    hci_sim_state.stats.start_time = system_get_time_base_int();
+    taskEXIT_CRITICAL();
+}
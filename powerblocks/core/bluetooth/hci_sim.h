@@ -0,0 +1,135 @@
+/**
+ * @file hci_sim.h
+ * @brief Simulated Bluetooth HCI Controller
+ *
+ * A software stand-in for the Wii's USB bluetooth dongle
+ * at /dev/usb/oh1/57e/305, installed as a virtual IOS device.
+ *
+ * Once installed, hci_initialize talks to the simulator instead
+ * of starlet. It answers the HCI command set the stack uses,
+ * replays recorded HCI event / ACL traces, and can synthesize
+ * up to 4 wiimotes that are discovered, connect, and stream
+ * input reports at a configurable rate.
+ *
+ * This makes it possible to load test HCI, L2CAP and the wiimote
+ * driver, reproduce drops from a capture, and benchmark throughput
+ * and latency without any remotes present.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "powerblocks/core/system/system.h"
+
+// Max synthetic remotes, matches the wiimote slots
+#define HCI_SIM_MAX_REMOTES 4
+
+// Latency histogram buckets. Bucket N counts latencies under 2^N microseconds,
+// the last bucket collects everything longer.
+#define HCI_SIM_LATENCY_BUCKETS 16
+
+// Trace record types
+#define HCI_SIM_TRACE_EVENT 0x01 // Data is a raw HCI event, event code first
+#define HCI_SIM_TRACE_ACL   0x02 // Data is a raw ACL packet, handle first
+
+/**
+ * @struct hci_sim_trace_record_t
+ * @brief Header of a record in a replay trace.
+ *
+ * A trace is a packed series of these headers each followed by
+ * length bytes of data, exactly as it would come out of the USB endpoint.
+ * All fields are little endian, like the HCI itself.
+ */
+typedef struct {
+    uint8_t type;      // HCI_SIM_TRACE_*
+    uint8_t reserved;
+    uint16_t length;   // Bytes of data following the header
+    uint32_t delay_us; // Time to wait after the previous record before delivering this one
+} PACKED hci_sim_trace_record_t;
+
+/**
+ * @struct hci_sim_config_t
+ * @brief Simulator configuration.
+ */
+typedef struct {
+    uint8_t remotes;         // Synthetic wiimotes to present during discovery, 0-4
+    uint32_t report_rate_hz; // Input reports per second, per remote, once a report mode is set. Up to 1000.
+
+    // Optional trace to replay once the controller is opened. NULL if none.
+    // Must stay valid until the simulator is removed.
+    const uint8_t* trace;
+    size_t trace_size;
+    bool trace_loop; // Restart the trace once it ends
+} hci_sim_config_t;
+
+/**
+ * @struct hci_sim_stats_t
+ * @brief Simulator counters.
+ *
+ * Latency is measured from when a report is generated
+ * to when its ACL transfer is handed back to the L2CAP layer,
+ * so it includes any time queued waiting on the stack.
+ */
+typedef struct {
+    uint64_t start_time;         // Time base when counting started
+
+    uint64_t reports_generated;  // Synthetic input reports created
+    uint64_t reports_delivered;  // Synthetic input reports received by the stack
+    uint64_t reports_dropped;    // Reports lost because the stack fell behind
+
+    uint64_t events_delivered;   // HCI events handed to the stack
+    uint64_t acl_in_delivered;   // ACL packets handed to the stack, including traces
+    uint64_t acl_out_received;   // ACL packets sent by the stack
+    uint64_t commands_received;  // HCI commands sent by the stack
+    uint64_t trace_records;      // Trace records replayed
+
+    uint64_t latency_total;      // Sum of report latency in time base ticks
+    uint64_t latency_max;        // Worst report latency in time base ticks
+    uint32_t latency_histogram[HCI_SIM_LATENCY_BUCKETS];
+} hci_sim_stats_t;
+
+/**
+ * @brief Installs the simulated controller.
+ *
+ * Must be called before hci_initialize / bltools_initialize
+ * so that opening the bluetooth device opens the simulator.
+ *
+ * @param config Simulator configuration
+ *
+ * @return Negative if Error
+ */
+extern int hci_sim_install(const hci_sim_config_t* config);
+
+/**
+ * @brief Removes the simulated controller.
+ *
+ * Stops the simulator task. Should come after hci_close.
+ */
+extern void hci_sim_remove();
+
+/**
+ * @brief Changes the synthetic report rate.
+ *
+ * @param report_rate_hz Reports per second per remote. Up to 1000.
+ */
+extern void hci_sim_set_report_rate(uint32_t report_rate_hz);
+
+/**
+ * @brief Reads back the simulator counters.
+ *
+ * @param stats Outputted stats
+ */
+extern void hci_sim_get_stats(hci_sim_stats_t* stats);
+
+/**
+ * @brief Clears the simulator counters.
+ *
+ * Also restarts the time they are measured from.
+ */
+extern void hci_sim_reset_stats();
@@ -1088,7 +1088,7 @@ static void l2cap_task_buffer_in(const hci_acl_packet_t* packet) {
     }
 }
 
-static void l2cap_acl_in_handle_0(void* params, int return_value) {
+static void l2cap_acl_in_handle_0(void* params, int return_value, BaseType_t* woken) {
     QueueHandle_t queue = (QueueHandle_t) params;
 
     uint8_t item = 0;
@@ -1096,11 +1096,11 @@ static void l2cap_acl_in_handle_0(void* params, int return_value) {
         item = 255;
     }
 
-    xQueueSendFromISR(queue, &item, &exception_isr_context_switch_needed);
+    xQueueSendFromISR(queue, &item, woken);
 }
 
 
-static void l2cap_acl_in_handle_1(void* params, int return_value) {
+static void l2cap_acl_in_handle_1(void* params, int return_value, BaseType_t* woken) {
     QueueHandle_t queue = (QueueHandle_t) params;
 
     uint8_t item = 1;
@@ -1108,7 +1108,7 @@ static void l2cap_acl_in_handle_1(void* params, int return_value) {
         item = 255;
     }
 
-    xQueueSendFromISR(queue, &item, &exception_isr_context_switch_needed);
+    xQueueSendFromISR(queue, &item, woken);
 }
 
 void l2cap_task(void* unused_1) {
@@ -1158,6 +1158,6 @@ void l2cap_task(void* unused_1) {
 
     xSemaphoreGive(l2cap_state.waiter);
     L2CAP_LOG_INFO("Task Exiting...");
-    // Return from task into infinite loop.
-    // Because this FreeRTOSs port supports that
+    // Wait to be deleted, not every port lets a task return
+    vTaskSuspend(NULL);
 }
\ No newline at end of file
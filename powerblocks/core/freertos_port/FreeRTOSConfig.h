@@ -30,8 +30,9 @@
 /// For optimized task selection
 #define configUSE_PORT_OPTIMISED_TASK_SELECTION 0
 
-// Do not idle the system tick to save power
-#define configUSE_TICKLESS_IDLE 0
+// Stop the tick while only the idle task can run,
+// see hrtimer.h. Set it to 0 to tick every millisecond.
+#define configUSE_TICKLESS_IDLE 1
 
 // Up to priority 10
 #define configMAX_PRIORITIES 10
@@ -58,9 +59,17 @@
 // There is an even slower 2 option for a deeper check
 #define configCHECK_FOR_STACK_OVERFLOW 1
 
-// Track performance of tasks
-/// TODO: Implement me
-#define configGENERATE_RUN_TIME_STATS 0
+// Track performance of tasks, counted in time base ticks.
+// The time base is always running, nothing to set up.
+#define configGENERATE_RUN_TIME_STATS 1
+#define configRUN_TIME_COUNTER_TYPE uint64_t
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE() system_get_time_base_int()
+
+// Lets system_get_task_stats list the tasks, with the
+// top of each stack kept so stack sizes can be reported.
+#define configUSE_TRACE_FACILITY 1
+#define configRECORD_STACK_HIGH_ADDRESS 1
 
 // FreeRTOS Assertions
 #define configASSERT(x) ASSERT(x)
@@ -76,6 +85,7 @@
 
 // Feature enable/disable
 #define configUSE_TASK_NOTIFICATIONS   1
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES 3 // Index 1 is reserved for synchronous IOS calls, 2 for fiber schedulers
 #define configUSE_MUTEXES              1
 #define configUSE_RECURSIVE_MUTEXES    1
 #define configUSE_COUNTING_SEMAPHORES  1
@@ -83,6 +93,7 @@
 #define configUSE_APPLICATION_TASK_TAG 0
 
 #define configUSE_POSIX_ERRNO 0
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS 2 // Index 1 is reserved for the lazy FPU context
 
 #define INCLUDE_vTaskPrioritySet            1
 #define INCLUDE_uxTaskPriorityGet           1
@@ -92,7 +103,7 @@
 #define INCLUDE_vTaskDelay                  1
 #define INCLUDE_xTaskGetSchedulerState      1
 #define INCLUDE_xTaskGetCurrentTaskHandle   1
-#define INCLUDE_uxTaskGetStackHighWaterMark 0
+#define INCLUDE_uxTaskGetStackHighWaterMark 1
 #define INCLUDE_xTaskGetIdleTaskHandle      0
 #define INCLUDE_eTaskGetState               0
 #define INCLUDE_xTimerPendFunctionCall      1
@@ -14,10 +14,16 @@
 #include "system/system.h"
 #include "system/syscall.h"
 #include "system/exceptions.h"
+#include "system/hrtimer.h"
 
 #include <string.h>
 
 #include "utils/crash_handler.h"
+#include "utils/fiber.h"
+
+// Space between a new task's first stack pointer and its FPU context.
+// The same 36 bytes as above the stack, rounded up to stay 8 byte aligned.
+#define PORT_FPU_CONTEXT_GAP 40
 
 static uint32_t entry_point_stack_pointer;
 
@@ -54,7 +60,7 @@ void vApplicationGetTimerTaskMemory( StaticTask_t **ppxTimerTaskTCBBuffer,
 BaseType_t xPortStartScheduler( void )
 {
     // Set tick time
-    SYSTEM_SET_DEC(SYSTEM_TB_CLOCK_HZ/configTICK_RATE_HZ);
+    hrtimer_start_tick();
 
     // Enable Interrupts
     //SYSTEM_ENABLE_ISR(true);
@@ -88,25 +94,61 @@ StackType_t * pxPortInitialiseStack( StackType_t * pxTopOfStack,
     // neighboring data.
     pxTopOfStack -= 36 / 4;
 
-    pxTopOfStack -= 464/4;
+    // stfd wants 8 byte alignment
+    pxTopOfStack = (StackType_t*)((uint32_t)pxTopOfStack & ~7);
+
+    // Floating point registers live here while the task does not own the FPU.
+    // Found again in vPortTaskCreated, right above the first context and the gap.
+    pxTopOfStack -= sizeof(exception_fpu_context_t) / 4;
+    memset(pxTopOfStack, 0, sizeof(exception_fpu_context_t));
+
+    // The task's first stack pointer is right below here. Its first frame writes
+    // the back chain and saved link register above that, keep them out of the FPU context.
+    pxTopOfStack -= PORT_FPU_CONTEXT_GAP / 4;
+
+    pxTopOfStack -= sizeof(exception_context_t) / 4;
     exception_context_t* task_context = (exception_context_t*)pxTopOfStack;
 
     memset(task_context, 0, sizeof(*task_context));
 
     task_context->srr0 = (uint32_t)pxCode; // PC after exception return
-    task_context->srr1 = 0x0001B032;       // Exception state, also will enable interrupts when task begins.
+    task_context->srr1 = 0x00019032;       // Exception state, also will enable interrupts when task begins. FPU off until first used.
     task_context->lr = (uint32_t)on_task_return;     // Where to go on return.
     task_context->r3 = (uint32_t)pvParameters; // First argument of function
 
     return pxTopOfStack;
 }
 
+void vPortTaskCreated( void * pxTCB )
+{
+    // The first word of the TCB is still the context from pxPortInitialiseStack
+    uint8_t* task_context = *(uint8_t**)pxTCB;
+
+    vTaskSetThreadLocalStoragePointer((TaskHandle_t)pxTCB, portFPU_CONTEXT_TLS_INDEX,
+                                      task_context + sizeof(exception_context_t) + PORT_FPU_CONTEXT_GAP);
+}
+
+void vPortCleanUpTCB( void * pxTCB )
+{
+    exceptions_fpu_release(pxTCB);
+}
+
+void vPortSuppressTicksAndSleep( TickType_t xExpectedIdleTime )
+{
+    hrtimer_tickless_idle(xExpectedIdleTime);
+}
+
 void vPortYield( void )
 {
     SYSCALL_YIELD();
 }
 
 void vApplicationStackOverflowHook(TaskHandle_t xTask, char * pcTaskName ) {
+    // A task running fibers is on a fiber's stack, not its own.
+    // The saved stack pointer is the first thing in the TCB.
+    if(fiber_stack_in_bounds(xTask, *(void**)xTask))
+        return;
+
     char msg[64];
     snprintf(msg, sizeof(msg), "STACK OVERFLOW: %s", pcTaskName);
     crash_handler_bug_check(msg, NULL);
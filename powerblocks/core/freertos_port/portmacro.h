@@ -115,6 +115,19 @@ typedef uint32_t    UBaseType_t;
 
 #endif /* if ( configNUMBER_OF_CORES == 1 ) */
 
+/* Lazy FPU, the thread local storage pointer holding each task's floating point registers */
+#define portFPU_CONTEXT_TLS_INDEX    1
+
+extern void vPortTaskCreated( void * pxTCB );
+extern void vPortCleanUpTCB( void * pxTCB );
+
+#define traceTASK_CREATE( pxNewTCB )    vPortTaskCreated( pxNewTCB )
+#define portCLEAN_UP_TCB( pxTCB )       vPortCleanUpTCB( pxTCB )
+
+/* Tickless idle, the decrementer is left off till the next task wakes */
+extern void vPortSuppressTicksAndSleep( TickType_t xExpectedIdleTime );
+#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime )    vPortSuppressTicksAndSleep( xExpectedIdleTime )
+
 extern void vPortYield( void );
 #define portYIELD()                                           vPortYield()
 
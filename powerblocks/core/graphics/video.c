@@ -14,6 +14,7 @@
 
 #include "system/system.h"
 #include "system/exceptions.h"
+#include "system/deferred.h"
 #include "ios/ios_settings.h"
 
 #include "FreeRTOS.h"
@@ -184,6 +185,12 @@ static const video_profile_t VIDEO_Profile640X480Ntscp = {
                       0, 0}    // Bottom Row
 };
 
+static void video_run_retrace_callback(void* unused) {
+    video_retrace_callback_t callback = video_retrace_callback;
+    if(callback != NULL)
+        callback();
+}
+
 static void video_irq_handler(exception_irq_type_t irq) {
     uint32_t display;
 
@@ -208,12 +215,14 @@ static void video_irq_handler(exception_irq_type_t irq) {
         VI_DI3 = display & ~VI_DI_STATUS;
     }
 
-    // Alert waiting task of vsync
-    xSemaphoreGiveFromISR(video_retrace_semaphore, &exception_isr_context_switch_needed);
-
+    // Callbacks can take a while, like copying out the framebuffer.
+    // Run it from the deferred task, it still goes before the woken task.
     if(video_retrace_callback != NULL) {
-        video_retrace_callback();
+        deferred_call_from_isr(video_run_retrace_callback, NULL);
     }
+
+    // Alert waiting task of vsync
+    xSemaphoreGiveFromISR(video_retrace_semaphore, &exception_isr_context_switch_needed);
 }
 
 video_mode_t video_system_default_video_mode() {
@@ -125,8 +125,10 @@ extern void video_wait_vsync_int();
 /**
  * @brief Sets the retrace callback.
  *
- * This is called from the interrupt handler for the retrace from the video interface.
- * Make sure to handle code coming from an interrupter appropriately.
+ * Called on the retrace from the video interface, from the deferred work task
+ * with interrupts masked, so it must not block. Other interrupts are not held
+ * off during the retrace interrupt itself. It runs before the task waiting
+ * in video_wait_vsync wakes up.
  * 
  * @param callback Function pointer to call on retrace.
  */
@@ -18,13 +18,18 @@
 
 #include "system/system.h"
 #include "system/ipc.h"
+#include "system/exceptions.h"
 #include "ios_settings.h"
+#include "ios_virtual.h"
+#include "utils/pool.h"
 
 #include "FreeRTOS.h"
 #include "semphr.h"
+#include "task.h"
 
 #include <stdalign.h>
 #include <stddef.h>
+#include <string.h>
 
 #define IOS_COMMAND_OPEN   1
 #define IOS_COMMAND_CLOSE  2
@@ -36,120 +41,170 @@
 #define IOS_COMMAND_ASYNC  8
 
 
+// Preallocated contexts for the synchronous calls
+#define IOS_REQUEST_POOL_SIZE 16
+
+// Most vectors a pooled ios_ioctlv can carry, larger ones fall back to the stack
+#define IOS_REQUEST_MAX_VECTORS 8
+
+// Notification index the synchronous calls wait on, so they do not eat a tasks own notifications
+#define IOS_REQUEST_NOTIFY_INDEX 1
+
 typedef struct {
-    SemaphoreHandle_t waiter;
+    ipc_message message;
+    alignas(32) ios_ioctlv_t args_buffer[IOS_REQUEST_MAX_VECTORS];
+
+    TaskHandle_t waiter;
     int ret;
-    StaticSemaphore_t data;
-} ios_waiter_alert_args;
+} ALIGN(32) ios_request_t;
+
+// Free contexts, counted by the semaphore so acquiring can wait for one.
+POOL_DEFINE(ios_request_pool, ios_request_t, IOS_REQUEST_POOL_SIZE);
+static SemaphoreHandle_t ios_request_available;
+static StaticSemaphore_t ios_request_available_data;
+
+static ios_latency_stats_t ios_latency_stats[IOS_LATENCY_COUNT];
+
+static ios_request_t* ios_request_acquire() {
+    xSemaphoreTake(ios_request_available, portMAX_DELAY);
+
+    taskENTER_CRITICAL();
+    ios_request_t* request = ios_request_pool_alloc();
+    taskEXIT_CRITICAL();
 
-static void ios_alert_waiter(void* param, int return_value) {
-    ios_waiter_alert_args* args = (ios_waiter_alert_args*)param;
-    args->ret = return_value;
-    xSemaphoreGiveFromISR(args->waiter, &exception_isr_context_switch_needed);
+    request->waiter = xTaskGetCurrentTaskHandle();
+    return request;
+}
+
+static void ios_request_release(ios_request_t* request) {
+    taskENTER_CRITICAL();
+    ios_request_pool_free(request);
+    taskEXIT_CRITICAL();
+
+    xSemaphoreGive(ios_request_available);
+}
+
+static void ios_request_done(void* param, int return_value, BaseType_t* woken) {
+    ios_request_t* request = (ios_request_t*)param;
+    request->ret = return_value;
+    vTaskNotifyGiveIndexedFromISR(request->waiter, IOS_REQUEST_NOTIFY_INDEX, woken);
+}
+
+// Waits out a submitted request and returns the context to the pool.
+static int ios_request_wait(ios_request_t* request, int submitted) {
+    int ret = submitted;
+    if(ret >= 0) {
+        ulTaskNotifyTakeIndexed(IOS_REQUEST_NOTIFY_INDEX, pdTRUE, portMAX_DELAY);
+        ret = request->ret;
+    }
+
+    ios_request_release(request);
+    return ret;
+}
+
+static void ios_latency_record(ios_latency_type_t type, uint64_t start) {
+    uint64_t latency = system_get_time_base_int() - start;
+    uint32_t us = (uint32_t)SYSTEM_TICKS_TO_US(latency);
+
+    int bucket = 0;
+    while(bucket < IOS_LATENCY_BUCKETS - 1 && us >= (1u << bucket))
+        bucket++;
+
+    taskENTER_CRITICAL();
+    ios_latency_stats_t* stats = &ios_latency_stats[type];
+    stats->calls++;
+    stats->total += latency;
+    if(latency > stats->max)
+        stats->max = latency;
+    stats->histogram[bucket]++;
+    taskEXIT_CRITICAL();
 }
 
 void ios_initialize() {
     ipc_initialize();
+
+    ios_request_available = xSemaphoreCreateCountingStatic(IOS_REQUEST_POOL_SIZE, IOS_REQUEST_POOL_SIZE, &ios_request_available_data);
+
     ios_settings_initialize();
 }
 
 int ios_open(const char* path, int mode) {
-    alignas(32) ipc_message message;
-    ios_waiter_alert_args args;
-    args.waiter = xSemaphoreCreateCountingStatic(1, 0, &args.data);
-
-    int ret = ios_open_async(path, mode, &message, ios_alert_waiter, &args);
-    if(ret < 0)
-        return ret;
-    
-    xSemaphoreTake(args.waiter, portMAX_DELAY);
-    return args.ret;
+    ios_request_t* request = ios_request_acquire();
+    return ios_request_wait(request, ios_open_async(path, mode, &request->message, ios_request_done, request));
 }
 
 int ios_close(int file_handle) {
-    alignas(32) ipc_message message;
-    ios_waiter_alert_args args;
-    args.waiter = xSemaphoreCreateCountingStatic(1, 0, &args.data);
-
-    int ret = ios_close_async(file_handle, &message, ios_alert_waiter, &args);
-    if(ret < 0)
-        return ret;
-    
-    xSemaphoreTake(args.waiter, portMAX_DELAY);
-    return args.ret;
+    ios_request_t* request = ios_request_acquire();
+    return ios_request_wait(request, ios_close_async(file_handle, &request->message, ios_request_done, request));
 }
 
 int ios_read(int file_handle, void* buffer, int size) {
-    alignas(32) ipc_message message;
-    ios_waiter_alert_args args;
-    args.waiter = xSemaphoreCreateCountingStatic(1, 0, &args.data);
-
-    int ret = ios_read_async(file_handle, buffer, size, &message, ios_alert_waiter, &args);
-    if(ret < 0)
-        return ret;
-    
-    xSemaphoreTake(args.waiter, portMAX_DELAY);
-    return args.ret;
+    ios_request_t* request = ios_request_acquire();
+    return ios_request_wait(request, ios_read_async(file_handle, buffer, size, &request->message, ios_request_done, request));
 }
 
 int ios_write(int file_handle, void* buffer, int size) {
-    alignas(32) ipc_message message;
-    ios_waiter_alert_args args;
-    args.waiter = xSemaphoreCreateCountingStatic(1, 0, &args.data);
-
-    int ret = ios_write_async(file_handle, buffer, size, &message, ios_alert_waiter, &args);
-    if(ret < 0)
-        return ret;
-    
-    xSemaphoreTake(args.waiter, portMAX_DELAY);
-    return args.ret;
+    ios_request_t* request = ios_request_acquire();
+    return ios_request_wait(request, ios_write_async(file_handle, buffer, size, &request->message, ios_request_done, request));
 }
 
 int ios_seek(int file_handle, int where, int whence) {
-    alignas(32) ipc_message message;
-    ios_waiter_alert_args args;
-    args.waiter = xSemaphoreCreateCountingStatic(1, 0, &args.data);
-
-    int ret = ios_seek_async(file_handle, where, whence, &message, ios_alert_waiter, &args);
-    if(ret < 0)
-        return ret;
-    
-    xSemaphoreTake(args.waiter, portMAX_DELAY);
-    return args.ret;
+    ios_request_t* request = ios_request_acquire();
+    return ios_request_wait(request, ios_seek_async(file_handle, where, whence, &request->message, ios_request_done, request));
 }
 
 int ios_ioctl(int file_handle, int ioctl, void* buffer_in, int in_size, void* buffer_io, int io_size) {
-    alignas(32) ipc_message message;
-    ios_waiter_alert_args args;
-    args.waiter = xSemaphoreCreateCountingStatic(1, 0, &args.data);
+    uint64_t start = system_get_time_base_int();
 
-    int ret = ios_ioctl_async(file_handle, ioctl, buffer_in, in_size, buffer_io, io_size, &message, ios_alert_waiter, &args);
-    if(ret < 0)
-        return ret;
-    
-    xSemaphoreTake(args.waiter, portMAX_DELAY);
-    return args.ret;
+    ios_request_t* request = ios_request_acquire();
+    int ret = ios_request_wait(request, ios_ioctl_async(file_handle, ioctl, buffer_in, in_size, buffer_io, io_size, &request->message, ios_request_done, request));
+
+    ios_latency_record(IOS_LATENCY_IOCTL, start);
+    return ret;
 }
 
 int ios_ioctlv(int file_handle, int ioctl, int in_size, int io_size, ios_ioctlv_t* argv) {
-    alignas(32) ipc_message message;
-    alignas(32) ios_ioctlv_t args_buffer[in_size+io_size];
-    ios_waiter_alert_args args;
-    args.waiter = xSemaphoreCreateCountingStatic(1, 0, &args.data);
-
-    int ret = ios_ioctlv_async(file_handle, ioctl, in_size, io_size, argv, &message, args_buffer, ios_alert_waiter, &args);
-    if(ret < 0)
-        return ret;
-    
-    xSemaphoreTake(args.waiter, portMAX_DELAY);
-    return args.ret;
+    uint64_t start = system_get_time_base_int();
+    int ret;
+
+    ios_request_t* request = ios_request_acquire();
+    if(in_size + io_size <= IOS_REQUEST_MAX_VECTORS) {
+        ret = ios_request_wait(request, ios_ioctlv_async(file_handle, ioctl, in_size, io_size, argv, &request->message, request->args_buffer, ios_request_done, request));
+    } else {
+        // Rare, the vector table does not fit in the pooled context
+        alignas(32) ios_ioctlv_t args_buffer[in_size+io_size];
+        ret = ios_request_wait(request, ios_ioctlv_async(file_handle, ioctl, in_size, io_size, argv, &request->message, args_buffer, ios_request_done, request));
+    }
+
+    ios_latency_record(IOS_LATENCY_IOCTLV, start);
+    return ret;
+}
+
+void ios_get_latency_stats(ios_latency_type_t type, ios_latency_stats_t* stats) {
+    taskENTER_CRITICAL();
+    *stats = ios_latency_stats[type];
+    taskEXIT_CRITICAL();
 }
 
+void ios_reset_latency_stats() {
+    taskENTER_CRITICAL();
+    memset(ios_latency_stats, 0, sizeof(ios_latency_stats));
+    taskEXIT_CRITICAL();
+}
 
 int ios_open_async(const char* path, int mode, ipc_message* message, ipc_async_handler_t handler, void* params) {
     // Needs to have a valid path
     if(path == NULL)
         return -1;
+
+    // Devices replaced in software never reach starlet.
+    if(ios_virtual_find(path) >= 0) {
+        message->command = IOS_COMMAND_OPEN;
+        message->open.path = path;
+        message->open.mode = mode;
+
+        return ios_virtual_request(message, handler, params);
+    }
     
     // Make sure the path is visible to hardware.
     system_flush_dcache((void*)path, IOS_MAX_PATH);
@@ -165,12 +220,22 @@ int ios_close_async(int file_handle, ipc_message* message, ipc_async_handler_t h
     message->command = IOS_COMMAND_CLOSE;
     message->file_handle = file_handle;
 
+    if(ios_virtual_is_handle(file_handle))
+        return ios_virtual_request(message, handler, params);
+
     return ipc_request(message, handler, params);
 }
 
 int ios_read_async(int file_handle, void* buffer, int size, ipc_message* message, ipc_async_handler_t handler, void* params) {
     message->command = IOS_COMMAND_READ;
     message->file_handle = file_handle;
+
+    if(ios_virtual_is_handle(file_handle)) {
+        message->read.address = buffer;
+        message->read.size = size;
+        return ios_virtual_request(message, handler, params);
+    }
+
     message->read.address = (void*)SYSTEM_MEM_PHYSICAL(buffer);
     message->read.size = size;
 
@@ -184,6 +249,13 @@ int ios_read_async(int file_handle, void* buffer, int size, ipc_message* message
 int ios_write_async(int file_handle, void* buffer, int size, ipc_message* message, ipc_async_handler_t handler, void* params) {
     message->command = IOS_COMMAND_WRITE;
     message->file_handle = file_handle;
+
+    if(ios_virtual_is_handle(file_handle)) {
+        message->write.address = buffer;
+        message->write.size = size;
+        return ios_virtual_request(message, handler, params);
+    }
+
     message->write.address = (void*)SYSTEM_MEM_PHYSICAL(buffer);
     message->write.size = size;
 
@@ -199,6 +271,9 @@ int ios_seek_async(int file_handle, int where, int whence, ipc_message* message,
     message->seek.where = where;
     message->seek.whence = whence;
 
+    if(ios_virtual_is_handle(file_handle))
+        return ios_virtual_request(message, handler, params);
+
     return ipc_request(message, handler, params);
 }
 
@@ -206,6 +281,15 @@ int ios_ioctl_async(int file_handle, int ioctl, void* buffer_in, int in_size, vo
     message->command = IOS_COMMAND_IOCTL;
     message->file_handle = file_handle;
     message->ioctl.ioctl = ioctl;
+
+    if(ios_virtual_is_handle(file_handle)) {
+        message->ioctl.address_in = buffer_in;
+        message->ioctl.size_in = in_size;
+        message->ioctl.address_io = buffer_io;
+        message->ioctl.size_io = io_size;
+        return ios_virtual_request(message, handler, params);
+    }
+
     message->ioctl.address_in = (void*)SYSTEM_MEM_PHYSICAL(buffer_in);
     message->ioctl.size_in = in_size;
     message->ioctl.address_io = (void*)SYSTEM_MEM_PHYSICAL(buffer_io);
@@ -226,11 +310,20 @@ int ios_ioctlv_async(int file_handle, int ioctl, int in_size, int io_size, ios_i
     message->ioctlv.ioctl = ioctl;
     message->ioctlv.argcin = in_size;
     message->ioctlv.argcio = io_size;
+
+    // Virtual devices get the vectors as is, no physical addresses or flushing.
+    if(ios_virtual_is_handle(file_handle)) {
+        memcpy(args_buffer, argv, sizeof(ios_ioctlv_t) * total);
+        message->ioctlv.pairs = args_buffer;
+        return ios_virtual_request(message, handler, params);
+    }
+
     message->ioctlv.pairs = (void*)SYSTEM_MEM_PHYSICAL(args_buffer);
 
     // Flush and convert pointers to physical in local copy
     for (int i = 0; i < total; i++) {
-        system_flush_dcache(argv[i].data, argv[i].size);
+        if(argv[i].size)
+            system_flush_dcache(argv[i].data, argv[i].size);
         args_buffer[i].data = (void*)SYSTEM_MEM_PHYSICAL(argv[i].data);
         args_buffer[i].size = argv[i].size;
     }
@@ -36,6 +36,31 @@ typedef struct {
     uint32_t size;
 } ios_ioctlv_t;
 
+// Latency histogram buckets. Bucket N counts calls under 2^N microseconds,
+// the last bucket collects everything longer.
+#define IOS_LATENCY_BUCKETS 16
+
+/**
+ * @enum ios_latency_type_t
+ * @brief Synchronous calls that have their latency recorded.
+ */
+typedef enum {
+    IOS_LATENCY_IOCTL,
+    IOS_LATENCY_IOCTLV,
+    IOS_LATENCY_COUNT
+} ios_latency_type_t;
+
+/**
+ * @struct ios_latency_stats_t
+ * @brief Latency of a synchronous call, from entry to return.
+ */
+typedef struct {
+    uint64_t calls;
+    uint64_t total; // Sum of latency in time base ticks
+    uint64_t max;   // Worst latency in time base ticks
+    uint32_t histogram[IOS_LATENCY_BUCKETS];
+} ios_latency_stats_t;
+
 /// TODO: Explore and properly document what needs alignment and what does not
 
 /**
@@ -261,4 +286,17 @@ extern int ios_ioctl_async(int file_handle, int ioctl, void* buffer_in, int in_s
  * @param params Pointer passed to the handler.
  * @return Negative if error.
  */
-extern int ios_ioctlv_async(int file_handle, int ioctl, int in_size, int io_size, ios_ioctlv_t* args, ipc_message* message, ios_ioctlv_t* args_buffer, ipc_async_handler_t handler, void* params);
\ No newline at end of file
+extern int ios_ioctlv_async(int file_handle, int ioctl, int in_size, int io_size, ios_ioctlv_t* args, ipc_message* message, ios_ioctlv_t* args_buffer, ipc_async_handler_t handler, void* params);
+
+/**
+ * @brief Reads back the latency of a synchronous call.
+ *
+ * @param type Call to read
+ * @param stats Outputted stats
+ */
+extern void ios_get_latency_stats(ios_latency_type_t type, ios_latency_stats_t* stats);
+
+/**
+ * @brief Clears the latency of every synchronous call.
+ */
+extern void ios_reset_latency_stats();
@@ -0,0 +1,119 @@
+/**
+ * @file ios_virtual.c
+ * @brief Virtual IOS Devices
+ *
+ * Allows a device in IOS's file system to be replaced
+ * by a software implementation running on broadway.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "ios_virtual.h"
+
+#include "ios.h"
+
+#include "system/system.h"
+#include "system/exceptions.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+
+// Same magic IPC uses, so a completed message looks the same either way
+#define IOS_VIRTUAL_MESSAGE_MAGIC 0x64e0eaed
+
+#define IOS_COMMAND_OPEN 1
+
+static const ios_virtual_device_t* ios_virtual_devices[IOS_VIRTUAL_MAX_DEVICES];
+
+int ios_virtual_register(const ios_virtual_device_t* device) {
+    if(device == NULL || device->path == NULL || device->submit == NULL)
+        return -1;
+
+    for(int i = 0; i < IOS_VIRTUAL_MAX_DEVICES; i++) {
+        if(ios_virtual_devices[i] == NULL) {
+            ios_virtual_devices[i] = device;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+void ios_virtual_unregister(const ios_virtual_device_t* device) {
+    for(int i = 0; i < IOS_VIRTUAL_MAX_DEVICES; i++) {
+        if(ios_virtual_devices[i] == device) {
+            ios_virtual_devices[i] = NULL;
+        }
+    }
+}
+
+int ios_virtual_find(const char* path) {
+    if(path == NULL)
+        return -1;
+
+    for(int i = 0; i < IOS_VIRTUAL_MAX_DEVICES; i++) {
+        if(ios_virtual_devices[i] == NULL)
+            continue;
+
+        if(strncmp(ios_virtual_devices[i]->path, path, IOS_MAX_PATH) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+int ios_virtual_request(ipc_message* message, ipc_async_handler_t handler, void* params) {
+    message->response_handler = handler;
+    message->params = params;
+    message->magic = IOS_VIRTUAL_MESSAGE_MAGIC;
+
+    // Opens are resolved here, devices only need to accept or reject them.
+    if(message->command == IOS_COMMAND_OPEN) {
+        int index = ios_virtual_find(message->open.path);
+        if(index < 0)
+            return -1;
+
+        const ios_virtual_device_t* device = ios_virtual_devices[index];
+
+        int ret = 0;
+        if(device->open)
+            ret = device->open(device->user, message->open.mode);
+
+        ios_virtual_complete(message, ret < 0 ? ret : IOS_VIRTUAL_HANDLE_BASE + index);
+        return 0;
+    }
+
+    if(!ios_virtual_is_handle(message->file_handle))
+        return -1;
+
+    const ios_virtual_device_t* device = ios_virtual_devices[message->file_handle - IOS_VIRTUAL_HANDLE_BASE];
+    if(device == NULL)
+        return -1;
+
+    device->submit(device->user, message);
+    return 0;
+}
+
+void ios_virtual_complete(ipc_message* message, int return_value) {
+    // Same protection as the IPC interrupt, never complete twice.
+    if(message->magic != IOS_VIRTUAL_MESSAGE_MAGIC)
+        return;
+
+    message->magic = 0;
+    message->returned = return_value;
+
+    // Run it masked, the same as the IPC completion task does.
+    BaseType_t woken = pdFALSE;
+
+    int ee;
+    SYSTEM_DISABLE_ISR(ee);
+    message->response_handler(message->params, return_value, &woken);
+    SYSTEM_ENABLE_ISR(ee);
+
+    if(woken)
+        portYIELD();
+}
@@ -0,0 +1,115 @@
+/**
+ * @file ios_virtual.h
+ * @brief Virtual IOS Devices
+ *
+ * Allows a device in IOS's file system to be replaced
+ * by a software implementation running on broadway.
+ *
+ * Opening a path claimed by a virtual device returns a
+ * virtual file handle, and every request made through
+ * the ios_* functions on it is routed to the device
+ * instead of starlet. Used to simulate hardware, such as
+ * the bluetooth controller, for load testing and replaying
+ * captured traffic.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "powerblocks/core/system/ipc.h"
+
+// Max number of devices that can be registered at once
+#define IOS_VIRTUAL_MAX_DEVICES 4
+
+// Virtual handles are offset well above anything IOS will hand out.
+#define IOS_VIRTUAL_HANDLE_BASE 0x10000
+
+/**
+ * @struct ios_virtual_device_t
+ * @brief A software device that can be opened through IOS.
+ *
+ * Requests are handed to submit with the ipc_message filled
+ * out exactly like it would be for starlet, except every
+ * address is left virtual (cached) and nothing is flushed.
+ *
+ * The device must later call ios_virtual_complete on the message.
+ * It may do so from within submit.
+ */
+typedef struct {
+    const char* path; // Path this device claims
+
+    // Called when the device is opened. Return negative to fail the open.
+    int (*open)(void* user, int mode);
+
+    // Called for every request other than open.
+    void (*submit)(void* user, ipc_message* message);
+
+    void* user;
+} ios_virtual_device_t;
+
+/**
+ * @brief Registers a virtual device.
+ *
+ * Any later ios_open on the devices path will be
+ * routed to the virtual device. Already open IOS handles
+ * are unaffected.
+ *
+ * @param device Device to register, must stay valid until unregistered.
+ * @return Negative if error.
+ */
+extern int ios_virtual_register(const ios_virtual_device_t* device);
+
+/**
+ * @brief Removes a virtual device.
+ *
+ * @param device Device to remove
+ */
+extern void ios_virtual_unregister(const ios_virtual_device_t* device);
+
+/**
+ * @brief Checks if a file handle belongs to a virtual device.
+ *
+ * @param file_handle Handle returned from ios_open
+ * @return True if virtual
+ */
+static inline bool ios_virtual_is_handle(int file_handle) {
+    return file_handle >= IOS_VIRTUAL_HANDLE_BASE && file_handle < IOS_VIRTUAL_HANDLE_BASE + IOS_VIRTUAL_MAX_DEVICES;
+}
+
+/**
+ * @brief Finds a virtual device for a path.
+ *
+ * @param path Path being opened
+ * @return Device index, or negative if no device claims the path.
+ */
+extern int ios_virtual_find(const char* path);
+
+/**
+ * @brief Submits a message to a virtual device.
+ *
+ * Used by ios.c, mirrors ipc_request.
+ *
+ * @param message Message, with virtual addresses.
+ * @param handler Called upon completion.
+ * @param params Pointer passed to the handler.
+ * @return Negative if error.
+ */
+extern int ios_virtual_request(ipc_message* message, ipc_async_handler_t handler, void* params);
+
+/**
+ * @brief Completes a request on a virtual device.
+ *
+ * Calls the messages handler with interrupts disabled,
+ * as if it came from the IPC interrupt, then switches to any
+ * task it woke. Must be called from a task, not an ISR.
+ *
+ * @param message Message being completed
+ * @param return_value Value returned to the caller
+ */
+extern void ios_virtual_complete(ipc_message* message, int return_value);
@@ -45,7 +45,8 @@ typedef enum {
     SDIO_CMD52_IO_RW_DIRECT       = 52,
     SDIO_CMD53_IO_RW_EXTENDED     = 53,
 
-    SDIO_ACMD6_SET_BUS_WIDTH      = 6
+    SDIO_ACMD6_SET_BUS_WIDTH      = 6,
+    SD_ACMD23_SET_WR_BLK_ERASE_COUNT = 23
 } sdio_cmd_t;
 
 /**
@@ -0,0 +1,329 @@
+/**
+ * @file boot.c
+ * @brief Boot Steps and Timeline
+ *
+ * Steps are handed out to worker tasks as they become ready. A worker that
+ * finishes a step starts more workers for whatever it made ready, and keeps
+ * going itself until nothing is left for it.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "boot.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "system.h"
+
+#include "powerblocks/core/utils/log.h"
+
+#include <stddef.h>
+
+static const char* TAG = "BOOT";
+
+// Timeline, only ever added to
+static boot_event_t boot_events[BOOT_TIMELINE_MAX_EVENTS];
+static int boot_event_count;
+static uint64_t boot_start_time;
+static uint64_t boot_first_frame_time;
+static bool boot_first_frame_marked;
+
+// The boot_run in progress
+static bool boot_running;
+static const boot_step_t* boot_steps;
+static int boot_step_count;
+static int* boot_results;
+static int boot_result;
+static uint32_t boot_started;
+static uint32_t boot_finished;
+static uint32_t boot_failed;
+static int boot_workers; // Including the task in boot_run, which only waits
+static UBaseType_t boot_priority;
+
+static SemaphoreHandle_t boot_done;
+static StaticSemaphore_t boot_done_data;
+
+static uint32_t boot_ticks_to_us(uint64_t ticks) {
+    return (uint32_t)(ticks * 1000000 / SYSTEM_TB_CLOCK_HZ);
+}
+
+static void boot_record(const char* name, boot_event_type_t type, int result) {
+    uint64_t now = system_get_time_base_int();
+
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+
+    // system_initialize marks first, everything is timed from there
+    if(boot_event_count == 0)
+        boot_start_time = now;
+
+    if(boot_event_count < BOOT_TIMELINE_MAX_EVENTS) {
+        boot_event_t* event = &boot_events[boot_event_count];
+        event->name = name;
+        event->time = now - boot_start_time;
+        event->type = type;
+        event->result = result;
+        boot_event_count++;
+    }
+
+    SYSTEM_ENABLE_ISR(level);
+}
+
+// Must be locked. Takes the first step that can start, -1 if none can yet.
+static int boot_claim_step() {
+    for(int i = 0; i < boot_step_count; i++) {
+        uint32_t after = boot_steps[i].after;
+
+        if(boot_started & BOOT_AFTER(i))
+            continue;
+        if((boot_finished & after) != after)
+            continue;
+
+        boot_started |= BOOT_AFTER(i);
+        return i;
+    }
+
+    return -1;
+}
+
+static void boot_run_step(int step) {
+    const boot_step_t* boot_step = &boot_steps[step];
+
+    int result;
+    if(boot_failed & boot_step->after) {
+        LOG_ERROR(TAG, "Skipped %s, a step it needs failed.", boot_step->name);
+        result = -1;
+    } else {
+        boot_record(boot_step->name, BOOT_EVENT_START, 0);
+        result = boot_step->function(boot_step->param);
+        boot_record(boot_step->name, BOOT_EVENT_END, result);
+
+        if(result < 0)
+            LOG_ERROR(TAG, "%s failed, %d.", boot_step->name, result);
+    }
+
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    boot_finished |= BOOT_AFTER(step);
+    if(result < 0) {
+        boot_failed |= BOOT_AFTER(step);
+        if(boot_result >= 0)
+            boot_result = result;
+    }
+    if(boot_results != NULL)
+        boot_results[step] = result;
+    SYSTEM_ENABLE_ISR(level);
+}
+
+static void boot_work(int step);
+
+static void boot_worker(void* param) {
+    boot_work((int)param);
+
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    bool last = --boot_workers == 1;
+    SYSTEM_ENABLE_ISR(level);
+
+    if(last)
+        xSemaphoreGive(boot_done);
+
+    vTaskDelete(NULL);
+}
+
+// Hands every step that can start to a new worker
+static void boot_start_workers() {
+    while(true) {
+        uint32_t level;
+        SYSTEM_DISABLE_ISR(level);
+
+        int step = -1;
+        if(boot_workers < BOOT_MAX_WORKERS + 1) {
+            step = boot_claim_step();
+            if(step >= 0)
+                boot_workers++;
+        }
+
+        SYSTEM_ENABLE_ISR(level);
+
+        if(step < 0)
+            return;
+
+        if(xTaskCreate(boot_worker, "BOOT", BOOT_WORKER_STACK_SIZE / sizeof(StackType_t),
+                       (void*)step, boot_priority, NULL) != pdPASS) {
+            // Still gets done, just not alongside the others.
+            // Stays counted while it runs here, so no more run at once.
+            LOG_ERROR(TAG, "Failed to start a worker for %s.", boot_steps[step].name);
+
+            boot_work(step);
+
+            SYSTEM_DISABLE_ISR(level);
+            boot_workers--;
+            SYSTEM_ENABLE_ISR(level);
+        }
+    }
+}
+
+// Runs the step, then whatever else is ready until nothing is
+static void boot_work(int step) {
+    while(step >= 0) {
+        boot_run_step(step);
+
+        uint32_t level;
+        SYSTEM_DISABLE_ISR(level);
+        step = boot_claim_step();
+        SYSTEM_ENABLE_ISR(level);
+
+        boot_start_workers();
+    }
+}
+
+// Checks every step can start eventually, no loops or missing steps
+static bool boot_check_steps(const boot_step_t* steps, int count) {
+    uint32_t all = count == 32 ? 0xFFFFFFFF : BOOT_AFTER(count) - 1;
+    uint32_t reachable = 0;
+
+    bool progress = true;
+    while(progress) {
+        progress = false;
+        for(int i = 0; i < count; i++) {
+            if(steps[i].function == NULL || (steps[i].after & ~all) != 0)
+                return false;
+
+            if(!(reachable & BOOT_AFTER(i)) && (steps[i].after & ~reachable) == 0) {
+                reachable |= BOOT_AFTER(i);
+                progress = true;
+            }
+        }
+    }
+
+    return reachable == all;
+}
+
+int boot_run(const boot_step_t* steps, int count, int* results) {
+    if(count < 0 || count > BOOT_MAX_STEPS) {
+        LOG_ERROR(TAG, "Can not run %d steps.", count);
+        return -1;
+    }
+
+    if(!boot_check_steps(steps, count)) {
+        LOG_ERROR(TAG, "Steps have a dependency loop or a missing step.");
+        return -2;
+    }
+
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    if(boot_running) {
+        SYSTEM_ENABLE_ISR(level);
+        LOG_ERROR(TAG, "Already running.");
+        return -3;
+    }
+    boot_running = true;
+    SYSTEM_ENABLE_ISR(level);
+
+    boot_done = xSemaphoreCreateBinaryStatic(&boot_done_data);
+
+    boot_steps = steps;
+    boot_step_count = count;
+    boot_results = results;
+    boot_result = 0;
+    boot_started = 0;
+    boot_finished = 0;
+    boot_failed = 0;
+    boot_workers = 1;
+    boot_priority = uxTaskPriorityGet(NULL);
+
+    boot_record("BOOT RUN", BOOT_EVENT_MARK, 0);
+
+    boot_start_workers();
+
+    // Nothing to wait on if the workers are already done
+    SYSTEM_DISABLE_ISR(level);
+    bool done = boot_workers == 1;
+    SYSTEM_ENABLE_ISR(level);
+
+    if(!done)
+        xSemaphoreTake(boot_done, portMAX_DELAY);
+
+    boot_record("BOOT DONE", BOOT_EVENT_MARK, boot_result);
+
+    int result = boot_result;
+    boot_running = false;
+
+    return result;
+}
+
+void boot_mark(const char* name) {
+    boot_record(name, BOOT_EVENT_MARK, 0);
+}
+
+void boot_mark_first_frame() {
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    bool first = !boot_first_frame_marked;
+    boot_first_frame_marked = true;
+    SYSTEM_ENABLE_ISR(level);
+
+    if(!first)
+        return;
+
+    uint64_t now = system_get_time_base_int();
+    boot_record("FIRST FRAME", BOOT_EVENT_MARK, 0);
+    boot_first_frame_time = now - boot_start_time;
+}
+
+uint64_t boot_get_first_frame_time() {
+    return boot_first_frame_time;
+}
+
+int boot_get_timeline(boot_event_t* events, int max_count) {
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+
+    int count = boot_event_count < max_count ? boot_event_count : max_count;
+    for(int i = 0; i < count; i++)
+        events[i] = boot_events[i];
+
+    SYSTEM_ENABLE_ISR(level);
+
+    return count;
+}
+
+void boot_log_timeline() {
+    static const char* types[] = { "mark", "start", "end" };
+
+    // Events already there never change
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    int count = boot_event_count;
+    SYSTEM_ENABLE_ISR(level);
+
+    for(int i = 0; i < count; i++) {
+        const boot_event_t* event = &boot_events[i];
+
+        if(event->type != BOOT_EVENT_END) {
+            LOG_INFO(TAG, "at_us=%d event=%s name=\"%s\"", boot_ticks_to_us(event->time),
+                     types[event->type], event->name);
+            continue;
+        }
+
+        // How long since it started
+        uint64_t start = event->time;
+        for(int j = i - 1; j >= 0; j--) {
+            if(boot_events[j].type == BOOT_EVENT_START && boot_events[j].name == event->name) {
+                start = boot_events[j].time;
+                break;
+            }
+        }
+
+        LOG_INFO(TAG, "at_us=%d event=%s name=\"%s\" took_us=%d result=%d", boot_ticks_to_us(event->time),
+                 types[event->type], event->name, boot_ticks_to_us(event->time - start), event->result);
+    }
+
+    if(boot_first_frame_time != 0)
+        LOG_INFO(TAG, "first_frame_us=%d", boot_ticks_to_us(boot_first_frame_time));
+}
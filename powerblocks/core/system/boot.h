@@ -0,0 +1,133 @@
+/**
+ * @file boot.h
+ * @brief Boot Steps and Timeline
+ *
+ * Runs startup steps, like bringing up IOS, video, bluetooth and the SD card,
+ * on several tasks at once. Each step says which steps have to finish before
+ * it can start, everything else overlaps. Most of startup is waiting on IOS,
+ * so steps that do not need each other should not wait on each other.
+ *
+ * The timeline records when each step started and finished on the time base,
+ * along with any other marks, from when system_initialize is entered
+ * until the first frame is displayed.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Most steps boot_run can take
+#define BOOT_MAX_STEPS 32
+
+// Most steps running at once, each runs on its own task
+#define BOOT_MAX_WORKERS 4
+#define BOOT_WORKER_STACK_SIZE (16 * 1024)
+
+// Most timeline events kept, later ones are dropped
+#define BOOT_TIMELINE_MAX_EVENTS 128
+
+/** @def BOOT_AFTER
+ *  @brief Dependency on a step, by its index in the steps. Combine with |.
+ */
+#define BOOT_AFTER(step) (1u << (step))
+
+/**
+ * @typedef boot_function_t
+ * @brief A boot step.
+ *
+ * @param param User parameter
+ * @return Negative if error, steps after it are skipped
+ */
+typedef int (*boot_function_t)(void* param);
+
+/**
+ * @struct boot_step_t
+ * @brief A boot step and what it waits on.
+ */
+typedef struct {
+    const char* name;
+    boot_function_t function;
+    void* param;
+    uint32_t after; // BOOT_AFTER of each step that has to finish first, 0 for none
+} boot_step_t;
+
+/**
+ * @enum boot_event_type_t
+ * @brief Kinds of timeline events.
+ */
+typedef enum {
+    BOOT_EVENT_MARK,
+    BOOT_EVENT_START,
+    BOOT_EVENT_END
+} boot_event_type_t;
+
+/**
+ * @struct boot_event_t
+ * @brief A timeline event.
+ */
+typedef struct {
+    const char* name;
+    uint64_t time;          // Time base ticks since system_initialize
+    boot_event_type_t type;
+    int result;             // Step's return value, for BOOT_EVENT_END
+} boot_event_t;
+
+/**
+ * @brief Runs boot steps.
+ *
+ * Blocks until every step has finished or been skipped.
+ * Steps run at the priority of the calling task.
+ *
+ * @param steps Steps
+ * @param count Number of steps, up to BOOT_MAX_STEPS
+ * @param results Each step's return value, can be NULL
+ * @return Negative if a step failed or the dependencies can never all finish
+ */
+extern int boot_run(const boot_step_t* steps, int count, int* results);
+
+/**
+ * @brief Adds a mark to the timeline.
+ *
+ * Safe from interrupts.
+ *
+ * @param name Name, must stay around
+ */
+extern void boot_mark(const char* name);
+
+/**
+ * @brief Marks the first frame as displayed.
+ *
+ * Nothing in the SDK calls this, only the app knows which frame is its first real one.
+ * Call it once that frame is in the framebuffer being shown, drawn and flushed
+ * or copied out of the EFB, and a retrace has passed.
+ * Only the first call counts.
+ */
+extern void boot_mark_first_frame();
+
+/**
+ * @brief Gets how long from system_initialize to the first frame.
+ *
+ * @return Time base ticks, 0 if no frame was displayed yet
+ */
+extern uint64_t boot_get_first_frame_time();
+
+/**
+ * @brief Gets the timeline.
+ *
+ * @param events Outputted events, in order
+ * @param max_count Most events to output
+ * @return Number of events outputted
+ */
+extern int boot_get_timeline(boot_event_t* events, int max_count);
+
+/**
+ * @brief Logs the timeline.
+ *
+ * One line per event, key=value pairs.
+ */
+extern void boot_log_timeline();
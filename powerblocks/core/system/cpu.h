@@ -48,6 +48,11 @@
 #define DBAT7U 574
 #define DBAT7L 575
 
+#define GQR0   912
+#define HID2   920
+#define DMAU   922
+#define DMAL   923
+
 #define HID0   1008
 #define HID4   1011
 
@@ -65,5 +70,19 @@
 #define HID0_ICFI (1 << (31 - 20))
 #define HID0_DCFI (1 << (31 - 21))
 
+/* HID2 values */
+#define HID2_PSE   (1 << (31 - 2))
+#define HID2_LCE   (1 << (31 - 3))
+#define HID2_DMAQL (0xF << (31 - 7))
+#define HID2_DCHERR (1 << (31 - 8))
+#define HID2_DNCERR (1 << (31 - 9))
+#define HID2_DCMERR (1 << (31 - 10))
+#define HID2_DQOERR (1 << (31 - 11))
+
+/* DMAL values */
+#define DMAL_LD (1 << (31 - 27))
+#define DMAL_T  (1 << (31 - 30))
+#define DMAL_F  (1 << (31 - 31))
+
 /* HID4 values */
 #define HID4_SBE (1 << (31 - 6))
@@ -0,0 +1,144 @@
+/**
+ * @file deferred.c
+ * @brief Deferred Interrupt Work
+ *
+ * A ring of calls filled by interrupt handlers and tasks,
+ * emptied by a task at the highest priority.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "deferred.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "system.h"
+#include "exceptions.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#define DEFERRED_TASK_STACK_SIZE 8192
+#define DEFERRED_TASK_PRIORITY   (configMAX_PRIORITIES - 1) // Stands in for the interrupt, like the IPC completion task
+
+typedef struct {
+    deferred_function_t function;
+    void* param;
+    uint64_t posted; // Time base when queued
+} deferred_call_t;
+
+// Written with interrupts off by anyone, read by the task
+static deferred_call_t deferred_ring[DEFERRED_QUEUE_SIZE];
+static uint32_t deferred_head;
+static uint32_t deferred_tail;
+
+static TaskHandle_t deferred_task_handle;
+static StaticTask_t deferred_task_data;
+static StackType_t deferred_task_stack[DEFERRED_TASK_STACK_SIZE / sizeof(StackType_t)];
+
+static deferred_stats_t deferred_stats;
+
+// Interrupts must be off. False if the ring is full.
+static bool deferred_push(deferred_function_t function, void* param) {
+    uint32_t depth = deferred_head - deferred_tail;
+    if(depth >= DEFERRED_QUEUE_SIZE) {
+        deferred_stats.overflows++;
+        return false;
+    }
+
+    deferred_call_t* call = &deferred_ring[deferred_head % DEFERRED_QUEUE_SIZE];
+    call->function = function;
+    call->param = param;
+    call->posted = system_get_time_base_int();
+    deferred_head++;
+
+    deferred_stats.posted++;
+    if(depth + 1 > deferred_stats.max_depth)
+        deferred_stats.max_depth = depth + 1;
+
+    return true;
+}
+
+static void deferred_task(void* unused) {
+    while(true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while(true) {
+            uint32_t level;
+            SYSTEM_DISABLE_ISR(level);
+
+            if(deferred_tail == deferred_head) {
+                SYSTEM_ENABLE_ISR(level);
+                break;
+            }
+
+            deferred_call_t call = deferred_ring[deferred_tail % DEFERRED_QUEUE_SIZE];
+            deferred_tail++;
+
+            SYSTEM_ENABLE_ISR(level);
+
+            // Calls were written for interrupt context and may use FromISR functions,
+            // which do not mask on this port. Other interrupts still get in between calls.
+            SYSTEM_DISABLE_ISR(level);
+            uint64_t start = system_get_time_base_int();
+            call.function(call.param);
+            uint64_t end = system_get_time_base_int();
+
+            uint32_t latency = (uint32_t)(start - call.posted);
+            uint32_t time = (uint32_t)(end - start);
+
+            deferred_stats.completed++;
+            if(latency > deferred_stats.max_latency)
+                deferred_stats.max_latency = latency;
+            if(time > deferred_stats.max_time)
+                deferred_stats.max_time = time;
+            SYSTEM_ENABLE_ISR(level);
+        }
+    }
+}
+
+void deferred_initialize() {
+    deferred_head = 0;
+    deferred_tail = 0;
+    memset(&deferred_stats, 0, sizeof(deferred_stats));
+
+    deferred_task_handle = xTaskCreateStatic(deferred_task, "DEFERRED", DEFERRED_TASK_STACK_SIZE / sizeof(StackType_t),
+                                             NULL, DEFERRED_TASK_PRIORITY, deferred_task_stack, &deferred_task_data);
+}
+
+void deferred_call_from_isr(deferred_function_t function, void* param) {
+    // Work is never lost, if the task is that far behind it runs here like before
+    if(!deferred_push(function, param)) {
+        function(param);
+        return;
+    }
+
+    vTaskNotifyGiveFromISR(deferred_task_handle, &exception_isr_context_switch_needed);
+}
+
+void deferred_call(deferred_function_t function, void* param) {
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    bool queued = deferred_push(function, param);
+
+    // Run it masked, the same as the task would
+    if(!queued)
+        function(param);
+
+    SYSTEM_ENABLE_ISR(level);
+
+    if(!queued)
+        return;
+
+    xTaskNotifyGive(deferred_task_handle);
+}
+
+void deferred_get_stats(deferred_stats_t* stats) {
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    *stats = deferred_stats;
+    SYSTEM_ENABLE_ISR(level);
+}
@@ -0,0 +1,80 @@
+/**
+ * @file deferred.h
+ * @brief Deferred Interrupt Work
+ *
+ * Lets an interrupt handler hand the heavy part of its work to a task,
+ * so it gets out of the interrupt quickly.
+ *
+ * Calls run in order, one at a time, from a task at the highest priority.
+ * So they still run before any other task gets back the CPU.
+ * Each call runs with interrupts masked, since this port has no masking
+ * of its own in the FromISR functions, so other interrupts only get in
+ * between calls. Treat them like interrupt handlers: do not block, and use
+ * the FromISR functions, passing NULL for the woken flag. Anything they wake
+ * runs once the task has emptied the queue. Unlike handlers they can use floating point.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// Calls that can be waiting at once. Any more run right away in the caller instead.
+#define DEFERRED_QUEUE_SIZE 64
+
+/**
+ * @typedef deferred_function_t
+ * @brief Work to run from the deferred task, with interrupts masked.
+ *
+ * @param param User parameter
+ */
+typedef void (*deferred_function_t)(void* param);
+
+/**
+ * @struct deferred_stats_t
+ * @brief Deferred work counters, times in time base ticks.
+ */
+typedef struct {
+    uint32_t posted;      // Calls queued
+    uint32_t completed;   // Calls ran by the task
+    uint32_t overflows;   // Calls ran by the caller because the queue was full
+    uint32_t max_depth;   // Most calls waiting at once
+    uint32_t max_latency; // Most time from being queued to starting
+    uint32_t max_time;    // Most time one call took
+} deferred_stats_t;
+
+/**
+ * @brief Starts the deferred work task.
+ *
+ * Called from system_initialize.
+ */
+extern void deferred_initialize();
+
+/**
+ * @brief Queues a call from an interrupt handler.
+ *
+ * Sets exception_isr_context_switch_needed so the
+ * task runs as soon as the interrupt returns.
+ *
+ * @param function Called from the deferred task
+ * @param param User parameter
+ */
+extern void deferred_call_from_isr(deferred_function_t function, void* param);
+
+/**
+ * @brief Queues a call from a task.
+ *
+ * @param function Called from the deferred task
+ * @param param User parameter
+ */
+extern void deferred_call(deferred_function_t function, void* param);
+
+/**
+ * @brief Gets the deferred work counters.
+ *
+ * @param stats Outputted stats
+ */
+extern void deferred_get_stats(deferred_stats_t* stats);
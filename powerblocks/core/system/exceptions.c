@@ -19,7 +19,10 @@
 
 #include "system.h"
 #include "syscall.h"
+#include "cpu.h"
+#include "hrtimer.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -41,11 +44,43 @@ extern const void* exceptions_vector_syscall;
 
 int32_t exception_isr_context_switch_needed;
 
+uint32_t exception_fpu_switch_count;
+
+// Task whose floating point registers are currently in the FPU
+static void* exception_fpu_owner;
+
+// Set while a handler that could interrupt a task is running.
+// These never get the FPU, there is nowhere to put the registers.
+static volatile bool exception_in_handler;
+
 // The IRQ handlers used with the processor interface
 static exception_irq_handler_t irq_handlers[EXCEPTION_IRQ_COUNT];
 
-// From FreeRTOS port.c file
-extern void prvTickISR();
+// GX flow control and the video retrace are the most time sensitive, then audio and IPC
+static uint8_t irq_priorities[EXCEPTION_IRQ_COUNT] = {
+    [EXCEPTION_IRQ_TYPE_FIFO]         = 14,
+    [EXCEPTION_IRQ_TYPE_VIDEO]        = 13,
+    [EXCEPTION_IRQ_TYPE_PE_FINISH]    = 12,
+    [EXCEPTION_IRQ_TYPE_PE_TOKEN]     = 11,
+    [EXCEPTION_IRQ_TYPE_DSP]          = 10,
+    [EXCEPTION_IRQ_TYPE_STREAMING]    = 9,
+    [EXCEPTION_IRQ_TYPE_IPC]          = 8,
+    [EXCEPTION_IRQ_TYPE_EXI]          = 7,
+    [EXCEPTION_IRQ_TYPE_SERIAL]       = 6,
+    [EXCEPTION_IRQ_TYPE_DVD]          = 5,
+    [EXCEPTION_IRQ_TYPE_HSP]          = 4,
+    [EXCEPTION_IRQ_TYPE_GP_RUNTIME]   = 3,
+    [EXCEPTION_IRQ_TYPE_MEMORY]       = 2,
+    [EXCEPTION_IRQ_TYPE_DEBUGGER]     = 1,
+    [EXCEPTION_IRQ_TYPE_RESET_SWITCH] = 0,
+};
+
+// Pending IRQs are turned into a mask with the highest priority in the top bit,
+// so counting leading zeros finds the next one to handle.
+static uint32_t irq_priority_bits[EXCEPTION_IRQ_COUNT];
+static exception_irq_type_t irq_priority_order[EXCEPTION_IRQ_COUNT];
+
+static exception_irq_stats_t irq_stats[EXCEPTION_IRQ_COUNT];
 
 // Inserts a b <RELATIVE ADDRESS> instruction at the givin address
 void exception_install_branch(uint32_t address, uint32_t handler) {
@@ -60,6 +95,23 @@ void exception_install_branch(uint32_t address, uint32_t handler) {
 }
 
 
+static void exceptions_sort_irqs() {
+    uint32_t placed = 0;
+
+    for(int slot = 0; slot < EXCEPTION_IRQ_COUNT; slot++) {
+        // Ties go to the higher IRQ number
+        int best = -1;
+        for(int i = EXCEPTION_IRQ_COUNT - 1; i >= 0; i--) {
+            if(!(placed & (1 << i)) && (best < 0 || irq_priorities[i] > irq_priorities[best]))
+                best = i;
+        }
+
+        placed |= 1 << best;
+        irq_priority_order[slot] = (exception_irq_type_t)best;
+        irq_priority_bits[best] = 0x80000000 >> slot;
+    }
+}
+
 void exceptions_install_vector() {
     // Install branch instructions
     exception_install_branch(0x80000100, (uint32_t)&exceptions_vector_reset);
@@ -79,6 +131,8 @@ void exceptions_install_vector() {
 
     // Clear IRQ handlers
     memset(irq_handlers, 0, sizeof(irq_handlers));
+    memset(irq_stats, 0, sizeof(irq_stats));
+    exceptions_sort_irqs();
 
     // Disable all processor interface external interrupts
     PI_INTMR = 0;
@@ -95,6 +149,28 @@ void exceptions_install_irq(exception_irq_handler_t handler, exception_irq_type_
     }
 }
 
+void exceptions_set_irq_priority(exception_irq_type_t type, uint8_t priority) {
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    irq_priorities[type] = priority;
+    exceptions_sort_irqs();
+    SYSTEM_ENABLE_ISR(level);
+}
+
+void exceptions_get_irq_stats(exception_irq_type_t type, exception_irq_stats_t* stats) {
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    *stats = irq_stats[type];
+    SYSTEM_ENABLE_ISR(level);
+}
+
+void exceptions_reset_irq_stats() {
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    memset(irq_stats, 0, sizeof(irq_stats));
+    SYSTEM_ENABLE_ISR(level);
+}
+
 void exception_reset(exception_context_t* context) {
     crash_handler_bug_check("RESET", context);
 }
@@ -111,27 +187,65 @@ void exception_isi(exception_context_t* context) {
     crash_handler_bug_check("ISI EXCEPTION ON INSTRUCTION LOAD", context);
 }
 
+void exceptions_fpu_release(void* task) {
+    if(exception_fpu_owner == task)
+        exception_fpu_owner = NULL;
+}
+
 void exception_external(exception_context_t* context) {
+    exception_in_handler = true;
+
     // Start with this being off
     exception_isr_context_switch_needed = 0;
 
-    // Get IRQ cause and mask
-    uint32_t irq_cause = PI_INTSR;
-    uint32_t irq_mask = PI_INTMR;
+    uint64_t entry = system_get_time_base_int();
+
+    // Each IRQ is handled once, if it is still pending after it
+    // will bring the exception right back.
+    uint32_t handled = 0;
+
+    while(true) {
+        // Only process enabled interrupts
+        uint32_t irq_cause = PI_INTSR & PI_INTMR & ~handled;
+        if(irq_cause == 0)
+            break;
+
+        // Reorder by priority, checked again after every handler
+        // in case something more important came in meanwhile.
+        uint32_t pending = 0;
+        while(irq_cause != 0) {
+            int bit = 31 - __builtin_clz(irq_cause);
+            irq_cause &= ~(1 << bit);
+            pending |= irq_priority_bits[bit];
+        }
+
+        exception_irq_type_t irq = irq_priority_order[__builtin_clz(pending)];
+        handled |= 1 << irq;
 
-    // Only process enabled interrupts
-    irq_cause &= irq_mask;
+        if(irq_handlers[irq] == NULL)
+            continue;
 
-    // Go through each bit.
-    for(int i = 0; i < EXCEPTION_IRQ_COUNT; i++) {
-        if((irq_cause & (1<<i)) && (irq_handlers[i] != NULL)) {
-            irq_handlers[i](i);
-        }
+        uint64_t start = system_get_time_base_int();
+        irq_handlers[irq](irq);
+        uint64_t end = system_get_time_base_int();
+
+        exception_irq_stats_t* stats = &irq_stats[irq];
+        uint32_t time = (uint32_t)(end - start);
+        uint32_t wait = (uint32_t)(start - entry);
+
+        stats->count++;
+        stats->total_time += time;
+        if(time > stats->max_time)
+            stats->max_time = time;
+        if(wait > stats->max_wait)
+            stats->max_wait = wait;
     }
 
     if(exception_isr_context_switch_needed != 0) {
         vTaskSwitchContext();
     }
+
+    exception_in_handler = false;
 }
 
 void exception_alignment(exception_context_t* context) {
@@ -143,17 +257,49 @@ void exception_program(exception_context_t* context) {
 }
 
 void exception_fpu_unavailable(exception_context_t* context) {
-    crash_handler_bug_check("FPU UNIVALBLE", context);
+    if(exception_in_handler) {
+        crash_handler_bug_check("FPU USED IN INTERRUPT", context);
+        return;
+    }
+
+    void* task = xTaskGetCurrentTaskHandle();
+    if(task == NULL) {
+        crash_handler_bug_check("FPU UNAVAILABLE", context);
+        return;
+    }
+
+    // Lazy switch, hand the FPU over only once a task actually uses it.
+    if(exception_fpu_owner != task) {
+        if(exception_fpu_owner != NULL) {
+            exception_fpu_save(pvTaskGetThreadLocalStoragePointer(exception_fpu_owner, portFPU_CONTEXT_TLS_INDEX));
+
+            // The owner is switched out, so the first word of its TCB points to the context it was saved with.
+            // Take the FPU from it there, so it comes back here next time it uses it.
+            exception_context_t* owner_context = *(exception_context_t**)exception_fpu_owner;
+            owner_context->srr1 &= ~MSR_FP;
+        }
+
+        exception_fpu_load(pvTaskGetThreadLocalStoragePointer(task, portFPU_CONTEXT_TLS_INDEX));
+        exception_fpu_owner = task;
+        exception_fpu_switch_count++;
+    }
+
+    context->srr1 |= MSR_FP;
 }
 
 void exception_decrementer(exception_context_t* context) {
-    // Set tick time
-    SYSTEM_SET_DEC(SYSTEM_TB_CLOCK_HZ/configTICK_RATE_HZ);
+    exception_in_handler = true;
+
+    // Timer callbacks can wake tasks too
+    exception_isr_context_switch_needed = 0;
 
-    if( xTaskIncrementTick() != pdFALSE ) {
+    // Runs the tick and any timers due, and sets the next deadline
+    if(hrtimer_decrementer() || exception_isr_context_switch_needed != 0) {
         /* Switch to the highest priority task that is ready to run. */
         vTaskSwitchContext();
     }
+
+    exception_in_handler = false;
 }
 
 void exception_syscall(exception_context_t* context) {
@@ -166,5 +312,7 @@ void exception_syscall(exception_context_t* context) {
 
     syscall_handler_t handler = syscall_registry[syscall_id];
 
+    exception_in_handler = true;
     context->r3 = handler(context, context->r3, context->r4, context->r5);
+    exception_in_handler = false;
 }
\ No newline at end of file
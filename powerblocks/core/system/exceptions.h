@@ -56,11 +56,24 @@ typedef struct {
 
     uint32_t gqr0, gqr1, gqr2, gqr3;
     uint32_t gqr4, gqr5, gqr6, gqr7;
-
-    double f[32];
-    uint64_t ffs;
 } exception_context_t;
 
+/**
+ * @struct exception_fpu_context_t
+ * @brief Floating point registers of a task.
+ *
+ * Floating point registers of a task.
+ * These are not part of exception_context_t. Tasks start with the FPU
+ * disabled, and the registers are only swapped in the FPU unavailable
+ * exception once a task actually uses them. One per task, kept at the
+ * top of its stack.
+ */
+typedef struct {
+    double f[32];       // ps0, full double precision
+    uint32_t ps[32][2]; // ps0 and ps1 as singles, only saved when paired singles are enabled
+    uint64_t fpscr;
+} exception_fpu_context_t;
+
 /**
  * @enum exception_irq_type_t
  * @brief Types of IRQs during external exceptions.
@@ -95,6 +108,25 @@ typedef enum {
  */
 extern int32_t exception_isr_context_switch_needed;
 
+ /**
+ *  @brief Number of times the FPU has changed owners.
+ *
+ * Number of times the FPU unavailable exception has saved one
+ * task's floating point registers and loaded another's.
+ */
+extern uint32_t exception_fpu_switch_count;
+
+/**
+ * @struct exception_irq_stats_t
+ * @brief Time spent on one IRQ, in time base ticks.
+ */
+typedef struct {
+    uint32_t count;      // Times the handler ran
+    uint64_t total_time; // Time in the handler, added up
+    uint32_t max_time;   // Time in the handler, most
+    uint32_t max_wait;   // Most time from the exception starting to the handler, spent on higher priority IRQs
+} exception_irq_stats_t;
+
 /**
  * @typedef exception_irq_handler_t
  * @brief Function pointer to handle irq exceptions.
@@ -123,6 +155,46 @@ extern void exceptions_install_vector();
  */
 extern void exceptions_install_irq(exception_irq_handler_t handler, exception_irq_type_t type);
 
+ /**
+ *  @brief Sets the priority of an IRQ.
+ *
+ * When several IRQs are pending, the highest priority one is handled first,
+ * and the pending ones are checked again after each handler. Equal priorities
+ * keep the default order. By default GX flow control and the video retrace
+ * come first, then audio, IPC and the rest of the I/O.
+ *
+ * @param type IRQ type
+ * @param priority Higher is handled sooner, 0 to 255
+ */
+extern void exceptions_set_irq_priority(exception_irq_type_t type, uint8_t priority);
+
+ /**
+ *  @brief Gets the time spent on an IRQ.
+ *
+ * @param type IRQ type
+ * @param stats Outputted stats
+ */
+extern void exceptions_get_irq_stats(exception_irq_type_t type, exception_irq_stats_t* stats);
+
+ /**
+ *  @brief Clears the time spent on every IRQ.
+ */
+extern void exceptions_reset_irq_stats();
+
+/**
+ * @brief Forgets a task as the owner of the FPU.
+ *
+ * Called by the FreeRTOS port as a task is deleted,
+ * so its registers are not saved into a freed stack.
+ *
+ * @param task Task being deleted
+ */
+extern void exceptions_fpu_release(void* task);
+
+// Floating point register save and load from exceptions_asm.s
+extern void exception_fpu_save(exception_fpu_context_t* context);
+extern void exception_fpu_load(const exception_fpu_context_t* context);
+
 // Exception handlers called from exceptions_asm.s
 extern void exception_reset(exception_context_t* context);
 extern void exception_machine_check(exception_context_t* context);
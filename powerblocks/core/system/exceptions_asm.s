@@ -10,13 +10,23 @@
  * @license MIT (see LICENSE file)
  */
 
+# Paired single load and store, the assembler does not know Gekko's instructions.
+# Always uses GQR0, W=0 so both ps0 and ps1 are transferred.
+.macro psq_st_gqr0 frs, d, ra
+    .long (60 << 26) | (\frs << 21) | (\ra << 16) | (\d & 0xFFF)
+.endm
+
+.macro psq_l_gqr0 frd, d, ra
+    .long (56 << 26) | (\frd << 21) | (\ra << 16) | (\d & 0xFFF)
+.endm
+
 .macro exceptions_context_save
     # At this point the MMU is disabled, so you will have
     # To translate the stack pointer to a physical address by clearing the upper 2 bits
     clrlwi 1, 1, 2
 
-    # Create stack frame
-    stwu 1, -464(1)
+    # Create stack frame, sizeof(exception_context_t)
+    stwu 1, -192(1)
 
     # Save r0
     stw 0, 0x04(1)
@@ -66,49 +76,8 @@
     mfspr 0, 919
     stw 0, 0xBC(1)
 
-    # Enable FPU in MSR
-    mfmsr 3
-    ori 3, 3, 0x2000
-    mtmsr 3
-    isync
-
-    # Store Floats
-    stfd 0, 0xC0(1)
-    stfd 1, 0xC8(1)
-    stfd 2, 0xD0(1)
-    stfd 3, 0xD8(1)
-    stfd 4, 0xE0(1)
-    stfd 5, 0xE8(1)
-    stfd 6, 0xF0(1)
-    stfd 7, 0xF8(1)
-    stfd 8, 0x100(1)
-    stfd 9, 0x108(1)
-    stfd 10, 0x110(1)
-    stfd 11, 0x118(1)
-    stfd 12, 0x120(1)
-    stfd 13, 0x128(1)
-    stfd 14, 0x130(1)
-    stfd 15, 0x138(1)
-    stfd 16, 0x140(1)
-    stfd 17, 0x148(1)
-    stfd 18, 0x150(1)
-    stfd 19, 0x158(1)
-    stfd 20, 0x160(1)
-    stfd 21, 0x168(1)
-    stfd 22, 0x170(1)
-    stfd 23, 0x178(1)
-    stfd 24, 0x180(1)
-    stfd 25, 0x188(1)
-    stfd 26, 0x190(1)
-    stfd 27, 0x198(1)
-    stfd 28, 0x1A0(1)
-    stfd 29, 0x1A8(1)
-    stfd 30, 0x1B0(1)
-    stfd 31, 0x1B8(1)
-
-    # Float State
-    mffs 0
-    stfd 0, 0x1C0(1)
+    # Floating point registers are left alone, the FPU stays
+    # disabled until a task uses it. See exception_fpu_unavailable.
 
     #
     # Disable exceptions, Reenable MMU
@@ -210,51 +179,11 @@ is_null_\@:
     lwz 0, 0xBC(1)
     mtspr 919, 0
 
-    # Unlike on the save,
-    # Do this before loading back the floats
-    # (or else...) Totally not a mistake I made
-    lfd 0, 0x1C0(1)
-    mtfsf 255, 0
-
-    # Restore Floats
-    lfd 0, 0xC0(1)
-    lfd 1, 0xC8(1)
-    lfd 2, 0xD0(1)
-    lfd 3, 0xD8(1)
-    lfd 4, 0xE0(1)
-    lfd 5, 0xE8(1)
-    lfd 6, 0xF0(1)
-    lfd 7, 0xF8(1)
-    lfd 8, 0x100(1)
-    lfd 9, 0x108(1)
-    lfd 10, 0x110(1)
-    lfd 11, 0x118(1)
-    lfd 12, 0x120(1)
-    lfd 13, 0x128(1)
-    lfd 14, 0x130(1)
-    lfd 15, 0x138(1)
-    lfd 16, 0x140(1)
-    lfd 17, 0x148(1)
-    lfd 18, 0x150(1)
-    lfd 19, 0x158(1)
-    lfd 20, 0x160(1)
-    lfd 21, 0x168(1)
-    lfd 22, 0x170(1)
-    lfd 23, 0x178(1)
-    lfd 24, 0x180(1)
-    lfd 25, 0x188(1)
-    lfd 26, 0x190(1)
-    lfd 27, 0x198(1)
-    lfd 28, 0x1A0(1)
-    lfd 29, 0x1A8(1)
-    lfd 30, 0x1B0(1)
-    lfd 31, 0x1B8(1)
-
     # Restore r0
     lwz 0, 0x04(1)
 
     # Restore stack pointer
-    addi 1, 1, 464
+    addi 1, 1, 192
 
     rfi
 .endm
@@ -340,6 +269,206 @@ exceptions_vector_syscall:
     bl exception_syscall
     exceptions_context_restore
 
+// Saves the floating point registers into a exception_fpu_context_t.
+// Called from exception_fpu_unavailable, with the FPU off.
+.global exception_fpu_save
+exception_fpu_save:
+    # FPU has to be on to touch the registers
+    mfmsr 5
+    ori 6, 5, 0x2000
+    mtmsr 6
+    isync
+
+    # Paired singles only when HID2[PSE] is set. Before the stfd's,
+    # ps1 is what would be lost, and f0 is used for the FPSCR after.
+    mfspr 6, 920
+    rlwinm. 6, 6, 3, 31, 31
+    beq no_ps_save
+
+    # GQR0 has to be unscaled floats so the values go out as is.
+    # It is part of the task context, so put it back after.
+    mfspr 7, 912
+    li 8, 0
+    mtspr 912, 8
+    isync
+
+    addi 4, 3, 0x100
+    psq_st_gqr0 0, 0x0, 4
+    psq_st_gqr0 1, 0x8, 4
+    psq_st_gqr0 2, 0x10, 4
+    psq_st_gqr0 3, 0x18, 4
+    psq_st_gqr0 4, 0x20, 4
+    psq_st_gqr0 5, 0x28, 4
+    psq_st_gqr0 6, 0x30, 4
+    psq_st_gqr0 7, 0x38, 4
+    psq_st_gqr0 8, 0x40, 4
+    psq_st_gqr0 9, 0x48, 4
+    psq_st_gqr0 10, 0x50, 4
+    psq_st_gqr0 11, 0x58, 4
+    psq_st_gqr0 12, 0x60, 4
+    psq_st_gqr0 13, 0x68, 4
+    psq_st_gqr0 14, 0x70, 4
+    psq_st_gqr0 15, 0x78, 4
+    psq_st_gqr0 16, 0x80, 4
+    psq_st_gqr0 17, 0x88, 4
+    psq_st_gqr0 18, 0x90, 4
+    psq_st_gqr0 19, 0x98, 4
+    psq_st_gqr0 20, 0xA0, 4
+    psq_st_gqr0 21, 0xA8, 4
+    psq_st_gqr0 22, 0xB0, 4
+    psq_st_gqr0 23, 0xB8, 4
+    psq_st_gqr0 24, 0xC0, 4
+    psq_st_gqr0 25, 0xC8, 4
+    psq_st_gqr0 26, 0xD0, 4
+    psq_st_gqr0 27, 0xD8, 4
+    psq_st_gqr0 28, 0xE0, 4
+    psq_st_gqr0 29, 0xE8, 4
+    psq_st_gqr0 30, 0xF0, 4
+    psq_st_gqr0 31, 0xF8, 4
+
+    mtspr 912, 7
+    isync
+
+no_ps_save:
+    # Full precision ps0
+    stfd 0, 0x0(3)
+    stfd 1, 0x8(3)
+    stfd 2, 0x10(3)
+    stfd 3, 0x18(3)
+    stfd 4, 0x20(3)
+    stfd 5, 0x28(3)
+    stfd 6, 0x30(3)
+    stfd 7, 0x38(3)
+    stfd 8, 0x40(3)
+    stfd 9, 0x48(3)
+    stfd 10, 0x50(3)
+    stfd 11, 0x58(3)
+    stfd 12, 0x60(3)
+    stfd 13, 0x68(3)
+    stfd 14, 0x70(3)
+    stfd 15, 0x78(3)
+    stfd 16, 0x80(3)
+    stfd 17, 0x88(3)
+    stfd 18, 0x90(3)
+    stfd 19, 0x98(3)
+    stfd 20, 0xA0(3)
+    stfd 21, 0xA8(3)
+    stfd 22, 0xB0(3)
+    stfd 23, 0xB8(3)
+    stfd 24, 0xC0(3)
+    stfd 25, 0xC8(3)
+    stfd 26, 0xD0(3)
+    stfd 27, 0xD8(3)
+    stfd 28, 0xE0(3)
+    stfd 29, 0xE8(3)
+    stfd 30, 0xF0(3)
+    stfd 31, 0xF8(3)
+
+    # Float State
+    mffs 0
+    stfd 0, 0x200(3)
+
+    mtmsr 5
+    isync
+    blr
+
+// Loads the floating point registers from a exception_fpu_context_t.
+.global exception_fpu_load
+exception_fpu_load:
+    mfmsr 5
+    ori 6, 5, 0x2000
+    mtmsr 6
+    isync
+
+    # Like the exception restore, FPSCR goes before the floats
+    lfd 0, 0x200(3)
+    mtfsf 255, 0
+
+    mfspr 6, 920
+    rlwinm. 6, 6, 3, 31, 31
+    beq no_ps_load
+
+    mfspr 7, 912
+    li 8, 0
+    mtspr 912, 8
+    isync
+
+    addi 4, 3, 0x100
+    psq_l_gqr0 0, 0x0, 4
+    psq_l_gqr0 1, 0x8, 4
+    psq_l_gqr0 2, 0x10, 4
+    psq_l_gqr0 3, 0x18, 4
+    psq_l_gqr0 4, 0x20, 4
+    psq_l_gqr0 5, 0x28, 4
+    psq_l_gqr0 6, 0x30, 4
+    psq_l_gqr0 7, 0x38, 4
+    psq_l_gqr0 8, 0x40, 4
+    psq_l_gqr0 9, 0x48, 4
+    psq_l_gqr0 10, 0x50, 4
+    psq_l_gqr0 11, 0x58, 4
+    psq_l_gqr0 12, 0x60, 4
+    psq_l_gqr0 13, 0x68, 4
+    psq_l_gqr0 14, 0x70, 4
+    psq_l_gqr0 15, 0x78, 4
+    psq_l_gqr0 16, 0x80, 4
+    psq_l_gqr0 17, 0x88, 4
+    psq_l_gqr0 18, 0x90, 4
+    psq_l_gqr0 19, 0x98, 4
+    psq_l_gqr0 20, 0xA0, 4
+    psq_l_gqr0 21, 0xA8, 4
+    psq_l_gqr0 22, 0xB0, 4
+    psq_l_gqr0 23, 0xB8, 4
+    psq_l_gqr0 24, 0xC0, 4
+    psq_l_gqr0 25, 0xC8, 4
+    psq_l_gqr0 26, 0xD0, 4
+    psq_l_gqr0 27, 0xD8, 4
+    psq_l_gqr0 28, 0xE0, 4
+    psq_l_gqr0 29, 0xE8, 4
+    psq_l_gqr0 30, 0xF0, 4
+    psq_l_gqr0 31, 0xF8, 4
+
+    mtspr 912, 7
+    isync
+
+no_ps_load:
+    # lfd only replaces ps0, so this brings back full precision over the single loaded above
+    lfd 0, 0x0(3)
+    lfd 1, 0x8(3)
+    lfd 2, 0x10(3)
+    lfd 3, 0x18(3)
+    lfd 4, 0x20(3)
+    lfd 5, 0x28(3)
+    lfd 6, 0x30(3)
+    lfd 7, 0x38(3)
+    lfd 8, 0x40(3)
+    lfd 9, 0x48(3)
+    lfd 10, 0x50(3)
+    lfd 11, 0x58(3)
+    lfd 12, 0x60(3)
+    lfd 13, 0x68(3)
+    lfd 14, 0x70(3)
+    lfd 15, 0x78(3)
+    lfd 16, 0x80(3)
+    lfd 17, 0x88(3)
+    lfd 18, 0x90(3)
+    lfd 19, 0x98(3)
+    lfd 20, 0xA0(3)
+    lfd 21, 0xA8(3)
+    lfd 22, 0xB0(3)
+    lfd 23, 0xB8(3)
+    lfd 24, 0xC0(3)
+    lfd 25, 0xC8(3)
+    lfd 26, 0xD0(3)
+    lfd 27, 0xD8(3)
+    lfd 28, 0xE0(3)
+    lfd 29, 0xE8(3)
+    lfd 30, 0xF0(3)
+    lfd 31, 0xF8(3)
+
+    mtmsr 5
+    isync
+    blr
+
 // Tail end of an exception. Just for starting the first task
 .global exceptions_start_first_task
 exceptions_start_first_task:
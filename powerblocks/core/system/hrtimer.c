@@ -0,0 +1,324 @@
+/**
+ * @file hrtimer.c
+ * @brief High Resolution Timers
+ *
+ * Sets the decrementer for whichever comes first, the next timer
+ * or the next FreeRTOS tick. Also stops the tick while idle.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "hrtimer.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "exceptions.h"
+
+#include <string.h>
+
+#define HRTIMER_TICK_PERIOD (SYSTEM_TB_CLOCK_HZ / configTICK_RATE_HZ)
+
+// The decrementer interrupts once it goes negative, so this is as far out as it can be set
+#define HRTIMER_DEC_MAX 0x7FFFFFFF
+
+// Longest the tick is stopped for at once, keeps the math from overflowing
+// when every task is blocked forever. The idle task just stops it again.
+#define HRTIMER_TICKLESS_MAX_TICKS (configTICK_RATE_HZ * 10)
+
+// Sleeps shorter than this spin, blocking and waking back up takes about as long
+#define HRTIMER_SLEEP_SPIN_US 10
+
+// Lateness is clamped to this many ticks in the stats, about 17 seconds
+#define HRTIMER_LATE_CAP ((1u << 30) - 1)
+
+// Started timers, soonest first
+static hrtimer_t* hrtimer_head;
+
+static bool hrtimer_running;
+
+// When the next FreeRTOS tick is due
+static uint64_t hrtimer_next_tick;
+
+// Set while the idle task has stopped the tick, until when
+static bool hrtimer_tickless;
+static uint64_t hrtimer_tickless_until;
+
+static hrtimer_stats_t hrtimer_all_stats;
+static hrtimer_tick_stats_t hrtimer_tick_stats;
+
+static void hrtimer_program(uint64_t now) {
+    uint64_t deadline = hrtimer_tickless ? hrtimer_tickless_until : hrtimer_next_tick;
+    if(hrtimer_head != NULL && hrtimer_head->deadline < deadline)
+        deadline = hrtimer_head->deadline;
+
+    uint32_t dec;
+    if(deadline <= now)
+        dec = 1;
+    else if(deadline - now > HRTIMER_DEC_MAX)
+        dec = HRTIMER_DEC_MAX;
+    else
+        dec = (uint32_t)(deadline - now);
+
+    SYSTEM_SET_DEC(dec);
+}
+
+static void hrtimer_insert(hrtimer_t* timer) {
+    hrtimer_t** link = &hrtimer_head;
+    while(*link != NULL && (*link)->deadline <= timer->deadline)
+        link = &(*link)->next;
+
+    timer->next = *link;
+    *link = timer;
+}
+
+static void hrtimer_remove(hrtimer_t* timer) {
+    hrtimer_t** link = &hrtimer_head;
+    while(*link != NULL) {
+        if(*link == timer) {
+            *link = timer->next;
+            break;
+        }
+        link = &(*link)->next;
+    }
+    timer->next = NULL;
+}
+
+static void hrtimer_record(hrtimer_stats_t* stats, uint32_t late, uint32_t bucket) {
+    stats->count++;
+    stats->total_late += late;
+    if(late > stats->max_late)
+        stats->max_late = late;
+    stats->histogram[bucket]++;
+}
+
+static void hrtimer_record_late(hrtimer_t* timer, uint64_t now) {
+    // Capped so microseconds can be worked out without a 64 bit divide,
+    // late * 4 still has to fit in 32 bits
+    uint64_t late64 = now - timer->deadline;
+    uint32_t late = late64 > HRTIMER_LATE_CAP ? HRTIMER_LATE_CAP : (uint32_t)late64;
+
+    // The time base runs at 60.75 MHz, 243 ticks every 4 us
+    uint32_t us = late * 4 / 243;
+
+    uint32_t bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+    if(bucket >= HRTIMER_HISTOGRAM_BUCKETS)
+        bucket = HRTIMER_HISTOGRAM_BUCKETS - 1;
+
+    hrtimer_record(&timer->stats, late, bucket);
+    hrtimer_record(&hrtimer_all_stats, late, bucket);
+}
+
+static void hrtimer_expire(uint64_t now) {
+    hrtimer_t* timer = hrtimer_head;
+    hrtimer_head = timer->next;
+    timer->next = NULL;
+
+    hrtimer_record_late(timer, now);
+
+    // Rearmed before the callback, so the callback can still stop or restart it
+    if(timer->period != 0) {
+        uint64_t next = timer->deadline + timer->period;
+        if(next <= now) {
+            uint64_t skipped = (now - next) / timer->period + 1;
+            timer->stats.missed += skipped;
+            hrtimer_all_stats.missed += skipped;
+            next += skipped * timer->period;
+        }
+
+        timer->deadline = next;
+        hrtimer_insert(timer);
+    } else {
+        timer->active = false;
+    }
+
+    timer->callback(timer, timer->param);
+}
+
+void hrtimer_initialize(hrtimer_t* timer, hrtimer_callback_t callback, void* param) {
+    memset(timer, 0, sizeof(*timer));
+    timer->callback = callback;
+    timer->param = param;
+}
+
+int hrtimer_start(hrtimer_t* timer, uint64_t deadline, uint64_t period) {
+    if(timer == NULL || timer->callback == NULL)
+        return -1;
+
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+
+    if(timer->active)
+        hrtimer_remove(timer);
+
+    timer->deadline = deadline;
+    timer->period = period;
+    timer->active = true;
+    hrtimer_insert(timer);
+
+    // Only matters if it is now the soonest
+    if(hrtimer_running && hrtimer_head == timer)
+        hrtimer_program(system_get_time_base_int());
+
+    SYSTEM_ENABLE_ISR(level);
+
+    return 0;
+}
+
+int hrtimer_start_us(hrtimer_t* timer, uint32_t delay_us, uint32_t period_us) {
+    return hrtimer_start(timer, system_get_time_base_int() + SYSTEM_US_TO_TICKS(delay_us),
+                         SYSTEM_US_TO_TICKS(period_us));
+}
+
+void hrtimer_stop(hrtimer_t* timer) {
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+
+    // The decrementer may still go off for it, that just finds nothing to do
+    if(timer->active) {
+        hrtimer_remove(timer);
+        timer->active = false;
+    }
+
+    SYSTEM_ENABLE_ISR(level);
+}
+
+bool hrtimer_is_active(const hrtimer_t* timer) {
+    return timer->active;
+}
+
+static void hrtimer_sleep_callback(hrtimer_t* timer, void* param) {
+    xSemaphoreGiveFromISR((SemaphoreHandle_t)param, &exception_isr_context_switch_needed);
+}
+
+void hrtimer_sleep_us(uint32_t us) {
+    // Nothing would ever expire the timer before the tick is started
+    if(us < HRTIMER_SLEEP_SPIN_US || !hrtimer_running) {
+        system_delay_int(SYSTEM_US_TO_TICKS(us));
+        return;
+    }
+
+    StaticSemaphore_t done_data;
+    SemaphoreHandle_t done = xSemaphoreCreateBinaryStatic(&done_data);
+
+    hrtimer_t timer;
+    hrtimer_initialize(&timer, hrtimer_sleep_callback, done);
+    hrtimer_start_us(&timer, us, 0);
+
+    xSemaphoreTake(done, portMAX_DELAY);
+}
+
+void hrtimer_get_stats(const hrtimer_t* timer, hrtimer_stats_t* stats) {
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    *stats = timer ? timer->stats : hrtimer_all_stats;
+    SYSTEM_ENABLE_ISR(level);
+}
+
+void hrtimer_reset_stats(hrtimer_t* timer) {
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    memset(timer ? &timer->stats : &hrtimer_all_stats, 0, sizeof(hrtimer_stats_t));
+    SYSTEM_ENABLE_ISR(level);
+}
+
+void hrtimer_get_tick_stats(hrtimer_tick_stats_t* stats) {
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    *stats = hrtimer_tick_stats;
+    SYSTEM_ENABLE_ISR(level);
+}
+
+void hrtimer_start_tick() {
+    uint64_t now = system_get_time_base_int();
+
+    hrtimer_next_tick = now + HRTIMER_TICK_PERIOD;
+    hrtimer_tickless = false;
+    hrtimer_running = true;
+
+    hrtimer_program(now);
+}
+
+void hrtimer_tickless_idle(uint64_t idle_ticks) {
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+
+    // Something became ready since the idle task decided to sleep
+    if(eTaskConfirmSleepModeStatus() == eAbortSleep) {
+        SYSTEM_ENABLE_ISR(level);
+        return;
+    }
+
+    if(idle_ticks > HRTIMER_TICKLESS_MAX_TICKS)
+        idle_ticks = HRTIMER_TICKLESS_MAX_TICKS;
+
+    // When the tick the next task wakes on is due
+    hrtimer_tickless_until = hrtimer_next_tick + (idle_ticks - 1) * HRTIMER_TICK_PERIOD;
+    hrtimer_tickless = true;
+    hrtimer_tick_stats.sleeps++;
+
+    hrtimer_program(system_get_time_base_int());
+
+    // Interrupts still come in, timers still run. Stop once one of them
+    // makes a task ready or the wake up tick comes.
+    while(true) {
+        SYSTEM_ENABLE_ISR(level);
+        SYSTEM_DISABLE_ISR(level);
+
+        if(eTaskConfirmSleepModeStatus() == eAbortSleep)
+            break;
+        if(system_get_time_base_int() >= hrtimer_tickless_until)
+            break;
+    }
+
+    hrtimer_tickless = false;
+
+    // Step over the ticks that went by. Any past the wake up tick are left
+    // for the decrementer, the tick count can not jump past a task's wake up.
+    uint64_t now = system_get_time_base_int();
+    if(now >= hrtimer_next_tick) {
+        uint64_t elapsed = (now - hrtimer_next_tick) / HRTIMER_TICK_PERIOD + 1;
+        if(elapsed > idle_ticks)
+            elapsed = idle_ticks;
+
+        vTaskStepTick(elapsed);
+        hrtimer_next_tick += elapsed * HRTIMER_TICK_PERIOD;
+        hrtimer_tick_stats.ticks_skipped += elapsed;
+    }
+
+    hrtimer_program(now);
+
+    SYSTEM_ENABLE_ISR(level);
+}
+
+bool hrtimer_decrementer() {
+    if(!hrtimer_running) {
+        SYSTEM_SET_DEC(HRTIMER_DEC_MAX);
+        return false;
+    }
+
+    bool switch_needed = false;
+    uint64_t now = system_get_time_base_int();
+
+    hrtimer_tick_stats.interrupts++;
+
+    // The idle task catches the tick count up itself once it wakes
+    if(!hrtimer_tickless) {
+        while(hrtimer_next_tick <= now) {
+            if(xTaskIncrementTick() != pdFALSE)
+                switch_needed = true;
+            hrtimer_next_tick += HRTIMER_TICK_PERIOD;
+        }
+    }
+
+    // Time is read again each time, callbacks take some
+    while(hrtimer_head != NULL && hrtimer_head->deadline <= (now = system_get_time_base_int()))
+        hrtimer_expire(now);
+
+    hrtimer_program(system_get_time_base_int());
+
+    return switch_needed;
+}
@@ -0,0 +1,196 @@
+/**
+ * @file hrtimer.h
+ * @brief High Resolution Timers
+ *
+ * Callbacks at a time base deadline, down to about a microsecond,
+ * one shot or periodic.
+ *
+ * The decrementer is set for whichever comes first, the next timer
+ * or the next FreeRTOS tick, so timers are not limited to the 1 ms tick.
+ * Ticks are kept to the time base, they do not drift from interrupt latency.
+ *
+ * While nothing but the idle task can run, the tick is stopped until
+ * the next task needs to wake up, instead of interrupting every millisecond.
+ *
+ * Callbacks run inside the decrementer interrupt, they must follow the same
+ * rules as an interrupt handler. Keep them short, use the FromISR functions
+ * with exception_isr_context_switch_needed, and no floating point.
+ *
+ * Every callback records how late it ran into a histogram,
+ * for that timer and for all of them together.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "powerblocks/core/system/system.h"
+
+// Histogram bucket 0 counts callbacks under 1 us late, bucket n under 2^n us.
+// The last one counts everything later.
+#define HRTIMER_HISTOGRAM_BUCKETS 12
+
+typedef struct hrtimer hrtimer_t;
+
+/**
+ * @typedef hrtimer_callback_t
+ * @brief Called when a timer expires.
+ *
+ * Called from the decrementer interrupt.
+ * The timer can be started or stopped again from here.
+ *
+ * @param timer Timer that expired
+ * @param param User parameter
+ */
+typedef void (*hrtimer_callback_t)(hrtimer_t* timer, void* param);
+
+/**
+ * @struct hrtimer_stats_t
+ * @brief How late callbacks ran.
+ */
+typedef struct {
+    uint32_t count;                                // Callbacks ran
+    uint32_t missed;                               // Periods skipped because the callback ran too late for them
+    uint64_t total_late;                           // Time base ticks late, added up
+    uint32_t max_late;                             // Time base ticks late, most
+    uint32_t histogram[HRTIMER_HISTOGRAM_BUCKETS]; // Callbacks by how late they ran
+} hrtimer_stats_t;
+
+/**
+ * @struct hrtimer_tick_stats_t
+ * @brief What the decrementer has been doing.
+ */
+typedef struct {
+    uint32_t interrupts;    // Decrementer interrupts taken
+    uint32_t sleeps;        // Times the idle task stopped the tick
+    uint64_t ticks_skipped; // Ticks stepped over while stopped, instead of interrupting for each
+} hrtimer_tick_stats_t;
+
+/**
+ * @struct hrtimer
+ * @brief A timer. Owned by the caller, must stay around while it is started.
+ */
+struct hrtimer {
+    hrtimer_t* next;
+    uint64_t deadline; // Time base of the next expiry
+    uint64_t period;   // Time base ticks between expiries, 0 for one shot
+    hrtimer_callback_t callback;
+    void* param;
+    bool active;
+
+    hrtimer_stats_t stats;
+};
+
+/**
+ * @brief Sets up a timer.
+ *
+ * @param timer Timer
+ * @param callback Called when it expires
+ * @param param User parameter for the callback
+ */
+extern void hrtimer_initialize(hrtimer_t* timer, hrtimer_callback_t callback, void* param);
+
+/**
+ * @brief Starts a timer at a time base deadline.
+ *
+ * Restarts it if already started. Safe from interrupts and callbacks.
+ * A deadline already passed expires right away.
+ *
+ * Periodic timers expire every period after the deadline, not
+ * after the callback, so they do not drift.
+ *
+ * @param timer Timer
+ * @param deadline Time base of the first expiry
+ * @param period Time base ticks between expiries, 0 for one shot
+ * @return Negative if error
+ */
+extern int hrtimer_start(hrtimer_t* timer, uint64_t deadline, uint64_t period);
+
+/**
+ * @brief Starts a timer some microseconds from now.
+ *
+ * @param timer Timer
+ * @param delay_us Microseconds till the first expiry
+ * @param period_us Microseconds between expiries, 0 for one shot
+ * @return Negative if error
+ */
+extern int hrtimer_start_us(hrtimer_t* timer, uint32_t delay_us, uint32_t period_us);
+
+/**
+ * @brief Stops a timer.
+ *
+ * Safe from interrupts and callbacks. Does nothing if not started.
+ *
+ * @param timer Timer
+ */
+extern void hrtimer_stop(hrtimer_t* timer);
+
+/**
+ * @brief Checks if a timer is started.
+ */
+extern bool hrtimer_is_active(const hrtimer_t* timer);
+
+/**
+ * @brief Blocks the calling task for some microseconds.
+ *
+ * Unlike vTaskDelay this is not rounded to the tick, and unlike
+ * system_delay_int other tasks run in the meantime.
+ * Very short sleeps just spin, as does any sleep before hrtimer_start_tick.
+ *
+ * @param us Microseconds to sleep
+ */
+extern void hrtimer_sleep_us(uint32_t us);
+
+/**
+ * @brief Gets how late callbacks ran.
+ *
+ * @param timer Timer, NULL for every timer together
+ * @param stats Outputted stats
+ */
+extern void hrtimer_get_stats(const hrtimer_t* timer, hrtimer_stats_t* stats);
+
+/**
+ * @brief Clears how late callbacks ran.
+ *
+ * @param timer Timer, NULL for every timer together
+ */
+extern void hrtimer_reset_stats(hrtimer_t* timer);
+
+/**
+ * @brief Gets decrementer and tickless idle counters.
+ *
+ * @param stats Outputted stats
+ */
+extern void hrtimer_get_tick_stats(hrtimer_tick_stats_t* stats);
+
+/**
+ * @brief Starts the FreeRTOS tick.
+ *
+ * Called by the FreeRTOS port as the scheduler starts.
+ */
+extern void hrtimer_start_tick();
+
+/**
+ * @brief Stops the tick while idle.
+ *
+ * Called by the FreeRTOS port from the idle task, with the scheduler suspended.
+ * Waits until the tick the next task wakes on, or until anything
+ * else makes a task ready, then catches the tick count up.
+ *
+ * @param idle_ticks Ticks until the next task wakes up
+ */
+extern void hrtimer_tickless_idle(uint64_t idle_ticks);
+
+/**
+ * @brief Handles the decrementer interrupt.
+ *
+ * Called from the decrementer exception.
+ *
+ * @return True if the tick made a task ready to switch to
+ */
+extern bool hrtimer_decrementer();
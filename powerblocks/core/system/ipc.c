@@ -5,6 +5,14 @@
  * IPC interface between Broadway and Starlet.
  * Designed to implement IOS's protocol.
  *
+ * Requests are pushed onto a submission ring and return right away.
+ * Starlet only takes one message at a time, so the interrupt posts
+ * the next one each time an acknowledgement comes back.
+ *
+ * Replies are moved off the interrupt onto a completion ring and
+ * handed to a completion task, which runs every handler that piled
+ * up in one pass with interrupts enabled.
+ *
  * @author Samuel Fitzsimons (rainbain)
  * @date 2025
  * @license MIT (see LICENSE file)
@@ -17,9 +25,13 @@
 
 #include "FreeRTOS.h"
 #include "semphr.h"
+#include "task.h"
 
 #include "utils/log.h"
 
+#include <stdbool.h>
+#include <string.h>
+
 static const char* TAB = "IPC";
 
 #define IPC_PPCMSG   (*(volatile uint32_t*)0xcd800000)
@@ -27,9 +39,16 @@ static const char* TAB = "IPC";
 #define IPC_ARMMSG   (*(volatile uint32_t*)0xcd800008)
 #define IPC_ARMCTRL  (*(volatile uint32_t*)0xcd80000c)
 
-// An arbitrary value, but it will stop putting in request if this many are pending
+// Depth of the submission ring. Posting only blocks once this many are waiting on starlet.
 #define IPC_MAX_REQUEST_COUNT 32
 
+// Depth of the completion ring. Must be a power of 2.
+// If it ever fills, handlers are ran straight from the interrupt like before.
+#define IPC_MAX_COMPLETION_COUNT 64
+
+#define IPC_COMPLETION_TASK_STACK_SIZE 4096
+#define IPC_COMPLETION_TASK_PRIORITY   (configMAX_PRIORITIES - 1) // Same as the timer task, it stands in for the interrupt
+
 #define IPC_PPCCTRL_X1  (1<<0)
 #define IPC_PPCCTRL_Y2  (1<<1)
 #define IPC_PPCCTRL_Y1  (1<<2)
@@ -39,39 +58,97 @@ static const char* TAB = "IPC";
 
 #define IPC_MESSAGE_MAGIC 0x64e0eaed
 
-static StaticSemaphore_t ipc_semaphore_static[2];
+typedef struct {
+    ipc_message* message;
+    int return_value;
+} ipc_completion_t;
+
+static StaticSemaphore_t ipc_semaphore_static;
+
+// Counts free submission slots. Only blocks when the ring is full.
+static SemaphoreHandle_t ipc_semaphore_slots;
+
+// Messages waiting for starlet to take them.
+// Written by tasks with interrupts off, read by the interrupt.
+static ipc_message* ipc_submission_ring[IPC_MAX_REQUEST_COUNT];
+static uint32_t ipc_submission_head;
+static uint32_t ipc_submission_count;
+
+// Set while a message has been posted and starlet has not acknowledged it yet.
+static bool ipc_in_flight;
+
+// Replies waiting on the completion task.
+// Single producer (interrupt), single consumer (completion task).
+static ipc_completion_t ipc_completion_ring[IPC_MAX_COMPLETION_COUNT];
+static volatile uint32_t ipc_completion_head;
+static volatile uint32_t ipc_completion_tail;
+
+static TaskHandle_t ipc_completion_task_handle;
+static StaticTask_t ipc_completion_task_data;
+static StackType_t ipc_completion_task_stack[IPC_COMPLETION_TASK_STACK_SIZE / sizeof(StackType_t)];
+
+// Set while a reply is held back in Starlet for lack of ring space.
+// The interrupt masks IY1, the completion task unmasks it once it has drained.
+static volatile bool ipc_completion_stalled;
 
-// Taken when something is sending an IPC command and awaiting an acknowledgment.
-// So other task will wait for it to be done before using it.
-static SemaphoreHandle_t ipc_semaphore_busy;
+static ipc_stats_t ipc_stats;
 
-// A counting semaphore thats givin when a interrupt is
-// generated carrying a acknowledgement. Allowing the thread to continue.
-static SemaphoreHandle_t ipc_semaphore_acknowledge;
+static void ipc_post(ipc_message* message) {
+    ipc_in_flight = true;
+    IPC_PPCMSG = SYSTEM_MEM_PHYSICAL(message);
+    IPC_PPCCTRL = (IPC_PPCCTRL & 0x30) | IPC_PPCCTRL_X1;
+}
 
 static void ipc_irq_handler(exception_irq_type_t irq) {
     uint32_t ctrl = IPC_PPCCTRL;
 
     if(ctrl & IPC_PPCCTRL_Y2) {
-        xSemaphoreGiveFromISR(ipc_semaphore_acknowledge, &exception_isr_context_switch_needed);
         IPC_PPCCTRL = (IPC_PPCCTRL & 0x30) | IPC_PPCCTRL_Y2; // Clear bit
+        ipc_stats.acknowledged++;
+
+        // Starlet has the message, feed it the next one.
+        if(ipc_submission_count) {
+            ipc_message* next = ipc_submission_ring[ipc_submission_head];
+            ipc_submission_head = (ipc_submission_head + 1) % IPC_MAX_REQUEST_COUNT;
+            ipc_submission_count--;
+            ipc_post(next);
+        } else {
+            ipc_in_flight = false;
+        }
+
+        xSemaphoreGiveFromISR(ipc_semaphore_slots, &exception_isr_context_switch_needed);
     }
 
     if(ctrl & IPC_PPCCTRL_Y1) {
-        ipc_message* message = (ipc_message*)SYSTEM_MEM_CACHED(IPC_ARMMSG);
+        if(ipc_completion_head - ipc_completion_tail >= IPC_MAX_COMPLETION_COUNT) {
+            // Completion task is too far behind. Leave Y1 set so Starlet holds
+            // the reply, and stop taking it until the ring has room again.
+            // Running the handler here would finish it ahead of earlier replies.
+            ipc_stats.completion_overflows++;
+            ipc_completion_stalled = true;
+            IPC_PPCCTRL = IPC_PPCCTRL & IPC_PPCCTRL_IY2;
+        } else {
+            ipc_message* message = (ipc_message*)SYSTEM_MEM_CACHED(IPC_ARMMSG);
 
-        if(message->magic == IPC_MESSAGE_MAGIC) {
-            // Invalidate memory so we can read the return value
-            system_invalidate_dcache((void*)message, 32);
-            int return_value = message->returned;
+            if(message->magic == IPC_MESSAGE_MAGIC) {
+                // Invalidate memory so we can read the return value
+                system_invalidate_dcache((void*)message, 32);
+                int return_value = message->returned;
 
-            // Clear magic
-            message->magic = 0;
+                // Clear magic
+                message->magic = 0;
 
-            message->response_handler(message->params, return_value);
-        }
+                uint32_t head = ipc_completion_head;
+                ipc_completion_t* completion = &ipc_completion_ring[head % IPC_MAX_COMPLETION_COUNT];
+                completion->message = message;
+                completion->return_value = return_value;
+                ipc_completion_head = head + 1;
 
-        IPC_PPCCTRL = (IPC_PPCCTRL & 0x30) | IPC_PPCCTRL_Y1 | IPC_PPCCTRL_X2; // Clear bit and relaunch
+                vTaskNotifyGiveFromISR(ipc_completion_task_handle, &exception_isr_context_switch_needed);
+            }
+
+            IPC_PPCCTRL = (IPC_PPCCTRL & 0x30) | IPC_PPCCTRL_Y1 | IPC_PPCCTRL_X2; // Clear bit and relaunch
+        }
     }
 
     // Acknowledge interrupts.
@@ -79,10 +156,67 @@ static void ipc_irq_handler(exception_irq_type_t irq) {
     EXCEPTION_PPC_IRQ |= (1<<30);
 }
 
+static void ipc_completion_task(void* unused) {
+    while(true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Interrupts zero exception_isr_context_switch_needed whenever they come in,
+        // so this pass keeps its own and hands it to each handler.
+        BaseType_t woken = pdFALSE;
+
+        uint32_t batch = 0;
+        while(ipc_completion_tail != ipc_completion_head) {
+            // Copy it out first, the interrupt can reuse the entry once the tail moves
+            ipc_completion_t completion = ipc_completion_ring[ipc_completion_tail % IPC_MAX_COMPLETION_COUNT];
+            ipc_completion_tail++;
+
+            // Handlers are written for interrupt context and call FromISR functions,
+            // which do not mask on this port. Mask around each one, not the whole batch.
+            uint32_t level;
+            SYSTEM_DISABLE_ISR(level);
+            completion.message->response_handler(completion.message->params, completion.return_value, &woken);
+            SYSTEM_ENABLE_ISR(level);
+
+            batch++;
+        }
+
+        if(batch) {
+            ipc_stats.batches++;
+            ipc_stats.completed += batch;
+            if(batch > ipc_stats.max_batch)
+                ipc_stats.max_batch = batch;
+        }
+
+        // Take the held back reply now there is room for it.
+        // Y1 is still set, so the interrupt comes straight back in.
+        if(ipc_completion_stalled) {
+            uint32_t level;
+            SYSTEM_DISABLE_ISR(level);
+            ipc_completion_stalled = false;
+            IPC_PPCCTRL = (IPC_PPCCTRL & IPC_PPCCTRL_IY2) | IPC_PPCCTRL_IY1;
+            SYSTEM_ENABLE_ISR(level);
+        }
+
+        // Only switch once for the whole batch.
+        if(woken)
+            portYIELD();
+    }
+}
+
 void ipc_initialize() {
     // Create Semaphores
-    ipc_semaphore_busy = xSemaphoreCreateMutexStatic(ipc_semaphore_static + 0);
-    ipc_semaphore_acknowledge = xSemaphoreCreateCountingStatic(IPC_MAX_REQUEST_COUNT, 0, ipc_semaphore_static + 1);
+    ipc_semaphore_slots = xSemaphoreCreateCountingStatic(IPC_MAX_REQUEST_COUNT, IPC_MAX_REQUEST_COUNT, &ipc_semaphore_static);
+
+    ipc_submission_head = 0;
+    ipc_submission_count = 0;
+    ipc_in_flight = false;
+    ipc_completion_head = 0;
+    ipc_completion_tail = 0;
+    ipc_completion_stalled = false;
+    memset(&ipc_stats, 0, sizeof(ipc_stats));
+
+    ipc_completion_task_handle = xTaskCreateStatic(ipc_completion_task, TAB, IPC_COMPLETION_TASK_STACK_SIZE / sizeof(StackType_t),
+                                                    NULL, IPC_COMPLETION_TASK_PRIORITY, ipc_completion_task_stack, &ipc_completion_task_data);
 
     // Register and Enable Interrupts
     exceptions_install_irq(ipc_irq_handler, EXCEPTION_IRQ_TYPE_IPC);
@@ -106,16 +240,45 @@ int ipc_request(ipc_message* message, ipc_async_handler_t handler, void* params)
     // Only do the 32 bytes, since thats only the part starlet cares about
     system_flush_dcache((void*)message_v, 32);
 
-    // Send request to hardware
-    xSemaphoreTake(ipc_semaphore_busy, portMAX_DELAY);
-    
-    IPC_PPCMSG = SYSTEM_MEM_PHYSICAL(message_v);
-    IPC_PPCCTRL = (IPC_PPCCTRL & 0x30) | IPC_PPCCTRL_X1;
+    // Reserve a slot, only waits if the ring is full
+    if(xSemaphoreTake(ipc_semaphore_slots, 0) != pdTRUE) {
+        ipc_stats.full_stalls++;
+        xSemaphoreTake(ipc_semaphore_slots, portMAX_DELAY);
+    }
+
+    // The interrupt is the only other side of the ring,
+    // so keeping it out for a few instructions is all the locking needed.
+    int ee;
+    SYSTEM_DISABLE_ISR(ee);
+
+    ipc_stats.submitted++;
+
+    if(!ipc_in_flight) {
+        ipc_post(message);
+    } else {
+        uint32_t tail = (ipc_submission_head + ipc_submission_count) % IPC_MAX_REQUEST_COUNT;
+        ipc_submission_ring[tail] = message;
+        ipc_submission_count++;
+
+        if(ipc_submission_count > ipc_stats.max_queue_depth)
+            ipc_stats.max_queue_depth = ipc_submission_count;
+    }
 
-    // Wait for acknowledgment.
-    xSemaphoreTake(ipc_semaphore_acknowledge, portMAX_DELAY);
-    xSemaphoreGive(ipc_semaphore_busy);
+    SYSTEM_ENABLE_ISR(ee);
 
-    
     return 0;
-}
\ No newline at end of file
+}
+
+void ipc_get_stats(ipc_stats_t* stats) {
+    int ee;
+    SYSTEM_DISABLE_ISR(ee);
+    *stats = ipc_stats;
+    SYSTEM_ENABLE_ISR(ee);
+}
+
+void ipc_reset_stats() {
+    int ee;
+    SYSTEM_DISABLE_ISR(ee);
+    memset(&ipc_stats, 0, sizeof(ipc_stats));
+    SYSTEM_ENABLE_ISR(ee);
+}
@@ -14,7 +14,17 @@
 
 #include <stdint.h>
 
-typedef void (*ipc_async_handler_t)(void* param, int return_value);
+#include "FreeRTOS.h"
+
+/**
+ * @brief Response handler.
+ *
+ * Runs with interrupts masked, like an interrupt handler.
+ * Pass woken to the FromISR calls it makes, where an interrupt handler would
+ * pass &exception_isr_context_switch_needed. Whoever runs the handler switches
+ * tasks if it gets set.
+ */
+typedef void (*ipc_async_handler_t)(void* param, int return_value, BaseType_t* woken);
 
 typedef struct {
     int command;
@@ -72,14 +82,29 @@ typedef struct {
     
 } ipc_message;
 
+/**
+ * @struct ipc_stats_t
+ * @brief IPC throughput counters.
+ */
+typedef struct {
+    uint64_t submitted;            // Requests put into the submission ring
+    uint64_t acknowledged;         // Requests starlet has taken
+    uint64_t completed;            // Handlers ran by the completion task
+    uint64_t batches;              // Times the completion task woke up with work
+    uint32_t max_batch;            // Most handlers ran in one wake up
+    uint32_t max_queue_depth;      // Most requests waiting on starlet at once
+    uint32_t full_stalls;          // Times a request had to wait for a free slot
+    uint32_t completion_overflows; // Replies held back in Starlet because the completion ring was full
+} ipc_stats_t;
+
 /**
  * @brief Initializes the IPC Interface
  * 
  * Usually called through ios_initialize
  *
  * Initializes the IPC interface.
- * Setups the FreeRTOS Mutexes and data structures for
- * communications.
+ * Setups the FreeRTOS semaphores, rings and completion
+ * task used for communications.
  * 
  */
 extern void ipc_initialize();
@@ -87,12 +112,28 @@ extern void ipc_initialize();
 /**
  * @brief Puts a request in and gets the response.
  * 
- * Puts a request into the IPC interface.
- * Then after its completion, the handler will be called from the interrupt service.
+ * Puts a request into the IPC submission ring and returns
+ * without waiting on starlet. Only blocks if the ring is full.
+ * 
+ * After its completion, the handler will be called from the IPC completion
+ * task with interrupts masked, in the order replies came back. It must not block
+ * and must use the FromISR functions, passing them its woken argument.
  * 
  * @param message Data structure to the message to send to Starlet.
- * @param handler Handler called from interrupt service upon compilation.
+ * @param handler Handler called upon completion.
  * @param params Pointer passed to the handler.
  * @return Result as int, negative if error.
  */
-extern int ipc_request(ipc_message* message, ipc_async_handler_t handler, void* params);
\ No newline at end of file
+extern int ipc_request(ipc_message* message, ipc_async_handler_t handler, void* params);
+
+/**
+ * @brief Reads back the IPC counters.
+ *
+ * @param stats Outputted stats
+ */
+extern void ipc_get_stats(ipc_stats_t* stats);
+
+/**
+ * @brief Clears the IPC counters.
+ */
+extern void ipc_reset_stats();
\ No newline at end of file
@@ -0,0 +1,230 @@
+/**
+ * @file mem.c
+ * @brief System Heaps
+ *
+ * Separate heaps for MEM1 and MEM2.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "mem.h"
+
+#include "system.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/log.h"
+
+// Stack system_initialize runs on grows down from __heap_end,
+// so keep the top of the MEM1 heap clear of it.
+#define MEM_BOOT_STACK_SIZE (64 * 1024)
+
+// IOS owns MEM2 from here up
+#define MEM_MEM2_END 0x933E0000
+
+// From the linker script
+extern uint8_t __heap_start[];
+extern uint8_t __heap_end[];
+extern uint8_t __mem2_heap_start[];
+
+static const char* TAG = "MEM";
+
+static tlsf_t mem_arenas[MEM_ARENA_COUNT];
+static bool mem_initialized = false;
+
+// Anything can allocate before system_initialize, like constructors
+#define MEM_ENSURE_INITIALIZED() \
+    if(!mem_initialized) { \
+        mem_initialize(); \
+    }
+
+void mem_initialize() {
+    if(mem_initialized)
+        return;
+
+    uint8_t* mem1_end = __heap_end - MEM_BOOT_STACK_SIZE;
+    int ret = tlsf_initialize(&mem_arenas[MEM_ARENA_MEM1], __heap_start, mem1_end - __heap_start);
+    ASSERT_OUT_OF_MEMORY(ret >= 0);
+
+    uint8_t* mem2_end = (uint8_t*)MEM_MEM2_END;
+    ret = tlsf_initialize(&mem_arenas[MEM_ARENA_MEM2], __mem2_heap_start, mem2_end - __mem2_heap_start);
+    ASSERT_OUT_OF_MEMORY(ret >= 0);
+
+    mem_initialized = true;
+}
+
+static void* mem_arena_alloc(mem_arena_t arena, size_t size, size_t alignment) {
+    MEM_ENSURE_INITIALIZED();
+
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    void* ptr = tlsf_memalign(&mem_arenas[arena], alignment, size);
+    SYSTEM_ENABLE_ISR(level);
+
+    return ptr;
+}
+
+void* mem1_alloc(size_t size) {
+    return mem_arena_alloc(MEM_ARENA_MEM1, size, TLSF_ALIGN);
+}
+
+void* mem2_alloc(size_t size) {
+    return mem_arena_alloc(MEM_ARENA_MEM2, size, TLSF_ALIGN);
+}
+
+void* mem1_aligned_alloc(size_t size, size_t alignment) {
+    return mem_arena_alloc(MEM_ARENA_MEM1, size, alignment);
+}
+
+void* mem2_aligned_alloc(size_t size, size_t alignment) {
+    return mem_arena_alloc(MEM_ARENA_MEM2, size, alignment);
+}
+
+// NULL if the pointer is not from either heap
+static tlsf_t* mem_find_arena(const void* ptr) {
+    for(int i = 0; i < MEM_ARENA_COUNT; i++) {
+        if(tlsf_contains(&mem_arenas[i], ptr))
+            return &mem_arenas[i];
+    }
+
+    return NULL;
+}
+
+void mem_free(void* ptr) {
+    if(ptr == NULL)
+        return;
+
+    tlsf_t* arena = mem_find_arena(ptr);
+    if(arena == NULL) {
+        LOG_ERROR(TAG, "Freeing 0x%08X, not from a heap.", (uint32_t)ptr);
+        ASSERT(0);
+        return;
+    }
+
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    tlsf_free(arena, ptr);
+    SYSTEM_ENABLE_ISR(level);
+}
+
+static void* mem_realloc(void* ptr, size_t size) {
+    if(ptr == NULL)
+        return malloc(size);
+
+    if(size == 0) {
+        mem_free(ptr);
+        return NULL;
+    }
+
+    // Nothing to move it from, leave it be like a failed realloc would
+    tlsf_t* arena = mem_find_arena(ptr);
+    if(arena == NULL) {
+        LOG_ERROR(TAG, "Reallocating 0x%08X, not from a heap.", (uint32_t)ptr);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    // Try in place first, so nothing is copied with interrupts disabled
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    bool resized = tlsf_resize(arena, ptr, size);
+    SYSTEM_ENABLE_ISR(level);
+
+    if(resized)
+        return ptr;
+
+    // Stays in the same heap
+    void* moved = mem_arena_alloc(arena - mem_arenas, size, TLSF_ALIGN);
+    if(moved == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    memcpy(moved, ptr, tlsf_usable_size(ptr));
+    mem_free(ptr);
+    return moved;
+}
+
+void mem_get_stats(mem_arena_t arena, tlsf_stats_t* stats) {
+    MEM_ENSURE_INITIALIZED();
+
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    tlsf_get_stats(&mem_arenas[arena], stats);
+    SYSTEM_ENABLE_ISR(level);
+}
+
+int mem_check(mem_arena_t arena) {
+    MEM_ENSURE_INITIALIZED();
+
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    int ret = tlsf_check(&mem_arenas[arena]);
+    SYSTEM_ENABLE_ISR(level);
+
+    return ret;
+}
+
+// C library allocation, all from MEM1.
+// Replaces the picolibc ones, which would take the same memory with sbrk.
+
+void* malloc(size_t size) {
+    void* ptr = mem1_alloc(size);
+    if(ptr == NULL)
+        errno = ENOMEM;
+    return ptr;
+}
+
+void free(void* ptr) {
+    mem_free(ptr);
+}
+
+void* calloc(size_t count, size_t size) {
+    size_t bytes;
+    if(__builtin_mul_overflow(count, size, &bytes)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    void* ptr = malloc(bytes);
+    if(ptr)
+        memset(ptr, 0, bytes);
+    return ptr;
+}
+
+// mem_realloc sets errno, a pointer from outside the heaps is EINVAL
+void* realloc(void* ptr, size_t size) {
+    return mem_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    void* ptr = mem1_aligned_alloc(size, alignment);
+    if(ptr == NULL)
+        errno = ENOMEM;
+    return ptr;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) {
+    if(alignment < sizeof(void*) || (alignment & (alignment - 1)))
+        return EINVAL;
+
+    void* ptr = mem1_aligned_alloc(size, alignment);
+    if(ptr == NULL)
+        return ENOMEM;
+
+    *out = ptr;
+    return 0;
+}
+
+size_t malloc_usable_size(void* ptr) {
+    return tlsf_usable_size(ptr);
+}
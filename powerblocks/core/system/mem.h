@@ -0,0 +1,116 @@
+/**
+ * @file mem.h
+ * @brief System Heaps
+ *
+ * Separate heaps for MEM1 and MEM2.
+ *
+ * MEM1 is the fast 24 MB the program is loaded into, what is
+ * left after the program and the main stack is the MEM1 heap.
+ * malloc and free and the rest of them allocate from it.
+ *
+ * MEM2 is the slower 64 MB, IOS keeps the top of it, the rest
+ * is the MEM2 heap. Good for large buffers like textures, audio and
+ * disk images so they are not taking up MEM1.
+ *
+ * Both are TLSF heaps, so allocating and freeing takes about the
+ * same time no matter how full or fragmented they get.
+ * Interrupts are disabled for the short time a heap is being
+ * changed, so they are safe from any task or interrupt.
+ * That is one lock for both heaps, not one each. Since TLSF is O(1)
+ * it is only held for a bounded few hundred cycles, and a mutex per heap
+ * could not be taken from interrupts anyway. Copies made by realloc
+ * happen outside of it.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "powerblocks/core/utils/tlsf.h"
+
+/**
+ * @enum mem_arena_t
+ * @brief The system heaps.
+ */
+typedef enum {
+    MEM_ARENA_MEM1,
+    MEM_ARENA_MEM2,
+
+    MEM_ARENA_COUNT
+} mem_arena_t;
+
+/**
+ * @brief Creates the system heaps.
+ *
+ * Called from system_initialize, before anything allocates.
+ */
+extern void mem_initialize();
+
+/**
+ * @brief Allocates memory from MEM1.
+ *
+ * @param size Bytes to allocate
+ * @return Memory aligned to 8 bytes, NULL if out of memory
+ */
+extern void* mem1_alloc(size_t size);
+
+/**
+ * @brief Allocates memory from MEM2.
+ *
+ * @param size Bytes to allocate
+ * @return Memory aligned to 8 bytes, NULL if out of memory
+ */
+extern void* mem2_alloc(size_t size);
+
+/**
+ * @brief Allocates aligned memory from MEM1.
+ *
+ * @param size Bytes to allocate
+ * @param alignment Power of 2, usually 32 for hardware
+ * @return Memory, NULL if out of memory
+ */
+extern void* mem1_aligned_alloc(size_t size, size_t alignment);
+
+/**
+ * @brief Allocates aligned memory from MEM2.
+ *
+ * @param size Bytes to allocate
+ * @param alignment Power of 2, usually 32 for hardware
+ * @return Memory, NULL if out of memory
+ */
+extern void* mem2_aligned_alloc(size_t size, size_t alignment);
+
+/**
+ * @brief Frees memory from either heap.
+ *
+ * The heap is found by the address.
+ *
+ * @param ptr Allocation, may be NULL
+ */
+extern void mem_free(void* ptr);
+
+/**
+ * @brief Reads back the counters of a heap.
+ *
+ * The fragmentation can be seen by comparing free to largest_free.
+ *
+ * @param arena Heap
+ * @param stats Outputted stats
+ */
+extern void mem_get_stats(mem_arena_t arena, tlsf_stats_t* stats);
+
+/**
+ * @brief Checks a heap is consistent.
+ *
+ * Walks every block, for debugging.
+ * Interrupts stay disabled the whole time.
+ *
+ * @param arena Heap
+ * @return Negative if damaged
+ */
+extern int mem_check(mem_arena_t arena);
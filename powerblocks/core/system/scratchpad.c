@@ -0,0 +1,274 @@
+/**
+ * @file scratchpad.c
+ * @brief Locked Cache Scratchpad
+ *
+ * Half of the data cache locked as fast memory,
+ * with a DMA engine to and from main memory.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "scratchpad.h"
+
+#include "system.h"
+#include "cpu.h"
+
+#include "utils/log.h"
+
+// The 4 standard BATs already map memory, so the scratchpad
+// gets DBAT4 from the extra Broadway BATs. 128 KB, the smallest.
+#define SCRATCHPAD_DBATU (SCRATCHPAD_ADDRESS | 0x3)    // BL=128KB, Vs, Vp
+#define SCRATCHPAD_DBATL (SCRATCHPAD_ADDRESS | 0x2)    // WIMG=0000, PP=RW
+
+#define SCRATCHPAD_DMA_QUEUE_MAX 15
+
+#define SCRATCHPAD_ERRORS (HID2_DCHERR | HID2_DNCERR | HID2_DCMERR | HID2_DQOERR)
+
+static const char* TAG = "SCRATCHPAD";
+
+static bool scratchpad_enabled = false;
+static bool scratchpad_mapped = false;
+
+// Commands queued since enabled, the ticket of the last one
+static scratchpad_ticket_t scratchpad_issued;
+
+extern void scratchpad_lock_cache();
+extern void scratchpad_unlock_cache();
+
+static int scratchpad_map() {
+    uint32_t hid4;
+    SYSTEM_GET_SPR(HID4, hid4);
+
+    if(hid4 & HID4_SBE) {
+        // Someone else turned the extra BATs on, do not take one in use
+        uint32_t dbat4u;
+        SYSTEM_GET_SPR(DBAT4U, dbat4u);
+        if((dbat4u & 0x3) && dbat4u != SCRATCHPAD_DBATU) {
+            LOG_ERROR(TAG, "DBAT4 is already in use.");
+            return -1;
+        }
+    } else {
+        // Make sure the extra BATs are all invalid before turning them on
+        uint32_t zero = 0;
+        SYSTEM_SET_SPR(IBAT4U, zero);
+        SYSTEM_SET_SPR(IBAT5U, zero);
+        SYSTEM_SET_SPR(IBAT6U, zero);
+        SYSTEM_SET_SPR(IBAT7U, zero);
+        SYSTEM_SET_SPR(DBAT5U, zero);
+        SYSTEM_SET_SPR(DBAT6U, zero);
+        SYSTEM_SET_SPR(DBAT7U, zero);
+    }
+
+    uint32_t dbatl = SCRATCHPAD_DBATL;
+    uint32_t dbatu = SCRATCHPAD_DBATU;
+    SYSTEM_SET_SPR(DBAT4L, dbatl);
+    SYSTEM_SET_SPR(DBAT4U, dbatu);
+
+    hid4 |= HID4_SBE;
+    SYSTEM_SET_SPR(HID4, hid4);
+
+    SYSTEM_SYNC();
+    SYSTEM_ISYNC();
+    return 0;
+}
+
+static uint32_t scratchpad_queue_length() {
+    uint32_t hid2;
+    SYSTEM_GET_SPR(HID2, hid2);
+    return (hid2 & HID2_DMAQL) >> (31 - 7);
+}
+
+// Transfers the engine has not finished. Counts one extra while a
+// command is still triggered, in case the queue length does not include it.
+static uint32_t scratchpad_in_flight() {
+    uint32_t dmal;
+    SYSTEM_GET_SPR(DMAL, dmal);
+    return scratchpad_queue_length() + ((dmal & DMAL_T) ? 1 : 0);
+}
+
+static bool scratchpad_in_range(const void* scratch, uint32_t size) {
+    uint32_t address = (uint32_t)scratch;
+    return address >= SCRATCHPAD_ADDRESS && size <= SCRATCHPAD_SIZE &&
+           address - SCRATCHPAD_ADDRESS <= SCRATCHPAD_SIZE - size;
+}
+
+static int scratchpad_queue(uint32_t memory, uint32_t scratch, uint32_t size, bool load, scratchpad_ticket_t* ticket) {
+    if(!scratchpad_enabled) {
+        LOG_ERROR(TAG, "Transfer while not enabled.");
+        return -1;
+    }
+
+    if(((memory | scratch | size) & 31) != 0 || !scratchpad_in_range((void*)scratch, size)) {
+        LOG_ERROR(TAG, "Bad transfer 0x%08X <-> 0x%08X, %d bytes.", memory, scratch, size);
+        return -2;
+    }
+
+    // Whatever was written into the scratchpad must be there before a store reads it
+    SYSTEM_SYNC();
+
+    while(size > 0) {
+        uint32_t bytes = size > SCRATCHPAD_DMA_MAX ? SCRATCHPAD_DMA_MAX : size;
+        uint32_t lines = bytes / 32; // 128 wraps to 0, which means 128
+
+        while(scratchpad_queue_length() >= SCRATCHPAD_DMA_QUEUE_MAX);
+
+        uint32_t dmau = SYSTEM_MEM_PHYSICAL(memory) | ((lines >> 2) & 0x1F);
+        uint32_t dmal = scratch | ((lines & 0x3) << 2) | (load ? DMAL_LD : 0) | DMAL_T;
+        SYSTEM_SET_SPR(DMAU, dmau);
+        SYSTEM_SET_SPR(DMAL, dmal);
+
+        scratchpad_issued++;
+
+        memory += bytes;
+        scratch += bytes;
+        size -= bytes;
+    }
+
+    if(ticket)
+        *ticket = scratchpad_issued;
+    return 0;
+}
+
+void* scratchpad_enable() {
+    if(scratchpad_enabled)
+        return NULL;
+
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+
+    if(!scratchpad_mapped) {
+        if(scratchpad_map() < 0) {
+            SYSTEM_ENABLE_ISR(level);
+            return NULL;
+        }
+        scratchpad_mapped = true;
+    }
+
+    scratchpad_lock_cache();
+
+    // Nothing from before counts
+    scratchpad_get_errors();
+    scratchpad_issued = 0;
+    scratchpad_enabled = true;
+
+    SYSTEM_ENABLE_ISR(level);
+
+    return (void*)SCRATCHPAD_ADDRESS;
+}
+
+void scratchpad_disable() {
+    if(!scratchpad_enabled)
+        return;
+
+    scratchpad_wait_all();
+
+    uint32_t level;
+    SYSTEM_DISABLE_ISR(level);
+    scratchpad_unlock_cache();
+    scratchpad_enabled = false;
+    SYSTEM_ENABLE_ISR(level);
+}
+
+bool scratchpad_is_enabled() {
+    return scratchpad_enabled;
+}
+
+int scratchpad_load(void* scratch, const void* memory, uint32_t size, scratchpad_ticket_t* ticket) {
+    return scratchpad_queue((uint32_t)memory, (uint32_t)scratch, size, true, ticket);
+}
+
+int scratchpad_store(void* memory, const void* scratch, uint32_t size, scratchpad_ticket_t* ticket) {
+    return scratchpad_queue((uint32_t)memory, (uint32_t)scratch, size, false, ticket);
+}
+
+bool scratchpad_is_done(scratchpad_ticket_t ticket) {
+    // Ticket numbers wrap, compare by distance
+    return (int32_t)(scratchpad_issued - scratchpad_in_flight() - ticket) >= 0;
+}
+
+void scratchpad_wait(scratchpad_ticket_t ticket) {
+    while(!scratchpad_is_done(ticket));
+}
+
+void scratchpad_wait_all() {
+    while(scratchpad_in_flight() > 0);
+}
+
+uint32_t scratchpad_get_errors() {
+    uint32_t hid2;
+    SYSTEM_GET_SPR(HID2, hid2);
+
+    uint32_t errors = hid2 & SCRATCHPAD_ERRORS;
+    if(errors) {
+        hid2 &= ~SCRATCHPAD_ERRORS;
+        SYSTEM_SET_SPR(HID2, hid2);
+    }
+
+    return errors;
+}
+
+int scratchpad_stream(const void* input, void* output, uint32_t size, uint32_t chunk_size,
+                      scratchpad_kernel_t kernel, void* param) {
+    if(!scratchpad_enabled)
+        return -1;
+
+    if(chunk_size == 0 || chunk_size > SCRATCHPAD_STREAM_CHUNK_MAX ||
+       (((uint32_t)input | (uint32_t)output | size | chunk_size) & 31) != 0)
+        return -2;
+
+    if(size == 0)
+        return 0;
+
+    // Input has to be in memory for the DMA to see it, and nothing of
+    // the output can be left in the cache to be written back over the results.
+    system_flush_dcache((void*)input, size);
+    if(output != input)
+        system_flush_dcache(output, size);
+
+    uint8_t* base = (uint8_t*)SCRATCHPAD_ADDRESS;
+    uint8_t* in[2] = { base, base + chunk_size };
+    uint8_t* out[2] = { base + chunk_size * 2, base + chunk_size * 3 };
+
+    const uint8_t* source = (const uint8_t*)input;
+    uint8_t* destination = (uint8_t*)output;
+
+    uint32_t chunks = (size + chunk_size - 1) / chunk_size;
+    scratchpad_ticket_t loaded[2] = {0};
+    scratchpad_ticket_t stored[2] = {0};
+    bool storing[2] = {false, false};
+
+    uint32_t first = size < chunk_size ? size : chunk_size;
+    int ret = scratchpad_load(in[0], source, first, &loaded[0]);
+    if(ret < 0)
+        return ret;
+
+    for(uint32_t i = 0; i < chunks; i++) {
+        uint32_t current = i & 1;
+        uint32_t offset = i * chunk_size;
+        uint32_t length = size - offset < chunk_size ? size - offset : chunk_size;
+
+        scratchpad_wait(loaded[current]);
+
+        // Next one loads while this one is processed
+        if(i + 1 < chunks) {
+            uint32_t next_offset = offset + chunk_size;
+            uint32_t next_length = size - next_offset < chunk_size ? size - next_offset : chunk_size;
+            scratchpad_load(in[current ^ 1], source + next_offset, next_length, &loaded[current ^ 1]);
+        }
+
+        // The store from two chunks ago used this output buffer
+        if(storing[current])
+            scratchpad_wait(stored[current]);
+
+        kernel(in[current], out[current], length, param);
+
+        scratchpad_store(destination + offset, out[current], length, &stored[current]);
+        storing[current] = true;
+    }
+
+    scratchpad_wait_all();
+
+    return scratchpad_get_errors() ? -3 : 0;
+}
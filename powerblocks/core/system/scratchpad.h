@@ -0,0 +1,152 @@
+/**
+ * @file scratchpad.h
+ * @brief Locked Cache Scratchpad
+ *
+ * Half of the 32 KB data cache can be locked and used as 16 KB
+ * of memory that never misses, mapped at SCRATCHPAD_ADDRESS.
+ * The rest stays a normal 16 KB data cache while it is enabled.
+ *
+ * A DMA engine moves data between it and main memory in the
+ * background, so the next piece of work can be streaming in while
+ * the current one is processed. Transfers are in 32 byte lines,
+ * both addresses must be 32 byte aligned.
+ *
+ * The DMA goes straight to memory, past the normal cache.
+ * Flush memory before loading it, and flush or invalidate memory
+ * before storing to it, scratchpad_stream does both.
+ *
+ * There is only one, the task that enables it owns it until disabled.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SCRATCHPAD_ADDRESS 0xE0000000
+#define SCRATCHPAD_SIZE    (16 * 1024)
+
+// Most one DMA command moves, larger transfers are split up
+#define SCRATCHPAD_DMA_MAX (128 * 32)
+
+// Largest chunk scratchpad_stream can use, four buffers fill the scratchpad
+#define SCRATCHPAD_STREAM_CHUNK_MAX (SCRATCHPAD_SIZE / 4)
+
+/**
+ * @brief Identifies a queued transfer.
+ *
+ * Transfers finish in the order they were queued.
+ */
+typedef uint32_t scratchpad_ticket_t;
+
+/**
+ * @brief Processes one chunk of a stream.
+ *
+ * @param input Chunk loaded into the scratchpad
+ * @param output Where to write the results, also in the scratchpad
+ * @param size Bytes in the chunk
+ * @param param User parameter
+ */
+typedef void (*scratchpad_kernel_t)(const void* input, void* output, uint32_t size, void* param);
+
+/**
+ * @brief Enables the scratchpad.
+ *
+ * Writes back the data cache and locks half of it.
+ * The contents start out zeroed.
+ *
+ * @return Start of the scratchpad, NULL if already enabled
+ */
+extern void* scratchpad_enable();
+
+/**
+ * @brief Disables the scratchpad.
+ *
+ * Waits for transfers to finish and gives the cache back.
+ * Anything left in the scratchpad is lost.
+ */
+extern void scratchpad_disable();
+
+/**
+ * @brief Checks if the scratchpad is enabled.
+ */
+extern bool scratchpad_is_enabled();
+
+/**
+ * @brief Queues a transfer from memory into the scratchpad.
+ *
+ * Waits only if the DMA queue is full.
+ *
+ * @param scratch Destination in the scratchpad
+ * @param memory Source in MEM1 or MEM2
+ * @param size Bytes, multiple of 32
+ * @param ticket Outputted ticket for the transfer, may be NULL
+ * @return Negative if error
+ */
+extern int scratchpad_load(void* scratch, const void* memory, uint32_t size, scratchpad_ticket_t* ticket);
+
+/**
+ * @brief Queues a transfer from the scratchpad out to memory.
+ *
+ * Waits only if the DMA queue is full.
+ *
+ * @param memory Destination in MEM1 or MEM2
+ * @param scratch Source in the scratchpad
+ * @param size Bytes, multiple of 32
+ * @param ticket Outputted ticket for the transfer, may be NULL
+ * @return Negative if error
+ */
+extern int scratchpad_store(void* memory, const void* scratch, uint32_t size, scratchpad_ticket_t* ticket);
+
+/**
+ * @brief Checks if a transfer is done.
+ *
+ * @param ticket From scratchpad_load or scratchpad_store
+ */
+extern bool scratchpad_is_done(scratchpad_ticket_t ticket);
+
+/**
+ * @brief Waits for a transfer to be done.
+ *
+ * Spins, transfers take microseconds.
+ *
+ * @param ticket From scratchpad_load or scratchpad_store
+ */
+extern void scratchpad_wait(scratchpad_ticket_t ticket);
+
+/**
+ * @brief Waits for every queued transfer to be done.
+ */
+extern void scratchpad_wait_all();
+
+/**
+ * @brief Gets and clears the DMA error bits.
+ *
+ * @return HID2_DCHERR, HID2_DNCERR, HID2_DCMERR and HID2_DQOERR from cpu.h, 0 if none.
+ */
+extern uint32_t scratchpad_get_errors();
+
+/**
+ * @brief Runs a kernel over a buffer through the scratchpad.
+ *
+ * Streams input through the scratchpad in chunks, runs the kernel on each
+ * and streams the results out to output. While one chunk is processed
+ * the next is loading and the last is storing.
+ *
+ * The scratchpad must be enabled, and its contents are overwritten.
+ * Output may be the same as input.
+ *
+ * @param input Source, 32 byte aligned
+ * @param output Destination, 32 byte aligned
+ * @param size Bytes, multiple of 32
+ * @param chunk_size Bytes per chunk, multiple of 32, at most SCRATCHPAD_STREAM_CHUNK_MAX
+ * @param kernel Processes each chunk
+ * @param param User parameter for the kernel
+ * @return Negative if error
+ */
+extern int scratchpad_stream(const void* input, void* output, uint32_t size, uint32_t chunk_size,
+                             scratchpad_kernel_t kernel, void* param);
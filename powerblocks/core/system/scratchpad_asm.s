@@ -0,0 +1,71 @@
+/**
+ * @file scratchpad_asm.s
+ * @brief Locking half the data cache.
+ *
+ * Turns the locked cache on and off.
+ * Both must run with interrupts disabled.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+    .global scratchpad_lock_cache
+    .global scratchpad_unlock_cache
+
+scratchpad_lock_cache:
+    # Write back everything dirty first, half the cache is about to be taken.
+    # Loading 32 KB in a row lands in every way of every set, so every
+    # dirty line is pushed out, and the dcbst cleans what was loaded.
+    lis     3, 0x8000
+    li      4, 1024
+    mtctr   4
+
+clean_loop:
+    lwz     5, 0(3)
+    dcbst   0, 3
+    addi    3, 3, 32
+    bdnz    clean_loop
+
+    sync
+
+    # HID2[LCE]
+    mfspr   4, 920
+    oris    4, 4, 0x1000
+    mtspr   920, 4
+    isync
+
+    # Claim all 512 lines at 0xE0000000 without reading memory.
+    lis     3, 0xE000
+    li      4, 512
+    mtctr   4
+
+claim_loop:
+    # dcbz_l 0, 3
+    .long   0x10001FEC
+    addi    3, 3, 32
+    bdnz    claim_loop
+
+    sync
+    blr
+
+scratchpad_unlock_cache:
+    # Drop the locked lines, they have no memory behind them
+    lis     3, 0xE000
+    li      4, 512
+    mtctr   4
+
+release_loop:
+    dcbi    0, 3
+    addi    3, 3, 32
+    bdnz    release_loop
+
+    sync
+
+    # Clear HID2[LCE]
+    mfspr   4, 920
+    rlwinm  4, 4, 0, 4, 2
+    mtspr   920, 4
+    isync
+
+    blr
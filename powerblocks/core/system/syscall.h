@@ -74,4 +74,20 @@ extern const syscall_handler_t syscall_registry[SYSCALL_REGISTRY_SIZE];
  *
  * Called for when an assert fails to report the information.
  */
-#define SYSCALL_ASSERT(error_name, line, file) SYSCALL(SYSCALL_ID_ASSERT, error_name, line, file)
\ No newline at end of file
+#ifdef __powerpc__
+
+#define SYSCALL_ASSERT(error_name, line, file) SYSCALL(SYSCALL_ID_ASSERT, error_name, line, file)
+
+#else
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Host builds have no syscalls, a failed assert just reports and stops
+#define SYSCALL_ASSERT(error_name, line, file) \
+    do { \
+        fprintf(stderr, "%s at %s:%d\n", (error_name), (file), (line)); \
+        abort(); \
+    } while(0)
+
+#endif
@@ -21,11 +21,19 @@
 #include "utils/log.h"
 
 #include "exceptions.h"
+#include "deferred.h"
+#include "boot.h"
+#include "mem.h"
 #include "gpio.h"
 
 // Main of the application of the user.
 extern void main();
 
+// Room for tasks created while the task list is being taken
+#define SYSTEM_TASK_STATS_SLACK 4
+
+static const char* TAG = "SYSTEM";
+
 void system_delay_int(uint64_t ticks) {
     uint64_t stop = system_get_time_base_int() + ticks;
 
@@ -33,24 +41,75 @@ void system_delay_int(uint64_t ticks) {
 }
 
 void* system_aligned_malloc(uint32_t bytes, uint32_t alignment) {
-    // Must be a power of 2
-    if((alignment & (alignment-1)) != 0)
-        return NULL;
-    
-    uint32_t raw = (uint32_t)malloc(bytes + alignment - 1 + sizeof(void*));
-    if(!raw)
-        return NULL;
-    
-    uint32_t aligned = (raw + sizeof(void*) + aligned - 1) & ~(aligned - 1);
-    ((void**)aligned)[-1] = (void*)raw;
-
-    return (void*)aligned;
+    return mem1_aligned_alloc(bytes, alignment);
 }
 
 void system_aligned_free(void* ptr) {
-    if(ptr) {
-        free(((void**)ptr)[-1]);
+    mem_free(ptr);
+}
+
+static char system_task_state_char(eTaskState state) {
+    switch(state) {
+        case eRunning:   return 'X';
+        case eReady:     return 'R';
+        case eBlocked:   return 'B';
+        case eSuspended: return 'S';
+        case eDeleted:   return 'D';
+        default:         return '?';
+    }
+}
+
+int system_get_task_stats(system_task_stats_t* stats, int max_count, uint64_t* time) {
+    if(stats == NULL || max_count <= 0)
+        return -1;
+
+    UBaseType_t capacity = uxTaskGetNumberOfTasks() + SYSTEM_TASK_STATS_SLACK;
+    TaskStatus_t* status = malloc(capacity * sizeof(TaskStatus_t));
+    if(status == NULL) {
+        LOG_ERROR(TAG, "Out of memory for %d task stats.", capacity);
+        return -2;
+    }
+
+    configRUN_TIME_COUNTER_TYPE now;
+    UBaseType_t count = uxTaskGetSystemState(status, capacity, &now);
+    if(count == 0) {
+        // More tasks showed up than there was slack for
+        free(status);
+        return -3;
+    }
+
+    // Oldest first, so the order stays the same between samples
+    for(UBaseType_t i = 1; i < count; i++) {
+        TaskStatus_t current = status[i];
+        UBaseType_t j = i;
+        while(j > 0 && status[j - 1].xTaskNumber > current.xTaskNumber) {
+            status[j] = status[j - 1];
+            j--;
+        }
+        status[j] = current;
+    }
+
+    if(count > (UBaseType_t)max_count)
+        count = max_count;
+
+    for(UBaseType_t i = 0; i < count; i++) {
+        uint32_t stack_size = (status[i].pxEndOfStack - status[i].pxStackBase + 1) * sizeof(StackType_t);
+        uint32_t stack_free = status[i].usStackHighWaterMark * sizeof(StackType_t);
+
+        stats[i].name = status[i].pcTaskName;
+        stats[i].id = status[i].xTaskNumber;
+        stats[i].priority = status[i].uxCurrentPriority;
+        stats[i].state = system_task_state_char(status[i].eCurrentState);
+        stats[i].run_time = status[i].ulRunTimeCounter;
+        stats[i].stack_size = stack_size;
+        stats[i].stack_peak = stack_size - stack_free;
     }
+
+    free(status);
+
+    if(time)
+        *time = now;
+    return count;
 }
 
 void system_initialize() {
@@ -58,6 +117,9 @@ void system_initialize() {
     uint32_t level;
     SYSTEM_DISABLE_ISR(level);
 
+    // Start of the boot timeline
+    boot_mark("ENTRY");
+
     // Arguments
     // Check magic
     //if(argv->magic == 0x5f617267) {
@@ -72,13 +134,20 @@ void system_initialize() {
     //    system_argv.end_argv = NULL;
     //}
 
+    // Heaps before anything can allocate
+    mem_initialize();
+
     log_initialize();
 
     // Install exception handlers
     exceptions_install_vector();
 
+    // Task for interrupt work that should not hold off other interrupts
+    deferred_initialize();
+
     // Create main task and start scheduler
-    xTaskCreate(main, "MAIN", SYSTEM_MAIN_STACK_SIZE, NULL, configMAX_PRIORITIES / 2, NULL);
+    boot_mark("SCHEDULER");
+    xTaskCreate(main, "MAIN", SYSTEM_MAIN_STACK_SIZE / sizeof(StackType_t), NULL, configMAX_PRIORITIES / 2, NULL);
     vTaskStartScheduler();
 
     // We do not expect execution to return here.
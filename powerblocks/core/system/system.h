@@ -42,8 +42,19 @@
  *  @brief Convert microseconds to time base ticks.
  *
  * Convert microseconds to time base ticks.
+ * The time base does not tick a whole number of times a microsecond,
+ * it ticks 243 times every 4, so that is used instead. The divide is only a shift.
  */
-#define SYSTEM_US_TO_TICKS(us) (SYSTEM_TB_CLOCK_HZ / 1000000 * (us))
+#define SYSTEM_US_TO_TICKS(us) ((uint64_t)(us) * (SYSTEM_TB_CLOCK_HZ / 250000) / 4)
+
+/** @def SYSTEM_TICKS_TO_US
+ *  @brief Convert time base ticks to microseconds.
+ *
+ * Convert time base ticks to microseconds.
+ * The inverse of SYSTEM_US_TO_TICKS, 4 microseconds every 243 ticks.
+ * Dividing by a whole ticks per microsecond would be 1.25% off.
+ */
+#define SYSTEM_TICKS_TO_US(ticks) ((uint64_t)(ticks) * 4 / (SYSTEM_TB_CLOCK_HZ / 250000))
 
 /** @def SYSTEM_MS_TO_TICKS
  *  @brief Convert miliseconds to time base ticks.
@@ -162,11 +173,32 @@ extern system_argv_t system_argv;
         "mtdec %0" : : "r"(msr) \
     );
 
+ /** @def SYSTEM_GET_SPR
+ *  @brief Gets the value of a special purpose register.
+ *
+ *  The register number must be a constant, see cpu.h.
+ */
+#define SYSTEM_GET_SPR(spr, value) \
+    __asm__ __volatile__( \
+        "mfspr %0, %1" : "=r"(value) : "i"(spr) \
+    );
+
+ /** @def SYSTEM_SET_SPR
+ *  @brief Sets the value of a special purpose register.
+ *
+ *  The register number must be a constant, see cpu.h.
+ */
+#define SYSTEM_SET_SPR(spr, value) \
+    __asm__ __volatile__( \
+        "mtspr %0, %1" : : "i"(spr), "r"(value) \
+    );
+
  /** @def SYSTEM_DISABLE_ISR
  *  @brief Disables interrupts
  *
  *  Disables interrupts, returns the external interrupt enable bit.
  */
+#ifdef __powerpc__
 #define SYSTEM_DISABLE_ISR(ee_enabled) \
     do { \
         uint32_t msr; \
@@ -175,6 +207,15 @@ extern system_argv_t system_argv;
         msr &= ~(0x8000); \
         SYSTEM_SET_MSR(msr); \
     } while(0)
+#else
+// Host builds run on the FreeRTOS POSIX port, where interrupts are signals
+// and its critical sections mask them. Only from tasks.
+#define SYSTEM_DISABLE_ISR(ee_enabled) \
+    do { \
+        ee_enabled = 1; \
+        vPortEnterCritical(); \
+    } while(0)
+#endif
 
  /** @def SYSTEM_ENABLE_ISR
  *  @brief Enables interrupts if ee_enabled is set.
@@ -183,6 +224,7 @@ extern system_argv_t system_argv;
  *  Can be used along with SYSTEM_DISABLE_ISR, to only
  *  reenable interrupts if they were enabled in the first place.
  */
+#ifdef __powerpc__
 #define SYSTEM_ENABLE_ISR(ee_enabled) \
     if(ee_enabled) { \
         uint32_t msr; \
@@ -190,6 +232,12 @@ extern system_argv_t system_argv;
         msr |= 0x8000; \
         SYSTEM_SET_MSR(msr); \
     }
+#else
+#define SYSTEM_ENABLE_ISR(ee_enabled) \
+    if(ee_enabled) { \
+        vPortExitCritical(); \
+    }
+#endif
 
  /** @def SYSTEM_SYNC
  *  @brief Insures all previous instructions have executed.
@@ -326,8 +374,8 @@ extern void system_invalidate_icache(void* data, uint32_t size);
  * 
  *  Must be a power of 2.
  *  
- *  Offsets the pointer by the alignment and stores the original unaligned
- *  pointer before the pointer returned.
+ *  Same as mem1_aligned_alloc, kept for older code.
+ *  Use mem2_aligned_alloc for large buffers that can live in MEM2.
  */
 extern void* system_aligned_malloc(uint32_t bytes, uint32_t alignment);
 
@@ -335,9 +383,40 @@ extern void* system_aligned_malloc(uint32_t bytes, uint32_t alignment);
  * @brief Free allocated memory with alignment.
  * 
  * Free allocated memory with alignment.
+ * Same as mem_free, works for either heap.
  */
 extern void system_aligned_free(void* ptr);
 
+ /** @struct system_task_stats_t
+ *  @brief CPU time and stack use of one task.
+ */
+typedef struct {
+    const char* name;    // Only valid while the task exists
+    uint32_t id;         // Unique number given to the task when it was created
+    uint32_t priority;   // Current priority, may be raised by a mutex it holds
+    char state;          // 'X' running, 'R' ready, 'B' blocked, 'S' suspended, 'D' deleted
+    uint64_t run_time;   // Time base ticks spent running since it was created
+    uint32_t stack_size; // Bytes of stack
+    uint32_t stack_peak; // Most bytes of stack it has ever used
+} system_task_stats_t;
+
+/**
+ * @brief Gets the CPU time and stack use of every task.
+ *
+ * Run times only ever go up, take two samples and compare them to
+ * get how much of the CPU each task used in between.
+ * Interrupts count towards whichever task they interrupted.
+ *
+ * Finding the stack peak reads through the part of each stack that has
+ * never been used, so this is not something to call every frame.
+ *
+ * @param stats Outputted stats, sorted by id
+ * @param max_count Size of stats, if there are more tasks the oldest are given
+ * @param time Outputted time base at the time of the sample, may be NULL
+ * @return Number of tasks in stats, negative if error
+ */
+extern int system_get_task_stats(system_task_stats_t* stats, int max_count, uint64_t* time);
+
 /**
  * @brief Initializes the system.
  *
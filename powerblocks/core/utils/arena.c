@@ -0,0 +1,95 @@
+/**
+ * @file arena.c
+ * @brief Linear Arenas
+ *
+ * Bump allocators for data that all goes away at once.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "arena.h"
+
+#include <string.h>
+
+// Fill new allocations and freed memory with patterns,
+// to make reads of uninitialized or stale data stand out.
+//#define ARENA_DEBUG_POISON
+
+#define ARENA_POISON_ALLOCATED 0xCD
+#define ARENA_POISON_FREED     0xDD
+
+void arena_initialize(arena_t* arena, void* memory, uint32_t size) {
+    memset(arena, 0, sizeof(*arena));
+
+    arena->memory = (uint8_t*)memory;
+    arena->stats.size = size;
+
+#ifdef ARENA_DEBUG_POISON
+    memset(memory, ARENA_POISON_FREED, size);
+#endif
+}
+
+void* arena_alloc(arena_t* arena, uint32_t size, uint32_t alignment) {
+    // Anything else does not make a mask
+    if(alignment == 0 || (alignment & (alignment - 1)) != 0)
+        return NULL;
+
+    // Align the address, not the offset, the memory itself may not be aligned
+    uintptr_t base = (uintptr_t)arena->memory;
+    uintptr_t aligned = (base + arena->offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    uint32_t offset = aligned - base;
+
+    if(offset < arena->offset || offset > arena->stats.size || size > arena->stats.size - offset) {
+        arena->stats.failures++;
+        return NULL;
+    }
+
+    arena->offset = offset + size;
+    arena->stats.used = arena->offset;
+    if(arena->offset > arena->stats.peak_used)
+        arena->stats.peak_used = arena->offset;
+    arena->stats.allocations++;
+
+#ifdef ARENA_DEBUG_POISON
+    memset((void*)aligned, ARENA_POISON_ALLOCATED, size);
+#endif
+
+    return (void*)aligned;
+}
+
+void arena_release(arena_t* arena, uint32_t mark) {
+    if(mark > arena->offset)
+        return;
+
+#ifdef ARENA_DEBUG_POISON
+    memset(arena->memory + mark, ARENA_POISON_FREED, arena->offset - mark);
+#endif
+
+    arena->offset = mark;
+    arena->stats.used = mark;
+}
+
+void arena_reset(arena_t* arena) {
+    arena_release(arena, 0);
+    arena->stats.resets++;
+}
+
+void arena_get_stats(const arena_t* arena, arena_stats_t* stats) {
+    *stats = arena->stats;
+}
+
+void frame_arena_initialize(frame_arena_t* frame, void* memory, uint32_t size) {
+    // Keep the second half aligned too
+    uint32_t half = (size / 2) & ~(ARENA_GX_ALIGN - 1);
+
+    arena_initialize(&frame->arenas[0], memory, half);
+    arena_initialize(&frame->arenas[1], (uint8_t*)memory + half, half);
+    frame->current = 0;
+}
+
+void frame_arena_next(frame_arena_t* frame) {
+    frame->current ^= 1;
+    arena_reset(&frame->arenas[frame->current]);
+}
@@ -0,0 +1,160 @@
+/**
+ * @file arena.h
+ * @brief Linear Arenas
+ *
+ * Bump allocators for data that all goes away at once,
+ * like everything built up for one frame.
+ *
+ * Allocating is moving an offset forward, there is no freeing
+ * single allocations. Reset the arena and it is all free again.
+ *
+ * Frame arenas are two arenas taking turns, one for the frame being
+ * built and one for the frame the GPU may still be reading.
+ * Switching frames resets the older one. Allocations from them are
+ * 32 byte aligned so they can be handed straight to GX, flush them
+ * from the data cache first like any other GX data.
+ *
+ * Arenas are not locked, keep each one to a single task.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Alignment frame arena allocations get, what GX needs
+#define ARENA_GX_ALIGN 32
+
+/**
+ * @struct arena_stats_t
+ * @brief Arena counters.
+ */
+typedef struct {
+    uint32_t size;          // Bytes in the arena
+    uint32_t used;          // Bytes used since the last reset, including alignment padding
+    uint32_t peak_used;     // Most used has been between resets, the high water mark
+
+    uint32_t allocations;
+    uint32_t failures;      // Allocations that did not fit
+    uint32_t resets;
+} arena_stats_t;
+
+/**
+ * @struct arena_t
+ * @brief A linear arena.
+ */
+typedef struct {
+    uint8_t* memory;
+    uint32_t offset;
+
+    arena_stats_t stats;
+} arena_t;
+
+/**
+ * @struct frame_arena_t
+ * @brief Two arenas taking turns by frame.
+ */
+typedef struct {
+    arena_t arenas[2];
+    uint32_t current;
+} frame_arena_t;
+
+/**
+ * @brief Creates an arena over a region of memory.
+ *
+ * @param arena Arena to create
+ * @param memory Start of the region
+ * @param size Bytes in the region
+ */
+extern void arena_initialize(arena_t* arena, void* memory, uint32_t size);
+
+/**
+ * @brief Allocates from an arena.
+ *
+ * @param arena Arena
+ * @param size Bytes to allocate
+ * @param alignment Power of 2
+ * @return Memory, NULL if it does not fit or the alignment is not a power of 2
+ */
+extern void* arena_alloc(arena_t* arena, uint32_t size, uint32_t alignment);
+
+/**
+ * @brief Frees everything allocated from an arena.
+ *
+ * @param arena Arena
+ */
+extern void arena_reset(arena_t* arena);
+
+/**
+ * @brief Gets the current position in an arena.
+ *
+ * Pass it to arena_release to free everything allocated after this.
+ * For scratch memory inside a function.
+ *
+ * @param arena Arena
+ * @return Position
+ */
+static inline uint32_t arena_mark(const arena_t* arena) {
+    return arena->offset;
+}
+
+/**
+ * @brief Frees everything allocated after a position.
+ *
+ * @param arena Arena
+ * @param mark From arena_mark
+ */
+extern void arena_release(arena_t* arena, uint32_t mark);
+
+/**
+ * @brief Reads back the arena counters.
+ *
+ * @param arena Arena
+ * @param stats Outputted stats
+ */
+extern void arena_get_stats(const arena_t* arena, arena_stats_t* stats);
+
+/**
+ * @brief Creates a frame arena over a region of memory.
+ *
+ * Each frame gets half the region.
+ *
+ * @param frame Frame arena to create
+ * @param memory Start of the region, 32 byte aligned
+ * @param size Bytes in the region
+ */
+extern void frame_arena_initialize(frame_arena_t* frame, void* memory, uint32_t size);
+
+/**
+ * @brief Allocates from the current frame.
+ *
+ * @param frame Frame arena
+ * @param size Bytes to allocate
+ * @return Memory aligned to ARENA_GX_ALIGN, NULL if it does not fit
+ */
+static inline void* frame_arena_alloc(frame_arena_t* frame, uint32_t size) {
+    return arena_alloc(&frame->arenas[frame->current], size, ARENA_GX_ALIGN);
+}
+
+/**
+ * @brief Moves on to the next frame.
+ *
+ * Call at the frame boundary, once the GPU is done with the frame
+ * before the current one. Everything allocated two frames ago is freed.
+ *
+ * @param frame Frame arena
+ */
+extern void frame_arena_next(frame_arena_t* frame);
+
+/**
+ * @brief Gets the arena of the current frame.
+ *
+ * @param frame Frame arena
+ */
+static inline arena_t* frame_arena_current(frame_arena_t* frame) {
+    return &frame->arenas[frame->current];
+}
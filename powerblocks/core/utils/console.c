@@ -69,7 +69,7 @@ void console_put(const char* string) {
             // Shift console up
             int diff = (console_cursor_position.y + console_font->character_size.y) - VIDEO_HEIGHT; 
             if(diff > 0) {
-                memcpy(console_framebuffer->pixels, console_framebuffer->pixels[diff], sizeof(console_framebuffer->pixels) - diff * VIDEO_WIDTH * sizeof(uint16_t));
+                memmove(console_framebuffer->pixels, console_framebuffer->pixels[diff], sizeof(console_framebuffer->pixels) - diff * VIDEO_WIDTH * sizeof(uint16_t));
 
                 console_cursor_position.y -= diff;
                 line_pos.y -= diff;
@@ -114,7 +114,7 @@ void console_put(const char * string) {
             int diff = (start_pos.y + console_font->character_size.y) - VIDEO_HEIGHT; 
             if(diff > 0) {
                 // Push back frame buffer
-                memcpy(console_framebuffer->pixels, console_framebuffer->pixels[diff], sizeof(console_framebuffer->pixels) - diff * VIDEO_WIDTH * sizeof(uint16_t));
+                memmove(console_framebuffer->pixels, console_framebuffer->pixels[diff], sizeof(console_framebuffer->pixels) - diff * VIDEO_WIDTH * sizeof(uint16_t));
 
                 console_cursor_position.y = VIDEO_HEIGHT - console_font->character_size.y;
 
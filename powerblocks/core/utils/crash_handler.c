@@ -3,6 +3,7 @@
 #include "graphics/video.h"
 
 #include "system/system.h"
+#include "system/cpu.h"
 
 #include "fonts.h"
 
@@ -18,6 +19,13 @@
 static crash_handler_t system_crash_handler = NULL;
 
 void crash_handler_bug_check(const char* cause, exception_context_t* ctx) {
+    // Can be called from an exception, where the FPU is off.
+    // Nothing is going back to the task, so printing can have it.
+    uint32_t msr;
+    SYSTEM_GET_MSR(msr);
+    SYSTEM_SET_MSR(msr | MSR_FP);
+    SYSTEM_ISYNC();
+
     if(system_crash_handler) {
         system_crash_handler(cause, ctx);
         return;
@@ -0,0 +1,417 @@
+/**
+ * @file fiber.c
+ * @brief Fibers and Jobs
+ *
+ * The scheduler runs on the task's own stack. It switches to a fiber
+ * to run a job, and the fiber switches back once the job finishes or waits.
+ * Fibers are made once, each loops running whatever job it is given.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "fiber.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __powerpc__
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/system/exceptions.h"
+#include "powerblocks/core/ios/ios.h"
+
+// Notification index the scheduler blocks on, so it does not eat the task's own notifications
+#define FIBER_NOTIFY_INDEX 2
+
+#define FIBER_LOCK(level)         SYSTEM_DISABLE_ISR(level)
+#define FIBER_UNLOCK(level)       SYSTEM_ENABLE_ISR(level)
+#define FIBER_TIME()              system_get_time_base_int()
+#define FIBER_CURRENT_TASK()      ((void*)xTaskGetCurrentTaskHandle())
+#define FIBER_BLOCK()             ulTaskNotifyTakeIndexed(FIBER_NOTIFY_INDEX, pdTRUE, portMAX_DELAY)
+#define FIBER_WAKE(task)          xTaskNotifyGiveIndexed((TaskHandle_t)(task), FIBER_NOTIFY_INDEX)
+#define FIBER_WAKE_FROM_ISR(task, woken) vTaskNotifyGiveIndexedFromISR((TaskHandle_t)(task), FIBER_NOTIFY_INDEX, (woken))
+
+// See fiber_asm.s
+extern void fiber_switch(fiber_context_t* from, fiber_context_t* to);
+extern void fiber_entry();
+
+static void fiber_main(fiber_t* fiber);
+
+static void fiber_context_create(fiber_t* fiber) {
+    // Room above the first frame for it to save the link register,
+    // and a null back chain to end stack traces.
+    uint32_t top = ((uint32_t)fiber->stack + fiber->stack_size - 16) & ~15;
+    *(uint32_t*)top = 0;
+
+    memset(&fiber->context, 0, sizeof(fiber->context));
+    fiber->context.sp = top;
+    fiber->context.lr = (uint32_t)fiber_entry;
+    fiber->context.gpr[0] = (uint32_t)fiber_main; // r14
+    fiber->context.gpr[1] = (uint32_t)fiber;      // r15
+}
+
+#else
+
+// Anywhere else, only for testing the logic. Nothing outside the
+// scheduler can signal, so blocking just goes back around.
+#define FIBER_LOCK(level)         ((void)((level) = 0))
+#define FIBER_UNLOCK(level)       ((void)(level))
+#define FIBER_TIME()              0
+#define FIBER_CURRENT_TASK()      ((void*)1)
+#define FIBER_BLOCK()             ((void)0)
+#define FIBER_WAKE(task)          ((void)(task))
+#define FIBER_WAKE_FROM_ISR(task, woken) ((void)(task), (void)(woken))
+
+static void fiber_main(fiber_t* fiber);
+
+static void fiber_switch(fiber_context_t* from, fiber_context_t* to) {
+    swapcontext(from, to);
+}
+
+// makecontext only passes ints
+static void fiber_host_entry(uint32_t high, uint32_t low) {
+    fiber_main((fiber_t*)(((uintptr_t)high << 16 << 16) | low));
+}
+
+static void fiber_context_create(fiber_t* fiber) {
+    uintptr_t address = (uintptr_t)fiber;
+
+    getcontext(&fiber->context);
+    fiber->context.uc_stack.ss_sp = fiber->stack;
+    fiber->context.uc_stack.ss_size = fiber->stack_size;
+    fiber->context.uc_link = NULL;
+    makecontext(&fiber->context, (void (*)())fiber_host_entry, 2,
+                (uint32_t)(address >> 16 >> 16), (uint32_t)address);
+}
+
+#endif
+
+// Schedulers between fiber_scheduler_run and it returning
+static fiber_scheduler_t* fiber_running;
+
+static void fiber_main(fiber_t* fiber) {
+    fiber_scheduler_t* scheduler = fiber->scheduler;
+
+    while(true) {
+        fiber->job.job.function(scheduler, fiber->job.job.param);
+
+        if(fiber->job.counter != NULL)
+            fiber_counter_add(fiber->job.counter, -1);
+
+        scheduler->stats.jobs++;
+        scheduler->fibers_busy--;
+        fiber->state = FIBER_STATE_FREE;
+
+        // Comes back here with the next job
+        fiber_switch(&fiber->context, &scheduler->context);
+    }
+}
+
+static fiber_t* fiber_find(fiber_scheduler_t* scheduler, fiber_state_t state, bool ready) {
+    for(uint32_t i = 0; i < scheduler->fiber_count; i++) {
+        uint32_t index = (scheduler->next_fiber + i) % scheduler->fiber_count;
+        fiber_t* fiber = &scheduler->fibers[index];
+
+        if(fiber->state != state)
+            continue;
+        if(ready && fiber->wait->value > 0)
+            continue;
+
+        scheduler->next_fiber = index + 1;
+        return fiber;
+    }
+
+    return NULL;
+}
+
+static fiber_t* fiber_start_job(fiber_scheduler_t* scheduler) {
+    for(uint32_t i = 0; i < scheduler->job_count; i++) {
+        fiber_queued_job_t* job = &scheduler->jobs[i];
+        if(job->job.dependency != NULL && job->job.dependency->value > 0)
+            continue;
+
+        // Only once there is a job for it, finding one moves where
+        // the next yielded fiber is looked for
+        fiber_t* fiber = fiber_find(scheduler, FIBER_STATE_FREE, false);
+        if(fiber == NULL)
+            return NULL;
+
+        fiber->job = *job;
+        memmove(job, job + 1, (scheduler->job_count - i - 1) * sizeof(fiber_queued_job_t));
+        scheduler->job_count--;
+
+        scheduler->fibers_busy++;
+        if(scheduler->fibers_busy > scheduler->stats.max_fibers)
+            scheduler->stats.max_fibers = scheduler->fibers_busy;
+
+        return fiber;
+    }
+
+    return NULL;
+}
+
+// Fibers already going first, so they free up,
+// then new jobs, then anything that gave up its turn.
+static fiber_t* fiber_next(fiber_scheduler_t* scheduler) {
+    fiber_t* fiber = fiber_find(scheduler, FIBER_STATE_WAITING, true);
+    if(fiber == NULL)
+        fiber = fiber_start_job(scheduler);
+    if(fiber == NULL)
+        fiber = fiber_find(scheduler, FIBER_STATE_YIELDED, false);
+
+    return fiber;
+}
+
+static void fiber_suspend(fiber_scheduler_t* scheduler, fiber_state_t state) {
+    fiber_t* fiber = scheduler->current;
+    fiber->state = state;
+    fiber_switch(&fiber->context, &scheduler->context);
+}
+
+int fiber_scheduler_initialize(fiber_scheduler_t* scheduler, void* stacks, uint32_t stack_size, uint32_t fiber_count) {
+    if(fiber_count == 0 || fiber_count > FIBER_MAX_FIBERS)
+        return -1;
+    if(stacks == NULL || stack_size < FIBER_MIN_STACK_SIZE)
+        return -2;
+
+    memset(scheduler, 0, sizeof(*scheduler));
+
+    stack_size &= ~15;
+    scheduler->stacks = (uint8_t*)stacks;
+    scheduler->stacks_size = stack_size * fiber_count;
+    scheduler->fiber_count = fiber_count;
+
+    for(uint32_t i = 0; i < fiber_count; i++) {
+        fiber_t* fiber = &scheduler->fibers[i];
+        fiber->scheduler = scheduler;
+        fiber->stack = scheduler->stacks + i * stack_size;
+        fiber->stack_size = stack_size;
+        fiber->state = FIBER_STATE_FREE;
+
+        fiber_context_create(fiber);
+    }
+
+    return 0;
+}
+
+int fiber_scheduler_run(fiber_scheduler_t* scheduler, fiber_job_function_t function, void* param) {
+    if(scheduler->task != NULL || scheduler->fiber_count == 0)
+        return -1;
+
+    fiber_job_t job = { function, param, NULL };
+    if(fiber_run_jobs(scheduler, &job, 1, NULL) < 0)
+        return -2;
+
+    uint32_t level;
+    FIBER_LOCK(level);
+    scheduler->task = FIBER_CURRENT_TASK();
+    scheduler->current = NULL;
+    scheduler->next = fiber_running;
+    fiber_running = scheduler;
+    FIBER_UNLOCK(level);
+
+    while(true) {
+        fiber_t* fiber = fiber_next(scheduler);
+
+        if(fiber != NULL) {
+            fiber->state = FIBER_STATE_RUNNING;
+            scheduler->current = fiber;
+            scheduler->stats.switches++;
+
+            fiber_switch(&scheduler->context, &fiber->context);
+
+            scheduler->current = NULL;
+            continue;
+        }
+
+        if(scheduler->fibers_busy == 0 && scheduler->job_count == 0)
+            break;
+
+        // Everything left is waiting on something outside the scheduler.
+        // Counters signalled since they were checked still leave a notification.
+        uint64_t start = FIBER_TIME();
+        FIBER_BLOCK();
+        scheduler->stats.idles++;
+        scheduler->stats.idle_time += FIBER_TIME() - start;
+    }
+
+    FIBER_LOCK(level);
+    fiber_scheduler_t** link = &fiber_running;
+    while(*link != scheduler)
+        link = &(*link)->next;
+    *link = scheduler->next;
+    scheduler->task = NULL;
+    FIBER_UNLOCK(level);
+
+    return 0;
+}
+
+int fiber_run_jobs(fiber_scheduler_t* scheduler, const fiber_job_t* jobs, uint32_t count, fiber_counter_t* counter) {
+    if(count > FIBER_MAX_JOBS - scheduler->job_count)
+        return -1;
+
+    // Raised first, a job can not finish before it is counted
+    if(counter != NULL)
+        fiber_counter_add(counter, (int32_t)count);
+
+    for(uint32_t i = 0; i < count; i++) {
+        fiber_queued_job_t* job = &scheduler->jobs[scheduler->job_count++];
+        job->job = jobs[i];
+        job->counter = counter;
+    }
+
+    if(scheduler->job_count > scheduler->stats.max_queued)
+        scheduler->stats.max_queued = scheduler->job_count;
+
+    return 0;
+}
+
+int fiber_wait(fiber_scheduler_t* scheduler, fiber_counter_t* counter) {
+    if(counter->value <= 0)
+        return 0;
+    if(scheduler->current == NULL)
+        return -1;
+
+    scheduler->stats.waits++;
+    scheduler->current->wait = counter;
+    fiber_suspend(scheduler, FIBER_STATE_WAITING);
+    scheduler->current->wait = NULL;
+
+    return 0;
+}
+
+void fiber_yield(fiber_scheduler_t* scheduler) {
+    if(scheduler->current == NULL)
+        return;
+
+    fiber_suspend(scheduler, FIBER_STATE_YIELDED);
+}
+
+void fiber_counter_add(fiber_counter_t* counter, int32_t amount) {
+    uint32_t level;
+    FIBER_LOCK(level);
+    counter->value += amount;
+    FIBER_UNLOCK(level);
+}
+
+void fiber_counter_signal(fiber_scheduler_t* scheduler, fiber_counter_t* counter) {
+    fiber_counter_add(counter, -1);
+
+    void* task = scheduler->task;
+    if(task != NULL)
+        FIBER_WAKE(task);
+}
+
+void fiber_counter_signal_from_isr(fiber_scheduler_t* scheduler, fiber_counter_t* counter, BaseType_t* woken) {
+    fiber_counter_add(counter, -1);
+
+    void* task = scheduler->task;
+    if(task != NULL)
+        FIBER_WAKE_FROM_ISR(task, woken);
+}
+
+void fiber_get_stats(fiber_scheduler_t* scheduler, fiber_stats_t* stats) {
+    *stats = scheduler->stats;
+}
+
+bool fiber_stack_in_bounds(void* task, void* sp) {
+    bool in_bounds = false;
+
+    uint32_t level;
+    FIBER_LOCK(level);
+
+    for(fiber_scheduler_t* scheduler = fiber_running; scheduler != NULL; scheduler = scheduler->next) {
+        fiber_t* fiber = scheduler->current;
+        if(scheduler->task != task || fiber == NULL)
+            continue;
+
+        uint8_t* p = (uint8_t*)sp;
+        in_bounds = p >= fiber->stack && p < fiber->stack + fiber->stack_size;
+        break;
+    }
+
+    FIBER_UNLOCK(level);
+
+    return in_bounds;
+}
+
+#ifdef __powerpc__
+
+// IPC response handler
+static void fiber_io_complete(void* param, int return_value, BaseType_t* woken) {
+    fiber_t* fiber = (fiber_t*)param;
+    fiber->io_result = return_value;
+    fiber_counter_signal_from_isr(fiber->scheduler, &fiber->io_done, woken);
+}
+
+static fiber_t* fiber_io_begin(fiber_scheduler_t* scheduler) {
+    fiber_t* fiber = scheduler->current;
+    if(fiber != NULL)
+        fiber->io_done.value = 1;
+
+    return fiber;
+}
+
+static int fiber_io_wait(fiber_scheduler_t* scheduler, fiber_t* fiber, int submitted) {
+    if(submitted < 0)
+        return submitted;
+
+    fiber_wait(scheduler, &fiber->io_done);
+    return fiber->io_result;
+}
+
+int fiber_ios_open(fiber_scheduler_t* scheduler, const char* path, int mode) {
+    fiber_t* fiber = fiber_io_begin(scheduler);
+    if(fiber == NULL)
+        return ios_open(path, mode);
+
+    return fiber_io_wait(scheduler, fiber, ios_open_async(path, mode, &fiber->io_message, fiber_io_complete, fiber));
+}
+
+int fiber_ios_close(fiber_scheduler_t* scheduler, int file_handle) {
+    fiber_t* fiber = fiber_io_begin(scheduler);
+    if(fiber == NULL)
+        return ios_close(file_handle);
+
+    return fiber_io_wait(scheduler, fiber, ios_close_async(file_handle, &fiber->io_message, fiber_io_complete, fiber));
+}
+
+int fiber_ios_read(fiber_scheduler_t* scheduler, int file_handle, void* buffer, int size) {
+    fiber_t* fiber = fiber_io_begin(scheduler);
+    if(fiber == NULL)
+        return ios_read(file_handle, buffer, size);
+
+    return fiber_io_wait(scheduler, fiber, ios_read_async(file_handle, buffer, size, &fiber->io_message, fiber_io_complete, fiber));
+}
+
+int fiber_ios_write(fiber_scheduler_t* scheduler, int file_handle, void* buffer, int size) {
+    fiber_t* fiber = fiber_io_begin(scheduler);
+    if(fiber == NULL)
+        return ios_write(file_handle, buffer, size);
+
+    return fiber_io_wait(scheduler, fiber, ios_write_async(file_handle, buffer, size, &fiber->io_message, fiber_io_complete, fiber));
+}
+
+int fiber_ios_seek(fiber_scheduler_t* scheduler, int file_handle, int where, int whence) {
+    fiber_t* fiber = fiber_io_begin(scheduler);
+    if(fiber == NULL)
+        return ios_seek(file_handle, where, whence);
+
+    return fiber_io_wait(scheduler, fiber, ios_seek_async(file_handle, where, whence, &fiber->io_message, fiber_io_complete, fiber));
+}
+
+int fiber_ios_ioctl(fiber_scheduler_t* scheduler, int file_handle, int ioctl, void* buffer_in, int in_size, void* buffer_io, int io_size) {
+    fiber_t* fiber = fiber_io_begin(scheduler);
+    if(fiber == NULL)
+        return ios_ioctl(file_handle, ioctl, buffer_in, in_size, buffer_io, io_size);
+
+    return fiber_io_wait(scheduler, fiber, ios_ioctl_async(file_handle, ioctl, buffer_in, in_size, buffer_io, io_size,
+                                                           &fiber->io_message, fiber_io_complete, fiber));
+}
+
+#endif
@@ -0,0 +1,324 @@
+/**
+ * @file fiber.h
+ * @brief Fibers and Jobs
+ *
+ * Cooperative fibers that run jobs inside one task, so a frame's work
+ * can be split up and overlapped without a FreeRTOS task for each piece.
+ *
+ * Switching fibers is a plain function call. Only the registers the ABI
+ * says a call keeps are swapped, there is no system call and no full
+ * exception context like switching tasks.
+ *
+ * Jobs are queued in batches with a counter. The counter goes up by
+ * the number of jobs, and back down as each one finishes. A job can wait
+ * for a counter to reach 0, which parks its fiber and runs other jobs
+ * in the meantime. A job can also be held back until a counter reaches 0.
+ *
+ * The fiber_ios functions start an async IOS request and park the fiber
+ * until it is answered, so other jobs keep the CPU busy in the meantime.
+ * Anything else that finishes outside the scheduler, in another task or
+ * an interrupt handler, can do the same with fiber_counter_signal.
+ *
+ * Fibers never run at the same time, and only switch when a job
+ * waits, yields or finishes. Jobs still should not block the task
+ * they run in for long, that holds up every other job.
+ *
+ * Floating point registers are part of a fiber, so jobs can use the FPU.
+ * The task the scheduler runs in then always has the FPU.
+ *
+ * Everything but the fiber_ios functions builds for the host as well,
+ * using ucontext to switch, so scheduling can be tested off the Wii.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdalign.h>
+
+#include "powerblocks/core/system/ipc.h"
+
+#ifndef __powerpc__
+#include <ucontext.h>
+#endif
+
+// Most fibers one scheduler can have
+#define FIBER_MAX_FIBERS 16
+
+// Most jobs that can be waiting to start at once
+#define FIBER_MAX_JOBS 128
+
+// Smallest stack a fiber can have. Interrupts taken while a
+// fiber runs save their context and run their handler on it too.
+#define FIBER_MIN_STACK_SIZE 2048
+
+typedef struct fiber_scheduler fiber_scheduler_t;
+
+/**
+ * @typedef fiber_job_function_t
+ * @brief A job, ran on a fiber.
+ *
+ * @param scheduler Scheduler running the job
+ * @param param User parameter
+ */
+typedef void (*fiber_job_function_t)(fiber_scheduler_t* scheduler, void* param);
+
+/**
+ * @struct fiber_counter_t
+ * @brief Jobs or requests still to finish. Starts at 0.
+ */
+typedef struct {
+    volatile int32_t value;
+} fiber_counter_t;
+
+/**
+ * @struct fiber_job_t
+ * @brief A job to queue.
+ */
+typedef struct {
+    fiber_job_function_t function;
+    void* param;
+    fiber_counter_t* dependency; // Not started until this reaches 0, NULL to start right away
+} fiber_job_t;
+
+/**
+ * @struct fiber_stats_t
+ * @brief Scheduler counters, times in time base ticks.
+ */
+typedef struct {
+    uint32_t jobs;        // Jobs finished
+    uint32_t switches;    // Fiber switches
+    uint32_t waits;       // Times a job had to wait on a counter
+    uint32_t idles;       // Times every job was waiting on something outside, and the task blocked
+    uint64_t idle_time;   // Time spent blocked
+    uint32_t max_queued;  // Most jobs waiting to start at once
+    uint32_t max_fibers;  // Most fibers busy at once
+} fiber_stats_t;
+
+#ifdef __powerpc__
+
+// Only what a call has to keep, see fiber_asm.s
+typedef struct {
+    uint32_t sp;
+    uint32_t lr;
+    uint32_t cr;
+    uint32_t gpr[18]; // r14 to r31
+    uint32_t pad;
+    double fpr[18];   // f14 to f31
+    uint32_t ps[18][2]; // f14 to f31 as paired singles, only with HID2[PSE] set
+} fiber_context_t;
+
+#else
+
+typedef ucontext_t fiber_context_t;
+
+#endif
+
+typedef struct {
+    fiber_job_t job;
+    fiber_counter_t* counter;
+} fiber_queued_job_t;
+
+typedef enum {
+    FIBER_STATE_FREE,
+    FIBER_STATE_RUNNING,
+    FIBER_STATE_WAITING,
+    FIBER_STATE_YIELDED
+} fiber_state_t;
+
+typedef struct {
+    // A parked fiber is only waiting on one request, so it can keep the message
+    alignas(32) ipc_message io_message;
+    fiber_counter_t io_done;
+    int io_result;
+
+    fiber_context_t context;
+    fiber_scheduler_t* scheduler;
+
+    uint8_t* stack;
+    uint32_t stack_size;
+
+    fiber_state_t state;
+    fiber_queued_job_t job;
+    fiber_counter_t* wait;
+} fiber_t;
+
+/**
+ * @struct fiber_scheduler
+ * @brief A scheduler and its fibers. Set up with fiber_scheduler_initialize.
+ */
+struct fiber_scheduler {
+    fiber_t fibers[FIBER_MAX_FIBERS];
+    uint32_t fiber_count;
+    uint32_t fibers_busy;
+
+    fiber_t* current;           // NULL while in the scheduler itself
+    fiber_context_t context;    // The task's own, the scheduler runs on it
+    uint32_t next_fiber;        // Where to start looking for a fiber to resume, so they take turns
+
+    fiber_queued_job_t jobs[FIBER_MAX_JOBS];
+    uint32_t job_count;
+
+    uint8_t* stacks;
+    uint32_t stacks_size;
+
+    void* task;                 // Task running the scheduler, NULL if not running
+    fiber_scheduler_t* next;    // Running schedulers
+
+    fiber_stats_t stats;
+};
+
+/**
+ * @brief Sets up a scheduler.
+ *
+ * The stacks are split evenly between the fibers. One fiber is needed
+ * for each job that can be started or waiting at once, a job that has
+ * to wait on a counter keeps its fiber until it is done.
+ *
+ * @param scheduler Scheduler
+ * @param stacks Memory for every fiber's stack, must stay around while the scheduler does
+ * @param stack_size Bytes of stack for each fiber, at least FIBER_MIN_STACK_SIZE
+ * @param fiber_count Fibers, up to FIBER_MAX_FIBERS
+ * @return Negative if error
+ */
+extern int fiber_scheduler_initialize(fiber_scheduler_t* scheduler, void* stacks, uint32_t stack_size, uint32_t fiber_count);
+
+/**
+ * @brief Runs a job and everything it queues.
+ *
+ * Turns the calling task into the scheduler until every job is done.
+ * While every job is waiting on a request, the task blocks.
+ *
+ * @param scheduler Scheduler
+ * @param function First job
+ * @param param User parameter for the first job
+ * @return Negative if error
+ */
+extern int fiber_scheduler_run(fiber_scheduler_t* scheduler, fiber_job_function_t function, void* param);
+
+/**
+ * @brief Queues jobs.
+ *
+ * All of them or none are queued. Jobs start in the order they are
+ * queued, as fibers free up and their dependencies finish.
+ *
+ * @param scheduler Scheduler
+ * @param jobs Jobs to queue, copied
+ * @param count Number of jobs
+ * @param counter Goes up by count, then down as each finishes. Can be NULL.
+ * @return Negative if error
+ */
+extern int fiber_run_jobs(fiber_scheduler_t* scheduler, const fiber_job_t* jobs, uint32_t count, fiber_counter_t* counter);
+
+/**
+ * @brief Waits for a counter to reach 0.
+ *
+ * Other jobs run in the meantime. Only from a job.
+ *
+ * @param scheduler Scheduler
+ * @param counter Counter
+ * @return Negative if error
+ */
+extern int fiber_wait(fiber_scheduler_t* scheduler, fiber_counter_t* counter);
+
+/**
+ * @brief Lets other jobs run.
+ *
+ * The calling job continues once every other fiber had a turn.
+ * Only from a job.
+ *
+ * @param scheduler Scheduler
+ */
+extern void fiber_yield(fiber_scheduler_t* scheduler);
+
+/**
+ * @brief Counts a counter down from another task.
+ *
+ * For work that finishes outside the scheduler.
+ * Raise the counter with fiber_counter_add before it starts.
+ *
+ * @param scheduler Scheduler waiting on it
+ * @param counter Counter
+ */
+extern void fiber_counter_signal(fiber_scheduler_t* scheduler, fiber_counter_t* counter);
+
+/**
+ * @brief Counts a counter down from an interrupt handler.
+ *
+ * Also safe from IPC response handlers.
+ *
+ * @param scheduler Scheduler waiting on it
+ * @param counter Counter
+ * @param woken Set if a task switch is needed, &exception_isr_context_switch_needed
+ *              from an interrupt or the handler's own argument from a response handler.
+ */
+extern void fiber_counter_signal_from_isr(fiber_scheduler_t* scheduler, fiber_counter_t* counter, BaseType_t* woken);
+
+/**
+ * @brief Raises a counter.
+ *
+ * @param counter Counter
+ * @param amount Amount to add
+ */
+extern void fiber_counter_add(fiber_counter_t* counter, int32_t amount);
+
+/**
+ * @brief Gets the scheduler counters.
+ *
+ * @param scheduler Scheduler
+ * @param stats Outputted stats
+ */
+extern void fiber_get_stats(fiber_scheduler_t* scheduler, fiber_stats_t* stats);
+
+/**
+ * @brief Checks a stack pointer against the fiber running in a task.
+ *
+ * Used by the FreeRTOS stack check, fiber stacks are outside of the task's.
+ *
+ * @param task Task
+ * @param sp Task's stack pointer
+ * @return True if on the running fiber's stack
+ */
+extern bool fiber_stack_in_bounds(void* task, void* sp);
+
+/**
+ * @brief Opens a file on IOS, letting other jobs run until it is done.
+ *
+ * Each of the fiber_ios functions acts like its ios counterpart,
+ * outside of a job they just call it.
+ *
+ * @param scheduler Scheduler
+ * @param path File path, see ios_open
+ * @param mode File mode
+ * @return File handle, negative if error
+ */
+extern int fiber_ios_open(fiber_scheduler_t* scheduler, const char* path, int mode);
+
+/**
+ * @brief Closes a file on IOS, letting other jobs run until it is done.
+ */
+extern int fiber_ios_close(fiber_scheduler_t* scheduler, int file_handle);
+
+/**
+ * @brief Reads from a file on IOS, letting other jobs run until it is done.
+ */
+extern int fiber_ios_read(fiber_scheduler_t* scheduler, int file_handle, void* buffer, int size);
+
+/**
+ * @brief Writes to a file on IOS, letting other jobs run until it is done.
+ */
+extern int fiber_ios_write(fiber_scheduler_t* scheduler, int file_handle, void* buffer, int size);
+
+/**
+ * @brief Seeks in a file on IOS, letting other jobs run until it is done.
+ */
+extern int fiber_ios_seek(fiber_scheduler_t* scheduler, int file_handle, int where, int whence);
+
+/**
+ * @brief Sends an ioctl on IOS, letting other jobs run until it is done.
+ */
+extern int fiber_ios_ioctl(fiber_scheduler_t* scheduler, int file_handle, int ioctl, void* buffer_in, int in_size, void* buffer_io, int io_size);
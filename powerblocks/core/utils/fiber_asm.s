@@ -0,0 +1,158 @@
+/**
+ * @file fiber_asm.s
+ * @brief Switching fibers.
+ *
+ * A switch is a function call, so only what the ABI says a call
+ * keeps is swapped. The stack pointer, link register, condition
+ * register, r14 to r31 and f14 to f31. r2 and r13 are the same everywhere.
+ *
+ * With paired singles on, ps1 of f14 to f31 is kept too, the same way
+ * exception_fpu_save does it. A stfd alone would only keep ps0.
+ *
+ * Layout matches fiber_context_t.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+# Paired single load and store, the assembler does not know Gekko's instructions.
+# Always uses GQR0, W=0 so both ps0 and ps1 are transferred.
+.macro psq_st_gqr0 frs, d, ra
+    .long (60 << 26) | (\frs << 21) | (\ra << 16) | (\d & 0xFFF)
+.endm
+
+.macro psq_l_gqr0 frd, d, ra
+    .long (56 << 26) | (\frd << 21) | (\ra << 16) | (\d & 0xFFF)
+.endm
+
+    .global fiber_switch
+    .global fiber_entry
+
+# void fiber_switch(fiber_context_t* from, fiber_context_t* to)
+fiber_switch:
+    mflr    5
+    mfcr    6
+    stw     1, 0(3)
+    stw     5, 4(3)
+    stw     6, 8(3)
+    stmw    14, 12(3)
+
+    # Uses the FPU, the first switch in a task claims it like any other floating point.
+    # Paired singles only when HID2[PSE] is set, before the stfd's.
+    mfspr   7, 920
+    rlwinm. 7, 7, 3, 31, 31
+    beq     fiber_no_ps_save
+
+    # GQR0 has to be unscaled floats so the values go out as is,
+    # it is put back once the other fiber's are loaded
+    mfspr   8, 912
+    li      9, 0
+    mtspr   912, 9
+    isync
+
+    addi    9, 3, 232
+    psq_st_gqr0 14, 0, 9
+    psq_st_gqr0 15, 8, 9
+    psq_st_gqr0 16, 16, 9
+    psq_st_gqr0 17, 24, 9
+    psq_st_gqr0 18, 32, 9
+    psq_st_gqr0 19, 40, 9
+    psq_st_gqr0 20, 48, 9
+    psq_st_gqr0 21, 56, 9
+    psq_st_gqr0 22, 64, 9
+    psq_st_gqr0 23, 72, 9
+    psq_st_gqr0 24, 80, 9
+    psq_st_gqr0 25, 88, 9
+    psq_st_gqr0 26, 96, 9
+    psq_st_gqr0 27, 104, 9
+    psq_st_gqr0 28, 112, 9
+    psq_st_gqr0 29, 120, 9
+    psq_st_gqr0 30, 128, 9
+    psq_st_gqr0 31, 136, 9
+
+fiber_no_ps_save:
+    stfd    14, 88(3)
+    stfd    15, 96(3)
+    stfd    16, 104(3)
+    stfd    17, 112(3)
+    stfd    18, 120(3)
+    stfd    19, 128(3)
+    stfd    20, 136(3)
+    stfd    21, 144(3)
+    stfd    22, 152(3)
+    stfd    23, 160(3)
+    stfd    24, 168(3)
+    stfd    25, 176(3)
+    stfd    26, 184(3)
+    stfd    27, 192(3)
+    stfd    28, 200(3)
+    stfd    29, 208(3)
+    stfd    30, 216(3)
+    stfd    31, 224(3)
+
+    # cr0 still says whether paired singles are on
+    beq     fiber_no_ps_load
+
+    addi    10, 4, 232
+    psq_l_gqr0 14, 0, 10
+    psq_l_gqr0 15, 8, 10
+    psq_l_gqr0 16, 16, 10
+    psq_l_gqr0 17, 24, 10
+    psq_l_gqr0 18, 32, 10
+    psq_l_gqr0 19, 40, 10
+    psq_l_gqr0 20, 48, 10
+    psq_l_gqr0 21, 56, 10
+    psq_l_gqr0 22, 64, 10
+    psq_l_gqr0 23, 72, 10
+    psq_l_gqr0 24, 80, 10
+    psq_l_gqr0 25, 88, 10
+    psq_l_gqr0 26, 96, 10
+    psq_l_gqr0 27, 104, 10
+    psq_l_gqr0 28, 112, 10
+    psq_l_gqr0 29, 120, 10
+    psq_l_gqr0 30, 128, 10
+    psq_l_gqr0 31, 136, 10
+
+    mtspr   912, 8
+    isync
+
+fiber_no_ps_load:
+    # lfd only replaces ps0, so this brings back full precision over the single loaded above
+    lfd     14, 88(4)
+    lfd     15, 96(4)
+    lfd     16, 104(4)
+    lfd     17, 112(4)
+    lfd     18, 120(4)
+    lfd     19, 128(4)
+    lfd     20, 136(4)
+    lfd     21, 144(4)
+    lfd     22, 152(4)
+    lfd     23, 160(4)
+    lfd     24, 168(4)
+    lfd     25, 176(4)
+    lfd     26, 184(4)
+    lfd     27, 192(4)
+    lfd     28, 200(4)
+    lfd     29, 208(4)
+    lfd     30, 216(4)
+    lfd     31, 224(4)
+
+    lmw     14, 12(4)
+    lwz     5, 4(4)
+    lwz     6, 8(4)
+    mtlr    5
+    mtcrf   0xFF, 6
+
+    # Last, so interrupts taken before here still land on a good stack
+    lwz     1, 0(4)
+    blr
+
+# First switch to a new fiber lands here, r14 is the function, r15 its argument
+fiber_entry:
+    mr      3, 15
+    mtctr   14
+    bctrl
+
+    # Fibers never return
+    trap
@@ -0,0 +1,296 @@
+/**
+ * @file memory.c
+ * @brief Fast memcpy, memmove and memset.
+ *
+ * Replaces the C library ones with versions for the 750's 32 byte cache lines.
+ *
+ * Large copies and fills go a cache line at a time. Destination lines
+ * that will be completely overwritten are made with dcbz, so they are not read
+ * from memory first just to be written over. Source lines are fetched ahead with dcbt.
+ *
+ * When the calling task already has the FPU, lines are moved with 8 byte lfd/stfd,
+ * otherwise with 4 byte integer loads and stores. Copying never claims the FPU itself,
+ * so tasks that do not use floating point keep their cheap switches, and these are
+ * safe in exception handlers where floating point is off.
+ *
+ * dcbz only goes to cached memory, it raises an alignment exception in
+ * uncached memory, so copies there still work but take the slower path.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Built -ffreestanding, so the compiler does not turn the loops
+// below back into calls to these same functions.
+
+#define MEMORY_LINE 32
+
+// Below this, lining everything up costs more than it saves
+#define MEMORY_LINE_THRESHOLD 64
+
+// How far ahead source lines are fetched
+#define MEMORY_PREFETCH_DISTANCE (MEMORY_LINE * 4)
+
+#ifdef __powerpc__
+
+#include "powerblocks/core/system/cpu.h"
+
+#define MEMORY_ZERO_LINE(p) __asm__ __volatile__("dcbz 0, %0" : : "r"(p) : "memory")
+#define MEMORY_TOUCH(p)     __asm__ __volatile__("dcbt 0, %0" : : "r"(p))
+
+// MEM1 and MEM2 through the cached BATs, 0x8XXXXXXX and 0x9XXXXXXX
+static inline bool memory_is_cached(const void* p) {
+    uint32_t region = (uint32_t)p >> 28;
+    return region == 0x8 || region == 0x9;
+}
+
+static inline bool memory_has_fpu() {
+    uint32_t msr;
+    __asm__ __volatile__("mfmsr %0" : "=r"(msr));
+    return (msr & MSR_FP) != 0;
+}
+
+#else
+
+// Anywhere else, only for testing the logic.
+#define MEMORY_ZERO_LINE(p) \
+    do { \
+        uint32_t* zero_line = (uint32_t*)(p); \
+        for(int zero_i = 0; zero_i < MEMORY_LINE / 4; zero_i++) \
+            zero_line[zero_i] = 0; \
+    } while(0)
+#define MEMORY_TOUCH(p) ((void)(p))
+
+static inline bool memory_is_cached(const void* p) {
+    return true;
+}
+
+// Which line copy the host tests take
+bool memory_host_use_fpu = true;
+
+static inline bool memory_has_fpu() {
+    return memory_host_use_fpu;
+}
+
+#endif
+
+// Lines of an aligned destination, from a source aligned to 8.
+static void __attribute__((noinline)) memory_copy_lines_fpu(uint8_t* d, const uint8_t* s, size_t lines, bool zero) {
+    const uint8_t* end = s + lines * MEMORY_LINE;
+
+    while(lines--) {
+        if(s + MEMORY_PREFETCH_DISTANCE < end)
+            MEMORY_TOUCH(s + MEMORY_PREFETCH_DISTANCE);
+
+        double a = ((const double*)s)[0];
+        double b = ((const double*)s)[1];
+        double c = ((const double*)s)[2];
+        double e = ((const double*)s)[3];
+
+        if(zero)
+            MEMORY_ZERO_LINE(d);
+
+        ((double*)d)[0] = a;
+        ((double*)d)[1] = b;
+        ((double*)d)[2] = c;
+        ((double*)d)[3] = e;
+
+        s += MEMORY_LINE;
+        d += MEMORY_LINE;
+    }
+}
+
+// Lines of an aligned destination, from a source aligned to 4.
+static void __attribute__((noinline)) memory_copy_lines_integer(uint8_t* d, const uint8_t* s, size_t lines, bool zero) {
+    const uint8_t* end = s + lines * MEMORY_LINE;
+
+    while(lines--) {
+        if(s + MEMORY_PREFETCH_DISTANCE < end)
+            MEMORY_TOUCH(s + MEMORY_PREFETCH_DISTANCE);
+
+        const uint32_t* sw = (const uint32_t*)s;
+        uint32_t w0 = sw[0], w1 = sw[1], w2 = sw[2], w3 = sw[3];
+        uint32_t w4 = sw[4], w5 = sw[5], w6 = sw[6], w7 = sw[7];
+
+        if(zero)
+            MEMORY_ZERO_LINE(d);
+
+        uint32_t* dw = (uint32_t*)d;
+        dw[0] = w0; dw[1] = w1; dw[2] = w2; dw[3] = w3;
+        dw[4] = w4; dw[5] = w5; dw[6] = w6; dw[7] = w7;
+
+        s += MEMORY_LINE;
+        d += MEMORY_LINE;
+    }
+}
+
+// Lines of an aligned destination, from any source.
+static void __attribute__((noinline)) memory_copy_lines_bytes(uint8_t* d, const uint8_t* s, size_t lines, bool zero) {
+    while(lines--) {
+        MEMORY_TOUCH(s + MEMORY_PREFETCH_DISTANCE);
+
+        // Gather the bytes, so the destination is still written a word at a time
+        union {
+            uint32_t words[MEMORY_LINE / 4];
+            uint8_t bytes[MEMORY_LINE];
+        } line;
+
+        for(int i = 0; i < MEMORY_LINE; i++)
+            line.bytes[i] = s[i];
+        s += MEMORY_LINE;
+
+        if(zero)
+            MEMORY_ZERO_LINE(d);
+
+        for(int i = 0; i < MEMORY_LINE / 4; i++)
+            ((uint32_t*)d)[i] = line.words[i];
+
+        d += MEMORY_LINE;
+    }
+}
+
+// Forward copy. dcbz is only allowed when nothing still to be read
+// can be in a destination line, always true unless memmove overlaps.
+static void memory_copy_forward(uint8_t* d, const uint8_t* s, size_t n, bool allow_zero) {
+    if(n >= MEMORY_LINE_THRESHOLD) {
+        // Line up the destination
+        while((uintptr_t)d & (MEMORY_LINE - 1)) {
+            *d++ = *s++;
+            n--;
+        }
+
+        size_t lines = n / MEMORY_LINE;
+        bool zero = allow_zero && memory_is_cached(d);
+
+        if(((uintptr_t)s & 7) == 0 && memory_has_fpu())
+            memory_copy_lines_fpu(d, s, lines, zero);
+        else if(((uintptr_t)s & 3) == 0)
+            memory_copy_lines_integer(d, s, lines, zero);
+        else
+            memory_copy_lines_bytes(d, s, lines, zero);
+
+        d += lines * MEMORY_LINE;
+        s += lines * MEMORY_LINE;
+        n -= lines * MEMORY_LINE;
+    }
+
+    // Whatever is left, words when both line up
+    if((((uintptr_t)d | (uintptr_t)s) & 3) == 0) {
+        while(n >= 4) {
+            *(uint32_t*)d = *(const uint32_t*)s;
+            d += 4;
+            s += 4;
+            n -= 4;
+        }
+    }
+
+    while(n--)
+        *d++ = *s++;
+}
+
+static void memory_copy_backward(uint8_t* d, const uint8_t* s, size_t n) {
+    d += n;
+    s += n;
+
+    if((((uintptr_t)d ^ (uintptr_t)s) & 3) == 0) {
+        while(n > 0 && ((uintptr_t)d & 3)) {
+            *--d = *--s;
+            n--;
+        }
+
+        while(n >= 16) {
+            d -= 16;
+            s -= 16;
+            uint32_t w0 = ((const uint32_t*)s)[0], w1 = ((const uint32_t*)s)[1];
+            uint32_t w2 = ((const uint32_t*)s)[2], w3 = ((const uint32_t*)s)[3];
+            ((uint32_t*)d)[3] = w3;
+            ((uint32_t*)d)[2] = w2;
+            ((uint32_t*)d)[1] = w1;
+            ((uint32_t*)d)[0] = w0;
+            n -= 16;
+        }
+
+        while(n >= 4) {
+            d -= 4;
+            s -= 4;
+            *(uint32_t*)d = *(const uint32_t*)s;
+            n -= 4;
+        }
+    }
+
+    while(n--)
+        *--d = *--s;
+}
+
+void* memcpy(void* restrict dest, const void* restrict src, size_t n) {
+    memory_copy_forward((uint8_t*)dest, (const uint8_t*)src, n, true);
+    return dest;
+}
+
+void* memmove(void* dest, const void* src, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+
+    if(d == s || n == 0)
+        return dest;
+
+    if(d < s || d >= s + n) {
+        // Forward is safe. Zeroing a destination line would wipe source bytes
+        // not read yet when the source starts less than a line after it.
+        bool allow_zero = d > s || (size_t)(s - d) >= MEMORY_LINE;
+        memory_copy_forward(d, s, n, allow_zero);
+    } else {
+        memory_copy_backward(d, s, n);
+    }
+
+    return dest;
+}
+
+void* memset(void* dest, int c, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    uint8_t value = (uint8_t)c;
+
+    if(n >= MEMORY_LINE_THRESHOLD) {
+        while((uintptr_t)d & (MEMORY_LINE - 1)) {
+            *d++ = value;
+            n--;
+        }
+
+        uint32_t word = value * 0x01010101u;
+        size_t lines = n / MEMORY_LINE;
+        bool cached = memory_is_cached(d);
+
+        if(cached && value == 0) {
+            // Zeroing is all dcbz does
+            for(size_t i = 0; i < lines; i++)
+                MEMORY_ZERO_LINE(d + i * MEMORY_LINE);
+        } else {
+            for(size_t i = 0; i < lines; i++) {
+                uint32_t* line = (uint32_t*)(d + i * MEMORY_LINE);
+                if(cached)
+                    MEMORY_ZERO_LINE(line);
+                line[0] = word; line[1] = word; line[2] = word; line[3] = word;
+                line[4] = word; line[5] = word; line[6] = word; line[7] = word;
+            }
+        }
+
+        d += lines * MEMORY_LINE;
+        n -= lines * MEMORY_LINE;
+
+        while(n >= 4) {
+            *(uint32_t*)d = word;
+            d += 4;
+            n -= 4;
+        }
+    }
+
+    while(n--)
+        *d++ = value;
+
+    return dest;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file pool.c
+ * @brief Fixed Size Object Pools
+ *
+ * Pools of same sized blocks.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "pool.h"
+
+#include <string.h>
+
+// Fill allocated and freed blocks with patterns,
+// and check freed blocks were left alone when they are reused.
+//#define POOL_DEBUG_POISON
+
+#define POOL_POISON_ALLOCATED 0xCD
+#define POOL_POISON_FREED     0xDD
+
+int pool_initialize(pool_t* pool, void* memory, uint32_t block_size, uint32_t count) {
+    if(block_size < sizeof(void*) || (block_size % sizeof(void*)) != 0 || ((uintptr_t)memory % sizeof(void*)) != 0)
+        return -1;
+
+    pool_t initial = POOL_STATIC_INITIALIZER(memory, block_size, count);
+    *pool = initial;
+    return 0;
+}
+
+void* pool_alloc(pool_t* pool) {
+    uint8_t* block;
+
+    if(pool->free_list) {
+        block = (uint8_t*)pool->free_list;
+        pool->free_list = *(void**)block;
+
+#ifdef POOL_DEBUG_POISON
+        for(uint32_t i = sizeof(void*); i < pool->block_size; i++) {
+            if(block[i] != POOL_POISON_FREED) {
+                pool->stats.corrupted++;
+                break;
+            }
+        }
+#endif
+    } else if(pool->unused < pool->stats.count) {
+        block = pool->memory + pool->unused * pool->block_size;
+        pool->unused++;
+    } else {
+        pool->stats.failures++;
+        return NULL;
+    }
+
+    pool->stats.used++;
+    if(pool->stats.used > pool->stats.peak_used)
+        pool->stats.peak_used = pool->stats.used;
+    pool->stats.allocations++;
+
+#ifdef POOL_DEBUG_POISON
+    memset(block, POOL_POISON_ALLOCATED, pool->block_size);
+#endif
+
+    return block;
+}
+
+int pool_free(pool_t* pool, void* block) {
+    if(block == NULL)
+        return 0;
+
+    uint32_t offset = (uint8_t*)block - pool->memory;
+    if((uint8_t*)block < pool->memory || offset >= pool->unused * pool->block_size || (offset % pool->block_size) != 0) {
+        pool->stats.failures++;
+        return -1;
+    }
+
+#ifdef POOL_DEBUG_POISON
+    memset(block, POOL_POISON_FREED, pool->block_size);
+#endif
+
+    *(void**)block = pool->free_list;
+    pool->free_list = block;
+
+    pool->stats.used--;
+    pool->stats.frees++;
+    return 0;
+}
+
+void pool_get_stats(const pool_t* pool, pool_stats_t* stats) {
+    *stats = pool->stats;
+}
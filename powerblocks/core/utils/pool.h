@@ -0,0 +1,117 @@
+/**
+ * @file pool.h
+ * @brief Fixed Size Object Pools
+ *
+ * Pools of same sized blocks, for objects that come and go often
+ * like IPC requests and packets.
+ *
+ * Allocating and freeing is taking and putting back the head of a list,
+ * and it never fragments. Blocks that have never been used are handed
+ * out in order first, so creating a pool does not touch its memory.
+ *
+ * Pools are not locked. When one is shared between tasks, or with
+ * interrupts, allocate and free inside a critical section.
+ *
+ * POOL_DEFINE makes a static pool for a type along with typed functions:
+ *
+ *     POOL_DEFINE(packet_pool, packet_t, 16);
+ *
+ *     packet_t* packet = packet_pool_alloc();
+ *     packet_pool_free(packet);
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @struct pool_stats_t
+ * @brief Pool counters.
+ */
+typedef struct {
+    uint32_t count;         // Blocks in the pool
+    uint32_t used;          // Blocks allocated right now
+    uint32_t peak_used;     // Most allocated at once, the high water mark
+
+    uint32_t allocations;
+    uint32_t frees;
+    uint32_t failures;      // Allocations with nothing left, or frees of blocks not from the pool
+    uint32_t corrupted;     // Free blocks written to after being freed, only found with POOL_DEBUG_POISON
+} pool_stats_t;
+
+/**
+ * @struct pool_t
+ * @brief A pool of blocks.
+ */
+typedef struct {
+    uint8_t* memory;
+    uint32_t block_size;
+
+    void* free_list;        // Blocks that were freed
+    uint32_t unused;        // Blocks from here on have never been allocated
+
+    pool_stats_t stats;
+} pool_t;
+
+/** @def POOL_STATIC_INITIALIZER
+ * @brief Initializer for a pool over static memory.
+ *
+ * @param memory Start of the blocks
+ * @param block_size Bytes per block, at least a pointer and a multiple of its alignment
+ * @param count Number of blocks
+ */
+#define POOL_STATIC_INITIALIZER(memory, block_size, count) \
+    { (uint8_t*)(memory), (block_size), NULL, 0, { (count), 0, 0, 0, 0, 0, 0 } }
+
+/** @def POOL_DEFINE
+ * @brief Defines a static pool for a type.
+ *
+ * Makes name, a pool_t of count blocks each holding a type,
+ * name_alloc() returning a type* and name_free(type*).
+ */
+#define POOL_DEFINE(name, type, count) \
+    static union { type object; void* link; } name##_storage[count]; \
+    static pool_t name = POOL_STATIC_INITIALIZER(name##_storage, sizeof(name##_storage[0]), count); \
+    static inline type* name##_alloc() { return (type*)pool_alloc(&name); } \
+    static inline void name##_free(type* object) { pool_free(&name, object); }
+
+/**
+ * @brief Creates a pool over a region of memory.
+ *
+ * @param pool Pool to create
+ * @param memory Start of the blocks
+ * @param block_size Bytes per block, at least a pointer and a multiple of its alignment
+ * @param count Number of blocks
+ * @return Negative if error
+ */
+extern int pool_initialize(pool_t* pool, void* memory, uint32_t block_size, uint32_t count);
+
+/**
+ * @brief Allocates a block.
+ *
+ * @param pool Pool
+ * @return Block, NULL if the pool is empty
+ */
+extern void* pool_alloc(pool_t* pool);
+
+/**
+ * @brief Frees a block.
+ *
+ * @param pool Pool it came from
+ * @param block Block, may be NULL
+ * @return Negative if the block is not from this pool
+ */
+extern int pool_free(pool_t* pool, void* block);
+
+/**
+ * @brief Reads back the pool counters.
+ *
+ * @param pool Pool
+ * @param stats Outputted stats
+ */
+extern void pool_get_stats(const pool_t* pool, pool_stats_t* stats);
@@ -0,0 +1,229 @@
+/**
+ * @file task_monitor.c
+ * @brief Task Monitor
+ *
+ * Samples system_get_task_stats on a period and works out how much
+ * of the CPU each task used since the last sample.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "task_monitor.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "log.h"
+
+#define TASK_MONITOR_TASK_STACK_SIZE 4096
+#define TASK_MONITOR_TASK_PRIORITY   (configMAX_PRIORITIES - 2)
+
+static const char* TAG = "TASKS";
+
+static SemaphoreHandle_t task_monitor_mutex;
+static StaticSemaphore_t task_monitor_mutex_data;
+
+static TaskHandle_t task_monitor_task_handle;
+static StaticTask_t task_monitor_task_data;
+static StackType_t task_monitor_task_stack[TASK_MONITOR_TASK_STACK_SIZE / sizeof(StackType_t)];
+
+static volatile bool task_monitor_running;
+static volatile uint32_t task_monitor_period_ms;
+static volatile bool task_monitor_logging;
+
+static framebuffer_t* volatile task_monitor_overlay;
+static const framebuffer_font_t* task_monitor_overlay_font;
+static vec2i task_monitor_overlay_position;
+
+// Latest sample. Names are copied, a task can be deleted while its stats are still shown.
+static task_monitor_task_t task_monitor_tasks[TASK_MONITOR_MAX_TASKS];
+static char task_monitor_names[TASK_MONITOR_MAX_TASKS][configMAX_TASK_NAME_LEN];
+static int task_monitor_count;
+static uint32_t task_monitor_sample_number;
+static uint64_t task_monitor_time;
+static uint64_t task_monitor_period;
+
+static system_task_stats_t task_monitor_new_stats[TASK_MONITOR_MAX_TASKS];
+static uint32_t task_monitor_new_cpu[TASK_MONITOR_MAX_TASKS];
+
+static void task_monitor_lock() {
+    if(task_monitor_mutex == NULL) {
+        uint32_t level;
+        SYSTEM_DISABLE_ISR(level);
+        if(task_monitor_mutex == NULL)
+            task_monitor_mutex = xSemaphoreCreateMutexStatic(&task_monitor_mutex_data);
+        SYSTEM_ENABLE_ISR(level);
+    }
+
+    xSemaphoreTake(task_monitor_mutex, portMAX_DELAY);
+}
+
+static void task_monitor_unlock() {
+    xSemaphoreGive(task_monitor_mutex);
+}
+
+static void task_monitor_task(void* param) {
+    TickType_t wake = xTaskGetTickCount();
+
+    while(true) {
+        if(!task_monitor_running) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            wake = xTaskGetTickCount();
+            continue;
+        }
+
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(task_monitor_period_ms));
+        if(!task_monitor_running)
+            continue;
+
+        task_monitor_sample();
+
+        if(task_monitor_logging)
+            task_monitor_log();
+
+        framebuffer_t* overlay = task_monitor_overlay;
+        if(overlay)
+            task_monitor_draw(overlay, task_monitor_overlay_font, task_monitor_overlay_position);
+    }
+}
+
+int task_monitor_start(uint32_t period_ms, bool log) {
+    if(period_ms == 0) {
+        LOG_ERROR(TAG, "Period can not be 0.");
+        return -1;
+    }
+
+    task_monitor_period_ms = period_ms;
+    task_monitor_logging = log;
+
+    if(task_monitor_task_handle == NULL) {
+        task_monitor_running = true;
+        task_monitor_task_handle = xTaskCreateStatic(task_monitor_task, "TASK MONITOR", TASK_MONITOR_TASK_STACK_SIZE / sizeof(StackType_t),
+                                                     NULL, TASK_MONITOR_TASK_PRIORITY, task_monitor_task_stack, &task_monitor_task_data);
+    } else if(!task_monitor_running) {
+        task_monitor_running = true;
+        xTaskNotifyGive(task_monitor_task_handle);
+    }
+
+    return 0;
+}
+
+void task_monitor_stop() {
+    task_monitor_running = false;
+}
+
+void task_monitor_set_overlay(framebuffer_t* framebuffer, const framebuffer_font_t* font, vec2i position) {
+    task_monitor_lock();
+    task_monitor_overlay_font = font;
+    task_monitor_overlay_position = position;
+    task_monitor_overlay = framebuffer;
+    task_monitor_unlock();
+}
+
+int task_monitor_sample() {
+    task_monitor_lock();
+
+    uint64_t time;
+    int count = system_get_task_stats(task_monitor_new_stats, TASK_MONITOR_MAX_TASKS, &time);
+    if(count < 0) {
+        task_monitor_unlock();
+        return count;
+    }
+
+    uint64_t period = task_monitor_sample_number > 0 ? time - task_monitor_time : 0;
+
+    // Both are sorted by id, walk them together to find each task's last run time
+    int previous = 0;
+    for(int i = 0; i < count; i++) {
+        system_task_stats_t* stats = &task_monitor_new_stats[i];
+
+        while(previous < task_monitor_count && task_monitor_tasks[previous].stats.id < stats->id)
+            previous++;
+
+        // New since the last sample, all of its run time is from this period
+        uint64_t run_time = stats->run_time;
+        if(previous < task_monitor_count && task_monitor_tasks[previous].stats.id == stats->id)
+            run_time -= task_monitor_tasks[previous].stats.run_time;
+
+        task_monitor_new_cpu[i] = 0;
+        if(period > 0) {
+            if(run_time > period)
+                run_time = period;
+            task_monitor_new_cpu[i] = (uint32_t)(run_time * 1000 / period);
+        }
+    }
+
+    for(int i = 0; i < count; i++) {
+        strncpy(task_monitor_names[i], task_monitor_new_stats[i].name, configMAX_TASK_NAME_LEN - 1);
+        task_monitor_names[i][configMAX_TASK_NAME_LEN - 1] = 0;
+
+        task_monitor_tasks[i].stats = task_monitor_new_stats[i];
+        task_monitor_tasks[i].stats.name = task_monitor_names[i];
+        task_monitor_tasks[i].cpu_permille = task_monitor_new_cpu[i];
+    }
+
+    task_monitor_count = count;
+    task_monitor_time = time;
+    task_monitor_period = period;
+    task_monitor_sample_number++;
+
+    task_monitor_unlock();
+    return 0;
+}
+
+int task_monitor_get(task_monitor_task_t* tasks, int max_count) {
+    task_monitor_lock();
+
+    int count = task_monitor_count < max_count ? task_monitor_count : max_count;
+    memcpy(tasks, task_monitor_tasks, count * sizeof(task_monitor_task_t));
+
+    task_monitor_unlock();
+    return count;
+}
+
+void task_monitor_log() {
+    task_monitor_lock();
+
+    LOG_INFO(TAG, "sample=%d period_us=%d tasks=%d", task_monitor_sample_number,
+             (uint32_t)(task_monitor_period * 1000000 / SYSTEM_TB_CLOCK_HZ), task_monitor_count);
+
+    for(int i = 0; i < task_monitor_count; i++) {
+        const task_monitor_task_t* task = &task_monitor_tasks[i];
+        LOG_INFO(TAG, "id=%d name=\"%s\" prio=%d state=%c cpu=%d.%d stack_peak=%d stack_size=%d",
+                 task->stats.id, task->stats.name, task->stats.priority, task->stats.state,
+                 task->cpu_permille / 10, task->cpu_permille % 10,
+                 task->stats.stack_peak, task->stats.stack_size);
+    }
+
+    task_monitor_unlock();
+}
+
+void task_monitor_draw(framebuffer_t* framebuffer, const framebuffer_font_t* font, vec2i position) {
+    char line[64];
+
+    task_monitor_lock();
+
+    framebuffer_put_text(framebuffer, 0xFFFFFFFF, 0x000000FF, position, font, "TASK               CPU   STACK PEAK/SIZE");
+    position.y += font->character_size.y;
+
+    for(int i = 0; i < task_monitor_count; i++) {
+        const task_monitor_task_t* task = &task_monitor_tasks[i];
+
+        snprintf(line, sizeof(line), "%-16.16s %3d.%d%% %7dK/%dK", task->stats.name,
+                 task->cpu_permille / 10, task->cpu_permille % 10,
+                 (task->stats.stack_peak + 1023) / 1024, task->stats.stack_size / 1024);
+
+        // Heavy users stand out
+        uint32_t color = task->cpu_permille >= 500 ? 0xFF4040FF : 0xFFFFFFFF;
+        framebuffer_put_text(framebuffer, color, 0x000000FF, position, font, line);
+        position.y += font->character_size.y;
+    }
+
+    task_monitor_unlock();
+}
@@ -0,0 +1,106 @@
+/**
+ * @file task_monitor.h
+ * @brief Task Monitor
+ *
+ * Samples system_get_task_stats on a period and works out how much
+ * of the CPU each task used since the last sample.
+ *
+ * Each sample can be logged, one line per task in a fixed
+ * key=value format so it can be picked out of the output by tools:
+ *
+ * [INFO] (TASKS) sample=3 period_us=1000012 tasks=7
+ * [INFO] (TASKS) id=1 name="MAIN" prio=5 state=B cpu=12.5 stack_peak=2304 stack_size=4194304
+ *
+ * cpu is a percent of the period. The sample line comes first,
+ * followed by one line for each task.
+ *
+ * It can also draw the latest sample over a framebuffer as an overlay.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/graphics/framebuffer.h"
+
+// Most tasks kept track of, any more are left out
+#define TASK_MONITOR_MAX_TASKS 32
+
+/**
+ * @struct task_monitor_task_t
+ * @brief One task in a sample.
+ */
+typedef struct {
+    system_task_stats_t stats;
+    uint32_t cpu_permille; // Share of the CPU since the last sample, in tenths of a percent
+} task_monitor_task_t;
+
+/**
+ * @brief Starts sampling.
+ *
+ * Creates the monitor task, it runs at a high priority so a task
+ * hogging the CPU cannot keep it from reporting.
+ *
+ * @param period_ms Milliseconds between samples
+ * @param log Log every sample
+ * @return Negative if error
+ */
+extern int task_monitor_start(uint32_t period_ms, bool log);
+
+/**
+ * @brief Stops sampling.
+ *
+ * The last sample stays available.
+ */
+extern void task_monitor_stop();
+
+/**
+ * @brief Draws every sample over a framebuffer.
+ *
+ * Text is drawn straight into the framebuffer from the monitor task,
+ * the same way the console does.
+ *
+ * @param framebuffer Framebuffer to draw onto, NULL to stop drawing
+ * @param font Font to draw with
+ * @param position Pixel position of the top left corner
+ */
+extern void task_monitor_set_overlay(framebuffer_t* framebuffer, const framebuffer_font_t* font, vec2i position);
+
+/**
+ * @brief Takes a sample now.
+ *
+ * Can be used without starting the monitor task, the CPU
+ * share is then since the last time this was called.
+ *
+ * @return Negative if error
+ */
+extern int task_monitor_sample();
+
+/**
+ * @brief Gets the latest sample.
+ *
+ * @param tasks Outputted tasks
+ * @param max_count Size of tasks
+ * @return Number of tasks in tasks
+ */
+extern int task_monitor_get(task_monitor_task_t* tasks, int max_count);
+
+/**
+ * @brief Logs the latest sample.
+ */
+extern void task_monitor_log();
+
+/**
+ * @brief Draws the latest sample onto a framebuffer.
+ *
+ * @param framebuffer Framebuffer to draw onto
+ * @param font Font to draw with
+ * @param position Pixel position of the top left corner
+ */
+extern void task_monitor_draw(framebuffer_t* framebuffer, const framebuffer_font_t* font, vec2i position);
@@ -0,0 +1,436 @@
+/**
+ * @file tlsf.c
+ * @brief Two Level Segregated Fit Allocator
+ *
+ * Constant time allocator over a single region of memory.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "tlsf.h"
+
+#include <string.h>
+
+#define TLSF_BLOCK_FREE 1
+
+// Smallest data a block can have, enough to hold the free list links
+#define TLSF_BLOCK_SIZE_MIN (2 * sizeof(tlsf_block_t*))
+
+// Sizes below this map straight to first level 0
+#define TLSF_SMALL_BLOCK_SIZE (1 << TLSF_FL_SHIFT)
+
+#define TLSF_BLOCK_SIZE_MAX ((uint32_t)1 << TLSF_FL_MAX)
+
+// Index of the highest set bit. cntlzw on the PowerPC, so constant time.
+static inline int tlsf_fls(uint32_t value) {
+    return value ? 31 - __builtin_clz(value) : -1;
+}
+
+// Index of the lowest set bit.
+static inline int tlsf_ffs(uint32_t value) {
+    return tlsf_fls(value & -value);
+}
+
+static inline uintptr_t tlsf_align_up(uintptr_t value, uintptr_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static inline uint32_t tlsf_block_size(const tlsf_block_t* block) {
+    return block->size & ~(TLSF_ALIGN - 1);
+}
+
+static inline bool tlsf_block_is_free(const tlsf_block_t* block) {
+    return (block->size & TLSF_BLOCK_FREE) != 0;
+}
+
+static inline void* tlsf_block_data(const tlsf_block_t* block) {
+    return (uint8_t*)block + TLSF_OVERHEAD;
+}
+
+static inline tlsf_block_t* tlsf_data_block(const void* ptr) {
+    return (tlsf_block_t*)((uint8_t*)ptr - TLSF_OVERHEAD);
+}
+
+static inline tlsf_block_t* tlsf_block_next(const tlsf_block_t* block) {
+    return (tlsf_block_t*)((uint8_t*)tlsf_block_data(block) + tlsf_block_size(block));
+}
+
+// Which list a block of this size belongs in
+static void tlsf_mapping_insert(uint32_t size, int* fl, int* sl) {
+    if(size < TLSF_SMALL_BLOCK_SIZE) {
+        *fl = 0;
+        *sl = size / (TLSF_SMALL_BLOCK_SIZE / TLSF_SL_COUNT);
+    } else {
+        int bit = tlsf_fls(size);
+        *sl = (size >> (bit - TLSF_SL_LOG2)) ^ (1 << TLSF_SL_LOG2);
+        *fl = bit - (TLSF_FL_SHIFT - 1);
+    }
+}
+
+// First list where every block is at least this big
+static void tlsf_mapping_search(uint32_t size, int* fl, int* sl) {
+    if(size >= TLSF_SMALL_BLOCK_SIZE)
+        size += (1 << (tlsf_fls(size) - TLSF_SL_LOG2)) - 1;
+
+    tlsf_mapping_insert(size, fl, sl);
+}
+
+static void tlsf_insert_free(tlsf_t* tlsf, tlsf_block_t* block) {
+    int fl, sl;
+    tlsf_mapping_insert(tlsf_block_size(block), &fl, &sl);
+
+    tlsf_block_t* head = tlsf->blocks[fl][sl];
+    block->next_free = head;
+    block->prev_free = NULL;
+    if(head)
+        head->prev_free = block;
+
+    tlsf->blocks[fl][sl] = block;
+    tlsf->fl_bitmap |= 1u << fl;
+    tlsf->sl_bitmap[fl] |= 1u << sl;
+
+    block->size |= TLSF_BLOCK_FREE;
+    tlsf->stats.free_blocks++;
+    tlsf->stats.free += tlsf_block_size(block) + TLSF_OVERHEAD;
+}
+
+static void tlsf_remove_free(tlsf_t* tlsf, tlsf_block_t* block) {
+    int fl, sl;
+    tlsf_mapping_insert(tlsf_block_size(block), &fl, &sl);
+
+    if(block->next_free)
+        block->next_free->prev_free = block->prev_free;
+
+    if(block->prev_free) {
+        block->prev_free->next_free = block->next_free;
+    } else {
+        tlsf->blocks[fl][sl] = block->next_free;
+
+        if(block->next_free == NULL) {
+            tlsf->sl_bitmap[fl] &= ~(1u << sl);
+            if(tlsf->sl_bitmap[fl] == 0)
+                tlsf->fl_bitmap &= ~(1u << fl);
+        }
+    }
+
+    block->size &= ~TLSF_BLOCK_FREE;
+    tlsf->stats.free_blocks--;
+    tlsf->stats.free -= tlsf_block_size(block) + TLSF_OVERHEAD;
+}
+
+// Takes a free block at least size bytes out of the lists
+static tlsf_block_t* tlsf_take_free(tlsf_t* tlsf, uint32_t size) {
+    int fl, sl;
+    tlsf_mapping_search(size, &fl, &sl);
+
+    // Anything left in this first level
+    uint32_t sl_map = fl < TLSF_FL_COUNT ? tlsf->sl_bitmap[fl] & (~0u << sl) : 0;
+    if(sl_map == 0) {
+        // Otherwise the next bigger first level
+        uint32_t fl_map = fl + 1 < TLSF_FL_COUNT ? tlsf->fl_bitmap & (~0u << (fl + 1)) : 0;
+        if(fl_map == 0) {
+            // Searching rounds up, so the list this size falls in is skipped.
+            // Its first block may still fit, which matters most when nearly full.
+            tlsf_mapping_insert(size, &fl, &sl);
+
+            tlsf_block_t* block = tlsf->blocks[fl][sl];
+            if(block == NULL || tlsf_block_size(block) < size)
+                return NULL;
+
+            tlsf_remove_free(tlsf, block);
+            return block;
+        }
+
+        fl = tlsf_ffs(fl_map);
+        sl_map = tlsf->sl_bitmap[fl];
+    }
+
+    sl = tlsf_ffs(sl_map);
+
+    tlsf_block_t* block = tlsf->blocks[fl][sl];
+    tlsf_remove_free(tlsf, block);
+    return block;
+}
+
+// Cuts block down to size bytes, returning what was left past it.
+static tlsf_block_t* tlsf_split(tlsf_block_t* block, uint32_t size) {
+    tlsf_block_t* rest = (tlsf_block_t*)((uint8_t*)tlsf_block_data(block) + size);
+    rest->prev_phys = block;
+    rest->size = tlsf_block_size(block) - size - TLSF_OVERHEAD;
+
+    block->size = size | (block->size & TLSF_BLOCK_FREE);
+    tlsf_block_next(rest)->prev_phys = rest;
+    return rest;
+}
+
+// Folds next into block, they must be next to each other and next out of the lists.
+static void tlsf_merge(tlsf_block_t* block, tlsf_block_t* next) {
+    block->size += tlsf_block_size(next) + TLSF_OVERHEAD;
+    tlsf_block_next(block)->prev_phys = block;
+}
+
+// Gives back anything past size in a used block
+static void tlsf_trim(tlsf_t* tlsf, tlsf_block_t* block, uint32_t size) {
+    if(tlsf_block_size(block) < size + TLSF_OVERHEAD + TLSF_BLOCK_SIZE_MIN)
+        return;
+
+    tlsf_block_t* rest = tlsf_split(block, size);
+
+    tlsf_block_t* next = tlsf_block_next(rest);
+    if(tlsf_block_is_free(next)) {
+        tlsf_remove_free(tlsf, next);
+        tlsf_merge(rest, next);
+    }
+
+    tlsf_insert_free(tlsf, rest);
+}
+
+static void tlsf_mark_used(tlsf_t* tlsf, tlsf_block_t* block) {
+    tlsf->stats.used += tlsf_block_size(block) + TLSF_OVERHEAD;
+    if(tlsf->stats.used > tlsf->stats.peak_used)
+        tlsf->stats.peak_used = tlsf->stats.used;
+}
+
+static void tlsf_mark_unused(tlsf_t* tlsf, tlsf_block_t* block) {
+    tlsf->stats.used -= tlsf_block_size(block) + TLSF_OVERHEAD;
+}
+
+// Block size for a request, 0 if it can never fit
+static uint32_t tlsf_adjust_size(size_t size) {
+    if(size >= TLSF_BLOCK_SIZE_MAX)
+        return 0;
+
+    uint32_t adjusted = tlsf_align_up((uint32_t)size, TLSF_ALIGN);
+    return adjusted < TLSF_BLOCK_SIZE_MIN ? TLSF_BLOCK_SIZE_MIN : adjusted;
+}
+
+int tlsf_initialize(tlsf_t* tlsf, void* memory, size_t size) {
+    memset(tlsf, 0, sizeof(*tlsf));
+
+    uintptr_t start = tlsf_align_up((uintptr_t)memory, TLSF_ALIGN);
+    uintptr_t end = ((uintptr_t)memory + size) & ~(uintptr_t)(TLSF_ALIGN - 1);
+
+    // One block and the header of the end marker
+    if(end <= start || end - start < 2 * TLSF_OVERHEAD + TLSF_BLOCK_SIZE_MIN)
+        return -1;
+
+    uint32_t block_size = end - start - 2 * TLSF_OVERHEAD;
+    if(block_size >= TLSF_BLOCK_SIZE_MAX)
+        block_size = TLSF_BLOCK_SIZE_MAX - TLSF_ALIGN;
+
+    tlsf_block_t* block = (tlsf_block_t*)start;
+    block->prev_phys = NULL;
+    block->size = block_size;
+
+    // Zero size and never free, so nothing merges past the end
+    tlsf_block_t* last = tlsf_block_next(block);
+    last->prev_phys = block;
+    last->size = 0;
+
+    tlsf->start = (uint8_t*)start;
+    tlsf->end = (uint8_t*)last;
+    tlsf->stats.size = block_size + TLSF_OVERHEAD;
+
+    tlsf_insert_free(tlsf, block);
+    return 0;
+}
+
+void* tlsf_malloc(tlsf_t* tlsf, size_t size) {
+    uint32_t adjusted = tlsf_adjust_size(size);
+
+    tlsf_block_t* block = adjusted ? tlsf_take_free(tlsf, adjusted) : NULL;
+    if(block == NULL) {
+        tlsf->stats.failures++;
+        return NULL;
+    }
+
+    tlsf_trim(tlsf, block, adjusted);
+
+    tlsf_mark_used(tlsf, block);
+    tlsf->stats.allocations++;
+    return tlsf_block_data(block);
+}
+
+void* tlsf_memalign(tlsf_t* tlsf, size_t alignment, size_t size) {
+    if(alignment & (alignment - 1))
+        return NULL;
+
+    if(alignment <= TLSF_ALIGN)
+        return tlsf_malloc(tlsf, size);
+
+    // Anything cut off the front has to be able to stand as a free block
+    const uint32_t gap_min = TLSF_OVERHEAD + TLSF_BLOCK_SIZE_MIN;
+
+    uint32_t adjusted = tlsf_adjust_size(size);
+    uint32_t padded = adjusted + alignment + gap_min;
+
+    tlsf_block_t* block = (adjusted && padded > adjusted) ? tlsf_take_free(tlsf, tlsf_adjust_size(padded)) : NULL;
+    if(block == NULL) {
+        tlsf->stats.failures++;
+        return NULL;
+    }
+
+    uintptr_t data = (uintptr_t)tlsf_block_data(block);
+    uintptr_t aligned = tlsf_align_up(data, alignment);
+    if(aligned != data && aligned - data < gap_min)
+        aligned = tlsf_align_up(data + gap_min, alignment);
+
+    if(aligned != data) {
+        tlsf_block_t* front = block;
+        block = tlsf_split(front, aligned - data - TLSF_OVERHEAD);
+
+        // The block before was in use, or it would have been merged with this one
+        tlsf_insert_free(tlsf, front);
+    }
+
+    tlsf_trim(tlsf, block, adjusted);
+
+    tlsf_mark_used(tlsf, block);
+    tlsf->stats.allocations++;
+    return tlsf_block_data(block);
+}
+
+bool tlsf_resize(tlsf_t* tlsf, void* ptr, size_t size) {
+    uint32_t adjusted = tlsf_adjust_size(size);
+    if(adjusted == 0)
+        return false;
+
+    tlsf_block_t* block = tlsf_data_block(ptr);
+    uint32_t current = tlsf_block_size(block);
+    tlsf_block_t* next = tlsf_block_next(block);
+
+    // Shrink, or grow into a free neighbor
+    if(adjusted > current &&
+       !(tlsf_block_is_free(next) && current + TLSF_OVERHEAD + tlsf_block_size(next) >= adjusted))
+        return false;
+
+    tlsf_mark_unused(tlsf, block);
+
+    if(adjusted > current) {
+        tlsf_remove_free(tlsf, next);
+        tlsf_merge(block, next);
+    }
+
+    tlsf_trim(tlsf, block, adjusted);
+    tlsf_mark_used(tlsf, block);
+    return true;
+}
+
+void* tlsf_realloc(tlsf_t* tlsf, void* ptr, size_t size) {
+    if(ptr == NULL)
+        return tlsf_malloc(tlsf, size);
+
+    if(size == 0) {
+        tlsf_free(tlsf, ptr);
+        return NULL;
+    }
+
+    if(tlsf_resize(tlsf, ptr, size))
+        return ptr;
+
+    void* moved = tlsf_malloc(tlsf, size);
+    if(moved == NULL)
+        return NULL;
+
+    memcpy(moved, ptr, tlsf_usable_size(ptr));
+    tlsf_free(tlsf, ptr);
+    return moved;
+}
+
+void tlsf_free(tlsf_t* tlsf, void* ptr) {
+    if(ptr == NULL)
+        return;
+
+    tlsf_block_t* block = tlsf_data_block(ptr);
+    tlsf_mark_unused(tlsf, block);
+    tlsf->stats.frees++;
+
+    tlsf_block_t* prev = block->prev_phys;
+    if(prev && tlsf_block_is_free(prev)) {
+        tlsf_remove_free(tlsf, prev);
+        tlsf_merge(prev, block);
+        block = prev;
+    }
+
+    tlsf_block_t* next = tlsf_block_next(block);
+    if(tlsf_block_is_free(next)) {
+        tlsf_remove_free(tlsf, next);
+        tlsf_merge(block, next);
+    }
+
+    tlsf_insert_free(tlsf, block);
+}
+
+size_t tlsf_usable_size(const void* ptr) {
+    return ptr ? tlsf_block_size(tlsf_data_block(ptr)) : 0;
+}
+
+bool tlsf_contains(const tlsf_t* tlsf, const void* ptr) {
+    return (const uint8_t*)ptr >= tlsf->start && (const uint8_t*)ptr < tlsf->end;
+}
+
+void tlsf_get_stats(const tlsf_t* tlsf, tlsf_stats_t* stats) {
+    *stats = tlsf->stats;
+    stats->largest_free = 0;
+
+    if(tlsf->fl_bitmap == 0)
+        return;
+
+    // Only the highest non empty list can hold the largest block
+    int fl = tlsf_fls(tlsf->fl_bitmap);
+    int sl = tlsf_fls(tlsf->sl_bitmap[fl]);
+
+    for(const tlsf_block_t* block = tlsf->blocks[fl][sl]; block; block = block->next_free) {
+        if(tlsf_block_size(block) > stats->largest_free)
+            stats->largest_free = tlsf_block_size(block);
+    }
+}
+
+int tlsf_check(const tlsf_t* tlsf) {
+    uint32_t free_blocks = 0;
+    uint32_t free_bytes = 0;
+    uint32_t total = 0;
+
+    const tlsf_block_t* prev = NULL;
+    const tlsf_block_t* block = (const tlsf_block_t*)tlsf->start;
+
+    while((const uint8_t*)block < tlsf->end) {
+        if(block->prev_phys != prev || tlsf_block_size(block) < TLSF_BLOCK_SIZE_MIN)
+            return -1;
+
+        if(tlsf_block_is_free(block)) {
+            // Neighbors are always merged
+            if(prev && tlsf_block_is_free(prev))
+                return -1;
+
+            int fl, sl;
+            tlsf_mapping_insert(tlsf_block_size(block), &fl, &sl);
+            if(!(tlsf->sl_bitmap[fl] & (1u << sl)) || !(tlsf->fl_bitmap & (1u << fl)))
+                return -1;
+
+            const tlsf_block_t* entry = tlsf->blocks[fl][sl];
+            while(entry && entry != block)
+                entry = entry->next_free;
+            if(entry == NULL)
+                return -1;
+
+            free_blocks++;
+            free_bytes += tlsf_block_size(block) + TLSF_OVERHEAD;
+        }
+
+        total += tlsf_block_size(block) + TLSF_OVERHEAD;
+        prev = block;
+        block = tlsf_block_next(block);
+    }
+
+    if((const uint8_t*)block != tlsf->end || block->prev_phys != prev || block->size != 0)
+        return -1;
+
+    if(free_blocks != tlsf->stats.free_blocks || free_bytes != tlsf->stats.free ||
+       total != tlsf->stats.size || total != free_bytes + tlsf->stats.used)
+        return -1;
+
+    return 0;
+}
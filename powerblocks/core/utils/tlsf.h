@@ -0,0 +1,185 @@
+/**
+ * @file tlsf.h
+ * @brief Two Level Segregated Fit Allocator
+ *
+ * Constant time allocator over a single region of memory.
+ *
+ * Free blocks are kept in lists by size. The first level splits sizes
+ * by power of two, the second splits each of those into TLSF_SL_COUNT
+ * linear steps. A bitmap for each level says which lists have blocks,
+ * so finding a block big enough is a couple of count leading zeros,
+ * not a walk. Freed blocks are merged with free neighbors right away.
+ *
+ * There is no locking and nothing system specific here, so it can be
+ * built and tested on its own. See mem.h for the system heaps.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Every block and every pointer returned is aligned to this
+#define TLSF_ALIGN_LOG2 3
+#define TLSF_ALIGN      (1 << TLSF_ALIGN_LOG2)
+
+// Second level lists for every power of two
+#define TLSF_SL_LOG2  5
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+
+// Blocks must be smaller than 1 << TLSF_FL_MAX, 128 MB
+#define TLSF_FL_MAX   27
+
+// Sizes below this all go in the first level 0, split linearly
+#define TLSF_FL_SHIFT (TLSF_SL_LOG2 + TLSF_ALIGN_LOG2)
+#define TLSF_FL_COUNT (TLSF_FL_MAX - TLSF_FL_SHIFT + 1)
+
+
+/**
+ * @struct tlsf_block_t
+ * @brief Header in front of every block.
+ */
+typedef struct tlsf_block {
+    struct tlsf_block* prev_phys; // Block right before this one in memory, NULL for the first
+    uint32_t size;                // Bytes after the header, low bit set while free
+
+    // Only while free, these are in the data
+    struct tlsf_block* next_free;
+    struct tlsf_block* prev_free;
+} tlsf_block_t;
+
+// Bytes of header in front of every block, 8 on the PowerPC
+#define TLSF_OVERHEAD offsetof(tlsf_block_t, next_free)
+
+/**
+ * @struct tlsf_stats_t
+ * @brief Heap counters.
+ *
+ * Sizes include block headers.
+ */
+typedef struct {
+    uint32_t size;          // Bytes the heap manages
+    uint32_t used;          // Bytes in allocated blocks
+    uint32_t peak_used;     // Most used has been, the high water mark
+    uint32_t free;          // Bytes in free blocks
+    uint32_t largest_free;  // Biggest single allocation that would succeed right now
+    uint32_t free_blocks;   // Free blocks, more for the same free bytes means more fragmented
+
+    uint32_t allocations;
+    uint32_t frees;
+    uint32_t failures;      // Allocations that found no block big enough
+} tlsf_stats_t;
+
+/**
+ * @struct tlsf_t
+ * @brief A heap.
+ */
+typedef struct {
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[TLSF_FL_COUNT];
+    tlsf_block_t* blocks[TLSF_FL_COUNT][TLSF_SL_COUNT];
+
+    uint8_t* start;
+    uint8_t* end;
+
+    tlsf_stats_t stats;
+} tlsf_t;
+
+/**
+ * @brief Creates a heap over a region of memory.
+ *
+ * @param tlsf Heap to create
+ * @param memory Start of the region
+ * @param size Bytes in the region
+ * @return Negative if error
+ */
+extern int tlsf_initialize(tlsf_t* tlsf, void* memory, size_t size);
+
+/**
+ * @brief Allocates memory.
+ *
+ * @param tlsf Heap
+ * @param size Bytes to allocate
+ * @return Memory aligned to TLSF_ALIGN, NULL if error
+ */
+extern void* tlsf_malloc(tlsf_t* tlsf, size_t size);
+
+/**
+ * @brief Allocates aligned memory.
+ *
+ * @param tlsf Heap
+ * @param alignment Power of 2
+ * @param size Bytes to allocate
+ * @return Memory, NULL if error
+ */
+extern void* tlsf_memalign(tlsf_t* tlsf, size_t alignment, size_t size);
+
+/**
+ * @brief Resizes an allocation without moving it.
+ *
+ * @param tlsf Heap
+ * @param ptr Allocation to resize
+ * @param size New size in bytes
+ * @return False if it would have to move, nothing is changed then.
+ */
+extern bool tlsf_resize(tlsf_t* tlsf, void* ptr, size_t size);
+
+/**
+ * @brief Resizes an allocation.
+ *
+ * Grows in place when the next block is free, otherwise moves it.
+ *
+ * @param tlsf Heap
+ * @param ptr Allocation to resize, may be NULL
+ * @param size New size in bytes
+ * @return Resized allocation, NULL if error, ptr stays valid then.
+ */
+extern void* tlsf_realloc(tlsf_t* tlsf, void* ptr, size_t size);
+
+/**
+ * @brief Frees memory.
+ *
+ * @param tlsf Heap it came from
+ * @param ptr Allocation, may be NULL
+ */
+extern void tlsf_free(tlsf_t* tlsf, void* ptr);
+
+/**
+ * @brief Bytes usable in an allocation.
+ *
+ * @param ptr Allocation
+ */
+extern size_t tlsf_usable_size(const void* ptr);
+
+/**
+ * @brief Checks if memory is part of the heap.
+ *
+ * @param tlsf Heap
+ * @param ptr Address
+ */
+extern bool tlsf_contains(const tlsf_t* tlsf, const void* ptr);
+
+/**
+ * @brief Reads back the heap counters.
+ *
+ * Finding the largest free block walks one free list.
+ *
+ * @param tlsf Heap
+ * @param stats Outputted stats
+ */
+extern void tlsf_get_stats(const tlsf_t* tlsf, tlsf_stats_t* stats);
+
+/**
+ * @brief Walks the whole heap checking it is consistent.
+ *
+ * For debugging and testing, takes time linear in the number of blocks.
+ *
+ * @param tlsf Heap
+ * @return Negative if damaged
+ */
+extern int tlsf_check(const tlsf_t* tlsf);
@@ -0,0 +1,495 @@
+/**
+ * @file archive.c
+ * @brief Packed Asset Archive
+ *
+ * Reads .pba archives made by tools/archive.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "archive.h"
+
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/system/mem.h"
+#include "powerblocks/core/utils/log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char* TAG = "ARCHIVE";
+
+#define ARCHIVE_VERSION 1
+
+// Top bit of a block word, the block was left uncompressed
+#define ARCHIVE_BLOCK_STORED 0x80000000
+
+#define ARCHIVE_LINK_MAP_INITIAL_ENTRIES 16
+
+#define ARCHIVE_MIN(a, b) ((a) < (b) ? (a) : (b))
+
+// Archives are big endian, same as the Wii, so these only change anything off of it.
+static uint32_t archive_be32(const void* data) {
+    const uint8_t* p = (const uint8_t*)data;
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint16_t archive_be16(const void* data) {
+    const uint8_t* p = (const uint8_t*)data;
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static void archive_decode_header(archive_header_t* header) {
+    header->version = archive_be16(&header->version);
+    header->flags = archive_be16(&header->flags);
+    header->entry_count = archive_be32(&header->entry_count);
+    header->block_size = archive_be32(&header->block_size);
+    header->names_offset = archive_be32(&header->names_offset);
+    header->names_size = archive_be32(&header->names_size);
+    header->data_offset = archive_be32(&header->data_offset);
+}
+
+static void archive_decode_entry(archive_entry_t* entry) {
+    entry->hash = archive_be32(&entry->hash);
+    entry->name_offset = archive_be32(&entry->name_offset);
+    entry->name_length = archive_be16(&entry->name_length);
+    entry->flags = archive_be16(&entry->flags);
+    entry->offset = archive_be32(&entry->offset);
+    entry->stored_size = archive_be32(&entry->stored_size);
+    entry->size = archive_be32(&entry->size);
+}
+
+// Reads an LZ4 extended length, the bytes after a nibble of 15
+static int archive_lz4_length(const uint8_t** ip, const uint8_t* iend, uint32_t* length) {
+    uint8_t value;
+    do {
+        if(*ip >= iend)
+            return -1;
+        value = *(*ip)++;
+        *length += value;
+    } while(value == 255);
+    return 0;
+}
+
+// Decodes one LZ4 block. Bounds checked, a bad archive can not write past dst.
+static int archive_lz4_decode(const uint8_t* src, uint32_t src_size, uint8_t* dst, uint32_t dst_size) {
+    const uint8_t* ip = src;
+    const uint8_t* iend = src + src_size;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + dst_size;
+
+    while(ip < iend) {
+        uint8_t token = *ip++;
+
+        uint32_t length = token >> 4;
+        if(length == 15 && archive_lz4_length(&ip, iend, &length) < 0)
+            return -1;
+
+        if(length > (uint32_t)(iend - ip) || length > (uint32_t)(oend - op))
+            return -1;
+
+        memcpy(op, ip, length);
+        op += length;
+        ip += length;
+
+        // The last sequence has no match
+        if(ip == iend)
+            break;
+
+        if(iend - ip < 2)
+            return -1;
+
+        uint32_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+
+        if(offset == 0 || offset > (uint32_t)(op - dst))
+            return -1;
+
+        length = token & 15;
+        if(length == 15 && archive_lz4_length(&ip, iend, &length) < 0)
+            return -1;
+        length += 4;
+
+        if(length > (uint32_t)(oend - op))
+            return -1;
+
+        const uint8_t* match = op - offset;
+        if(offset >= length) {
+            memcpy(op, match, length);
+            op += length;
+        } else {
+            // Overlapping, repeats the last offset bytes
+            while(length--)
+                *op++ = *match++;
+        }
+    }
+
+    return (int)(op - dst);
+}
+
+// Gives the archive a cluster map, entries are read in any order
+static void archive_create_link_map(archive_t* archive) {
+    UINT size = ARCHIVE_LINK_MAP_INITIAL_ENTRIES * sizeof(DWORD);
+
+    while(size <= ARCHIVE_FASTSEEK_MAX_MAP_SIZE) {
+        DWORD* map = (DWORD*)realloc(archive->link_map, size);
+        if(map == NULL)
+            break;
+
+        archive->link_map = map;
+        map[0] = size / sizeof(DWORD);
+        archive->file.cltbl = map;
+
+        FRESULT res = f_lseek(&archive->file, CREATE_LINKMAP);
+        if(res == FR_OK)
+            return;
+
+        // Too small, map[0] now holds how many entries are needed
+        if(res != FR_NOT_ENOUGH_CORE)
+            break;
+
+        size = map[0] * sizeof(DWORD);
+    }
+
+    // Fall back to normal seeking
+    free(archive->link_map);
+    archive->link_map = NULL;
+    archive->file.cltbl = NULL;
+}
+
+static int archive_read_at(archive_t* archive, FSIZE_t offset, void* buffer, UINT size) {
+    FRESULT res = f_lseek(&archive->file, offset);
+
+    UINT read = 0;
+    if(res == FR_OK)
+        res = f_read(&archive->file, buffer, size, &read);
+
+    if(res != FR_OK || read != size) {
+        LOG_ERROR(TAG, "Read of %u bytes at %u failed: %d", size, (uint32_t)offset, res);
+        return -1;
+    }
+
+    return 0;
+}
+
+static bool archive_check_entry(archive_t* archive, const archive_entry_t* entry) {
+    if(entry->name_offset >= archive->header.names_size ||
+       entry->name_length >= archive->header.names_size - entry->name_offset)
+        return false;
+
+    if(archive->names[entry->name_offset + entry->name_length] != '\0')
+        return false;
+
+    if(entry->offset & 31 || entry->offset > f_size(&archive->file) ||
+       entry->stored_size > f_size(&archive->file) - entry->offset)
+        return false;
+
+    // Only the blocks grow when compressed, not the data
+    if(!(entry->flags & ARCHIVE_ENTRY_LZ4) && entry->stored_size != entry->size)
+        return false;
+
+    return true;
+}
+
+int archive_mount(archive_t* archive, const char* path) {
+    memset(archive, 0, sizeof(*archive));
+
+    FRESULT res = f_open(&archive->file, path, FA_READ);
+    if(res != FR_OK) {
+        LOG_ERROR(TAG, "Failed to open %s: %d", path, res);
+        return -1;
+    }
+
+    archive_header_t* header = &archive->header;
+    if(archive_read_at(archive, 0, header, sizeof(*header)) < 0)
+        goto fail;
+    archive_decode_header(header);
+
+    if(memcmp(header->magic, "PBAR", 4) != 0 || header->version != ARCHIVE_VERSION) {
+        LOG_ERROR(TAG, "%s is not a version %d archive", path, ARCHIVE_VERSION);
+        goto fail;
+    }
+
+    if(header->block_size == 0 || header->block_size > ARCHIVE_MAX_BLOCK_SIZE || header->block_size & 31) {
+        LOG_ERROR(TAG, "%s has an unsupported block size %u", path, header->block_size);
+        goto fail;
+    }
+
+    uint32_t index_size = header->entry_count * sizeof(archive_entry_t);
+    if(header->entry_count > f_size(&archive->file) / sizeof(archive_entry_t) ||
+       header->names_offset != sizeof(archive_header_t) + index_size ||
+       header->names_size > f_size(&archive->file) - header->names_offset) {
+        LOG_ERROR(TAG, "%s has a damaged index", path);
+        goto fail;
+    }
+
+    archive->entries = (archive_entry_t*)malloc(index_size ? index_size : 1);
+    archive->names = (char*)malloc(header->names_size ? header->names_size : 1);
+    if(archive->entries == NULL || archive->names == NULL)
+        goto fail;
+
+    // Index and names are back to back
+    if(archive_read_at(archive, sizeof(archive_header_t), archive->entries, index_size) < 0)
+        goto fail;
+    if(archive_read_at(archive, header->names_offset, archive->names, header->names_size) < 0)
+        goto fail;
+
+    for(uint32_t i = 0; i < header->entry_count; i++) {
+        archive_decode_entry(&archive->entries[i]);
+        if(!archive_check_entry(archive, &archive->entries[i])) {
+            LOG_ERROR(TAG, "%s has a damaged entry %u", path, i);
+            goto fail;
+        }
+    }
+
+    archive_create_link_map(archive);
+    archive->lock = xSemaphoreCreateMutexStatic(&archive->lock_data);
+
+    return 0;
+
+fail:
+    free(archive->entries);
+    free(archive->names);
+    f_close(&archive->file);
+    archive->entries = NULL;
+    archive->names = NULL;
+    return -1;
+}
+
+void archive_unmount(archive_t* archive) {
+    f_close(&archive->file);
+
+    free(archive->link_map);
+    free(archive->entries);
+    free(archive->names);
+
+    archive->link_map = NULL;
+    archive->entries = NULL;
+    archive->names = NULL;
+    archive->header.entry_count = 0;
+}
+
+uint32_t archive_hash(const char* name) {
+    uint32_t hash = 0x811C9DC5;
+    while(*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+uint32_t archive_count(archive_t* archive) {
+    return archive->header.entry_count;
+}
+
+int archive_find(archive_t* archive, const char* name) {
+    uint32_t hash = archive_hash(name);
+
+    // First entry with the hash
+    uint32_t low = 0;
+    uint32_t high = archive->header.entry_count;
+    while(low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if(archive->entries[middle].hash < hash)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    // Collisions sit next to each other
+    for(; low < archive->header.entry_count && archive->entries[low].hash == hash; low++) {
+        if(strcmp(archive->names + archive->entries[low].name_offset, name) == 0)
+            return (int)low;
+    }
+
+    return -1;
+}
+
+int archive_get_info(archive_t* archive, uint32_t index, archive_info_t* info) {
+    if(index >= archive->header.entry_count)
+        return -1;
+
+    const archive_entry_t* entry = &archive->entries[index];
+    info->name = archive->names + entry->name_offset;
+    info->size = entry->size;
+    info->stored_size = entry->stored_size;
+    info->compressed = (entry->flags & ARCHIVE_ENTRY_LZ4) != 0;
+    return 0;
+}
+
+int archive_open(archive_t* archive, archive_file_t* file, const char* name) {
+    memset(file, 0, sizeof(*file));
+
+    int index = archive_find(archive, name);
+    if(index < 0)
+        return -1;
+
+    file->archive = archive;
+    file->entry = &archive->entries[index];
+
+    if(file->entry->flags & ARCHIVE_ENTRY_LZ4) {
+        // The packer only keeps blocks that got smaller
+        file->input = (uint8_t*)mem1_aligned_alloc(archive->header.block_size, 32);
+        if(file->input == NULL)
+            return -1;
+    }
+
+    return 0;
+}
+
+// Reads the next stored block of a compressed entry into dst, which takes size bytes.
+static int archive_next_block(archive_file_t* file, uint8_t* dst, uint32_t size) {
+    archive_t* archive = file->archive;
+    const archive_entry_t* entry = file->entry;
+
+    if(entry->stored_size - file->source < sizeof(uint32_t))
+        return -1;
+
+    xSemaphoreTake(archive->lock, portMAX_DELAY);
+
+    uint8_t word_data[sizeof(uint32_t)];
+    if(archive_read_at(archive, entry->offset + file->source, word_data, sizeof(word_data)) < 0) {
+        xSemaphoreGive(archive->lock);
+        return -1;
+    }
+
+    uint32_t word = archive_be32(word_data);
+
+    bool stored = (word & ARCHIVE_BLOCK_STORED) != 0;
+    uint32_t length = word & ~ARCHIVE_BLOCK_STORED;
+
+    if(length > entry->stored_size - file->source - sizeof(uint32_t) ||
+       length > archive->header.block_size || (stored && length != size)) {
+        xSemaphoreGive(archive->lock);
+        LOG_ERROR(TAG, "Damaged block in %s", archive->names + entry->name_offset);
+        return -1;
+    }
+
+    // Still sequential, no seek needed
+    UINT read = 0;
+    FRESULT res = f_read(&archive->file, stored ? dst : file->input, length, &read);
+
+    xSemaphoreGive(archive->lock);
+
+    if(res != FR_OK || read != length)
+        return -1;
+
+    file->source += sizeof(uint32_t) + length;
+
+    if(stored)
+        return 0;
+
+    // Decompress outside the lock so other readers can use the card meanwhile
+    if(archive_lz4_decode(file->input, length, dst, size) != (int)size) {
+        LOG_ERROR(TAG, "Damaged block in %s", archive->names + entry->name_offset);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int archive_read_compressed(archive_file_t* file, uint8_t* buffer, uint32_t size) {
+    uint32_t block_size = file->archive->header.block_size;
+    uint32_t done = 0;
+
+    while(done < size) {
+        // Hand out what is left of the last block first
+        if(file->block_position < file->block_fill) {
+            uint32_t count = ARCHIVE_MIN(size - done, file->block_fill - file->block_position);
+            memcpy(buffer + done, file->block + file->block_position, count);
+
+            file->block_position += count;
+            file->position += count;
+            done += count;
+            continue;
+        }
+
+        uint32_t expect = ARCHIVE_MIN(block_size, file->entry->size - file->position);
+
+        // Whole blocks go straight to the caller
+        if(size - done >= expect) {
+            if(archive_next_block(file, buffer + done, expect) < 0)
+                return -1;
+
+            file->position += expect;
+            done += expect;
+            continue;
+        }
+
+        if(file->block == NULL) {
+            file->block = (uint8_t*)mem1_aligned_alloc(block_size, 32);
+            if(file->block == NULL)
+                return -1;
+        }
+
+        if(archive_next_block(file, file->block, expect) < 0)
+            return -1;
+
+        file->block_fill = expect;
+        file->block_position = 0;
+    }
+
+    return (int)done;
+}
+
+int archive_read(archive_file_t* file, void* buffer, uint32_t size) {
+    const archive_entry_t* entry = file->entry;
+    if(entry == NULL)
+        return -1;
+
+    size = ARCHIVE_MIN(size, entry->size - file->position);
+    if(size == 0)
+        return 0;
+
+    if(entry->flags & ARCHIVE_ENTRY_LZ4)
+        return archive_read_compressed(file, (uint8_t*)buffer, size);
+
+    archive_t* archive = file->archive;
+
+    xSemaphoreTake(archive->lock, portMAX_DELAY);
+    int res = archive_read_at(archive, entry->offset + file->position, buffer, size);
+    xSemaphoreGive(archive->lock);
+
+    if(res < 0)
+        return -1;
+
+    file->position += size;
+    return (int)size;
+}
+
+void archive_close(archive_file_t* file) {
+    if(file->input)
+        mem_free(file->input);
+    if(file->block)
+        mem_free(file->block);
+
+    memset(file, 0, sizeof(*file));
+}
+
+void* archive_load(archive_t* archive, const char* name, uint32_t* size) {
+    archive_file_t file;
+    if(archive_open(archive, &file, name) < 0)
+        return NULL;
+
+    uint32_t entry_size = file.entry->size;
+
+    // Padded so the whole buffer can be flushed or DMAed
+    void* data = mem1_aligned_alloc((entry_size + 32) & ~31, 32);
+    if(data == NULL) {
+        archive_close(&file);
+        return NULL;
+    }
+
+    int read = archive_read(&file, data, entry_size);
+    archive_close(&file);
+
+    if(read != (int)entry_size) {
+        mem_free(data);
+        return NULL;
+    }
+
+    if(size)
+        *size = entry_size;
+    return data;
+}
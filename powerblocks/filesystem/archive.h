@@ -0,0 +1,217 @@
+/**
+ * @file archive.h
+ * @brief Packed Asset Archive
+ *
+ * Reads .pba archives made by tools/archive.
+ *
+ * Loading many small files through FatFS costs a directory lookup
+ * and a walk of the cluster chain for each one. An archive is opened
+ * once, and its index is kept in memory, sorted by name hash, so
+ * finding an entry is a binary search and reading it is a seek
+ * within one already open file.
+ *
+ * Entry data is 32 byte aligned within the archive, so it can be read
+ * into buffers that are ready for GX or DMA. Entries may be LZ4
+ * compressed, they are then decompressed a block at a time as they
+ * are read.
+ *
+ * Any number of entries can be open at once, reads through the
+ * archive are serialized.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#pragma once
+
+#include "ff.h"
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Largest decompression block an archive may use
+#define ARCHIVE_MAX_BLOCK_SIZE (128 * 1024)
+
+// Archive cluster map limit, in bytes. Read only, so seeks can always use it.
+#define ARCHIVE_FASTSEEK_MAX_MAP_SIZE (16 * 1024)
+
+#define ARCHIVE_ENTRY_LZ4 (1 << 0)
+
+/**
+ * @struct archive_header_t
+ * @brief On disk header, big endian. Byte swapped once read in.
+ */
+typedef struct {
+    char magic[4];          // "PBAR"
+    uint16_t version;
+    uint16_t flags;
+    uint32_t entry_count;
+    uint32_t block_size;    // Decompressed size of each LZ4 block
+    uint32_t names_offset;
+    uint32_t names_size;
+    uint32_t data_offset;
+    uint32_t reserved;
+} archive_header_t;
+
+/**
+ * @struct archive_entry_t
+ * @brief On disk index entry, big endian. Byte swapped once read in.
+ */
+typedef struct {
+    uint32_t hash;          // FNV-1a of the name
+    uint32_t name_offset;   // Into the name table
+    uint16_t name_length;
+    uint16_t flags;
+    uint32_t offset;        // Of the data from the start of the archive, 32 byte aligned
+    uint32_t stored_size;   // Bytes in the archive
+    uint32_t size;          // Bytes once decompressed
+    uint32_t reserved[2];
+} archive_entry_t;
+
+/**
+ * @struct archive_info_t
+ * @brief Describes an entry.
+ */
+typedef struct {
+    const char* name;
+    uint32_t size;
+    uint32_t stored_size;
+    bool compressed;
+} archive_info_t;
+
+/**
+ * @struct archive_t
+ * @brief A mounted archive.
+ */
+typedef struct {
+    FIL file;
+    archive_header_t header;
+
+    archive_entry_t* entries;
+    char* names;
+    DWORD* link_map;
+
+    SemaphoreHandle_t lock;
+    StaticSemaphore_t lock_data;
+} archive_t;
+
+/**
+ * @struct archive_file_t
+ * @brief An open entry.
+ */
+typedef struct {
+    archive_t* archive;
+    const archive_entry_t* entry;
+
+    uint32_t position;      // Decompressed bytes read so far
+    uint32_t source;        // Bytes of stored data consumed so far
+
+    // Compressed entries only
+    uint8_t* input;         // One compressed block
+    uint8_t* block;         // One decompressed block, only made when a read ends mid block
+    uint32_t block_fill;
+    uint32_t block_position;
+} archive_file_t;
+
+/**
+ * @brief Mounts an archive.
+ *
+ * Reads the index and name table into memory.
+ *
+ * @param archive Archive to mount
+ * @param path Path of the .pba file
+ * @return Negative if error
+ */
+extern int archive_mount(archive_t* archive, const char* path);
+
+/**
+ * @brief Unmounts an archive.
+ *
+ * All entries must be closed first.
+ *
+ * @param archive Archive to unmount
+ */
+extern void archive_unmount(archive_t* archive);
+
+/**
+ * @brief Hashes a name the same way the packer does.
+ *
+ * @param name Entry name
+ * @return FNV-1a hash
+ */
+extern uint32_t archive_hash(const char* name);
+
+/**
+ * @brief Number of entries in the archive.
+ *
+ * @param archive Mounted archive
+ */
+extern uint32_t archive_count(archive_t* archive);
+
+/**
+ * @brief Finds an entry by name.
+ *
+ * Names are paths relative to the packed directory, with forward slashes.
+ *
+ * @param archive Mounted archive
+ * @param name Entry name
+ * @return Index of the entry, negative if not found
+ */
+extern int archive_find(archive_t* archive, const char* name);
+
+/**
+ * @brief Describes an entry.
+ *
+ * @param archive Mounted archive
+ * @param index Index of the entry
+ * @param info Outputted info
+ * @return Negative if error
+ */
+extern int archive_get_info(archive_t* archive, uint32_t index, archive_info_t* info);
+
+/**
+ * @brief Opens an entry by name.
+ *
+ * @param archive Mounted archive
+ * @param file Entry to open
+ * @param name Entry name
+ * @return Negative if error
+ */
+extern int archive_open(archive_t* archive, archive_file_t* file, const char* name);
+
+/**
+ * @brief Reads the next bytes of an entry.
+ *
+ * 32 byte aligned buffers are read into directly where possible.
+ *
+ * @param file Open entry
+ * @param buffer Buffer to read into
+ * @param size Bytes to read
+ * @return Bytes read, 0 at the end of the entry, negative if error
+ */
+extern int archive_read(archive_file_t* file, void* buffer, uint32_t size);
+
+/**
+ * @brief Closes an entry.
+ *
+ * @param file Open entry
+ */
+extern void archive_close(archive_file_t* file);
+
+/**
+ * @brief Reads a whole entry into a new 32 byte aligned buffer.
+ *
+ * The buffer is padded to a multiple of 32 bytes, and
+ * must be freed with mem_free.
+ *
+ * @param archive Mounted archive
+ * @param name Entry name
+ * @param size Outputted size of the entry, may be NULL
+ * @return Entry data, NULL if error
+ */
+extern void* archive_load(archive_t* archive, const char* name, uint32_t* size);
@@ -0,0 +1,280 @@
+/**
+ * @file disk_cache.c
+ * @brief Disk Sector Cache
+ *
+ * Write back LRU sector cache that sits between FatFS's
+ * disk io and a block device.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "disk_cache.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// Buffers the device can DMA into directly
+#define DISK_CACHE_IS_ALIGNED(x) ((((uintptr_t)(x)) & 31) == 0)
+
+static DRESULT disk_cache_device_read(disk_cache_t* cache, BYTE* buff, LBA_t sector, UINT count) {
+    cache->stats.device_reads++;
+    cache->stats.bytes_read += count * FF_MAX_SS;
+    return cache->device->read(buff, sector, count);
+}
+
+static DRESULT disk_cache_device_write(disk_cache_t* cache, const BYTE* buff, LBA_t sector, UINT count) {
+    cache->stats.device_writes++;
+    cache->stats.bytes_written += count * FF_MAX_SS;
+    return cache->device->write(buff, sector, count);
+}
+
+static int disk_cache_find(disk_cache_t* cache, LBA_t sector) {
+    for(int i = 0; i < DISK_CACHE_SECTORS; i++) {
+        if(cache->entries[i].valid && cache->entries[i].sector == sector)
+            return i;
+    }
+    return -1;
+}
+
+static void disk_cache_touch(disk_cache_t* cache, int index) {
+    cache->entries[index].last_used = ++cache->use_counter;
+}
+
+// Claims the least recently used entry for a sector.
+// Flushes first if that would lose unwritten data.
+static int disk_cache_insert(disk_cache_t* cache, LBA_t sector) {
+    int victim = 0;
+    uint32_t oldest = UINT32_MAX;
+
+    for(int i = 0; i < DISK_CACHE_SECTORS; i++) {
+        if(!cache->entries[i].valid) {
+            victim = i;
+            break;
+        }
+
+        if(cache->entries[i].last_used < oldest) {
+            oldest = cache->entries[i].last_used;
+            victim = i;
+        }
+    }
+
+    disk_cache_entry_t* entry = &cache->entries[victim];
+
+    // Writing out everything at once keeps adjacent sectors together
+    if(entry->valid && entry->dirty) {
+        if(disk_cache_flush(cache) != RES_OK)
+            return -1;
+    }
+
+    entry->sector = sector;
+    entry->valid = true;
+    entry->dirty = false;
+    disk_cache_touch(cache, victim);
+
+    return victim;
+}
+
+void disk_cache_initialize(disk_cache_t* cache, const disk_cache_device_t* device) {
+    cache->device = device;
+    cache->disabled = false;
+    disk_cache_invalidate(cache);
+    memset(&cache->stats, 0, sizeof(cache->stats));
+}
+
+void disk_cache_invalidate(disk_cache_t* cache) {
+    memset(cache->entries, 0, sizeof(cache->entries));
+    cache->use_counter = 0;
+    cache->next_sequential = (LBA_t)-1;
+}
+
+DRESULT disk_cache_set_enabled(disk_cache_t* cache, bool enabled) {
+    if(!enabled && !cache->disabled) {
+        DRESULT res = disk_cache_flush(cache);
+        if(res != RES_OK)
+            return res;
+
+        disk_cache_invalidate(cache);
+    }
+
+    cache->disabled = !enabled;
+    return RES_OK;
+}
+
+DRESULT disk_cache_read(disk_cache_t* cache, BYTE* buff, LBA_t sector, UINT count) {
+    DRESULT res;
+
+    if(cache->disabled) {
+        cache->stats.read_misses += count;
+        return disk_cache_device_read(cache, buff, sector, count);
+    }
+
+    // Big reads are already efficient, do not wash the cache out with them.
+    // FatFS only reads more than one sector at a time straight into a users buffer,
+    // so an aligned one can go right to the device with no copies.
+    if(count > DISK_CACHE_READ_AHEAD || (count > 1 && DISK_CACHE_IS_ALIGNED(buff))) {
+        res = disk_cache_device_read(cache, buff, sector, count);
+        if(res != RES_OK)
+            return res;
+
+        cache->stats.read_misses += count;
+
+        // Unwritten data in the cache is newer than the device
+        for(int i = 0; i < DISK_CACHE_SECTORS; i++) {
+            disk_cache_entry_t* entry = &cache->entries[i];
+            if(entry->valid && entry->dirty && entry->sector >= sector && entry->sector < sector + count)
+                memcpy(buff + (entry->sector - sector) * FF_MAX_SS, cache->data[i], FF_MAX_SS);
+        }
+
+        cache->next_sequential = sector + count;
+        return RES_OK;
+    }
+
+    bool sequential = sector == cache->next_sequential;
+
+    UINT i = 0;
+    while(i < count) {
+        LBA_t current = sector + i;
+
+        int index = disk_cache_find(cache, current);
+        if(index >= 0) {
+            memcpy(buff + i * FF_MAX_SS, cache->data[index], FF_MAX_SS);
+            disk_cache_touch(cache, index);
+            cache->stats.read_hits++;
+            i++;
+            continue;
+        }
+
+        // Gather the run of missing sectors so it is one request
+        UINT run = 1;
+        while(i + run < count && disk_cache_find(cache, current + run) < 0)
+            run++;
+
+        // Keep going past the end of the request if this looks like a stream
+        UINT fetch = run;
+        if(sequential && i + run == count) {
+            while(fetch < DISK_CACHE_READ_AHEAD && disk_cache_find(cache, current + fetch) < 0)
+                fetch++;
+        }
+
+        res = disk_cache_device_read(cache, cache->read_staging[0], current, fetch);
+
+        // Read ahead may have ran off the end of the card, try just what was asked for
+        if(res != RES_OK && fetch > run) {
+            fetch = run;
+            res = disk_cache_device_read(cache, cache->read_staging[0], current, fetch);
+        }
+
+        if(res != RES_OK)
+            return res;
+
+        cache->stats.read_misses += run;
+        cache->stats.read_ahead += fetch - run;
+
+        for(UINT j = 0; j < fetch; j++) {
+            if(j < run)
+                memcpy(buff + (i + j) * FF_MAX_SS, cache->read_staging[j], FF_MAX_SS);
+
+            index = disk_cache_insert(cache, current + j);
+            if(index >= 0)
+                memcpy(cache->data[index], cache->read_staging[j], FF_MAX_SS);
+        }
+
+        i += run;
+    }
+
+    cache->next_sequential = sector + count;
+    return RES_OK;
+}
+
+DRESULT disk_cache_write(disk_cache_t* cache, const BYTE* buff, LBA_t sector, UINT count) {
+    cache->stats.write_sectors += count;
+
+    if(cache->disabled)
+        return disk_cache_device_write(cache, buff, sector, count);
+
+    if(count > DISK_CACHE_READ_AHEAD || (count > 1 && DISK_CACHE_IS_ALIGNED(buff))) {
+        DRESULT res = disk_cache_device_write(cache, buff, sector, count);
+        if(res != RES_OK)
+            return res;
+
+        // Keep cached copies in step, they are now clean
+        for(int i = 0; i < DISK_CACHE_SECTORS; i++) {
+            disk_cache_entry_t* entry = &cache->entries[i];
+            if(entry->valid && entry->sector >= sector && entry->sector < sector + count) {
+                memcpy(cache->data[i], buff + (entry->sector - sector) * FF_MAX_SS, FF_MAX_SS);
+                entry->dirty = false;
+            }
+        }
+
+        return RES_OK;
+    }
+
+    for(UINT i = 0; i < count; i++) {
+        LBA_t current = sector + i;
+
+        int index = disk_cache_find(cache, current);
+        if(index >= 0) {
+            if(cache->entries[index].dirty)
+                cache->stats.write_coalesced++;
+            disk_cache_touch(cache, index);
+        } else {
+            index = disk_cache_insert(cache, current);
+
+            // Could not make room, send it on its own
+            if(index < 0) {
+                DRESULT res = disk_cache_device_write(cache, buff + i * FF_MAX_SS, current, 1);
+                if(res != RES_OK)
+                    return res;
+                continue;
+            }
+        }
+
+        memcpy(cache->data[index], buff + i * FF_MAX_SS, FF_MAX_SS);
+        cache->entries[index].dirty = true;
+    }
+
+    return RES_OK;
+}
+
+DRESULT disk_cache_flush(disk_cache_t* cache) {
+    int order[DISK_CACHE_SECTORS];
+    int dirty = 0;
+
+    // Sort dirty sectors by address so runs can be found
+    for(int i = 0; i < DISK_CACHE_SECTORS; i++) {
+        if(!cache->entries[i].valid || !cache->entries[i].dirty)
+            continue;
+
+        int j = dirty++;
+        while(j > 0 && cache->entries[order[j - 1]].sector > cache->entries[i].sector) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    int i = 0;
+    while(i < dirty) {
+        LBA_t start = cache->entries[order[i]].sector;
+
+        int run = 1;
+        while(i + run < dirty && run < DISK_CACHE_WRITE_BATCH && cache->entries[order[i + run]].sector == start + run)
+            run++;
+
+        for(int j = 0; j < run; j++)
+            memcpy(cache->write_staging[j], cache->data[order[i + j]], FF_MAX_SS);
+
+        DRESULT res = disk_cache_device_write(cache, cache->write_staging[0], start, run);
+        if(res != RES_OK)
+            return res;
+
+        for(int j = 0; j < run; j++)
+            cache->entries[order[i + j]].dirty = false;
+
+        i += run;
+    }
+
+    return RES_OK;
+}
@@ -0,0 +1,184 @@
+/**
+ * @file disk_cache.h
+ * @brief Disk Sector Cache
+ *
+ * Write back LRU sector cache that sits between FatFS's
+ * disk io and a block device.
+ *
+ * Every device request is a full IOS round trip, so FatFS's
+ * habit of walking the FAT and directories one sector at a time
+ * is expensive. The cache keeps recently used sectors, reads ahead
+ * when access is sequential, and holds writes until CTRL_SYNC or
+ * eviction so they can go out as a few multi sector transfers.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#pragma once
+
+#include "ff.h"
+#include "diskio.h"
+
+#include "powerblocks/core/system/system.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Sectors held by the cache. Each is FF_MAX_SS bytes.
+#ifndef DISK_CACHE_SECTORS
+#define DISK_CACHE_SECTORS 64
+#endif
+
+// Sectors fetched at once when reads are sequential.
+// Also the largest transfer that goes through the cache, anything bigger goes straight to the device.
+// Multi sector transfers on 32 byte aligned buffers always go straight to the device.
+#ifndef DISK_CACHE_READ_AHEAD
+#define DISK_CACHE_READ_AHEAD 16
+#endif
+
+// Most sectors written out in one request when flushing.
+// Held writes that line up are sent together, up to this many.
+#ifndef DISK_CACHE_WRITE_BATCH
+#define DISK_CACHE_WRITE_BATCH 32
+#endif
+
+/**
+ * @struct disk_cache_device_t
+ * @brief Block device underneath a cache.
+ */
+typedef struct {
+    DRESULT (*read)(BYTE* buff, LBA_t sector, UINT count);
+    DRESULT (*write)(const BYTE* buff, LBA_t sector, UINT count);
+} disk_cache_device_t;
+
+/**
+ * @struct disk_cache_stats_t
+ * @brief Cache counters.
+ *
+ * Bytes per IPC is (bytes_read + bytes_written) / (device_reads + device_writes).
+ */
+typedef struct {
+    uint64_t read_hits;          // Sectors FatFS read that were already cached
+    uint64_t read_misses;        // Sectors FatFS read that had to come from the device
+    uint64_t read_ahead;         // Extra sectors fetched past what was asked for
+    uint64_t write_sectors;      // Sectors FatFS wrote
+    uint64_t write_coalesced;    // Writes that landed on a sector that was already dirty
+
+    uint64_t device_reads;       // Read requests sent to the device
+    uint64_t device_writes;      // Write requests sent to the device
+    uint64_t bytes_read;         // Bytes read from the device
+    uint64_t bytes_written;      // Bytes written to the device
+} disk_cache_stats_t;
+
+typedef struct {
+    LBA_t sector;
+    uint32_t last_used;
+    bool valid;
+    bool dirty;
+} disk_cache_entry_t;
+
+/**
+ * @struct disk_cache_t
+ * @brief A sector cache for one drive.
+ */
+typedef struct {
+    const disk_cache_device_t* device;
+    bool disabled; // Everything goes straight to the device
+
+    disk_cache_entry_t entries[DISK_CACHE_SECTORS];
+    uint32_t use_counter;
+
+    // Where the last read ended, to spot sequential access
+    LBA_t next_sequential;
+
+    disk_cache_stats_t stats;
+
+    BYTE data[DISK_CACHE_SECTORS][FF_MAX_SS] ALIGN(32);
+
+    // Multi sector transfers are staged here.
+    // Separate for writes since a read can evict dirty sectors halfway through.
+    BYTE read_staging[DISK_CACHE_READ_AHEAD][FF_MAX_SS] ALIGN(32);
+    BYTE write_staging[DISK_CACHE_WRITE_BATCH][FF_MAX_SS] ALIGN(32);
+} disk_cache_t;
+
+/**
+ * @brief Sets up a cache for a device.
+ *
+ * @param cache Cache to set up
+ * @param device Device underneath, must stay valid
+ */
+extern void disk_cache_initialize(disk_cache_t* cache, const disk_cache_device_t* device);
+
+/**
+ * @brief Drops everything cached, including unwritten data.
+ *
+ * Used when the media may have changed.
+ *
+ * @param cache Cache to clear
+ */
+extern void disk_cache_invalidate(disk_cache_t* cache);
+
+/**
+ * @brief Turns caching on or off.
+ *
+ * Turning it off writes out anything held and drops the rest,
+ * every request after goes straight to the device. For comparing
+ * against the cache in benchmarks.
+ *
+ * @param cache Cache
+ * @param enabled True to cache
+ * @return RES_OK on success
+ */
+extern DRESULT disk_cache_set_enabled(disk_cache_t* cache, bool enabled);
+
+/**
+ * @brief Reads sectors through the cache.
+ */
+extern DRESULT disk_cache_read(disk_cache_t* cache, BYTE* buff, LBA_t sector, UINT count);
+
+/**
+ * @brief Writes sectors through the cache.
+ *
+ * Small writes are held until disk_cache_flush or eviction.
+ */
+extern DRESULT disk_cache_write(disk_cache_t* cache, const BYTE* buff, LBA_t sector, UINT count);
+
+/**
+ * @brief Writes out every dirty sector.
+ *
+ * Adjacent dirty sectors are written together.
+ *
+ * @param cache Cache to flush
+ * @return RES_OK on success
+ */
+extern DRESULT disk_cache_flush(disk_cache_t* cache);
+
+/**
+ * @brief Reads back the cache counters of a drive.
+ *
+ * @param pdrv Physical drive number
+ * @param stats Outputted stats
+ * @return Negative if the drive has no cache
+ */
+extern int disk_get_cache_stats(BYTE pdrv, disk_cache_stats_t* stats);
+
+/**
+ * @brief Clears the cache counters of a drive.
+ *
+ * @param pdrv Physical drive number
+ * @return Negative if the drive has no cache
+ */
+extern int disk_reset_cache_stats(BYTE pdrv);
+
+/**
+ * @brief Turns caching on or off for a drive.
+ *
+ * Stays in effect until the drive is initialized again.
+ *
+ * @param pdrv Physical drive number
+ * @param enabled True to cache
+ * @return Negative if error
+ */
+extern int disk_set_cache_enabled(BYTE pdrv, bool enabled);
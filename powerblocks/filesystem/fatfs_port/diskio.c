@@ -15,56 +15,115 @@
 #include "powerblocks/core/system/system.h"
 
 #include "powerblocks/filesystem/sd.h"
+#include "powerblocks/filesystem/disk_cache.h"
+#include "powerblocks/filesystem/image_disk.h"
 
 #include <stdbool.h>
+#include <string.h>
+
+#define DISK_DEV_SD    0
+#define DISK_DEV_IMAGE IMAGE_DISK_DRIVE
+#define DISK_DEV_COUNT 2
+
+static const disk_cache_device_t disk_devices[DISK_DEV_COUNT] = {
+    [DISK_DEV_SD] = {
+        .read = sd_disk_read,
+        .write = sd_disk_write
+    },
+    [DISK_DEV_IMAGE] = {
+        .read = image_disk_read,
+        .write = image_disk_write
+    }
+};
 
-#define DISK_DEV_SD 0
+static disk_cache_t disk_caches[DISK_DEV_COUNT];
 
 DSTATUS disk_status(BYTE pdrv) {
     switch(pdrv) {
         case DISK_DEV_SD:
             return sd_disk_status();
+        case DISK_DEV_IMAGE:
+            return image_disk_status();
         default:
             return STA_NOINIT;
     }
 }
 
 DSTATUS disk_initialize(BYTE pdrv) {
+    if(pdrv >= DISK_DEV_COUNT)
+        return STA_NOINIT;
+
+    // The media may have been swapped, nothing cached can be trusted.
+    disk_cache_initialize(&disk_caches[pdrv], &disk_devices[pdrv]);
+
     switch(pdrv) {
         case DISK_DEV_SD:
             return sd_disk_initialize();
+        case DISK_DEV_IMAGE:
+            return image_disk_initialize();
         default:
             return STA_NOINIT;
     }
 }
 
 DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count) {
-    switch(pdrv) {
-        case DISK_DEV_SD:
-            return sd_disk_read(buff, sector, count);
-        default:
-            return RES_PARERR;
-    }
+    if(pdrv >= DISK_DEV_COUNT)
+        return RES_PARERR;
+
+    return disk_cache_read(&disk_caches[pdrv], buff, sector, count);
 }
 
 DRESULT disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count) {
-    switch(pdrv) {
-        case DISK_DEV_SD:
-            return sd_disk_write(buff, sector, count);
-        default:
-            return RES_PARERR;
-    }
+    if(pdrv >= DISK_DEV_COUNT)
+        return RES_PARERR;
+
+    return disk_cache_write(&disk_caches[pdrv], buff, sector, count);
 }
 
 DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff) {
+    if(pdrv >= DISK_DEV_COUNT)
+        return RES_PARERR;
+
+    // Held writes go out on sync
+    if(cmd == CTRL_SYNC) {
+        DRESULT res = disk_cache_flush(&disk_caches[pdrv]);
+        if(res != RES_OK)
+            return res;
+    }
+
     switch(pdrv) {
         case DISK_DEV_SD:
             return sd_disk_ioctl(cmd, buff);
+        case DISK_DEV_IMAGE:
+            return image_disk_ioctl(cmd, buff);
         default:
             return RES_PARERR;
     }
 }
 
+int disk_get_cache_stats(BYTE pdrv, disk_cache_stats_t* stats) {
+    if(pdrv >= DISK_DEV_COUNT)
+        return -1;
+
+    *stats = disk_caches[pdrv].stats;
+    return 0;
+}
+
+int disk_reset_cache_stats(BYTE pdrv) {
+    if(pdrv >= DISK_DEV_COUNT)
+        return -1;
+
+    memset(&disk_caches[pdrv].stats, 0, sizeof(disk_caches[pdrv].stats));
+    return 0;
+}
+
+int disk_set_cache_enabled(BYTE pdrv, bool enabled) {
+    if(pdrv >= DISK_DEV_COUNT)
+        return -1;
+
+    return disk_cache_set_enabled(&disk_caches[pdrv], enabled) == RES_OK ? 0 : -1;
+}
+
 #define RTC_EPOCH_YEAR 2000
 
 static const uint8_t days_in_month[12] = { 31,28,31,30,31,30,31,31,30,31,30,31 };
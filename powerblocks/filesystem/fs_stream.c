@@ -0,0 +1,177 @@
+/**
+ * @file fs_stream.c
+ * @brief Streaming File Reader
+ *
+ * Reads a file ahead of its consumer on a dedicated IO task.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "fs_stream.h"
+
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/system/mem.h"
+#include "powerblocks/core/utils/log.h"
+
+#include <string.h>
+
+static const char* TAG = "FS_STREAM";
+
+// Above main, it spends nearly all its time blocked on the card anyway
+#define FS_STREAM_TASK_PRIORITY (configMAX_PRIORITIES / 2 + 1)
+
+// Put in the free queue to wake the IO task up to exit
+#define FS_STREAM_CHUNK_STOP 0xFF
+
+static void fs_stream_task(void* param) {
+    fs_stream_t* stream = (fs_stream_t*)param;
+
+    while(true) {
+        uint8_t chunk;
+        xQueueReceive(stream->free_queue, &chunk, portMAX_DELAY);
+
+        if(chunk == FS_STREAM_CHUNK_STOP || stream->stopping)
+            break;
+
+        uint8_t* data = stream->buffer + chunk * stream->config.chunk_size;
+
+        UINT read = 0;
+        FRESULT res = f_read(&stream->file, data, stream->config.chunk_size, &read);
+
+        fs_stream_item_t item;
+        item.chunk = chunk;
+        item.size = res == FR_OK ? (int)read : -(int)res;
+
+        if(stream->config.callback) {
+            stream->config.callback(stream->config.user, data, item.size);
+
+            stream->stats.chunks++;
+            if(item.size > 0)
+                stream->stats.bytes += item.size;
+
+            // Reuse it right away
+            if(item.size > 0)
+                xQueueSend(stream->free_queue, &chunk, 0);
+        } else {
+            xQueueSend(stream->filled_queue, &item, portMAX_DELAY);
+        }
+
+        // Nothing more to read, wait to be closed
+        if(item.size <= 0)
+            break;
+    }
+
+    xSemaphoreGive(stream->stopped);
+    vTaskSuspend(NULL);
+}
+
+int fs_stream_open(fs_stream_t* stream, const char* path, const fs_stream_config_t* config) {
+    if(config->chunk_count < 2 || config->chunk_count > FS_STREAM_MAX_CHUNKS || config->chunk_size == 0)
+        return -1;
+
+    memset(stream, 0, sizeof(*stream));
+    memcpy(&stream->config, config, sizeof(stream->config));
+    stream->current = -1;
+
+    FRESULT res = f_open(&stream->file, path, FA_READ);
+    if(res != FR_OK) {
+        LOG_ERROR(TAG, "Failed to open %s: %d", path, res);
+        return -1;
+    }
+
+    stream->buffer = (uint8_t*)config->buffer;
+    if(stream->buffer == NULL) {
+        stream->buffer = mem1_aligned_alloc(config->chunk_size * config->chunk_count, 32);
+        if(stream->buffer == NULL) {
+            f_close(&stream->file);
+            return -1;
+        }
+        stream->owns_buffer = true;
+    }
+
+    stream->free_queue = xQueueCreateStatic(FS_STREAM_MAX_CHUNKS + 1, sizeof(uint8_t),
+        stream->free_storage, &stream->free_queue_data);
+    stream->filled_queue = xQueueCreateStatic(FS_STREAM_MAX_CHUNKS, sizeof(fs_stream_item_t),
+        (uint8_t*)stream->filled_storage, &stream->filled_queue_data);
+    stream->stopped = xSemaphoreCreateBinaryStatic(&stream->stopped_data);
+
+    // Every chunk starts out waiting to be filled
+    for(uint8_t i = 0; i < config->chunk_count; i++)
+        xQueueSend(stream->free_queue, &i, 0);
+
+    stream->stats.start_time = system_get_time_base_int();
+
+    stream->task = xTaskCreateStatic(fs_stream_task, TAG, FS_STREAM_TASK_STACK_SIZE / sizeof(StackType_t),
+                                     stream, FS_STREAM_TASK_PRIORITY, stream->task_stack, &stream->task_data);
+
+    return 0;
+}
+
+int fs_stream_acquire(fs_stream_t* stream, const void** data, TickType_t timeout) {
+    if(stream->current >= 0 || stream->config.callback)
+        return -1;
+
+    // Once the end is reached keep reporting it
+    if(stream->finished)
+        return 0;
+
+    fs_stream_item_t item;
+    if(xQueueReceive(stream->filled_queue, &item, 0) != pdTRUE) {
+        // Had to wait, the IO task fell behind
+        uint64_t start = system_get_time_base_int();
+        BaseType_t got = xQueueReceive(stream->filled_queue, &item, timeout);
+        uint64_t stall = system_get_time_base_int() - start;
+
+        stream->stats.stalls++;
+        stream->stats.stall_time += stall;
+        if(stall > stream->stats.stall_max)
+            stream->stats.stall_max = stall;
+
+        if(got != pdTRUE)
+            return -1;
+    }
+
+    if(item.size <= 0) {
+        stream->finished = true;
+        return item.size;
+    }
+
+    stream->current = item.chunk;
+    stream->stats.chunks++;
+    stream->stats.bytes += item.size;
+
+    *data = stream->buffer + item.chunk * stream->config.chunk_size;
+    return item.size;
+}
+
+void fs_stream_release(fs_stream_t* stream) {
+    if(stream->current < 0)
+        return;
+
+    uint8_t chunk = (uint8_t)stream->current;
+    stream->current = -1;
+    xQueueSend(stream->free_queue, &chunk, portMAX_DELAY);
+}
+
+void fs_stream_close(fs_stream_t* stream) {
+    // Wake the task if its waiting on a free chunk, there is always room for this.
+    stream->stopping = true;
+    uint8_t stop = FS_STREAM_CHUNK_STOP;
+    xQueueSend(stream->free_queue, &stop, 0);
+
+    // Once it says its done it is parked, safe to remove.
+    xSemaphoreTake(stream->stopped, portMAX_DELAY);
+    vTaskDelete(stream->task);
+
+    f_close(&stream->file);
+
+    if(stream->owns_buffer)
+        mem_free(stream->buffer);
+    stream->buffer = NULL;
+}
+
+void fs_stream_get_stats(fs_stream_t* stream, fs_stream_stats_t* stats) {
+    *stats = stream->stats;
+}
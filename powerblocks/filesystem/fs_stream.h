@@ -0,0 +1,159 @@
+/**
+ * @file fs_stream.h
+ * @brief Streaming File Reader
+ *
+ * Reads a file ahead of its consumer on a dedicated IO task.
+ *
+ * The file is split into fixed size chunks, and up to chunk_count of
+ * them are read ahead into a ring of buffers. The consumer takes a
+ * filled chunk, works on it, and hands it back to be refilled, so
+ * the next read from the SD card is already going while the
+ * current chunk is processed.
+ *
+ * Chunks can either be pulled with fs_stream_acquire / fs_stream_release
+ * or pushed to a callback from the IO task.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#pragma once
+
+#include "ff.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Most chunks a stream can have in flight
+#define FS_STREAM_MAX_CHUNKS 8
+
+#define FS_STREAM_TASK_STACK_SIZE 4096
+
+/**
+ * @brief Called from the IO task with each chunk in callback mode.
+ *
+ * The chunk is reused as soon as this returns.
+ * A size of 0 marks the end of the file, negative is an error.
+ */
+typedef void (*fs_stream_callback_t)(void* user, const void* data, int size);
+
+/**
+ * @struct fs_stream_config_t
+ * @brief Stream configuration.
+ */
+typedef struct {
+    uint32_t chunk_size;  // Bytes per chunk. Multiples of 512 read straight from the card.
+    uint32_t chunk_count; // Chunks in flight, 2 to FS_STREAM_MAX_CHUNKS
+
+    // chunk_size * chunk_count bytes, 32 byte aligned. NULL to allocate.
+    void* buffer;
+
+    // Optional, chunks are handed here instead of fs_stream_acquire.
+    fs_stream_callback_t callback;
+    void* user;
+} fs_stream_config_t;
+
+/**
+ * @struct fs_stream_stats_t
+ * @brief Stream counters.
+ */
+typedef struct {
+    uint64_t start_time;    // Time base when the stream was opened
+    uint64_t bytes;         // Bytes delivered to the consumer
+    uint32_t chunks;        // Chunks delivered to the consumer
+
+    uint32_t stalls;        // Times fs_stream_acquire had to wait for the IO task
+    uint64_t stall_time;    // Time base ticks spent waiting in fs_stream_acquire
+    uint64_t stall_max;     // Longest single wait in time base ticks
+} fs_stream_stats_t;
+
+typedef struct {
+    uint8_t chunk;
+    int size;
+} fs_stream_item_t;
+
+/**
+ * @struct fs_stream_t
+ * @brief A file being streamed.
+ */
+typedef struct {
+    FIL file;
+    fs_stream_config_t config;
+
+    uint8_t* buffer;
+    bool owns_buffer;
+
+    volatile bool stopping;
+    int current; // Chunk held by the consumer, -1 if none
+    bool finished;
+
+    fs_stream_stats_t stats;
+
+    TaskHandle_t task;
+    QueueHandle_t free_queue;   // Chunks waiting to be filled
+    QueueHandle_t filled_queue; // Chunks waiting on the consumer
+    SemaphoreHandle_t stopped;
+
+    // Static Data
+    fs_stream_item_t filled_storage[FS_STREAM_MAX_CHUNKS];
+    uint8_t free_storage[FS_STREAM_MAX_CHUNKS + 1];
+    StaticQueue_t filled_queue_data;
+    StaticQueue_t free_queue_data;
+    StaticSemaphore_t stopped_data;
+    StaticTask_t task_data;
+    StackType_t task_stack[FS_STREAM_TASK_STACK_SIZE / sizeof(StackType_t)];
+} fs_stream_t;
+
+/**
+ * @brief Opens a file and starts streaming it.
+ *
+ * Reading starts right away.
+ *
+ * @param stream Stream to open, must stay valid until closed.
+ * @param path File path
+ * @param config Stream configuration
+ * @return Negative if error
+ */
+extern int fs_stream_open(fs_stream_t* stream, const char* path, const fs_stream_config_t* config);
+
+/**
+ * @brief Takes the next filled chunk.
+ *
+ * Must be released with fs_stream_release before taking another.
+ * Not used in callback mode.
+ *
+ * @param stream Stream to read
+ * @param data Outputted chunk data
+ * @param timeout Ticks to wait for the chunk
+ * @return Bytes in the chunk, 0 at the end of the file, negative if error or timed out.
+ */
+extern int fs_stream_acquire(fs_stream_t* stream, const void** data, TickType_t timeout);
+
+/**
+ * @brief Gives the current chunk back to be refilled.
+ *
+ * @param stream Stream
+ */
+extern void fs_stream_release(fs_stream_t* stream);
+
+/**
+ * @brief Stops the IO task and closes the file.
+ *
+ * @param stream Stream to close
+ */
+extern void fs_stream_close(fs_stream_t* stream);
+
+/**
+ * @brief Reads back the stream counters.
+ *
+ * @param stream Stream
+ * @param stats Outputted stats
+ */
+extern void fs_stream_get_stats(fs_stream_t* stream, fs_stream_stats_t* stats);
@@ -12,47 +12,224 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
+#include <stdbool.h>
+#include <time.h>
 #include <errno.h>
 #include <sys/stat.h>
 #include <sys/unistd.h>
 #include <fcntl.h>
 
 #include "ff.h"
+#include "fs_syscall.h"
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+
+// Files opened read only at least this big get a fast seek cluster map.
+#ifndef FS_FASTSEEK_THRESHOLD
+#define FS_FASTSEEK_THRESHOLD (1024 * 1024)
+#endif
+
+// Most memory a single files cluster map may use. Fragmented files that need more seek normally.
+#ifndef FS_FASTSEEK_MAX_MAP_SIZE
+#define FS_FASTSEEK_MAX_MAP_SIZE (16 * 1024)
+#endif
+
+// Most memory all cluster maps together may use.
+#ifndef FS_FASTSEEK_BUDGET
+#define FS_FASTSEEK_BUDGET (64 * 1024)
+#endif
+
+// Starting map size, enough for a contiguous file.
+// FatFS says how much it really needs if this is too small.
+#define FS_FASTSEEK_INITIAL_ENTRIES 16
+
+// Descriptors are handed out from fixed size slabs that never move once allocated,
+// so an open FIL, and its sector window, stays put for as long as it is open.
+#define FS_DESCRIPTOR_SLAB_SIZE 8
+#define FS_MAX_DESCRIPTORS      256
+#define FS_DESCRIPTOR_SLABS     (FS_MAX_DESCRIPTORS / FS_DESCRIPTOR_SLAB_SIZE)
 
 typedef struct {
     uint8_t used;
+    int next_free; // Next descriptor in the free list, -1 for the end
     FIL fil;
+
+    // Fast seek cluster map, NULL if the file does not have one.
+    DWORD* link_map;
+    size_t link_map_size;
+
+    // Keeps pread's seek, read, and seek back from interleaving with other calls on the file.
+    SemaphoreHandle_t lock;
+    StaticSemaphore_t lock_data;
 } file_descriptor_t;
 
-static size_t descriptor_table_size = 0;
-static file_descriptor_t* file_descriptor_table = NULL;
+static size_t fastseek_bytes_used = 0;
+
+// Guards the descriptor table and the fast seek budget, never held across FatFS calls.
+// FatFS locks each volume itself, so files on different volumes do not wait on each other.
+static SemaphoreHandle_t file_lock = NULL;
+static StaticSemaphore_t file_lock_data;
 
-// Find and mark an entry as used, or allocate a new one if needed
+static file_descriptor_t* descriptor_slabs[FS_DESCRIPTOR_SLABS];
+static int descriptor_slab_count = 0;
+static int descriptor_free_head = -1;
+
+static void lock_files() {
+    if(file_lock == NULL) {
+        taskENTER_CRITICAL();
+        if(file_lock == NULL)
+            file_lock = xSemaphoreCreateMutexStatic(&file_lock_data);
+        taskEXIT_CRITICAL();
+    }
+
+    xSemaphoreTake(file_lock, portMAX_DELAY);
+}
+
+static void unlock_files() {
+    xSemaphoreGive(file_lock);
+}
+
+static void lock_file(file_descriptor_t* file) {
+    xSemaphoreTake(file->lock, portMAX_DELAY);
+}
+
+static void unlock_file(file_descriptor_t* file) {
+    xSemaphoreGive(file->lock);
+}
+
+static file_descriptor_t* descriptor_at(int fd) {
+    return &descriptor_slabs[fd / FS_DESCRIPTOR_SLAB_SIZE][fd % FS_DESCRIPTOR_SLAB_SIZE];
+}
+
+// Looks up an open descriptor, NULL if its not one
+static file_descriptor_t* get_file(int fd) {
+    file_descriptor_t* file = NULL;
+
+    lock_files();
+    if(fd >= 0 && fd < descriptor_slab_count * FS_DESCRIPTOR_SLAB_SIZE) {
+        file = descriptor_at(fd);
+        if(!file->used)
+            file = NULL;
+    }
+    unlock_files();
+
+    return file;
+}
+
+// Takes a descriptor off the free list, adding a slab if its empty
 static int allocate_file() {
-    for(int i = 0; i < descriptor_table_size; i++) {
-        if(file_descriptor_table[i].used == 0) {
-            file_descriptor_table[i].used = 1;
-            return i;
+    lock_files();
+
+    if(descriptor_free_head < 0) {
+        if(descriptor_slab_count >= FS_DESCRIPTOR_SLABS) {
+            unlock_files();
+            return -1;
+        }
+
+        file_descriptor_t* slab = (file_descriptor_t*)calloc(FS_DESCRIPTOR_SLAB_SIZE, sizeof(*slab));
+        if(slab == NULL) { // oh deer, out of memory
+            unlock_files();
+            return -1;
         }
-    }
 
-    // Allocate a new entry
-    int entry = descriptor_table_size;
+        int base = descriptor_slab_count * FS_DESCRIPTOR_SLAB_SIZE;
+        descriptor_slabs[descriptor_slab_count++] = slab;
 
-    file_descriptor_t* new_table = (file_descriptor_t*)realloc(file_descriptor_table, (descriptor_table_size + 1) * sizeof(*file_descriptor_table));
-    if(new_table == NULL) { // oh deer, out of memory
-        return -1;
+        // Push backwards so the lowest comes out first
+        for(int i = FS_DESCRIPTOR_SLAB_SIZE - 1; i >= 0; i--) {
+            slab[i].lock = xSemaphoreCreateMutexStatic(&slab[i].lock_data);
+            slab[i].next_free = descriptor_free_head;
+            descriptor_free_head = base + i;
+        }
     }
 
-    descriptor_table_size++;
-    file_descriptor_table = new_table;
+    int fd = descriptor_free_head;
+    file_descriptor_t* file = descriptor_at(fd);
+    descriptor_free_head = file->next_free;
+    file->used = 1;
+
+    unlock_files();
+    return fd;
+}
+
+static void free_file(int fd) {
+    lock_files();
+
+    file_descriptor_t* file = descriptor_at(fd);
+    file->used = 0;
+    file->next_free = descriptor_free_head;
+    descriptor_free_head = fd;
+
+    unlock_files();
+}
+
+// Moves a cluster map's share of the budget from old_size to size.
+// Growing fails if it would go over budget, shrinking always works.
+static bool resize_fastseek_budget(size_t old_size, size_t size) {
+    lock_files();
+
+    bool fits = size <= old_size || fastseek_bytes_used - old_size + size <= FS_FASTSEEK_BUDGET;
+    if(fits)
+        fastseek_bytes_used = fastseek_bytes_used - old_size + size;
 
-    file_descriptor_table[entry].used = 1;
-    return entry;
+    unlock_files();
+    return fits;
 }
 
-static void free_file(int i) {
-    file_descriptor_table[i].used = 0;
+static void release_link_map(file_descriptor_t* file) {
+    if(file->link_map) {
+        free(file->link_map);
+        resize_fastseek_budget(file->link_map_size, 0);
+    }
+
+    file->link_map = NULL;
+    file->link_map_size = 0;
+    file->fil.cltbl = NULL;
+}
+
+// Gives big read only files a cluster map, so seeking does not walk the FAT chain.
+// Without it every seek backwards starts over from the first cluster.
+static void create_link_map(file_descriptor_t* file) {
+    file->link_map = NULL;
+    file->link_map_size = 0;
+
+    size_t size = FS_FASTSEEK_INITIAL_ENTRIES * sizeof(DWORD);
+
+    while(true) {
+        if(size > FS_FASTSEEK_MAX_MAP_SIZE)
+            break;
+
+        // Claimed before allocating, so two opens can not both fit in what is left
+        if(!resize_fastseek_budget(file->link_map_size, size))
+            break;
+
+        DWORD* map = (DWORD*)realloc(file->link_map, size);
+        if(map == NULL) {
+            resize_fastseek_budget(size, file->link_map_size);
+            break;
+        }
+
+        file->link_map = map;
+        file->link_map_size = size;
+
+        map[0] = size / sizeof(DWORD);
+        file->fil.cltbl = map;
+
+        FRESULT res = f_lseek(&file->fil, CREATE_LINKMAP);
+        if(res == FR_OK)
+            return;
+
+        // Too small, map[0] now holds how many entries are needed
+        if(res != FR_NOT_ENOUGH_CORE)
+            break;
+
+        size = map[0] * sizeof(DWORD);
+    }
+
+    // Fall back to normal seeking
+    release_link_map(file);
 }
 
 int open(const char *path, int flags, ...) {
@@ -108,24 +285,69 @@ int open(const char *path, int flags, ...) {
         return fd;
     }
 
-    FRESULT res = f_open(&file_descriptor_table[fd].fil, path, fatfs_mode);
+    file_descriptor_t* file = descriptor_at(fd);
+    file->link_map = NULL;
+    file->link_map_size = 0;
+
+    FRESULT res = f_open(&file->fil, path, fatfs_mode);
     if(res != FR_OK) {
         free_file(fd);
         errno = EIO;
         return -1;
     }
 
+    // Files using fast seek can not grow, so only read only files get it.
+    if(!(fatfs_mode & FA_WRITE) && f_size(&file->fil) >= FS_FASTSEEK_THRESHOLD)
+        create_link_map(file);
+
     return fd;
 }
 
 ssize_t read(int fd, void* buf, size_t count) {
-    if(fd < 0 || fd >= descriptor_table_size || file_descriptor_table[fd].used == 0) {
+    file_descriptor_t* file = get_file(fd);
+    if(file == NULL) {
         errno = EBADF;
         return -1;
     }
 
     UINT br = 0;
-    FRESULT res = f_read(&file_descriptor_table[fd].fil, buf, count, &br);
+    lock_file(file);
+    FRESULT res = f_read(&file->fil, buf, count, &br);
+    unlock_file(file);
+    if(res != FR_OK) {
+        errno = EIO;
+        return -1;
+    }
+
+    return br;
+}
+
+ssize_t pread(int fd, void* buf, size_t count, off_t offset) {
+    file_descriptor_t* file = get_file(fd);
+    if(file == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    if(offset < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    FIL *fp = &file->fil;
+    UINT br = 0;
+
+    // The file position is left where it was, so other readers are not disturbed.
+    lock_file(file);
+    FSIZE_t position = f_tell(fp);
+
+    FRESULT res = f_lseek(fp, offset);
+    if(res == FR_OK)
+        res = f_read(fp, buf, count, &br);
+
+    f_lseek(fp, position);
+    unlock_file(file);
+
     if(res != FR_OK) {
         errno = EIO;
         return -1;
@@ -135,13 +357,16 @@ ssize_t read(int fd, void* buf, size_t count) {
 }
 
 ssize_t write(int fd, const void* buf, size_t count) {
-    if(fd < 0 || fd >= descriptor_table_size || file_descriptor_table[fd].used == 0) {
+    file_descriptor_t* file = get_file(fd);
+    if(file == NULL) {
         errno = EBADF;
         return -1;
     }
 
     UINT bw = 0;
-    FRESULT res = f_write(&file_descriptor_table[fd].fil, buf, count, &bw);
+    lock_file(file);
+    FRESULT res = f_write(&file->fil, buf, count, &bw);
+    unlock_file(file);
     if(res != FR_OK) {
         errno = EIO;
         return -1;
@@ -151,14 +376,17 @@ ssize_t write(int fd, const void* buf, size_t count) {
 }
 
 off_t lseek(int fd, off_t offset, int whence) {
-    if(fd < 0 || fd >= descriptor_table_size || file_descriptor_table[fd].used == 0) {
+    file_descriptor_t* file = get_file(fd);
+    if(file == NULL) {
         errno = EBADF;
         return -1;
     }
 
-    FIL *fp = &file_descriptor_table[fd].fil;
+    FIL *fp = &file->fil;
     DWORD new_pos;
 
+    lock_file(file);
+
     switch(whence) {
         case SEEK_SET:
             new_pos = offset;
@@ -170,11 +398,13 @@ off_t lseek(int fd, off_t offset, int whence) {
             new_pos = f_size(fp) + offset;
             break;
         default:
+            unlock_file(file);
             errno = EINVAL;
             return -1;
     }
 
     FRESULT res = f_lseek(fp, new_pos);
+    unlock_file(file);
     if(res != FR_OK) {
         errno = EIO;
         return -1;
@@ -183,19 +413,180 @@ off_t lseek(int fd, off_t offset, int whence) {
     return new_pos;
 }
 
+int fs_preallocate(int fd, off_t size) {
+    file_descriptor_t* file = get_file(fd);
+    if(file == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    FIL *fp = &file->fil;
+
+    if(size < 0 || !(fp->flag & FA_WRITE)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // FatFS can only lay out an empty file
+    if(f_size(fp) != 0) {
+        errno = EEXIST;
+        return -1;
+    }
+
+    lock_file(file);
+    FRESULT res = f_expand(fp, size, 1);
+    unlock_file(file);
+
+    if(res == FR_DENIED) {
+        errno = ENOSPC; // No contiguous space big enough
+        return -1;
+    } else if(res != FR_OK) {
+        errno = EIO;
+        return -1;
+    }
+
+    return 0;
+}
+
 int close(int fd) {
-    if(fd < 0 || fd >= descriptor_table_size || file_descriptor_table[fd].used == 0) {
+    file_descriptor_t* file = get_file(fd);
+    if(file == NULL) {
         errno = EBADF;
         return -1;
     }
 
-    f_close(&file_descriptor_table[fd].fil);
+    // Waits out any call still using it
+    lock_file(file);
+    f_close(&file->fil);
+    release_link_map(file);
+    unlock_file(file);
+
     free_file(fd);
     return 0;
 }
 
+// FAT keeps local date and time fields, libc wants seconds since 1970.
+static time_t fat_time_to_unix(WORD fdate, WORD ftime) {
+    static const uint16_t days_before_month[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+
+    int year = (fdate >> 9) + 1980;
+    int month = (fdate >> 5) & 0x0F;
+    int day = fdate & 0x1F;
+
+    if(month < 1 || month > 12 || day < 1)
+        return 0;
+
+    // Days since 1970, counting leap days before this year
+    int64_t days = (int64_t)(year - 1970) * 365
+                 + ((year - 1969) / 4) - ((year - 1901) / 100) + ((year - 1601) / 400)
+                 + days_before_month[month - 1] + day - 1;
+
+    bool leap = (year % 4 == 0 && (year % 100 != 0 || year % 400 == 0));
+    if(leap && month > 2)
+        days++;
+
+    return (time_t)(days * 86400 + (ftime >> 11) * 3600 + ((ftime >> 5) & 0x3F) * 60 + (ftime & 0x1F) * 2);
+}
+
+static void fill_stat(struct stat* st, FSIZE_t size, BYTE attributes, WORD fdate, WORD ftime) {
+    memset(st, 0, sizeof(*st));
+
+    if(attributes & AM_DIR) {
+        st->st_mode = S_IFDIR | 0555;
+    } else {
+        st->st_mode = S_IFREG | 0444;
+    }
+
+    if(!(attributes & AM_RDO))
+        st->st_mode |= 0222;
+
+    st->st_nlink = 1;
+    st->st_size = size;
+    st->st_blksize = FF_MAX_SS;
+    st->st_blocks = (size + 511) / 512;
+    st->st_mtime = fat_time_to_unix(fdate, ftime);
+    st->st_atime = st->st_mtime;
+    st->st_ctime = st->st_mtime;
+}
+
 int fstat(int fd, struct stat *st) {
-    st->st_mode = S_IFREG;
+    file_descriptor_t* file = get_file(fd);
+    if(file == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    // Open files do not carry their time stamps, only the size.
+    fill_stat(st, f_size(&file->fil), (file->fil.flag & FA_WRITE) ? 0 : AM_RDO, 0, 0);
+    return 0;
+}
+
+int stat(const char *path, struct stat *st) {
+    FILINFO info;
+    FRESULT res = f_stat(path, &info);
+
+    if(res == FR_NO_FILE || res == FR_NO_PATH || res == FR_INVALID_NAME) {
+        errno = ENOENT;
+        return -1;
+    } else if(res != FR_OK) {
+        errno = EIO;
+        return -1;
+    }
+
+    fill_stat(st, info.fsize, info.fattrib, info.fdate, info.ftime);
+    return 0;
+}
+
+fs_dir_t* opendir(const char *path) {
+    fs_dir_t* dir = (fs_dir_t*)malloc(sizeof(*dir));
+    if(dir == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    FRESULT res = f_opendir(&dir->dir, path);
+    if(res != FR_OK) {
+        free(dir);
+        errno = (res == FR_NO_PATH || res == FR_NO_FILE) ? ENOENT : EIO;
+        return NULL;
+    }
+
+    return dir;
+}
+
+struct dirent* readdir(fs_dir_t* dir) {
+    if(dir == NULL) {
+        errno = EBADF;
+        return NULL;
+    }
+
+    FILINFO info;
+    FRESULT res = f_readdir(&dir->dir, &info);
+    if(res != FR_OK) {
+        errno = EIO;
+        return NULL;
+    }
+
+    // End of the directory, errno untouched
+    if(info.fname[0] == 0)
+        return NULL;
+
+    dir->entry.d_ino = 0;
+    dir->entry.d_type = (info.fattrib & AM_DIR) ? DT_DIR : DT_REG;
+    strncpy(dir->entry.d_name, info.fname, sizeof(dir->entry.d_name) - 1);
+    dir->entry.d_name[sizeof(dir->entry.d_name) - 1] = 0;
+
+    return &dir->entry;
+}
+
+int closedir(fs_dir_t* dir) {
+    if(dir == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    f_closedir(&dir->dir);
+    free(dir);
     return 0;
 }
 
@@ -0,0 +1,88 @@
+/**
+ * @file fs_syscall.h
+ * @brief Implements libc's filesystem syscalls
+ *
+ * File calls that have no standard libc form,
+ * for descriptors from open(), and the directory calls.
+ *
+ * The POSIX directory calls use their own fs_dir_t,
+ * since DIR is already taken by FatFS.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "ff.h"
+
+#ifndef DT_UNKNOWN
+#define DT_UNKNOWN 0
+#define DT_DIR     4
+#define DT_REG     8
+#endif
+
+/**
+ * @struct dirent
+ * @brief A directory entry from readdir.
+ */
+struct dirent {
+    ino_t d_ino;           // Always 0, FAT has no inodes
+    unsigned char d_type;  // DT_DIR or DT_REG
+    char d_name[FF_LFN_BUF + 1];
+};
+
+/**
+ * @struct fs_dir_t
+ * @brief An open directory.
+ */
+typedef struct {
+    DIR dir;
+    struct dirent entry; // Returned by readdir, reused each call
+} fs_dir_t;
+
+/**
+ * @brief Opens a directory for reading.
+ *
+ * @param path Directory path
+ * @return Directory, NULL if error and errno is set.
+ */
+extern fs_dir_t* opendir(const char* path);
+
+/**
+ * @brief Reads the next entry in a directory.
+ *
+ * The entry is overwritten by the next call.
+ *
+ * @param dir Directory from opendir
+ * @return Entry, NULL at the end or if error.
+ */
+extern struct dirent* readdir(fs_dir_t* dir);
+
+/**
+ * @brief Closes a directory.
+ *
+ * @param dir Directory from opendir
+ * @return Negative if error.
+ */
+extern int closedir(fs_dir_t* dir);
+
+/**
+ * @brief Reserves space for a file of known size.
+ *
+ * Allocates size bytes of contiguous clusters up front and sets the
+ * file to that size. Later writes land in place without walking or
+ * growing the FAT, and go out as large transfers. Good for saves,
+ * captures and screenshots where the size is known ahead of time.
+ *
+ * The file must be open for writing and still empty.
+ *
+ * @param fd File descriptor from open()
+ * @param size Bytes to reserve
+ * @return Negative if error, errno is set.
+ */
+extern int fs_preallocate(int fd, off_t size);
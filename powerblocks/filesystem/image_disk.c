@@ -0,0 +1,138 @@
+/**
+ * @file image_disk.c
+ * @brief Disk Image Drive
+ *
+ * A FatFS drive backed by a disk image in memory instead of the SD card.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "image_disk.h"
+
+#include "powerblocks/core/system/system.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#define IMAGE_DISK_SECTOR_SIZE 512
+
+static uint8_t* image_disk_data = NULL;
+static LBA_t image_disk_sectors = 0;
+static image_disk_config_t image_disk_config;
+static image_disk_stats_t image_disk_stats;
+
+// Stands in for the time a real command would take.
+// Sleeps for whole ticks like waiting on IOS would, and spins for the rest.
+static void image_disk_wait(UINT count) {
+    uint64_t us = image_disk_config.command_latency_us + (uint64_t)image_disk_config.sector_latency_us * count;
+    if(us == 0)
+        return;
+
+    uint64_t ticks = SYSTEM_US_TO_TICKS(us);
+    uint64_t stop = system_get_time_base_int() + ticks;
+    image_disk_stats.latency_total += ticks;
+
+    TickType_t whole = pdMS_TO_TICKS(us / 1000);
+    if(whole)
+        vTaskDelay(whole);
+
+    while(system_get_time_base_int() < stop);
+}
+
+int image_disk_attach(void* image, size_t size, const image_disk_config_t* config) {
+    if(image == NULL || size < IMAGE_DISK_SECTOR_SIZE)
+        return -1;
+
+    image_disk_data = (uint8_t*)image;
+    image_disk_sectors = size / IMAGE_DISK_SECTOR_SIZE;
+    image_disk_set_config(config);
+    image_disk_reset_stats();
+
+    return 0;
+}
+
+void image_disk_detach() {
+    image_disk_data = NULL;
+    image_disk_sectors = 0;
+}
+
+void image_disk_set_config(const image_disk_config_t* config) {
+    if(config) {
+        image_disk_config = *config;
+    } else {
+        memset(&image_disk_config, 0, sizeof(image_disk_config));
+    }
+}
+
+void image_disk_get_stats(image_disk_stats_t* stats) {
+    *stats = image_disk_stats;
+}
+
+void image_disk_reset_stats() {
+    memset(&image_disk_stats, 0, sizeof(image_disk_stats));
+}
+
+DSTATUS image_disk_status() {
+    return image_disk_data ? 0 : STA_NOINIT | STA_NODISK;
+}
+
+DSTATUS image_disk_initialize() {
+    return image_disk_status();
+}
+
+DRESULT image_disk_read(BYTE* buff, LBA_t sector, UINT count) {
+    if(image_disk_data == NULL)
+        return RES_NOTRDY;
+
+    if(sector >= image_disk_sectors || count > image_disk_sectors - sector)
+        return RES_PARERR;
+
+    image_disk_wait(count);
+    memcpy(buff, image_disk_data + sector * IMAGE_DISK_SECTOR_SIZE, count * IMAGE_DISK_SECTOR_SIZE);
+
+    image_disk_stats.reads++;
+    image_disk_stats.sectors_read += count;
+    return RES_OK;
+}
+
+DRESULT image_disk_write(const BYTE* buff, LBA_t sector, UINT count) {
+    if(image_disk_data == NULL)
+        return RES_NOTRDY;
+
+    if(sector >= image_disk_sectors || count > image_disk_sectors - sector)
+        return RES_PARERR;
+
+    image_disk_wait(count);
+    memcpy(image_disk_data + sector * IMAGE_DISK_SECTOR_SIZE, buff, count * IMAGE_DISK_SECTOR_SIZE);
+
+    image_disk_stats.writes++;
+    image_disk_stats.sectors_written += count;
+    return RES_OK;
+}
+
+DRESULT image_disk_ioctl(BYTE cmd, void* buff) {
+    switch (cmd) {
+        case CTRL_SYNC:
+            return RES_OK;
+
+        case GET_SECTOR_COUNT:
+            *(LBA_t*)buff = image_disk_sectors;
+            return RES_OK;
+
+        case GET_SECTOR_SIZE:
+            *(WORD*)buff = IMAGE_DISK_SECTOR_SIZE;
+            return RES_OK;
+
+        case GET_BLOCK_SIZE:
+            *(DWORD*)buff = 1;
+            return RES_OK;
+
+        default:
+            return RES_PARERR;
+    }
+}
@@ -0,0 +1,114 @@
+/**
+ * @file image_disk.h
+ * @brief Disk Image Drive
+ *
+ * A FatFS drive backed by a disk image in memory instead of the SD card.
+ *
+ * Each command waits out a configurable latency, so the image can
+ * stand in for the cost of an IOS / SDIO round trip. This gives a
+ * repeatable disk for benchmarking the sector cache, read ahead and
+ * fast seek, and for stress testing the POSIX layer, without depending
+ * on whatever card happens to be in the slot.
+ *
+ * Mounted as drive "1:".
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#pragma once
+
+#include "ff.h"
+#include "diskio.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Physical drive number of the image
+#define IMAGE_DISK_DRIVE 1
+
+/**
+ * @struct image_disk_config_t
+ * @brief Simulated device cost.
+ */
+typedef struct {
+    uint32_t command_latency_us; // Fixed cost of every read or write, the round trip
+    uint32_t sector_latency_us;  // Added per sector transferred
+} image_disk_config_t;
+
+/**
+ * @struct image_disk_stats_t
+ * @brief Commands the image has seen.
+ */
+typedef struct {
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t sectors_read;
+    uint64_t sectors_written;
+    uint64_t latency_total; // Simulated time spent waiting, in time base ticks
+} image_disk_stats_t;
+
+/**
+ * @brief Attaches an image.
+ *
+ * The image must already hold a FAT file system, or be
+ * formatted with f_mkfs on "1:" before mounting.
+ *
+ * @param image Image data, must stay valid until detached.
+ * @param size Size of the image in bytes, whole sectors
+ * @param config Simulated latency
+ * @return Negative if error
+ */
+extern int image_disk_attach(void* image, size_t size, const image_disk_config_t* config);
+
+/**
+ * @brief Detaches the image.
+ *
+ * Should be unmounted first.
+ */
+extern void image_disk_detach();
+
+/**
+ * @brief Changes the simulated latency.
+ *
+ * @param config Simulated latency
+ */
+extern void image_disk_set_config(const image_disk_config_t* config);
+
+/**
+ * @brief Reads back the command counters.
+ *
+ * @param stats Outputted stats
+ */
+extern void image_disk_get_stats(image_disk_stats_t* stats);
+
+/**
+ * @brief Clears the command counters.
+ */
+extern void image_disk_reset_stats();
+
+/**
+ * @brief FatFS disk_status implementation.
+ */
+extern DSTATUS image_disk_status();
+
+/**
+ * @brief FatFS disk_initialize implementation.
+ */
+extern DSTATUS image_disk_initialize();
+
+/**
+ * @brief FatFS disk_read implementation.
+ */
+extern DRESULT image_disk_read(BYTE* buff, LBA_t sector, UINT count);
+
+/**
+ * @brief FatFS disk_write implementation.
+ */
+extern DRESULT image_disk_write(const BYTE* buff, LBA_t sector, UINT count);
+
+/**
+ * @brief FatFS disk_ioctl implementation.
+ */
+extern DRESULT image_disk_ioctl(BYTE cmd, void* buff);
@@ -17,6 +17,8 @@
 #include "task.h"
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 static const char* TAG = "SD";
 
@@ -42,10 +44,23 @@ static const char* TAG = "SD";
 #define SD_LOG_DEBUG(fmt, ...)
 #endif
 
+// Sectors in the bounce buffer used for transfers that are not 32 byte aligned
+#define SD_BOUNCE_SECTORS 16
+
+// Writes at least this long tell the card how many blocks are coming first,
+// so it can erase them all up front instead of block by block.
+#define SD_PRE_ERASE_MIN_SECTORS 8
+
+// IOS DMA's straight to and from the callers buffer, and cache maintenance
+// works on whole lines. Anything not on a line boundary goes through here.
+#define SD_IS_DMA_ALIGNED(x) ((((uintptr_t)(x)) & 31) == 0)
+
 static bool sd_initialized = false;
 static uint32_t sd_rca;
 static bool sd_card_sdhc;
 
+static BYTE sd_bounce_buffer[SD_BOUNCE_SECTORS * 512] ALIGN(32);
+
 int sd_initialize() {
     // Open front SD slot
     int ret = sdio_initialize("/dev/sdio/slot0");
@@ -203,7 +218,7 @@ DSTATUS sd_disk_initialize() {
     return status;
 }
 
-DRESULT sd_disk_read(BYTE* buff, LBA_t sector, UINT count) {
+static DRESULT sd_read_direct(BYTE* buff, LBA_t sector, UINT count) {
     int ret = sdio_send_cmd(SD_CMD18_READ_MULTIPLE_BLOCK, SD_CMDTYPE_AC, SD_RESP_R1, sector * (sd_card_sdhc ? 1 : 512), buff, count, 512, NULL, 0);
     system_invalidate_dcache(buff, count * 512);
     if(ret < 0) {
@@ -213,8 +228,17 @@ DRESULT sd_disk_read(BYTE* buff, LBA_t sector, UINT count) {
     return RES_OK;
 }
 
-DRESULT sd_disk_write(const BYTE* buff, LBA_t sector, UINT count) {
+static DRESULT sd_write_direct(const BYTE* buff, LBA_t sector, UINT count) {
     system_flush_dcache(buff, count * 512);
+
+    if(count >= SD_PRE_ERASE_MIN_SECTORS) {
+        // Only a hint, the write works fine without it.
+        int ret = sdio_send_cmd(SD_CMD55_APP_CMD, SD_CMDTYPE_AC, SD_RESP_R1, sd_rca, NULL, 0, 0, NULL, 0);
+        if(ret >= 0)
+            ret = sdio_send_cmd(SD_ACMD23_SET_WR_BLK_ERASE_COUNT, SD_CMDTYPE_AC, SD_RESP_R1, count, NULL, 0, 0, NULL, 0);
+        if(ret < 0)
+            SD_LOG_DEBUG("Pre erase failed: %d", ret);
+    }
     int ret = sdio_send_cmd(SD_CMD25_WRITE_MULTIPLE_BLOCK, SD_CMDTYPE_AC, SD_RESP_R1, sector * (sd_card_sdhc ? 1 : 512), (void*)buff, count, 512, NULL, 0);
     if(ret < 0) {
         SD_LOG_ERROR("Disk write failed on sector: %d", sector);
@@ -223,6 +247,50 @@ DRESULT sd_disk_write(const BYTE* buff, LBA_t sector, UINT count) {
     return RES_OK;
 }
 
+DRESULT sd_disk_read(BYTE* buff, LBA_t sector, UINT count) {
+    // Aligned buffers are read into directly, no copies.
+    if(SD_IS_DMA_ALIGNED(buff))
+        return sd_read_direct(buff, sector, count);
+
+    // Otherwise invalidating would throw away whatever shares the first and last line.
+    while(count) {
+        UINT chunk = count < SD_BOUNCE_SECTORS ? count : SD_BOUNCE_SECTORS;
+
+        DRESULT res = sd_read_direct(sd_bounce_buffer, sector, chunk);
+        if(res != RES_OK)
+            return res;
+
+        memcpy(buff, sd_bounce_buffer, chunk * 512);
+
+        buff += chunk * 512;
+        sector += chunk;
+        count -= chunk;
+    }
+
+    return RES_OK;
+}
+
+DRESULT sd_disk_write(const BYTE* buff, LBA_t sector, UINT count) {
+    if(SD_IS_DMA_ALIGNED(buff))
+        return sd_write_direct(buff, sector, count);
+
+    while(count) {
+        UINT chunk = count < SD_BOUNCE_SECTORS ? count : SD_BOUNCE_SECTORS;
+
+        memcpy(sd_bounce_buffer, buff, chunk * 512);
+
+        DRESULT res = sd_write_direct(sd_bounce_buffer, sector, chunk);
+        if(res != RES_OK)
+            return res;
+
+        buff += chunk * 512;
+        sector += chunk;
+        count -= chunk;
+    }
+
+    return RES_OK;
+}
+
 DRESULT sd_disk_ioctl(BYTE cmd, void* buff) {
     switch (cmd) {
         // IOS / the controller handles this
@@ -44,11 +44,16 @@ extern DSTATUS sd_disk_initialize();
 
 /**
  * @brief FatFS disk_read implementation
+ * 
+ * 32 byte aligned buffers are DMA'd into directly.
+ * Unaligned ones go through a bounce buffer a few sectors at a time.
  */
 extern DRESULT sd_disk_read(BYTE* buff, LBA_t sector, UINT count);
 
 /**
- * @brief FatFS disk_read implementation
+ * @brief FatFS disk_write implementation
+ * 
+ * Same alignment rules as sd_disk_read.
  */
 extern DRESULT sd_disk_write(const BYTE* buff, LBA_t sector, UINT count);
 
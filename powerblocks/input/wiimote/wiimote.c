@@ -18,8 +18,13 @@
 
 #include "wiimote_hid.h"
 #include "wiimote_sys.h"
+#include "wiimote_cache.h"
 #include "wiimote_log.h"
 
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
 #include <string.h>
 
 const char* WIIMOTE_TAG = "WIIMOTE";
@@ -29,6 +34,36 @@ wiimote_t WIIMOTES[WIIMOTE_MAX_REMOTES];
 // Offset of the sensor bar to the TV, based on placement when loading system settings
 static vec2i sensor_bar_offset;
 
+// Bumped each time a slot is given or taken a driver.
+// A new driver can be allocated where a freed one was, so the pointer alone can not tell them apart.
+static uint32_t wiimote_slot_generation[WIIMOTE_MAX_REMOTES];
+
+// Last state each slot was parsed from, so polls with no new reports can skip parsing.
+static struct {
+    uint32_t generation;
+    uint32_t sequence;
+    bool valid;
+} wiimote_poll_state[WIIMOTE_MAX_REMOTES];
+
+// Event queues. One producer (the bluetooth task) and one consumer per remote,
+// so the head and tail are enough to keep them apart.
+typedef struct {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    wiimote_event_t events[WIIMOTE_EVENT_QUEUE_SIZE];
+} wiimote_event_queue_t;
+
+static struct {
+    bool enabled;
+    wiimote_event_queue_t queues[WIIMOTE_MAX_REMOTES];
+
+    TaskHandle_t notify_task;
+    SemaphoreHandle_t available;
+    StaticSemaphore_t available_data;
+
+    wiimote_event_stats_t stats;
+} wiimote_events;
+
 // Lookup table of what features are present in each reporting mode
 static const int wiimote_present_lookup_table[] = {
     // WIIMOTE_REPORT_BUTTONS
@@ -68,9 +103,10 @@ static const int wiimote_present_lookup_table[] = {
     WIIMOTE_PRESENT_BUTTONS | WIIMOTE_PRESENT_ACCELEROMETER | WIIMOTE_PRESENT_INTERLACED | WIIMOTE_PRESENT_IR | WIIMOTE_PRESENT_IR_FULL
 };
 
-// Lookup table for the order to prefer modes from the previous table, higher modes selected first
-static const uint8_t wiimote_present_preferred_table[] =  {
-    0, 1, 2, 3, 4, 5, 6, 3, 14
+// Bytes on air for each reporting mode from the previous table.
+// Interleaved takes two reports to carry everything.
+static const uint8_t wiimote_report_size_table[] = {
+    2, 5, 10, 17, 21, 21, 21, 21, 0, 0, 0, 0, 0, 21, 42, 0
 };
 
 static void wiimote_update_buttons(const wiimote_raw_t* raw_data, wiimote_t* output) {
@@ -79,13 +115,13 @@ static void wiimote_update_buttons(const wiimote_raw_t* raw_data, wiimote_t* out
     wiimote_set_button_helper(&output->buttons, new_state);
 }
 
-static void wiimote_update_accelerometer(const wiimote_raw_t* raw_data, wiimote_t* output) {
+static vec3 wiimote_parse_accelerometer(const wiimote_raw_t* raw_data, bool interlaced) {
     int x, y, z;
 
     // Encoding of the data for these things is a bit weird.
     // In interlaced its all 8 bits of precision.
     // For all other modes, its 10 bit X, 9 bit Y and Z
-    if(output->present & WIIMOTE_PRESENT_INTERLACED) {
+    if(interlaced) {
         x = (int)raw_data->data_report[2] << 2;
         y = (int)raw_data->data_report[23] << 2;
 
@@ -111,6 +147,11 @@ static void wiimote_update_accelerometer(const wiimote_raw_t* raw_data, wiimote_
     pos.x = (float)(x - (int)raw_data->calibration.accel_zero[0]) / (float)raw_data->calibration.accel_one[0];
     pos.y = (float)(y - (int)raw_data->calibration.accel_zero[1]) / (float)raw_data->calibration.accel_one[1];
     pos.z = (float)(z - (int)raw_data->calibration.accel_zero[2]) / (float)raw_data->calibration.accel_one[2];
+    return pos;
+}
+
+static void wiimote_update_accelerometer(const wiimote_raw_t* raw_data, wiimote_t* output) {
+    vec3 pos = wiimote_parse_accelerometer(raw_data, output->present & WIIMOTE_PRESENT_INTERLACED);
     output->accelerometer.rectangular = pos;
 
     // Now that we have that go ahead and calculate the spherical coordinates for it.
@@ -363,6 +404,10 @@ static float clamp(float d, float min, float max) {
 
 void wiimotes_initialize() {
     memset(WIIMOTES, 0, sizeof(WIIMOTES));
+    memset(wiimote_slot_generation, 0, sizeof(wiimote_slot_generation));
+    memset(wiimote_poll_state, 0, sizeof(wiimote_poll_state));
+    memset(&wiimote_events, 0, sizeof(wiimote_events));
+    wiimote_events.available = xSemaphoreCreateBinaryStatic(&wiimote_events.available_data);
 
     // Sensor Bar On
     gpio_set_direction(GPIO_SENSOR_BAR, true);
@@ -370,6 +415,7 @@ void wiimotes_initialize() {
 
     // Load settings
     wiimote_sys_phrase_settings();
+    wiimote_cache_initialize();
 
     if(wiimote_sys_config.sensor_bar_position) {
         // Top of TV
@@ -447,19 +493,55 @@ static void wiimote_update(const wiimote_raw_t* raw_data, wiimote_t* output) {
     }
 }
 
+// Nothing new came in, so any button presses or releases from the last report are over.
+static void wiimote_settle(wiimote_t* output) {
+    wiimote_set_button_helper(&output->buttons, output->buttons.state);
+
+    switch(output->extensions.type) {
+        case WIIMOTE_EXTENSION_NUNCHUK:
+            wiimote_set_button_helper(&output->extensions.nunchuck.buttons, output->extensions.nunchuck.buttons.state);
+            break;
+        case WIIMOTE_EXTENSION_CLASSIC_CONTROLLER:
+            wiimote_set_button_helper(&output->extensions.classic_controller.buttons, output->extensions.classic_controller.buttons.state);
+            break;
+        default:
+            break;
+    }
+}
+
 void wiimote_poll() {
     wiimote_raw_t raw;
     for(int i = 0; i < WIIMOTE_MAX_REMOTES; i++) {
-        if(WIIMOTES[i].driver == NULL)
-            continue;
-        
+        // The driver is only looked at in here. Removing it from its slot
+        // takes the same critical section, so it can be freed once removed.
+        taskENTER_CRITICAL();
+
         wiimote_hid_t* hid = (wiimote_hid_t*)WIIMOTES[i].driver;
+        if(hid == NULL) {
+            taskEXIT_CRITICAL();
+            continue;
+        }
+
+        uint32_t generation = wiimote_slot_generation[i];
+
+        // Skip the parse if nothing has been written since last time
+        bool unchanged = wiimote_poll_state[i].valid &&
+                         wiimote_poll_state[i].generation == generation &&
+                         wiimote_poll_state[i].sequence == hid->internal_state_sequence;
 
-        // Quickly grab state
-        xSemaphoreTake(hid->internal_state_lock, portMAX_DELAY);
-        memcpy(&raw, &hid->internal_state, sizeof(raw));
-        xSemaphoreGive(hid->internal_state_lock);
+        // Writers finish inside a critical section, so this never waits on one
+        if(!unchanged)
+            wiimote_poll_state[i].sequence = wiimote_hid_read_state(hid, &raw);
 
+        taskEXIT_CRITICAL();
+
+        if(unchanged) {
+            wiimote_settle(&WIIMOTES[i]);
+            continue;
+        }
+
+        wiimote_poll_state[i].generation = generation;
+        wiimote_poll_state[i].valid = true;
 
         wiimote_update(&raw, &WIIMOTES[i]);
     }
@@ -474,34 +556,225 @@ int wiimote_find_empty_slot() {
     return -1;
 }
 
+void wiimote_set_slot(int slot, void* driver) {
+    taskENTER_CRITICAL();
+    WIIMOTES[slot].driver = driver;
+    wiimote_slot_generation[slot]++;
+    taskEXIT_CRITICAL();
+}
+
 int wiimote_remove_slot(void* driver) {
+    int ret = -1;
+
+    taskENTER_CRITICAL();
     for(int i = 0; i < WIIMOTE_MAX_REMOTES; i++) {
         if(WIIMOTES[i].driver == driver) {
             WIIMOTES[i].driver = NULL;
-            return 0;
+            wiimote_slot_generation[i]++;
+            ret = 0;
+            break;
         }
     }
-    return -1;
+    taskEXIT_CRITICAL();
+
+    return ret;
 }
 
-int wiimote_set_reporting(wiimote_t* wiimote, int present) {
-    uint8_t reporting_mode = 0x0;
-    // Search for each mode, assuming the first listed modes are more favorable
-    // Over the later ones, first mode matching all present bits
-    for(int i = 0; i < sizeof(wiimote_present_preferred_table) / sizeof(wiimote_present_preferred_table[0]); i++) {
-        uint8_t m = wiimote_present_preferred_table[i];
-        int p = wiimote_present_lookup_table[m];
-
-        // If a bit is set in the present, but not in this entry
-        // then thats bad, but if were all good, we can use this mode
-        if((present & ~p) == 0) {
-            reporting_mode = m + 0x30;
+uint8_t wiimote_select_report_type(uint32_t present) {
+    // Smallest mode carrying every present bit.
+    // On a tie, the one carrying the least that was not asked for.
+    int best = -1;
+    for(int i = 0; i < sizeof(wiimote_report_size_table) / sizeof(wiimote_report_size_table[0]); i++) {
+        int p = wiimote_present_lookup_table[i];
+        if(wiimote_report_size_table[i] == 0 || (present & ~p) != 0)
+            continue;
+
+        if(best < 0 || wiimote_report_size_table[i] < wiimote_report_size_table[best] ||
+            (wiimote_report_size_table[i] == wiimote_report_size_table[best] &&
+            __builtin_popcount(p) < __builtin_popcount(wiimote_present_lookup_table[best]))) {
+            best = i;
         }
     }
 
-    if(reporting_mode == 0x0) {
+    return best < 0 ? 0 : best + 0x30;
+}
+
+int wiimote_set_reporting(wiimote_t* wiimote, int present) {
+    if(wiimote->driver == NULL)
+        return BLERROR_ARGUMENT;
+
+    if(wiimote_select_report_type(present) == 0)
+        return BLERROR_ARGUMENT;
+
+    wiimote_hid_t* hid = (wiimote_hid_t*)wiimote->driver;
+    hid->requested_present = present;
+    int ret = wiimote_hid_apply_reporting(hid, true);
+
+    // Start in this mode next time
+    if(ret >= 0)
+        wiimote_cache_store_reporting(hid->device.mac_address, present, hid->set_report_mode);
+    return ret;
+}
+
+int wiimote_set_reporting_policy(wiimote_t* wiimote, wiimote_reporting_policy_t policy) {
+    if(wiimote->driver == NULL)
+        return BLERROR_ARGUMENT;
+
+    // The bluetooth task tracks activity with these
+    wiimote_hid_t* hid = (wiimote_hid_t*)wiimote->driver;
+    xSemaphoreTake(hid->report_lock, portMAX_DELAY);
+    hid->reporting_policy = policy;
+    hid->idle = false;
+    hid->last_activity = system_get_time_base_int();
+    xSemaphoreGive(hid->report_lock);
+
+    return wiimote_hid_update_continuous(hid);
+}
+
+int wiimote_get_reporting_stats(const wiimote_t* wiimote, wiimote_reporting_stats_t* stats) {
+    if(wiimote->driver == NULL)
         return BLERROR_ARGUMENT;
+
+    const wiimote_hid_t* hid = (const wiimote_hid_t*)wiimote->driver;
+
+    taskENTER_CRITICAL();
+    stats->report_type = hid->set_report_mode;
+    stats->ir_mode = hid->set_ir_mode;
+    stats->continuous = hid->set_continuous;
+    stats->reports = hid->report_count;
+    stats->elapsed = system_get_time_base_int() - hid->report_count_start;
+    stats->time_to_first_report = hid->first_report_time ? hid->first_report_time - hid->connect_time : 0;
+    stats->cache_hit = hid->cache_hit;
+    taskEXIT_CRITICAL();
+
+    stats->rate_hz = 0.0f;
+    if(stats->elapsed)
+        stats->rate_hz = (float)stats->reports * (float)SYSTEM_TB_CLOCK_HZ / (float)stats->elapsed;
+
+    return 0;
+}
+
+void wiimote_push_event(int slot, const wiimote_raw_t* raw, uint64_t timestamp) {
+    if(!wiimote_events.enabled || slot < 0 || slot >= WIIMOTE_MAX_REMOTES)
+        return;
+
+    if(raw->report_type < 0x30 || raw->report_type > 0x3F)
+        return;
+
+    wiimote_event_queue_t* queue = &wiimote_events.queues[slot];
+    uint32_t head = queue->head;
+
+    if(head - queue->tail >= WIIMOTE_EVENT_QUEUE_SIZE) {
+        wiimote_events.stats.events_dropped++;
+        return;
+    }
+
+    wiimote_event_t* event = &queue->events[head & (WIIMOTE_EVENT_QUEUE_SIZE - 1)];
+    event->timestamp = timestamp;
+    event->present = wiimote_present_lookup_table[raw->report_type - 0x30];
+    event->report_type = raw->report_type;
+    memcpy(event->data, raw->data_report, sizeof(event->data));
+
+    event->buttons = 0;
+    if(event->present & WIIMOTE_PRESENT_BUTTONS)
+        event->buttons = (uint16_t)raw->data_report[0] | ((uint16_t)raw->data_report[1] << 8);
+
+    event->accelerometer = vec3_new(0.0f, 0.0f, 0.0f);
+    if(event->present & WIIMOTE_PRESENT_ACCELEROMETER)
+        event->accelerometer = wiimote_parse_accelerometer(raw, event->present & WIIMOTE_PRESENT_INTERLACED);
+
+    // Publish it
+    WIIMOTE_HID_BARRIER();
+    queue->head = head + 1;
+    wiimote_events.stats.events_queued++;
+
+    xSemaphoreGive(wiimote_events.available);
+    TaskHandle_t notify = wiimote_events.notify_task;
+    if(notify != NULL)
+        xTaskNotifyGive(notify);
+}
+
+void wiimote_events_enable(bool enable) {
+    taskENTER_CRITICAL();
+    wiimote_events.enabled = enable;
+    for(int i = 0; i < WIIMOTE_MAX_REMOTES; i++) {
+        wiimote_events.queues[i].tail = wiimote_events.queues[i].head;
     }
+    taskEXIT_CRITICAL();
+}
+
+bool wiimote_event_read(int slot, wiimote_event_t* event) {
+    if(slot < 0 || slot >= WIIMOTE_MAX_REMOTES)
+        return false;
+
+    wiimote_event_queue_t* queue = &wiimote_events.queues[slot];
+    uint32_t tail = queue->tail;
+    if(tail == queue->head)
+        return false;
+
+    WIIMOTE_HID_BARRIER();
+    memcpy(event, &queue->events[tail & (WIIMOTE_EVENT_QUEUE_SIZE - 1)], sizeof(*event));
+    WIIMOTE_HID_BARRIER();
+    queue->tail = tail + 1;
+
+    // Arrival to consumption
+    uint64_t latency = system_get_time_base_int() - event->timestamp;
+    uint32_t us = (uint32_t)SYSTEM_TICKS_TO_US(latency);
+    int bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+    if(bucket >= WIIMOTE_EVENT_LATENCY_BUCKETS)
+        bucket = WIIMOTE_EVENT_LATENCY_BUCKETS - 1;
+
+    taskENTER_CRITICAL();
+    wiimote_events.stats.events_read++;
+    wiimote_events.stats.latency_total += latency;
+    if(latency > wiimote_events.stats.latency_max)
+        wiimote_events.stats.latency_max = latency;
+    wiimote_events.stats.latency_histogram[bucket]++;
+    taskEXIT_CRITICAL();
+
+    return true;
+}
+
+static bool wiimote_events_pending() {
+    for(int i = 0; i < WIIMOTE_MAX_REMOTES; i++) {
+        if(wiimote_events.queues[i].head != wiimote_events.queues[i].tail)
+            return true;
+    }
+    return false;
+}
+
+bool wiimote_event_wait(TickType_t timeout) {
+    if(wiimote_events_pending())
+        return true;
+
+    // The semaphore may be stale from events already read, so check again after
+    TickType_t start = xTaskGetTickCount();
+    TickType_t elapsed = 0;
+    while(elapsed <= timeout) {
+        if(xSemaphoreTake(wiimote_events.available, timeout - elapsed) != pdTRUE)
+            return false;
 
-    return wiimote_hid_set_report(wiimote->driver, reporting_mode, true);
-}
\ No newline at end of file
+        if(wiimote_events_pending())
+            return true;
+
+        elapsed = xTaskGetTickCount() - start;
+    }
+
+    return false;
+}
+
+void wiimote_event_set_notify(TaskHandle_t task) {
+    wiimote_events.notify_task = task;
+}
+
+void wiimote_event_get_stats(wiimote_event_stats_t* stats) {
+    taskENTER_CRITICAL();
+    memcpy(stats, &wiimote_events.stats, sizeof(*stats));
+    taskEXIT_CRITICAL();
+}
+
+void wiimote_event_reset_stats() {
+    taskENTER_CRITICAL();
+    memset(&wiimote_events.stats, 0, sizeof(wiimote_events.stats));
+    taskEXIT_CRITICAL();
+}
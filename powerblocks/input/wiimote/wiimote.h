@@ -16,6 +16,9 @@
 
 #include "powerblocks/input/wiimote/wiimote_extension.h"
 
+#include "FreeRTOS.h"
+#include "task.h"
+
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -45,6 +48,13 @@
 // Max remotes that can be connected.
 #define WIIMOTE_MAX_REMOTES 4
 
+// Events buffered per remote before new ones are dropped. Power of 2.
+#define WIIMOTE_EVENT_QUEUE_SIZE 32
+
+// Latency histogram buckets. Bucket N counts latencies under 2^N microseconds,
+// the last bucket collects everything longer.
+#define WIIMOTE_EVENT_LATENCY_BUCKETS 16
+
 typedef struct {
     // True if this wiimote has been connected.
     void *driver;
@@ -93,6 +103,52 @@ typedef struct {
     wiimote_extension_data_t extensions;
 } wiimote_t;
 
+// How the remote is asked to send reports
+typedef enum {
+    WIIMOTE_REPORTING_AUTO,       // Continuous while in use, only on change once idle. Default.
+    WIIMOTE_REPORTING_CONTINUOUS, // Always report at the full rate
+    WIIMOTE_REPORTING_ON_CHANGE   // Only report when something changes
+} wiimote_reporting_policy_t;
+
+// Delivered report rate for the current reporting configuration
+typedef struct {
+    uint8_t report_type; // Report type in use, 0x30 - 0x3F
+    uint8_t ir_mode;     // 1 basic, 3 extended, 5 full
+    bool continuous;
+
+    uint32_t reports;    // Data reports received since it was set
+    uint64_t elapsed;    // Time base ticks since it was set
+    float rate_hz;
+
+    // Time base ticks from the connection starting to the first data report, 0 if none yet
+    uint64_t time_to_first_report;
+    bool cache_hit; // Reconnected using cached calibration
+} wiimote_reporting_stats_t;
+
+// A single input report, parsed as it arrived.
+// Unlike WIIMOTES, every report is kept, along with when it came in.
+typedef struct {
+    uint64_t timestamp;  // Time base when the report came in over bluetooth
+    uint32_t present;    // WIIMOTE_PRESENT_* data in this report
+    uint16_t buttons;    // Core button state
+    vec3 accelerometer;  // Calibrated acceleration in G, if present
+
+    // Raw report, for IR and extension data
+    uint8_t report_type;
+    uint8_t data[42];
+} wiimote_event_t;
+
+typedef struct {
+    uint32_t events_queued;
+    uint32_t events_read;
+    uint32_t events_dropped; // Queue was full
+
+    // Time from arrival to being read, in time base ticks.
+    uint64_t latency_total;
+    uint64_t latency_max;
+    uint32_t latency_histogram[WIIMOTE_EVENT_LATENCY_BUCKETS];
+} wiimote_event_stats_t;
+
 extern wiimote_t WIIMOTES[WIIMOTE_MAX_REMOTES];
 
 // Initializes motes and registers drivers.
@@ -106,9 +162,41 @@ extern void wiimote_poll();
 // -1 if not slot
 extern int wiimote_find_empty_slot();
 
-// Removes a slot
+// Hands a slot to a driver, once it is fully set up
+extern void wiimote_set_slot(int slot, void* driver);
+// Removes a slot. Once removed, wiimote_poll no longer touches the driver.
 extern int wiimote_remove_slot(void* driver);
 
 // Sets what data the wiimote will report
 // Same thing as the "present" stuff
-extern int wiimote_set_reporting(wiimote_t* wiimote, int present);
\ No newline at end of file
+// The smallest report type and IR mode carrying it is used, and extension
+// data is left out while nothing is plugged in.
+extern int wiimote_set_reporting(wiimote_t* wiimote, int present);
+
+// Sets when the wiimote sends reports
+extern int wiimote_set_reporting_policy(wiimote_t* wiimote, wiimote_reporting_policy_t policy);
+
+// Gets the report rate delivered by the current configuration
+extern int wiimote_get_reporting_stats(const wiimote_t* wiimote, wiimote_reporting_stats_t* stats);
+
+// Enables or disables queuing input events.
+// Off by default, clears any queued events when changed.
+extern void wiimote_events_enable(bool enable);
+
+// Pops the oldest event for a remote.
+// Returns false if there are none.
+extern bool wiimote_event_read(int slot, wiimote_event_t* event);
+
+// Blocks until any remote has an event queued, or timeout.
+// Returns true if there are events to read.
+extern bool wiimote_event_wait(TickType_t timeout);
+
+// Sets a task to be sent a notification (xTaskNotifyGive) for every event queued.
+// NULL to stop.
+extern void wiimote_event_set_notify(TaskHandle_t task);
+
+// Reads back the event counters and latency histogram
+extern void wiimote_event_get_stats(wiimote_event_stats_t* stats);
+
+// Clears the event counters
+extern void wiimote_event_reset_stats();
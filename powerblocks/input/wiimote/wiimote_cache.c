@@ -0,0 +1,204 @@
+/**
+ * @file wiimote_cache.c
+ * @brief Remembered Wiimote Information
+ *
+ * Keeps what was learned about each wiimote the last time it connected,
+ * keyed by MAC address, so reconnecting remotes can skip the memory
+ * reads for calibration and extension type.
+ * 
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ */
+
+#include "wiimote_cache.h"
+
+#include "powerblocks/core/bluetooth/blerror.h"
+
+#include "wiimote_sys.h"
+#include "wiimote_log.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// File header, bump the version if wiimote_cache_entry_t changes
+#define WIIMOTE_CACHE_FILE_MAGIC   0x574D4331 // WMC1
+#define WIIMOTE_CACHE_FILE_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+} wiimote_cache_file_header_t;
+
+static wiimote_cache_entry_t wiimote_cache[WIIMOTE_CACHE_MAX_ENTRIES];
+static uint32_t wiimote_cache_use_counter;
+
+// Must be called in a critical section
+static wiimote_cache_entry_t* wiimote_cache_find(const uint8_t* mac_address) {
+    for(int i = 0; i < WIIMOTE_CACHE_MAX_ENTRIES; i++) {
+        if(wiimote_cache[i].flags && memcmp(wiimote_cache[i].mac_address, mac_address, 6) == 0)
+            return &wiimote_cache[i];
+    }
+    return NULL;
+}
+
+// Finds or makes an entry, replacing the least recently used if full.
+// Must be called in a critical section
+static wiimote_cache_entry_t* wiimote_cache_find_or_add(const uint8_t* mac_address) {
+    wiimote_cache_entry_t* entry = wiimote_cache_find(mac_address);
+    if(entry == NULL) {
+        entry = &wiimote_cache[0];
+        for(int i = 0; i < WIIMOTE_CACHE_MAX_ENTRIES; i++) {
+            if(wiimote_cache[i].flags == 0) {
+                entry = &wiimote_cache[i];
+                break;
+            }
+            if(wiimote_cache[i].last_used < entry->last_used)
+                entry = &wiimote_cache[i];
+        }
+
+        memset(entry, 0, sizeof(*entry));
+        memcpy(entry->mac_address, mac_address, 6);
+    }
+
+    entry->last_used = ++wiimote_cache_use_counter;
+    return entry;
+}
+
+static void wiimote_cache_add_paired(const uint8_t* sys_mac_address) {
+    // SYSCONF stores them backwards
+    uint8_t mac_address[6];
+    for(int i = 0; i < 6; i++) {
+        mac_address[i] = sys_mac_address[5 - i];
+    }
+
+    wiimote_cache_entry_t* entry = wiimote_cache_find_or_add(mac_address);
+    entry->flags |= WIIMOTE_CACHE_FLAG_PAIRED;
+}
+
+void wiimote_cache_initialize() {
+    taskENTER_CRITICAL();
+    memset(wiimote_cache, 0, sizeof(wiimote_cache));
+    wiimote_cache_use_counter = 0;
+
+    for(int i = 0; i < wiimote_sys_config.wiimotes.count; i++) {
+        wiimote_cache_add_paired(wiimote_sys_config.wiimotes.registered_entrys[i].mac_address);
+    }
+
+    for(int i = 0; i < wiimote_sys_config.guest_wiimotes.count; i++) {
+        wiimote_cache_add_paired(wiimote_sys_config.guest_wiimotes.entrys[i].mac_address);
+    }
+    taskEXIT_CRITICAL();
+}
+
+bool wiimote_cache_lookup(const uint8_t* mac_address, wiimote_cache_entry_t* entry) {
+    taskENTER_CRITICAL();
+    wiimote_cache_entry_t* found = wiimote_cache_find(mac_address);
+    if(found != NULL) {
+        found->last_used = ++wiimote_cache_use_counter;
+        memcpy(entry, found, sizeof(*entry));
+    }
+    taskEXIT_CRITICAL();
+
+    return found != NULL;
+}
+
+void wiimote_cache_store_calibration(const uint8_t* mac_address, const uint16_t* accel_zero, const uint16_t* accel_one) {
+    taskENTER_CRITICAL();
+    wiimote_cache_entry_t* entry = wiimote_cache_find_or_add(mac_address);
+    memcpy(entry->accel_zero, accel_zero, sizeof(entry->accel_zero));
+    memcpy(entry->accel_one, accel_one, sizeof(entry->accel_one));
+    entry->flags |= WIIMOTE_CACHE_FLAG_CALIBRATION;
+    taskEXIT_CRITICAL();
+}
+
+void wiimote_cache_store_extension(const uint8_t* mac_address, const uint8_t* extension_id) {
+    taskENTER_CRITICAL();
+    wiimote_cache_entry_t* entry = wiimote_cache_find_or_add(mac_address);
+    if(extension_id)
+        memcpy(entry->extension_id, extension_id, sizeof(entry->extension_id));
+    else
+        memset(entry->extension_id, 0, sizeof(entry->extension_id));
+    entry->flags |= WIIMOTE_CACHE_FLAG_EXTENSION;
+    taskEXIT_CRITICAL();
+}
+
+void wiimote_cache_store_reporting(const uint8_t* mac_address, uint32_t requested_present, uint8_t report_type) {
+    taskENTER_CRITICAL();
+    wiimote_cache_entry_t* entry = wiimote_cache_find_or_add(mac_address);
+    entry->requested_present = requested_present;
+    entry->report_type = report_type;
+    entry->flags |= WIIMOTE_CACHE_FLAG_REPORTING;
+    taskEXIT_CRITICAL();
+}
+
+int wiimote_cache_load(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if(file == NULL)
+        return BLERROR_ARGUMENT;
+
+    wiimote_cache_file_header_t header;
+    if(fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != WIIMOTE_CACHE_FILE_MAGIC || header.version != WIIMOTE_CACHE_FILE_VERSION) {
+        WIIMOTE_LOG_ERROR("Wiimote cache \"%s\" is not valid.", path);
+        fclose(file);
+        return BLERROR_RUNTIME;
+    }
+
+    int loaded = 0;
+    for(int i = 0; i < header.count; i++) {
+        wiimote_cache_entry_t saved;
+        if(fread(&saved, sizeof(saved), 1, file) != 1)
+            break;
+
+        // Paired comes from SYSCONF only, it may have changed since
+        taskENTER_CRITICAL();
+        wiimote_cache_entry_t* entry = wiimote_cache_find_or_add(saved.mac_address);
+        uint8_t paired = entry->flags & WIIMOTE_CACHE_FLAG_PAIRED;
+        memcpy(entry, &saved, sizeof(*entry));
+        entry->flags = (saved.flags & ~WIIMOTE_CACHE_FLAG_PAIRED) | paired;
+        entry->last_used = ++wiimote_cache_use_counter;
+        taskEXIT_CRITICAL();
+
+        loaded++;
+    }
+
+    fclose(file);
+    WIIMOTE_LOG_INFO("Loaded %d cached wiimotes.", loaded);
+    return 0;
+}
+
+int wiimote_cache_save(const char* path) {
+    // Copy out so the file writes are not in a critical section
+    wiimote_cache_entry_t entries[WIIMOTE_CACHE_MAX_ENTRIES];
+    wiimote_cache_file_header_t header = {
+        .magic = WIIMOTE_CACHE_FILE_MAGIC,
+        .version = WIIMOTE_CACHE_FILE_VERSION,
+        .count = 0
+    };
+
+    taskENTER_CRITICAL();
+    for(int i = 0; i < WIIMOTE_CACHE_MAX_ENTRIES; i++) {
+        // Only worth saving if something was learned
+        if(wiimote_cache[i].flags & ~WIIMOTE_CACHE_FLAG_PAIRED)
+            memcpy(&entries[header.count++], &wiimote_cache[i], sizeof(entries[0]));
+    }
+    taskEXIT_CRITICAL();
+
+    FILE* file = fopen(path, "wb");
+    if(file == NULL)
+        return BLERROR_ARGUMENT;
+
+    int ret = 0;
+    if(fwrite(&header, sizeof(header), 1, file) != 1 ||
+        (header.count && fwrite(entries, sizeof(entries[0]), header.count, file) != header.count)) {
+        WIIMOTE_LOG_ERROR("Failed to write wiimote cache \"%s\".", path);
+        ret = BLERROR_RUNTIME;
+    }
+
+    fclose(file);
+    return ret;
+}
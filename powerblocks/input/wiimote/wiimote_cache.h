@@ -0,0 +1,65 @@
+/**
+ * @file wiimote_cache.h
+ * @brief Remembered Wiimote Information
+ *
+ * Keeps what was learned about each wiimote the last time it connected,
+ * keyed by MAC address, so reconnecting remotes can skip the memory
+ * reads for calibration and extension type.
+ *
+ * Seeded with the paired remotes from SYSCONF, and can be saved and
+ * loaded from a file to survive between runs.
+ * 
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Remotes remembered at once, oldest is replaced
+#define WIIMOTE_CACHE_MAX_ENTRIES 16
+
+#define WIIMOTE_CACHE_FLAG_PAIRED      (1<<0) // Listed in SYSCONF
+#define WIIMOTE_CACHE_FLAG_CALIBRATION (1<<1) // Calibration is known
+#define WIIMOTE_CACHE_FLAG_EXTENSION   (1<<2) // Extension ID is known
+#define WIIMOTE_CACHE_FLAG_REPORTING   (1<<3) // Reporting setup is known
+
+typedef struct {
+    uint8_t mac_address[6]; // HCI order, same as hci_discovered_device_info_t
+    uint8_t flags;          // WIIMOTE_CACHE_FLAG_*
+    uint8_t report_type;    // Last report type used
+
+    uint16_t accel_zero[3];
+    uint16_t accel_one[3];
+
+    uint8_t extension_id[6]; // 6 byte code from 0x04A400FA, all 0 for none
+    uint32_t requested_present; // WIIMOTE_PRESENT_* the app last asked for
+
+    uint32_t last_used;
+} wiimote_cache_entry_t;
+
+// Clears the cache and seeds it from SYSCONF.
+// wiimote_sys_phrase_settings must have been called.
+extern void wiimote_cache_initialize();
+
+// Copies out the entry for a remote.
+// Returns false if it is unknown.
+extern bool wiimote_cache_lookup(const uint8_t* mac_address, wiimote_cache_entry_t* entry);
+
+// Stores calibration for a remote
+extern void wiimote_cache_store_calibration(const uint8_t* mac_address, const uint16_t* accel_zero, const uint16_t* accel_one);
+
+// Stores the connected extension of a remote
+extern void wiimote_cache_store_extension(const uint8_t* mac_address, const uint8_t* extension_id);
+
+// Stores the reporting setup of a remote
+extern void wiimote_cache_store_reporting(const uint8_t* mac_address, uint32_t requested_present, uint8_t report_type);
+
+// Loads entries saved with wiimote_cache_save, on top of the ones from SYSCONF.
+// Requires the filesystem. Negative if error.
+extern int wiimote_cache_load(const char* path);
+
+// Saves the cache to a file. Requires the filesystem. Negative if error.
+extern int wiimote_cache_save(const char* path);
@@ -23,6 +23,7 @@
 #include "wiimote.h"
 #include "wiimote_sys.h"
 #include "wiimote_extension.h"
+#include "wiimote_cache.h"
 #include "wiimote_log.h"
 
 #include "FreeRTOS.h"
@@ -51,6 +52,12 @@
 #define CONTROL_CHANNEL_SID   0x0040
 #define INTERRUPT_CHANNEL_SID 0x0041
 
+// Idle time before dropping to on change reports with WIIMOTE_REPORTING_AUTO
+#define WIIMOTE_IDLE_TIMEOUT_MS 500
+
+// How far a data byte has to move to count as activity. Accelerometers are never still.
+#define WIIMOTE_ACTIVITY_THRESHOLD 2
+
 #define SIGNAL_CHANNEL_INDEX    0
 #define CONTROL_CHANNEL_INDEX   1
 #define INTERRUPT_CHANNEL_INDEX 2
@@ -72,19 +79,21 @@ static void wiimote_handle_status_report(wiimote_hid_t* wiimote, const uint8_t*
     }
 
     
-    xSemaphoreTake(wiimote->internal_state_lock, portMAX_DELAY);
+    wiimote_hid_state_write_begin(wiimote);
     wiimote_raw_t* state = &wiimote->internal_state;
     state->core_state.core_buttons = ((uint16_t)report[0] << 8) | (report[1]);
     state->core_state.flags = report[2];
     state->core_state.battery_level = report[5];
-    xSemaphoreGive(wiimote->internal_state_lock);
+    wiimote_hid_state_write_end(wiimote);
 
     // Reenable reporting.
     // Since I have coded it to never request a report,
     // If we get a unrequest report, it is required we reenable reporting.
-    uint16_t old_mode = wiimote->set_report_mode;
+    // The extension may have changed too, so pick the mode again.
+    xSemaphoreTake(wiimote->report_lock, portMAX_DELAY);
     wiimote->set_report_mode = 0;
-    wiimote_hid_set_report(wiimote, old_mode, false);
+    xSemaphoreGive(wiimote->report_lock);
+    wiimote_hid_apply_reporting(wiimote, true);
 
     printf("report in, set it to: %d\n", wiimote->set_report_mode);
 
@@ -103,17 +112,68 @@ static void wiimote_handle_status_report(wiimote_hid_t* wiimote, const uint8_t*
         t = 0x00;
         wiimote_write_memory(wiimote, WIIMOTE_MEMORY_ENCRYPTION_DISABLE_B, &t, 1);
         
-        // Now request the extension type to finish the process
-        wiimote_hid_request_extension_type(wiimote);
+        // Now request the extension type to finish the process.
+        // Reconnecting with the same one plugged in, the cached type is already in use.
+        if(!wiimote->extension_cached || wiimote->internal_state.ext_mapper == NULL)
+            wiimote_hid_request_extension_type(wiimote);
+        wiimote->extension_cached = false;
     } else {
-        xSemaphoreTake(wiimote->internal_state_lock, portMAX_DELAY);
+        wiimote->extension_cached = false;
+
+        wiimote_hid_state_write_begin(wiimote);
         wiimote_raw_t* state = &wiimote->internal_state;
         state->ext_mapper = NULL;
-        xSemaphoreGive(wiimote->internal_state_lock);
+        wiimote_hid_state_write_end(wiimote);
+
+        wiimote_cache_store_extension(wiimote->device.mac_address, NULL);
+    }
+}
+
+// True if a report differs enough from the last to count as the remote being used
+static bool wiimote_report_active(const uint8_t* last, const uint8_t* report, int length) {
+    // Buttons exactly, minus the accelerometer bits packed in with them
+    if(length >= 2) {
+        if((last[0] & 0x9F) != (report[0] & 0x9F) || (last[1] & 0x9F) != (report[1] & 0x9F))
+            return true;
+    }
+
+    for(int i = 2; i < length; i++) {
+        int delta = (int)report[i] - (int)last[i];
+        if(delta > WIIMOTE_ACTIVITY_THRESHOLD || delta < -WIIMOTE_ACTIVITY_THRESHOLD)
+            return true;
     }
+
+    return false;
 }
 
-static void wiimote_handle_data_report(wiimote_hid_t* wiimote, uint8_t report_type, const uint8_t* report, size_t length) {
+// Switches between continuous and on change reporting with WIIMOTE_REPORTING_AUTO
+static void wiimote_track_activity(wiimote_hid_t* wiimote, const uint8_t* report, int length, uint64_t timestamp) {
+    if(wiimote->reporting_policy != WIIMOTE_REPORTING_AUTO)
+        return;
+
+    bool active = wiimote_report_active(wiimote->last_report, report, length);
+    memcpy(wiimote->last_report, report, length);
+
+    // The app may be changing the policy meanwhile
+    bool changed = false;
+    xSemaphoreTake(wiimote->report_lock, portMAX_DELAY);
+    if(active) {
+        wiimote->last_activity = timestamp;
+        if(wiimote->idle) {
+            wiimote->idle = false;
+            changed = true;
+        }
+    } else if(!wiimote->idle && timestamp - wiimote->last_activity > SYSTEM_MS_TO_TICKS(WIIMOTE_IDLE_TIMEOUT_MS)) {
+        wiimote->idle = true;
+        changed = true;
+    }
+    xSemaphoreGive(wiimote->report_lock);
+
+    if(changed)
+        wiimote_hid_update_continuous(wiimote);
+}
+
+static void wiimote_handle_data_report(wiimote_hid_t* wiimote, uint8_t report_type, const uint8_t* report, size_t length, uint64_t timestamp) {
     // Size of each report type starting from 0x30
     static const uint8_t report_lengths[] = {
         2, 5, 10, 17, 21, 21, 21, 21, 0, 0, 0, 0, 0, 21, 21, 21
@@ -124,8 +184,16 @@ static void wiimote_handle_data_report(wiimote_hid_t* wiimote, uint8_t report_ty
     if(length < report_length) {
         WIIMOTE_LOG_ERROR("Status report too small! %d for report %02X", length, report_type);
     }
+
+    wiimote->report_count++;
+    if(wiimote->first_report_time == 0)
+        wiimote->first_report_time = timestamp;
+
+    // Second interleaved half would always look different from the first
+    if(report_type != WIIMOTE_REPORT_INTERLEAVED_B)
+        wiimote_track_activity(wiimote, report, report_length, timestamp);
     
-    xSemaphoreTake(wiimote->internal_state_lock, portMAX_DELAY);
+    wiimote_hid_state_write_begin(wiimote);
     wiimote_raw_t* state = &wiimote->internal_state;
     if(report_type != 0x3F) {
         state->report_type = report_type;
@@ -134,7 +202,12 @@ static void wiimote_handle_data_report(wiimote_hid_t* wiimote, uint8_t report_ty
         // Interlace report. Super fun wacky weird
         memcpy(state->data_report + 21, report, report_length);
     }
-    xSemaphoreGive(wiimote->internal_state_lock);
+    wiimote_hid_state_write_end(wiimote);
+
+    // Only this task writes the state, so its safe to read here.
+    // Interleaved reports wait for their second half.
+    if(report_type != WIIMOTE_REPORT_INTERLEAVED_A && wiimote->slot >= 0)
+        wiimote_push_event(wiimote->slot, state, timestamp);
 }
 
 static void wiimote_handle_calibration_data(wiimote_hid_t* wiimote, const uint8_t* data, size_t length) {
@@ -143,6 +216,7 @@ static void wiimote_handle_calibration_data(wiimote_hid_t* wiimote, const uint8_
         return;
     }
 
+    wiimote_hid_state_write_begin(wiimote);
     uint16_t t = data[3];
     wiimote->internal_state.calibration.accel_zero[0] = ((uint16_t)data[0] << 2) | ((t >> 4) & 0b11);
     wiimote->internal_state.calibration.accel_zero[1] = ((uint16_t)data[1] << 2) | ((t >> 2) & 0b11);
@@ -157,6 +231,11 @@ static void wiimote_handle_calibration_data(wiimote_hid_t* wiimote, const uint8_
     wiimote->internal_state.calibration.accel_one[0] -= wiimote->internal_state.calibration.accel_zero[0];
     wiimote->internal_state.calibration.accel_one[1] -= wiimote->internal_state.calibration.accel_zero[1];
     wiimote->internal_state.calibration.accel_one[2] -= wiimote->internal_state.calibration.accel_zero[2];
+    wiimote_hid_state_write_end(wiimote);
+
+    // Next time it connects this read can be skipped
+    wiimote_cache_store_calibration(wiimote->device.mac_address,
+        wiimote->internal_state.calibration.accel_zero, wiimote->internal_state.calibration.accel_one);
 
     // Print it out for debugging
     WIIMOTE_LOG_DEBUG("Calibration Data:");
@@ -190,11 +269,13 @@ static void wiimote_handle_extension_type(wiimote_hid_t* wiimote, const uint8_t*
     // Up until this point, an extension was requested, we initialized it, then requested the extension type.
     // Now we will want to detect the extension type and use it
     const wiimote_extension_mapper_t* mapper = wiimote_get_mapper(data, length);
+    if(length == 6)
+        wiimote_cache_store_extension(wiimote->device.mac_address, data);
 
-    xSemaphoreTake(wiimote->internal_state_lock, portMAX_DELAY);
+    wiimote_hid_state_write_begin(wiimote);
     wiimote_raw_t* state = &wiimote->internal_state;
     state->ext_mapper = mapper;
-    xSemaphoreGive(wiimote->internal_state_lock);
+    wiimote_hid_state_write_end(wiimote);
 }
 
 static void wiimote_handle_read_memory(wiimote_hid_t* wiimote, const uint8_t* report, size_t length) {
@@ -240,6 +321,9 @@ static void wiimote_on_report_in(void* channel_v, void* wiimote_v) {
     l2cap_channel_t* channel = (l2cap_channel_t*)channel_v;
     wiimote_hid_t* wiimote = (wiimote_hid_t*)wiimote_v;
 
+    // L2CAP calls this as soon as the ACL packet is assembled
+    uint64_t timestamp = system_get_time_base_int();
+
     // Receive Report
     uint8_t payload[64];
     int payload_length = l2cap_receive_channel(channel, payload, sizeof(payload));
@@ -284,7 +368,7 @@ static void wiimote_on_report_in(void* channel_v, void* wiimote_v) {
         case WIIMOTE_REPORT_EXT21:
         case WIIMOTE_REPORT_INTERLEAVED_A:
         case WIIMOTE_REPORT_INTERLEAVED_B:
-            wiimote_handle_data_report(wiimote, report_type, report, report_length);
+            wiimote_handle_data_report(wiimote, report_type, report, report_length, timestamp);
             break;
         default:
             WIIMOTE_LOG_ERROR("Unhandled report: %02X", report_type);
@@ -400,6 +484,8 @@ static int wiimote_initialize_ir_camera(wiimote_hid_t* wiimote) {
         vTaskDelay(100 / portTICK_PERIOD_MS);
 
         // Now set mode for IR Mode register (threw the set report function)
+        // Forget the last mode, it may have been written before the camera was on.
+        wiimote->set_ir_mode = 0;
         wiimote_hid_set_report(wiimote, wiimote->set_report_mode, true);
 
         // You have to do this again for some reason?
@@ -432,9 +518,14 @@ static void wiimote_hid_initialize_state(wiimote_hid_t* wiimote, int slot) {
     wiimote->internal_state.calibration.accel_one[1] = 104;
     wiimote->internal_state.calibration.accel_one[2] = 104;
 
-    // Slot and mutex
+    // Slot
     wiimote->slot = slot;
-    wiimote->internal_state_lock = xSemaphoreCreateMutexStatic(&wiimote->semaphore_data[0]);
+
+    wiimote->report_lock = xSemaphoreCreateMutexStatic(&wiimote->report_lock_data);
+
+    // Everything by default, the policy trims it down
+    wiimote->requested_present = WIIMOTE_PRESENT_BUTTONS | WIIMOTE_PRESENT_ACCELEROMETER | WIIMOTE_PRESENT_IR | WIIMOTE_PRESENT_EXTENSION;
+    wiimote->reporting_policy = WIIMOTE_REPORTING_AUTO;
 
     // Setup Channels.
     // My L2CAP implementation requires that you
@@ -470,8 +561,32 @@ static int wiimote_hid_initialize(wiimote_hid_t* wiimote, const hci_discovered_d
     
     WIIMOTE_LOG_INFO("Configuring Wiimote");
 
+    // Anything remembered from last time it was connected
+    wiimote_cache_entry_t cached;
+    bool known = wiimote_cache_lookup(wiimote->device.mac_address, &cached);
+
+    if(known && (cached.flags & WIIMOTE_CACHE_FLAG_REPORTING))
+        wiimote->requested_present = cached.requested_present;
+
+    if(known && (cached.flags & WIIMOTE_CACHE_FLAG_CALIBRATION)) {
+        wiimote_hid_state_write_begin(wiimote);
+        memcpy(wiimote->internal_state.calibration.accel_zero, cached.accel_zero, sizeof(cached.accel_zero));
+        memcpy(wiimote->internal_state.calibration.accel_one, cached.accel_one, sizeof(cached.accel_one));
+        wiimote_hid_state_write_end(wiimote);
+        wiimote->cache_hit = true;
+    }
+
+    // Usable before the status report comes back, which then skips the extension type read
+    // if it agrees something is plugged in. Extensions plugged in later are read as usual.
+    if(known && (cached.flags & WIIMOTE_CACHE_FLAG_EXTENSION)) {
+        wiimote_hid_state_write_begin(wiimote);
+        wiimote->internal_state.ext_mapper = wiimote_extension_get_mapper(wiimote_extension_get_type(cached.extension_id));
+        wiimote_hid_state_write_end(wiimote);
+        wiimote->extension_cached = true;
+    }
+
     // Default reporting mode
-    wiimote_hid_set_report(wiimote, WIIMOTE_REPORT_BUTTONS_ACCEL_IR10_EXT6, false);
+    wiimote_hid_apply_reporting(wiimote, false);
 
     // LEDs
     int ret = wiimote_hid_set_leds(wiimote, 0x10 << (wiimote->slot & 0b11));
@@ -481,19 +596,23 @@ static int wiimote_hid_initialize(wiimote_hid_t* wiimote, const hci_discovered_d
     }
     
     // Request calibration data
-    ret = wiimote_hid_request_calibration_data(wiimote);
-    if(ret < 0) {
-        WIIMOTE_LOG_ERROR("Request calibration data failed %d", ret);
-        return ret;
+    if(!wiimote->cache_hit) {
+        ret = wiimote_hid_request_calibration_data(wiimote);
+        if(ret < 0) {
+            WIIMOTE_LOG_ERROR("Request calibration data failed %d", ret);
+            return ret;
+        }
     }
 
     // Will also off connecting any extensions.
     wiimote_request_status(wiimote);
 
-    vTaskDelay(500 / portTICK_PERIOD_MS);
+    // Let the calibration read settle first, nothing to wait on when it was cached
+    if(!wiimote->cache_hit)
+        vTaskDelay(500 / portTICK_PERIOD_MS);
 
     // Get the camera going
-    wiimote_initialize_ir_camera(wiimote);
+    ret = wiimote_initialize_ir_camera(wiimote);
     if(ret < 0) {
         WIIMOTE_LOG_ERROR("Initialize IR failed %d", ret);
         return ret;
@@ -506,15 +625,63 @@ void wiimote_hid_close(wiimote_hid_t* wiimote) {
 
 }
 
-int wiimote_hid_set_report(wiimote_hid_t* wiimote, uint8_t report_type, bool update_ir_mode) {
+int wiimote_hid_apply_reporting(wiimote_hid_t* wiimote, bool update_ir_mode) {
+    uint32_t present = wiimote->requested_present;
+
+    // No reason to carry extension bytes with nothing plugged in
+    if(!(wiimote->internal_state.core_state.flags & WIIMOTE_FLAGS_EXTENSION_CONNECTED))
+        present &= ~WIIMOTE_PRESENT_EXTENSION;
+
+    uint8_t report_type = wiimote_select_report_type(present);
+    if(report_type == 0)
+        return BLERROR_ARGUMENT;
+
+    return wiimote_hid_set_report(wiimote, report_type, update_ir_mode);
+}
+
+uint32_t wiimote_hid_read_state(wiimote_hid_t* wiimote, wiimote_raw_t* out) {
+    uint32_t sequence;
+
+    // Writers finish inside a critical section, so on a single core
+    // this only ever retries if a report landed mid copy.
+    do {
+        sequence = wiimote->internal_state_sequence;
+        WIIMOTE_HID_BARRIER();
+        memcpy(out, &wiimote->internal_state, sizeof(*out));
+        WIIMOTE_HID_BARRIER();
+    } while((sequence & 1) || sequence != wiimote->internal_state_sequence);
+
+    return sequence;
+}
+
+static int wiimote_hid_send_report_mode(wiimote_hid_t* wiimote, uint8_t report_type, bool update_ir_mode) {
+    bool continuous;
+    switch(wiimote->reporting_policy) {
+        case WIIMOTE_REPORTING_CONTINUOUS:
+            continuous = true;
+            break;
+        case WIIMOTE_REPORTING_ON_CHANGE:
+            continuous = false;
+            break;
+        default:
+            continuous = !wiimote->idle;
+            break;
+    }
+
     // Only update it if we need to
     int ret;
-    if(wiimote->set_report_mode != report_type) {
+    if(wiimote->set_report_mode != report_type || wiimote->set_continuous != continuous) {
         // Interestingly, I believe your supposed to use the set report HID code
         // But newer wiimotes make you just use the data in code.
-        uint8_t payload[4] = {WIIMOTE_HID_OUTPUT_REPORT, WIIMOTE_REPORT_REPORT_MODE, 0x00, report_type};
+        uint8_t payload[4] = {WIIMOTE_HID_OUTPUT_REPORT, WIIMOTE_REPORT_REPORT_MODE, continuous ? 0x04 : 0x00, report_type};
 
         wiimote->set_report_mode = report_type;
+        wiimote->set_continuous = continuous;
+
+        // New configuration, start measuring its rate again
+        wiimote->report_count = 0;
+        wiimote->report_count_start = system_get_time_base_int();
+
         ret = l2cap_send_channel(&wiimote->channels[INTERRUPT_CHANNEL_INDEX], payload, sizeof(payload));
         if(ret < 0)
             return ret;
@@ -549,6 +716,27 @@ int wiimote_hid_set_report(wiimote_hid_t* wiimote, uint8_t report_type, bool upd
     return ret;
 }
 
+int wiimote_hid_set_report(wiimote_hid_t* wiimote, uint8_t report_type, bool update_ir_mode) {
+    // Decide and send in one go, or two callers could send in the opposite order they decided
+    xSemaphoreTake(wiimote->report_lock, portMAX_DELAY);
+    int ret = wiimote_hid_send_report_mode(wiimote, report_type, update_ir_mode);
+    xSemaphoreGive(wiimote->report_lock);
+    return ret;
+}
+
+int wiimote_hid_update_continuous(wiimote_hid_t* wiimote) {
+    int ret = 0;
+
+    // Read the mode under the lock too, the other side may have just changed it.
+    // Nothing to update before the first mode is set, it will follow the policy.
+    xSemaphoreTake(wiimote->report_lock, portMAX_DELAY);
+    if(wiimote->set_report_mode != 0)
+        ret = wiimote_hid_send_report_mode(wiimote, wiimote->set_report_mode, false);
+    xSemaphoreGive(wiimote->report_lock);
+
+    return ret;
+}
+
 
 // White lists of accepted parameters for a remote to connect.
 // Only any one of the checks has to pass for it to try and connect.
@@ -588,6 +776,13 @@ bool wiimote_hid_driver_filter(const hci_discovered_device_info_t* device, const
 }
 
 bool wiimote_hid_driver_filter_paired(const hci_discovered_device_info_t* device) {
+    // Cache is seeded from the registry, so this is the quick way to check
+    wiimote_cache_entry_t cached;
+    if(wiimote_cache_lookup(device->address, &cached) && (cached.flags & WIIMOTE_CACHE_FLAG_PAIRED)) {
+        WIIMOTE_LOG_INFO("Found paired wiimote reconnecting.");
+        return true;
+    }
+
     // So is its MAC address recorded in the wii's paired wiimotes?
     if(wiimote_is_paired_registered(device->address)) {
         WIIMOTE_LOG_INFO("Found registered paired wiimote reconnecting.");
@@ -618,6 +813,9 @@ void* wiimote_hid_driver_initialize_new(const hci_discovered_device_info_t* devi
     // Track if on error, we need to disconnect, or even l2cap
     int init_state = 0;
 
+    // For time to first report
+    uint64_t connect_time = system_get_time_base_int();
+
     // Create Connection
     uint16_t handle;
     int ret = hci_create_connection(device, &handle);
@@ -631,6 +829,7 @@ void* wiimote_hid_driver_initialize_new(const hci_discovered_device_info_t* devi
 
     // Clear wiimote state
     wiimote_hid_initialize_state(driver, slot);
+    driver->connect_time = connect_time;
 
     // Open Device
     ret = l2cap_open_device(&driver->device, handle, device->address, driver->channels, 3);
@@ -664,7 +863,7 @@ void* wiimote_hid_driver_initialize_new(const hci_discovered_device_info_t* devi
     if(ret < 0)
         goto DRIVER_LOAD_FAILED;
 
-    WIIMOTES[slot].driver = driver;
+    wiimote_set_slot(slot, driver);
     return driver;
 
 
@@ -702,6 +901,9 @@ void* wiimote_hid_driver_initialize_paired(const hci_discovered_device_info_t* d
     // Track if on error, we need to disconnect, or even l2cap
     int init_state = 0;
 
+    // For time to first report
+    uint64_t connect_time = system_get_time_base_int();
+
     // Create Connection
     uint16_t handle;
     int ret = hci_accept_connection(device, true, &handle);
@@ -715,6 +917,7 @@ void* wiimote_hid_driver_initialize_paired(const hci_discovered_device_info_t* d
 
     // Clear wiimote state
     wiimote_hid_initialize_state(driver, slot);
+    driver->connect_time = connect_time;
 
     // Open Device
     ret = l2cap_open_device(&driver->device, handle, device->address, driver->channels, 3);
@@ -745,7 +948,7 @@ void* wiimote_hid_driver_initialize_paired(const hci_discovered_device_info_t* d
     if(ret < 0)
         goto DRIVER_LOAD_FAILED;
 
-    WIIMOTES[slot].driver = driver;
+    wiimote_set_slot(slot, driver);
 
     return driver;
 
@@ -17,6 +17,7 @@
 #include "powerblocks/input/wiimote/wiimote_extension.h"
 
 #include "FreeRTOS.h"
+#include "task.h"
 #include "semphr.h"
 
 #define WIIMOTE_REPORT_LEDS                    0x11 // Set the leds on the controller
@@ -85,14 +86,60 @@ typedef struct {
 
     uint8_t set_report_mode;
     uint8_t set_ir_mode;
-
-    // Internal state
-    SemaphoreHandle_t internal_state_lock;
+    bool set_continuous;
+
+    // The app and the bluetooth task both change the reporting mode.
+    // Held from deciding on a mode until it is sent, and around changes to the policy.
+    SemaphoreHandle_t report_lock;
+    StaticSemaphore_t report_lock_data;
+
+    // Reporting policy
+    uint32_t requested_present; // WIIMOTE_PRESENT_* the app asked for
+    wiimote_reporting_policy_t reporting_policy;
+    bool idle; // No activity in a while, drop to on change reports
+    uint64_t last_activity;
+    uint8_t last_report[21];
+
+    // Delivered reports since the reporting mode last changed
+    uint32_t report_count;
+    uint64_t report_count_start;
+
+    // Reconnect timing
+    bool cache_hit;          // Calibration came from the cache
+    bool extension_cached;   // Extension type came from the cache, trusted for the first status report
+    uint64_t connect_time;
+    uint64_t first_report_time;
+
+    // Internal state, handed to wiimote_poll with a sequence lock.
+    // The sequence is odd while a write is in progress, and
+    // readers retry if it moved while they were copying.
+    volatile uint32_t internal_state_sequence;
     wiimote_raw_t internal_state;
-
-    StaticSemaphore_t semaphore_data[1];
 } wiimote_hid_t;
 
+// Stops the compiler from moving memory accesses across the sequence.
+#define WIIMOTE_HID_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+// Begins a write to the internal state.
+// Writers never block, the critical section only keeps two writers
+// from interleaving and is held for a few stores.
+static inline void wiimote_hid_state_write_begin(wiimote_hid_t* wiimote) {
+    taskENTER_CRITICAL();
+    wiimote->internal_state_sequence++;
+    WIIMOTE_HID_BARRIER();
+}
+
+// Ends a write to the internal state, publishing it.
+static inline void wiimote_hid_state_write_end(wiimote_hid_t* wiimote) {
+    WIIMOTE_HID_BARRIER();
+    wiimote->internal_state_sequence++;
+    taskEXIT_CRITICAL();
+}
+
+// Copies out a consistent snapshot of the internal state without locking.
+// Returns the sequence number it was taken at.
+extern uint32_t wiimote_hid_read_state(wiimote_hid_t* wiimote, wiimote_raw_t* out);
+
 // Closes a connection to a wiimote
 extern void wiimote_hid_close(wiimote_hid_t* wiimote);
 
@@ -100,6 +147,12 @@ extern void wiimote_hid_close(wiimote_hid_t* wiimote);
 // You usually want to update the IR mode too.
 extern int wiimote_hid_set_report(wiimote_hid_t* wiimote, uint8_t report_type, bool update_ir_mode);
 
+// Sends the current report type again if the policy now wants it continuous or not
+extern int wiimote_hid_update_continuous(wiimote_hid_t* wiimote);
+
+// Picks and sets the report type from requested_present and the reporting policy
+extern int wiimote_hid_apply_reporting(wiimote_hid_t* wiimote, bool update_ir_mode);
+
 // Driver filter callback
 // Will allow connection if a valid wiimote and a slot is available.
 extern bool wiimote_hid_driver_filter(const hci_discovered_device_info_t* device, const char* device_name);
@@ -112,4 +165,11 @@ extern bool wiimote_hid_driver_filter_paired(const hci_discovered_device_info_t*
 extern void* wiimote_hid_driver_initialize_new(const hci_discovered_device_info_t* device);
 
 // Called to initiate a driver for a reconnecting wiimote
-extern void* wiimote_hid_driver_initialize_paired(const hci_discovered_device_info_t* device);
\ No newline at end of file
+extern void* wiimote_hid_driver_initialize_paired(const hci_discovered_device_info_t* device);
+
+// Smallest report type carrying all the present bits, or 0 if none can. Implemented in wiimote.c.
+extern uint8_t wiimote_select_report_type(uint32_t present);
+
+// Queues a input event from the state of a slot. Implemented in wiimote.c.
+// Called by the receive side after each data report.
+extern void wiimote_push_event(int slot, const wiimote_raw_t* raw, uint64_t timestamp);
@@ -0,0 +1,272 @@
+/**
+ * @file archive_test.c
+ * @brief Test for the packed asset archive reader.
+ *
+ * Reads an archive packed from archive_fixture/ by tools/archive at build time,
+ * so the reader is checked against what the packer really writes, byte order
+ * and all. The archive is copied onto a FAT image on the image drive, then
+ * every entry is looked up, read back whole and in odd sized pieces, and
+ * checked against the fixture's files. The LZ4 entries use small blocks so
+ * they span several, some stored and some compressed.
+ *
+ * Damaged copies of the header must fail to mount.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "powerblocks/filesystem/archive.h"
+#include "powerblocks/filesystem/image_disk.h"
+#include "powerblocks/core/system/mem.h"
+#include "powerblocks/core/utils/log.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "ff.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_IMAGE_SIZE (4 * 1024 * 1024)
+
+#define TEST_TASK_STACK_SIZE (64 * 1024)
+#define TEST_TASK_PRIORITY   (configMAX_PRIORITIES - 4)
+
+// Packed with BLOCK_SIZE 256 in CMakeLists.txt
+#define TEST_BLOCK_SIZE 256
+
+typedef struct {
+    const char* name;
+    bool compressed;
+} test_entry_t;
+
+static const test_entry_t test_entries[] = {
+    { "readme.txt",        true  },
+    { "levels/level1.dat", true  },
+    { "sprites/noise.bin", false },
+};
+
+#define TEST_ENTRY_COUNT (sizeof(test_entries) / sizeof(test_entries[0]))
+
+static FATFS test_fs;
+static uint8_t test_mkfs_work[FF_MAX_SS * 8];
+static uint8_t* test_image;
+
+static archive_t test_archive;
+
+static bool test_fail(const char* name, const char* what) {
+    printf("%s: %s\n", name, what);
+    return false;
+}
+
+// Reads a whole host file, the caller frees it
+static uint8_t* test_read_host(const char* path, uint32_t* size) {
+    FILE* file = fopen(path, "rb");
+    if(file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t* data = (uint8_t*)malloc(length ? length : 1);
+    if(data != NULL && fread(data, 1, length, file) != (size_t)length) {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(file);
+    *size = (uint32_t)length;
+    return data;
+}
+
+static bool test_write_image(const char* path, const uint8_t* data, uint32_t size) {
+    FIL file;
+    if(f_open(&file, path, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+        return false;
+
+    UINT written = 0;
+    FRESULT res = f_write(&file, data, size, &written);
+    f_close(&file);
+
+    return res == FR_OK && written == size;
+}
+
+static bool test_entry(const test_entry_t* expect) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", TEST_FIXTURE_PATH, expect->name);
+
+    uint32_t size;
+    uint8_t* source = test_read_host(path, &size);
+    if(source == NULL)
+        return test_fail(expect->name, "fixture file missing");
+
+    bool passed = false;
+
+    int index = archive_find(&test_archive, expect->name);
+    archive_info_t info;
+    if(index < 0 || archive_get_info(&test_archive, (uint32_t)index, &info) < 0) {
+        test_fail(expect->name, "lookup failed");
+        goto done;
+    }
+
+    if(strcmp(info.name, expect->name) != 0 || info.size != size) {
+        test_fail(expect->name, "info does not match the fixture");
+        goto done;
+    }
+
+    if(info.compressed != expect->compressed) {
+        test_fail(expect->name, expect->compressed ? "expected LZ4" : "expected stored");
+        goto done;
+    }
+
+    // Whole, straight into the caller's buffer
+    uint32_t loaded_size = 0;
+    uint8_t* loaded = (uint8_t*)archive_load(&test_archive, expect->name, &loaded_size);
+    if(loaded == NULL || loaded_size != size || memcmp(loaded, source, size) != 0) {
+        if(loaded)
+            mem_free(loaded);
+        test_fail(expect->name, "load does not match the fixture");
+        goto done;
+    }
+    mem_free(loaded);
+
+    // Odd sized pieces, so reads end mid block and straddle them
+    archive_file_t file;
+    if(archive_open(&test_archive, &file, expect->name) < 0) {
+        test_fail(expect->name, "open failed");
+        goto done;
+    }
+
+    uint8_t piece[TEST_BLOCK_SIZE + 61];
+    uint32_t position = 0;
+    uint32_t step = 1;
+    while(true) {
+        int read = archive_read(&file, piece, step);
+        if(read <= 0)
+            break;
+
+        if(position + read > size || memcmp(piece, source + position, read) != 0) {
+            archive_close(&file);
+            test_fail(expect->name, "piecewise read does not match the fixture");
+            goto done;
+        }
+
+        position += read;
+        step = step * 7 % sizeof(piece) + 1;
+    }
+    archive_close(&file);
+
+    if(position != size) {
+        test_fail(expect->name, "piecewise read stopped early");
+        goto done;
+    }
+
+    passed = true;
+
+done:
+    free(source);
+    return passed;
+}
+
+// Mounts a copy of the archive with one header word changed
+static bool test_damaged_header(const uint8_t* pba, uint32_t size, uint32_t offset, uint32_t value, const char* what) {
+    uint8_t* copy = (uint8_t*)malloc(size);
+    memcpy(copy, pba, size);
+
+    copy[offset + 0] = (uint8_t)(value >> 24);
+    copy[offset + 1] = (uint8_t)(value >> 16);
+    copy[offset + 2] = (uint8_t)(value >> 8);
+    copy[offset + 3] = (uint8_t)value;
+
+    bool written = test_write_image("1:/damaged.pba", copy, size);
+    free(copy);
+    if(!written)
+        return test_fail(what, "could not write the damaged copy");
+
+    archive_t damaged;
+    if(archive_mount(&damaged, "1:/damaged.pba") == 0) {
+        archive_unmount(&damaged);
+        return test_fail(what, "damaged archive mounted");
+    }
+
+    return true;
+}
+
+static int test_run() {
+    test_image = (uint8_t*)calloc(1, TEST_IMAGE_SIZE);
+    image_disk_attach(test_image, TEST_IMAGE_SIZE, NULL);
+
+    MKFS_PARM format = { .fmt = FM_ANY };
+    if(f_mkfs("1:", &format, test_mkfs_work, sizeof(test_mkfs_work)) != FR_OK ||
+       f_mount(&test_fs, "1:", 1) != FR_OK) {
+        printf("Could not format and mount the image\n");
+        return 1;
+    }
+
+    uint32_t pba_size;
+    uint8_t* pba = test_read_host(TEST_ARCHIVE_PATH, &pba_size);
+    if(pba == NULL || !test_write_image("1:/assets.pba", pba, pba_size)) {
+        printf("Could not copy %s onto the image\n", TEST_ARCHIVE_PATH);
+        return 1;
+    }
+
+    if(archive_mount(&test_archive, "1:/assets.pba") < 0) {
+        printf("Could not mount the archive\n");
+        return 1;
+    }
+
+    bool failed = false;
+
+    if(archive_count(&test_archive) != TEST_ENTRY_COUNT)
+        failed = !test_fail("archive", "wrong entry count");
+
+    if(archive_find(&test_archive, "missing.txt") >= 0)
+        failed = !test_fail("missing.txt", "found an entry that is not there");
+
+    for(uint32_t i = 0; i < TEST_ENTRY_COUNT; i++) {
+        if(!test_entry(&test_entries[i]))
+            failed = true;
+    }
+
+    archive_unmount(&test_archive);
+
+    // Header words, see archive_header_t
+    if(!test_damaged_header(pba, pba_size, 0, 0x50424158, "bad magic") ||
+       !test_damaged_header(pba, pba_size, 4, 0x00020000, "bad version") ||
+       !test_damaged_header(pba, pba_size, 8, 0x00100000, "entry count past the end") ||
+       !test_damaged_header(pba, pba_size, 12, 100, "unaligned block size") ||
+       !test_damaged_header(pba, pba_size, 16, 40, "names overlapping the index"))
+        failed = true;
+
+    free(pba);
+    f_unmount("1:");
+    image_disk_detach();
+    free(test_image);
+
+    if(failed)
+        return 1;
+
+    printf("%d entries read back, damaged headers rejected\n", (int)TEST_ENTRY_COUNT);
+    return 0;
+}
+
+static void test_task(void* unused) {
+    exit(test_run());
+}
+
+int main() {
+    // Keeps the output in order if a task aborts
+    setvbuf(stdout, NULL, _IONBF, 0);
+    log_initialize();
+
+    xTaskCreate(test_task, "TEST", TEST_TASK_STACK_SIZE / sizeof(StackType_t), NULL, TEST_TASK_PRIORITY, NULL);
+    vTaskStartScheduler();
+
+    return 1;
+}
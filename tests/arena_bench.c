@@ -0,0 +1,232 @@
+/**
+ * @file arena_bench.c
+ * @brief Arena and pool microbenchmark against malloc.
+ *
+ * The same loops as the FrameArena example, timed on the host with
+ * the host's malloc. Draw commands for a frame come from malloc or a
+ * frame arena, and packets in flight come from malloc or a pool.
+ *
+ * Checks the arena's alignment handling first, so it fails
+ * like a test if that is broken.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "powerblocks/core/utils/arena.h"
+#include "powerblocks/core/utils/pool.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_FRAME_COUNT        20000
+#define BENCH_COMMANDS_PER_FRAME 256
+#define BENCH_ARENA_SIZE         (512 * 1024)
+
+#define BENCH_PACKET_ROUNDS      100000
+#define BENCH_PACKETS_IN_FLIGHT  32
+
+typedef struct {
+    uint32_t key;
+    uint16_t mesh;
+    uint16_t material;
+    float matrix[3][4];
+} bench_draw_command_t;
+
+typedef struct {
+    uint16_t handle;
+    uint16_t length;
+    uint8_t data[60];
+} bench_packet_t;
+
+POOL_DEFINE(bench_packet_pool, bench_packet_t, BENCH_PACKETS_IN_FLIGHT);
+
+static uint8_t bench_arena_memory[BENCH_ARENA_SIZE] __attribute__((aligned(ARENA_GX_ALIGN)));
+static frame_arena_t bench_frame_arena;
+
+// Keeps the compiler from dropping allocations nothing reads
+static volatile uint32_t bench_sink;
+
+static uint64_t bench_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void bench_print(const char* name, uint64_t ns, uint64_t count) {
+    printf("  %s %6.2f ns per allocation\n", name, (double)ns / (double)count);
+}
+
+// Different amount of work every frame
+static uint32_t bench_commands_in_frame(uint32_t frame) {
+    return BENCH_COMMANDS_PER_FRAME / 2 + (frame * 7919) % BENCH_COMMANDS_PER_FRAME;
+}
+
+static void bench_build_frame(bench_draw_command_t** commands, uint32_t* keys, uint32_t count) {
+    uint32_t sum = 0;
+    for(uint32_t i = 0; i < count; i++) {
+        commands[i]->key = i * 2654435761u;
+        keys[i] = commands[i]->key;
+        sum += keys[i];
+    }
+    bench_sink += sum;
+}
+
+static bool bench_check_arena() {
+    static uint8_t memory[256] __attribute__((aligned(64)));
+    arena_t arena;
+    arena_initialize(&arena, memory, sizeof(memory));
+
+    static const uint32_t bad[] = { 0, 3, 24, 0x80000001 };
+    for(int i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        if(arena_alloc(&arena, 1, bad[i]) != NULL || arena_mark(&arena) != 0) {
+            printf("arena_alloc took alignment %u\n", bad[i]);
+            return false;
+        }
+    }
+
+    for(uint32_t alignment = 1; alignment <= 64; alignment <<= 1) {
+        void* p = arena_alloc(&arena, 1, alignment);
+        if(p == NULL || ((uintptr_t)p & (alignment - 1)) != 0) {
+            printf("arena_alloc did not align to %u\n", alignment);
+            return false;
+        }
+    }
+
+    // Nothing past the end, and release gives it back
+    uint32_t mark = arena_mark(&arena);
+    if(arena_alloc(&arena, sizeof(memory), 1) != NULL) {
+        printf("arena_alloc went past the end\n");
+        return false;
+    }
+    arena_alloc(&arena, 8, 1);
+    arena_release(&arena, mark);
+    if(arena_mark(&arena) != mark) {
+        printf("arena_release did not go back to the mark\n");
+        return false;
+    }
+
+    return true;
+}
+
+static void bench_frames_malloc() {
+    static bench_draw_command_t* commands[BENCH_COMMANDS_PER_FRAME * 2];
+    uint64_t allocations = 0;
+
+    uint64_t start = bench_now();
+    for(uint32_t frame = 0; frame < BENCH_FRAME_COUNT; frame++) {
+        uint32_t count = bench_commands_in_frame(frame);
+
+        for(uint32_t i = 0; i < count; i++)
+            commands[i] = malloc(sizeof(bench_draw_command_t));
+        uint32_t* keys = malloc(count * sizeof(uint32_t));
+        allocations += count + 1;
+
+        bench_build_frame(commands, keys, count);
+
+        for(uint32_t i = 0; i < count; i++)
+            free(commands[i]);
+        free(keys);
+    }
+
+    bench_print("malloc + free      ", bench_now() - start, allocations);
+}
+
+static bool bench_frames_arena() {
+    static bench_draw_command_t* commands[BENCH_COMMANDS_PER_FRAME * 2];
+    uint64_t allocations = 0;
+
+    frame_arena_initialize(&bench_frame_arena, bench_arena_memory, BENCH_ARENA_SIZE);
+
+    uint64_t start = bench_now();
+    for(uint32_t frame = 0; frame < BENCH_FRAME_COUNT; frame++) {
+        uint32_t count = bench_commands_in_frame(frame);
+
+        for(uint32_t i = 0; i < count; i++)
+            commands[i] = frame_arena_alloc(&bench_frame_arena, sizeof(bench_draw_command_t));
+        uint32_t* keys = frame_arena_alloc(&bench_frame_arena, count * sizeof(uint32_t));
+        allocations += count + 1;
+
+        bench_build_frame(commands, keys, count);
+
+        frame_arena_next(&bench_frame_arena);
+    }
+
+    bench_print("Frame arena        ", bench_now() - start, allocations);
+
+    arena_stats_t stats;
+    arena_get_stats(frame_arena_current(&bench_frame_arena), &stats);
+    if(stats.failures != 0) {
+        printf("Frame arena ran out, peak %u of %u bytes\n", stats.peak_used, stats.size);
+        return false;
+    }
+
+    return true;
+}
+
+static void bench_packets_malloc() {
+    bench_packet_t* packets[BENCH_PACKETS_IN_FLIGHT];
+
+    uint64_t start = bench_now();
+    for(int round = 0; round < BENCH_PACKET_ROUNDS; round++) {
+        for(int i = 0; i < BENCH_PACKETS_IN_FLIGHT; i++) {
+            packets[i] = malloc(sizeof(bench_packet_t));
+            packets[i]->handle = i;
+        }
+        for(int i = 0; i < BENCH_PACKETS_IN_FLIGHT; i++) {
+            bench_sink += packets[i]->handle;
+            free(packets[i]);
+        }
+    }
+
+    bench_print("Packets, malloc    ", bench_now() - start, (uint64_t)BENCH_PACKET_ROUNDS * BENCH_PACKETS_IN_FLIGHT);
+}
+
+static bool bench_packets_pool() {
+    bench_packet_t* packets[BENCH_PACKETS_IN_FLIGHT];
+
+    uint64_t start = bench_now();
+    for(int round = 0; round < BENCH_PACKET_ROUNDS; round++) {
+        for(int i = 0; i < BENCH_PACKETS_IN_FLIGHT; i++) {
+            packets[i] = bench_packet_pool_alloc();
+            packets[i]->handle = i;
+        }
+        for(int i = 0; i < BENCH_PACKETS_IN_FLIGHT; i++) {
+            bench_sink += packets[i]->handle;
+            bench_packet_pool_free(packets[i]);
+        }
+    }
+
+    bench_print("Packets, pool      ", bench_now() - start, (uint64_t)BENCH_PACKET_ROUNDS * BENCH_PACKETS_IN_FLIGHT);
+
+    pool_stats_t stats;
+    pool_get_stats(&bench_packet_pool, &stats);
+    if(stats.failures != 0 || stats.used != 0) {
+        printf("Pool ran out or leaked, %u failed, %u still used\n", stats.failures, stats.used);
+        return false;
+    }
+
+    return true;
+}
+
+int main() {
+    if(!bench_check_arena())
+        return 1;
+
+    printf("%d frames of %d to %d draw commands:\n", BENCH_FRAME_COUNT,
+           BENCH_COMMANDS_PER_FRAME / 2, BENCH_COMMANDS_PER_FRAME * 3 / 2 - 1);
+    bench_frames_malloc();
+    if(!bench_frames_arena())
+        return 1;
+
+    printf("%d packets in flight:\n", BENCH_PACKETS_IN_FLIGHT);
+    bench_packets_malloc();
+    if(!bench_packets_pool())
+        return 1;
+
+    return 0;
+}
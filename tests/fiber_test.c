@@ -0,0 +1,242 @@
+/**
+ * @file fiber_test.c
+ * @brief Scheduling test for fibers and jobs.
+ *
+ * Runs utils/fiber.c on the host, where it switches with ucontext.
+ * Checks batches and their counters, dependencies, taking turns on
+ * yields, a tree of jobs waiting on their children, counters signalled
+ * from outside a job, the stack check, and the scheduler counters.
+ *
+ * The switch itself is fiber_asm.s on the Wii, that is not covered here.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "powerblocks/core/utils/fiber.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_STACK_SIZE (32 * 1024)
+
+// Depth and width of the job tree, every job above the
+// leaves waits on its children and keeps its fiber
+#define TEST_TREE_DEPTH 3
+#define TEST_TREE_WIDTH 2
+
+#define TEST_FAN_OUT    100
+#define TEST_YIELDERS   4
+#define TEST_YIELDS     8
+
+static uint8_t test_stacks[FIBER_MAX_FIBERS][TEST_STACK_SIZE] __attribute__((aligned(16)));
+static fiber_scheduler_t test_scheduler;
+
+static bool test_failed;
+
+// Order jobs ran in, one letter each
+static char test_order[256];
+static uint32_t test_order_length;
+
+static uint32_t test_leaves;
+static fiber_counter_t test_stage;
+static fiber_counter_t test_outside;
+
+static void test_expect(bool ok, const char* what) {
+    if(ok)
+        return;
+
+    printf("%s\n", what);
+    test_failed = true;
+}
+
+static void test_log(char c) {
+    if(test_order_length < sizeof(test_order) - 1)
+        test_order[test_order_length++] = c;
+}
+
+static void test_count_job(fiber_scheduler_t* scheduler, void* param) {
+    (void)scheduler;
+    (*(uint32_t*)param)++;
+}
+
+// Logs its letter once per turn
+static void test_yield_job(fiber_scheduler_t* scheduler, void* param) {
+    for(int i = 0; i < TEST_YIELDS; i++) {
+        test_log((char)(uintptr_t)param);
+        fiber_yield(scheduler);
+    }
+}
+
+static void test_after_stage_job(fiber_scheduler_t* scheduler, void* param) {
+    (void)scheduler;
+    (void)param;
+    test_expect(test_stage.value == 0, "Dependent job started before its dependency finished");
+    test_log('D');
+}
+
+static void test_stage_job(fiber_scheduler_t* scheduler, void* param) {
+    (void)param;
+    fiber_yield(scheduler);
+    test_log('S');
+}
+
+static void test_tree_job(fiber_scheduler_t* scheduler, void* param) {
+    uint32_t depth = (uint32_t)(uintptr_t)param;
+
+    // Keeps a value across every switch below it
+    volatile double check = 1.0 + depth;
+
+    if(depth == TEST_TREE_DEPTH) {
+        test_leaves++;
+        fiber_yield(scheduler);
+        test_expect(check == 1.0 + depth, "Leaf lost a local across a yield");
+        return;
+    }
+
+    fiber_job_t children[TEST_TREE_WIDTH];
+    for(int i = 0; i < TEST_TREE_WIDTH; i++) {
+        children[i].function = test_tree_job;
+        children[i].param = (void*)(uintptr_t)(depth + 1);
+        children[i].dependency = NULL;
+    }
+
+    fiber_counter_t done = { 0 };
+    test_expect(fiber_run_jobs(scheduler, children, TEST_TREE_WIDTH, &done) == 0, "Could not queue the children");
+    test_expect(fiber_wait(scheduler, &done) == 0 && done.value == 0, "Wait came back before the children finished");
+    test_expect(check == 1.0 + depth, "Job lost a local across a wait");
+}
+
+// Something outside the scheduler, done by the time it yields back
+static void test_outside_job(fiber_scheduler_t* scheduler, void* param) {
+    (void)param;
+    fiber_yield(scheduler);
+    test_log('O');
+
+    BaseType_t woken = pdFALSE;
+    fiber_counter_signal_from_isr(scheduler, &test_outside, &woken);
+}
+
+static void test_root_job(fiber_scheduler_t* scheduler, void* param) {
+    (void)param;
+
+    int on_stack;
+    test_expect(fiber_stack_in_bounds((void*)1, &on_stack), "Job's stack is not the fiber's");
+
+    // A batch bigger than the fibers, everything gets ran
+    static fiber_job_t fan_out[TEST_FAN_OUT];
+    uint32_t ran = 0;
+    for(int i = 0; i < TEST_FAN_OUT; i++) {
+        fan_out[i].function = test_count_job;
+        fan_out[i].param = &ran;
+        fan_out[i].dependency = NULL;
+    }
+
+    fiber_counter_t batch = { 0 };
+    test_expect(fiber_run_jobs(scheduler, fan_out, TEST_FAN_OUT, &batch) == 0, "Could not queue the batch");
+    test_expect(batch.value == TEST_FAN_OUT, "Batch counter not raised when queued");
+    fiber_wait(scheduler, &batch);
+    test_expect(ran == TEST_FAN_OUT && batch.value == 0, "Batch did not all run");
+
+    // Queued first, but held until the stage is done
+    test_order_length = 0;
+    fiber_job_t after = { test_after_stage_job, NULL, &test_stage };
+    fiber_job_t stage[2] = { { test_stage_job, NULL, NULL }, { test_stage_job, NULL, NULL } };
+    fiber_counter_t both = { 0 };
+    fiber_run_jobs(scheduler, &after, 1, &both);
+    fiber_run_jobs(scheduler, stage, 2, &test_stage);
+    fiber_wait(scheduler, &both);
+    test_order[test_order_length] = 0;
+    test_expect(test_stage.value == 0, "Stage did not finish");
+    test_expect(strcmp(test_order, "SSD") == 0, "Dependent job did not run last");
+
+    // Yielding jobs take turns
+    test_order_length = 0;
+    fiber_job_t yielders[TEST_YIELDERS];
+    for(int i = 0; i < TEST_YIELDERS; i++) {
+        yielders[i].function = test_yield_job;
+        yielders[i].param = (void*)(uintptr_t)('a' + i);
+        yielders[i].dependency = NULL;
+    }
+    fiber_counter_t turns = { 0 };
+    fiber_run_jobs(scheduler, yielders, TEST_YIELDERS, &turns);
+    fiber_wait(scheduler, &turns);
+    for(uint32_t i = 0; i < TEST_YIELDERS * TEST_YIELDS; i++)
+        test_expect(test_order[i] == 'a' + i % TEST_YIELDERS, "Yielding jobs did not take turns");
+
+    // Jobs waiting on jobs waiting on jobs
+    test_leaves = 0;
+    fiber_job_t tree = { test_tree_job, (void*)0, NULL };
+    fiber_counter_t tree_done = { 0 };
+    fiber_run_jobs(scheduler, &tree, 1, &tree_done);
+    fiber_wait(scheduler, &tree_done);
+    uint32_t leaves = 1;
+    for(int i = 0; i < TEST_TREE_DEPTH; i++)
+        leaves *= TEST_TREE_WIDTH;
+    test_expect(test_leaves == leaves, "Not every leaf of the tree ran");
+
+    // Counted down from outside any job
+    test_order_length = 0;
+    fiber_counter_add(&test_outside, 1);
+    fiber_job_t outside = { test_outside_job, NULL, NULL };
+    fiber_run_jobs(scheduler, &outside, 1, NULL);
+    fiber_wait(scheduler, &test_outside);
+    test_log('W');
+    test_order[test_order_length] = 0;
+    test_expect(strcmp(test_order, "OW") == 0, "Wait on an outside counter came back early");
+}
+
+int main() {
+    if(fiber_scheduler_initialize(&test_scheduler, test_stacks, FIBER_MIN_STACK_SIZE - 1, 4) >= 0 ||
+       fiber_scheduler_initialize(&test_scheduler, test_stacks, TEST_STACK_SIZE, FIBER_MAX_FIBERS + 1) >= 0 ||
+       fiber_scheduler_initialize(&test_scheduler, test_stacks, TEST_STACK_SIZE, 0) >= 0) {
+        printf("Took a bad stack size or fiber count\n");
+        return 1;
+    }
+
+    if(fiber_scheduler_initialize(&test_scheduler, test_stacks, TEST_STACK_SIZE, FIBER_MAX_FIBERS) < 0) {
+        printf("Could not set up the scheduler\n");
+        return 1;
+    }
+
+    // Runs twice, everything has to come back the way it was
+    for(int run = 0; run < 2 && !test_failed; run++) {
+        if(fiber_scheduler_run(&test_scheduler, test_root_job, NULL) < 0) {
+            printf("Run %d failed\n", run);
+            return 1;
+        }
+    }
+
+    if(test_failed)
+        return 1;
+
+    // Not in a job anymore
+    int on_stack;
+    fiber_counter_t pending = { 1 };
+    if(fiber_wait(&test_scheduler, &pending) >= 0 || fiber_stack_in_bounds((void*)1, &on_stack)) {
+        printf("Acted like a job outside the scheduler\n");
+        return 1;
+    }
+
+    // Too many at once is refused whole
+    static fiber_job_t too_many[FIBER_MAX_JOBS + 1];
+    fiber_counter_t counter = { 0 };
+    if(fiber_run_jobs(&test_scheduler, too_many, FIBER_MAX_JOBS + 1, &counter) >= 0 || counter.value != 0) {
+        printf("Queued more jobs than fit\n");
+        return 1;
+    }
+
+    fiber_stats_t stats;
+    fiber_get_stats(&test_scheduler, &stats);
+    if(test_scheduler.fibers_busy != 0 || test_scheduler.job_count != 0 || stats.max_fibers > FIBER_MAX_FIBERS) {
+        printf("Scheduler did not come back empty\n");
+        return 1;
+    }
+
+    printf("%u jobs, %u switches, %u waits, at most %u fibers and %u queued\n",
+           stats.jobs, stats.switches, stats.waits, stats.max_fibers, stats.max_queued);
+    return 0;
+}
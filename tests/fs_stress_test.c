@@ -0,0 +1,411 @@
+/**
+ * @file fs_stress_test.c
+ * @brief Stress test for the POSIX file calls on a disk image.
+ *
+ * Runs FatFS, the sector cache and fs_syscall.c on FreeRTOS's POSIX port.
+ * The image drive is backed by a FAT image file mapped into memory, and
+ * waits out a simulated command latency, so tasks block in the middle of
+ * FatFS calls and interleave the way they would on the SD card.
+ *
+ * Several tasks at once write, seek, read back and check their own files,
+ * and pread one big shared file through a single descriptor. Everything is
+ * checked again after remounting, and again after the image file is mapped
+ * in fresh, so nothing can be left sitting in the cache.
+ *
+ * fs_syscall.c is renamed, same as in memory_test, so it sits next to the
+ * host's C library. The code here calls it by the usual names.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "powerblocks/filesystem/disk_cache.h"
+#include "powerblocks/filesystem/image_disk.h"
+#include "powerblocks/filesystem/fs_syscall.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "ff.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TEST_IMAGE_PATH "fs_stress.img"
+#define TEST_IMAGE_SIZE (8 * 1024 * 1024)
+
+// A whole tick per command, so every one that reaches the image sleeps like waiting on IOS would
+#define TEST_COMMAND_US 1000
+#define TEST_SECTOR_US  2
+
+#define TEST_TASKS       6
+#define TEST_PASSES      12
+#define TEST_FILE_SIZE   (24 * 1024)
+#define TEST_SHARED_SIZE (1536 * 1024) // Big enough for a fast seek map
+#define TEST_PREAD_SIZE  3000
+
+#define TEST_TASK_STACK_SIZE (64 * 1024)
+#define TEST_TASK_PRIORITY   (configMAX_PRIORITIES - 4)
+
+typedef struct {
+    int id;
+    uint32_t seed;
+    uint32_t passes;
+    const char* error; // First thing that went wrong, NULL if nothing
+    volatile bool done;
+
+    uint8_t pattern[TEST_FILE_SIZE];
+    uint8_t readback[TEST_FILE_SIZE];
+    uint8_t window[TEST_PREAD_SIZE];
+} test_worker_t;
+
+static FATFS test_fs;
+static uint8_t test_mkfs_work[FF_MAX_SS * 8];
+
+static uint8_t* test_image;
+static int test_shared_fd;
+static test_worker_t test_workers[TEST_TASKS];
+
+static uint32_t test_next(uint32_t* seed) {
+    *seed = *seed * 1664525 + 1013904223;
+    return *seed;
+}
+
+// The shared file's byte at any offset, so any window can be checked
+static uint8_t test_shared_byte(uint32_t offset) {
+    return (uint8_t)((offset * 2654435761u) >> 24);
+}
+
+static bool test_fail(test_worker_t* worker, const char* what) {
+    if(worker->error == NULL)
+        worker->error = what;
+    return false;
+}
+
+// Maps the image file in, creating it if needed
+static bool test_map_image(bool create) {
+    FILE* file = fopen(TEST_IMAGE_PATH, create ? "w+b" : "r+b");
+    if(file == NULL)
+        return false;
+
+    if(create && ftruncate(fileno(file), TEST_IMAGE_SIZE) != 0) {
+        fclose(file);
+        return false;
+    }
+
+    void* image = mmap(NULL, TEST_IMAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(file), 0);
+    fclose(file);
+    if(image == MAP_FAILED)
+        return false;
+
+    test_image = (uint8_t*)image;
+    return true;
+}
+
+static void test_unmap_image() {
+    msync(test_image, TEST_IMAGE_SIZE, MS_SYNC);
+    munmap(test_image, TEST_IMAGE_SIZE);
+    test_image = NULL;
+}
+
+static void test_make_pattern(test_worker_t* worker) {
+    for(int i = 0; i < TEST_FILE_SIZE; i++)
+        worker->pattern[i] = (uint8_t)(test_next(&worker->seed) >> 24);
+}
+
+static bool test_write_file(test_worker_t* worker, const char* path) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC);
+    if(fd < 0)
+        return test_fail(worker, "open for writing failed");
+
+    // Odd sized pieces so writes straddle sectors
+    int written = 0;
+    while(written < TEST_FILE_SIZE) {
+        int piece = 1 + test_next(&worker->seed) % 1500;
+        if(piece > TEST_FILE_SIZE - written)
+            piece = TEST_FILE_SIZE - written;
+
+        if(write(fd, worker->pattern + written, piece) != piece) {
+            close(fd);
+            return test_fail(worker, "short write");
+        }
+        written += piece;
+
+        // The volume lock is not handed over when freed, let the others in
+        taskYIELD();
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size != TEST_FILE_SIZE) {
+        close(fd);
+        return test_fail(worker, "fstat has the wrong size");
+    }
+
+    // Back over it while still open, through the same window the writes went through
+    if(lseek(fd, 0, SEEK_SET) != 0 || read(fd, worker->readback, TEST_FILE_SIZE) != TEST_FILE_SIZE) {
+        close(fd);
+        return test_fail(worker, "read back failed");
+    }
+
+    if(memcmp(worker->pattern, worker->readback, TEST_FILE_SIZE) != 0) {
+        close(fd);
+        return test_fail(worker, "read back does not match what was written");
+    }
+
+    // Overwrite a piece in the middle and check the position lands after it
+    off_t middle = test_next(&worker->seed) % (TEST_FILE_SIZE - 700);
+    for(int i = 0; i < 700; i++)
+        worker->pattern[middle + i] ^= 0x5A;
+
+    if(lseek(fd, middle, SEEK_SET) != middle || write(fd, worker->pattern + middle, 700) != 700 ||
+       lseek(fd, 0, SEEK_CUR) != middle + 700) {
+        close(fd);
+        return test_fail(worker, "overwrite in the middle failed");
+    }
+
+    if(close(fd) != 0)
+        return test_fail(worker, "close failed");
+
+    return true;
+}
+
+static bool test_check_file(test_worker_t* worker, const char* path) {
+    struct stat st;
+    if(stat(path, &st) != 0 || st.st_size != TEST_FILE_SIZE)
+        return test_fail(worker, "stat has the wrong size");
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return test_fail(worker, "open for reading failed");
+
+    memset(worker->readback, 0, sizeof(worker->readback));
+    ssize_t got = read(fd, worker->readback, TEST_FILE_SIZE);
+
+    // Nothing past the end
+    uint8_t extra;
+    ssize_t past = read(fd, &extra, 1);
+    close(fd);
+
+    if(got != TEST_FILE_SIZE || past != 0)
+        return test_fail(worker, "reopened file is the wrong size");
+
+    if(memcmp(worker->pattern, worker->readback, TEST_FILE_SIZE) != 0)
+        return test_fail(worker, "reopened file does not match");
+
+    return true;
+}
+
+// Some random windows of the shared file. Every task reads it through the
+// same descriptor, so pread must not lose its place to the others.
+static bool test_pread_shared(test_worker_t* worker) {
+    for(int i = 0; i < 4; i++) {
+        uint32_t offset = test_next(&worker->seed) % (TEST_SHARED_SIZE - TEST_PREAD_SIZE);
+
+        if(pread(test_shared_fd, worker->window, TEST_PREAD_SIZE, offset) != TEST_PREAD_SIZE)
+            return test_fail(worker, "pread of the shared file failed");
+
+        for(int j = 0; j < TEST_PREAD_SIZE; j++) {
+            if(worker->window[j] != test_shared_byte(offset + j))
+                return test_fail(worker, "pread of the shared file came back wrong");
+        }
+
+        taskYIELD();
+    }
+
+    return true;
+}
+
+static void test_worker_task(void* param) {
+    test_worker_t* worker = (test_worker_t*)param;
+
+    char path[32];
+    snprintf(path, sizeof(path), "1:/task%d.bin", worker->id);
+
+    for(int pass = 0; pass < TEST_PASSES; pass++) {
+        test_make_pattern(worker);
+
+        if(!test_write_file(worker, path) || !test_check_file(worker, path) || !test_pread_shared(worker))
+            break;
+
+        worker->passes++;
+    }
+
+    worker->done = true;
+    vTaskSuspend(NULL);
+}
+
+static bool test_create_shared() {
+    static uint8_t chunk[4096];
+
+    int fd = open("1:/shared.bin", O_WRONLY | O_CREAT | O_TRUNC);
+    if(fd < 0 || fs_preallocate(fd, TEST_SHARED_SIZE) != 0)
+        return false;
+
+    for(uint32_t offset = 0; offset < TEST_SHARED_SIZE; offset += sizeof(chunk)) {
+        for(uint32_t i = 0; i < sizeof(chunk); i++)
+            chunk[i] = test_shared_byte(offset + i);
+
+        if(write(fd, chunk, sizeof(chunk)) != sizeof(chunk)) {
+            close(fd);
+            return false;
+        }
+    }
+
+    return close(fd) == 0;
+}
+
+static int test_count_files() {
+    fs_dir_t* dir = opendir("1:/");
+    if(dir == NULL)
+        return -1;
+
+    int files = 0;
+    struct dirent* entry;
+    while((entry = readdir(dir)) != NULL) {
+        if(entry->d_type == DT_REG && strncmp(entry->d_name, "task", 4) == 0)
+            files++;
+    }
+
+    closedir(dir);
+    return files;
+}
+
+static bool test_check_all(const char* when) {
+    for(int i = 0; i < TEST_TASKS; i++) {
+        char path[32];
+        snprintf(path, sizeof(path), "1:/task%d.bin", i);
+
+        if(!test_check_file(&test_workers[i], path)) {
+            printf("Task %d's file is wrong %s: %s\n", i, when, test_workers[i].error);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static int test_run() {
+    if(!test_map_image(true)) {
+        printf("Could not create %s\n", TEST_IMAGE_PATH);
+        return 1;
+    }
+
+    // Format with no latency, its not what is being tested
+    image_disk_attach(test_image, TEST_IMAGE_SIZE, NULL);
+
+    MKFS_PARM format = { .fmt = FM_ANY };
+    if(f_mkfs("1:", &format, test_mkfs_work, sizeof(test_mkfs_work)) != FR_OK ||
+       f_mount(&test_fs, "1:", 1) != FR_OK) {
+        printf("Could not format and mount the image\n");
+        return 1;
+    }
+
+    if(!test_create_shared()) {
+        printf("Could not write the shared file\n");
+        return 1;
+    }
+
+    test_shared_fd = open("1:/shared.bin", O_RDONLY);
+    if(test_shared_fd < 0) {
+        printf("Could not open the shared file\n");
+        return 1;
+    }
+
+    image_disk_config_t config = {
+        .command_latency_us = TEST_COMMAND_US,
+        .sector_latency_us = TEST_SECTOR_US
+    };
+    image_disk_set_config(&config);
+    image_disk_reset_stats();
+    disk_reset_cache_stats(IMAGE_DISK_DRIVE);
+
+    TaskHandle_t handles[TEST_TASKS];
+    for(int i = 0; i < TEST_TASKS; i++) {
+        test_workers[i].id = i;
+        test_workers[i].seed = i + 1;
+
+        if(xTaskCreate(test_worker_task, "WORKER", TEST_TASK_STACK_SIZE / sizeof(StackType_t),
+                       &test_workers[i], TEST_TASK_PRIORITY, &handles[i]) != pdPASS) {
+            printf("Could not start task %d\n", i);
+            return 1;
+        }
+    }
+
+    bool failed = false;
+    for(int i = 0; i < TEST_TASKS; i++) {
+        while(!test_workers[i].done)
+            vTaskDelay(pdMS_TO_TICKS(10));
+        vTaskDelete(handles[i]);
+
+        if(test_workers[i].error != NULL) {
+            printf("Task %d failed on pass %d: %s\n", i, (int)test_workers[i].passes, test_workers[i].error);
+            failed = true;
+        }
+    }
+
+    close(test_shared_fd);
+    if(failed)
+        return 1;
+
+    image_disk_stats_t disk;
+    disk_cache_stats_t cache;
+    image_disk_get_stats(&disk);
+    disk_get_cache_stats(IMAGE_DISK_DRIVE, &cache);
+
+    if(test_count_files() != TEST_TASKS) {
+        printf("Directory listing does not have every task's file\n");
+        return 1;
+    }
+
+    // Mounting again starts the cache over, everything has to have reached the image
+    f_unmount("1:");
+    if(f_mount(&test_fs, "1:", 1) != FR_OK || !test_check_all("after remounting"))
+        return 1;
+
+    // And the image file itself has to have it
+    f_unmount("1:");
+    image_disk_detach();
+    test_unmap_image();
+
+    if(!test_map_image(false)) {
+        printf("Could not map %s again\n", TEST_IMAGE_PATH);
+        return 1;
+    }
+
+    image_disk_attach(test_image, TEST_IMAGE_SIZE, NULL);
+    if(f_mount(&test_fs, "1:", 1) != FR_OK || !test_check_all("after mapping the image again"))
+        return 1;
+
+    f_unmount("1:");
+    image_disk_detach();
+    test_unmap_image();
+    remove(TEST_IMAGE_PATH);
+
+    printf("%d tasks, %d passes each, %d disk reads, %d disk writes, %d ms waited, %d%% cache hits\n",
+           TEST_TASKS, TEST_PASSES, (int)disk.reads, (int)disk.writes,
+           (int)(disk.latency_total / (SYSTEM_TB_CLOCK_HZ / 1000)),
+           (int)(cache.read_hits * 100 / (cache.read_hits + cache.read_misses + 1)));
+    return 0;
+}
+
+static void test_task(void* unused) {
+    exit(test_run());
+}
+
+int main() {
+    // Keeps the output in order if a task aborts
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    xTaskCreate(test_task, "TEST", TEST_TASK_STACK_SIZE / sizeof(StackType_t), NULL, TEST_TASK_PRIORITY, NULL);
+    vTaskStartScheduler();
+
+    return 1;
+}
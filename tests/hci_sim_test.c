@@ -0,0 +1,206 @@
+/**
+ * @file hci_sim_test.c
+ * @brief Bluetooth stack test against the simulated controller.
+ *
+ * Runs on FreeRTOS's POSIX port. hci_sim stands in for /dev/usb/oh1/57e/305
+ * as a virtual IOS device, and the real HCI and L2CAP code talks to it:
+ * discovery, connecting each remote, opening its HID channels, turning on
+ * continuous reports and reading them back, then shutting it all down.
+ *
+ * A short trace is replayed alongside, with a record whose event claims
+ * more bytes than the record holds. It has to be skipped, not read past.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "powerblocks/core/bluetooth/hci.h"
+#include "powerblocks/core/bluetooth/hci_sim.h"
+#include "powerblocks/core/bluetooth/l2cap.h"
+#include "powerblocks/core/ios/ios.h"
+#include "powerblocks/core/utils/log.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_REMOTES     2
+#define TEST_REPORT_RATE 500
+#define TEST_REPORTS     200 // Read from each remote
+
+#define TEST_TASK_STACK_SIZE (64 * 1024)
+#define TEST_TASK_PRIORITY   (configMAX_PRIORITIES - 4)
+
+// Same channel IDs the wiimote driver uses
+#define TEST_CONTROL_SID   0x0040
+#define TEST_INTERRUPT_SID 0x0041
+
+typedef struct {
+    hci_discovered_device_info_t info;
+    uint16_t handle;
+
+    l2cap_device_t device;
+    l2cap_channel_t channels[3]; // Signals, control, interrupt
+
+    uint8_t signal_buffer[256];
+    uint8_t control_buffer[256];
+    uint8_t interrupt_buffer[1024];
+} test_remote_t;
+
+static test_remote_t test_remotes[TEST_REMOTES];
+static int test_discovered;
+
+static SemaphoreHandle_t test_discovery_done;
+static StaticSemaphore_t test_discovery_done_data;
+
+// Vendor events, which the stack only logs. The middle one's own length
+// runs well past its record and the end of the trace.
+static const uint8_t test_trace[] = {
+    0x01, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00,   0xFF, 0x02, 0xAB, 0xCD,
+    0x01, 0x00, 0x04, 0x00, 0xE8, 0x03, 0x00, 0x00,   0xFF, 0xC8, 0x00, 0x00,
+    0x01, 0x00, 0x02, 0x00, 0xE8, 0x03, 0x00, 0x00,   0xFF, 0x00,
+};
+
+static void test_on_discovered(void* user_data, const hci_discovered_device_info_t* device) {
+    if(test_discovered < TEST_REMOTES)
+        test_remotes[test_discovered++].info = *device;
+}
+
+static void test_on_discovery_complete(void* user_data, uint8_t error) {
+    xSemaphoreGive(test_discovery_done);
+}
+
+static bool test_connect(test_remote_t* remote) {
+    if(hci_create_connection(&remote->info, &remote->handle) < 0) {
+        printf("Could not connect\n");
+        return false;
+    }
+
+    l2cap_initialize_channel(&remote->device, &remote->channels[0], 0x0001, 0x0001, 0x0000,
+                             remote->signal_buffer, sizeof(remote->signal_buffer));
+    l2cap_initialize_channel(&remote->device, &remote->channels[1], TEST_CONTROL_SID, 0, 0x0011,
+                             remote->control_buffer, sizeof(remote->control_buffer));
+    l2cap_initialize_channel(&remote->device, &remote->channels[2], TEST_INTERRUPT_SID, 0, 0x0013,
+                             remote->interrupt_buffer, sizeof(remote->interrupt_buffer));
+
+    if(l2cap_open_device(&remote->device, remote->handle, remote->info.address, remote->channels, 3) < 0 ||
+       l2cap_open_channel(&remote->device, &remote->channels[1]) < 0 ||
+       l2cap_open_channel(&remote->device, &remote->channels[2]) < 0) {
+        printf("Could not open the HID channels\n");
+        return false;
+    }
+
+    // Buttons and accelerometer, sent continuously
+    const uint8_t report_mode[4] = { 0xA2, 0x12, 0x04, 0x31 };
+    if(l2cap_send_channel(&remote->channels[2], report_mode, sizeof(report_mode)) < 0) {
+        printf("Could not set the report mode\n");
+        return false;
+    }
+
+    return true;
+}
+
+static bool test_read_reports() {
+    for(int i = 0; i < TEST_REPORTS; i++) {
+        for(int r = 0; r < TEST_REMOTES; r++) {
+            uint8_t report[32];
+            int length = l2cap_receive_channel(&test_remotes[r].channels[2], report, sizeof(report));
+
+            if(length != 7 || report[0] != 0xA1 || report[1] != 0x31) {
+                printf("Remote %d report %d: got %d bytes, %02X %02X\n", r, i, length, report[0], report[1]);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static int test_run() {
+    ios_initialize();
+
+    hci_sim_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.remotes = TEST_REMOTES;
+    config.report_rate_hz = TEST_REPORT_RATE;
+    config.trace = test_trace;
+    config.trace_size = sizeof(test_trace);
+
+    if(hci_sim_install(&config) < 0) {
+        printf("Could not install the simulator\n");
+        return 1;
+    }
+
+    if(hci_initialize("/dev/usb/oh1/57e/305") < 0 || l2cap_initialize() < 0) {
+        printf("Could not bring up the stack\n");
+        return 1;
+    }
+
+    test_discovery_done = xSemaphoreCreateBinaryStatic(&test_discovery_done_data);
+    if(hci_begin_discovery(HCI_INQUIRY_MODE_GENERAL_ACCESS, 1, TEST_REMOTES,
+                           test_on_discovered, test_on_discovery_complete, NULL) < 0 ||
+       xSemaphoreTake(test_discovery_done, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        printf("Discovery did not finish\n");
+        return 1;
+    }
+
+    if(test_discovered != TEST_REMOTES) {
+        printf("Found %d of %d remotes\n", test_discovered, TEST_REMOTES);
+        return 1;
+    }
+
+    for(int i = 0; i < TEST_REMOTES; i++) {
+        if(!test_connect(&test_remotes[i]))
+            return 1;
+    }
+
+    if(!test_read_reports())
+        return 1;
+
+    hci_sim_stats_t stats;
+    hci_sim_get_stats(&stats);
+
+    if(stats.trace_records != 3) {
+        printf("Replayed %d of 3 trace records\n", (int)stats.trace_records);
+        return 1;
+    }
+
+    if(stats.reports_delivered < TEST_REMOTES * TEST_REPORTS || stats.reports_generated < stats.reports_delivered) {
+        printf("Report counters do not add up, %d generated, %d delivered\n",
+               (int)stats.reports_generated, (int)stats.reports_delivered);
+        return 1;
+    }
+
+    printf("%d reports generated, %d delivered, %d dropped, %d commands, %d events\n",
+           (int)stats.reports_generated, (int)stats.reports_delivered, (int)stats.reports_dropped,
+           (int)stats.commands_received, (int)stats.events_delivered);
+
+    // Shut down in order, the controller goes last
+    l2cap_signal_close();
+    hci_close();
+    l2cap_close();
+    hci_sim_remove();
+    return 0;
+}
+
+static void test_task(void* unused) {
+    exit(test_run());
+}
+
+int main() {
+    // Keeps the output in order if a task aborts
+    setvbuf(stdout, NULL, _IONBF, 0);
+    log_initialize();
+
+    xTaskCreate(test_task, "TEST", TEST_TASK_STACK_SIZE / sizeof(StackType_t), NULL, TEST_TASK_PRIORITY, NULL);
+    vTaskStartScheduler();
+
+    return 1;
+}
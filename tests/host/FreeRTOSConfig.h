@@ -0,0 +1,87 @@
+/**
+ * @file FreeRTOSConfig.h
+ * @brief FreeRTOS configuration for host tests.
+ *
+ * Host tests run on FreeRTOS's POSIX port, each task a pthread.
+ * Kept as close to freertos_port/FreeRTOSConfig.h as the port allows,
+ * so the SDK code sees the same kernel features it does on the Wii.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#pragma once
+
+#include "powerblocks/core/system/system.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define configCPU_CLOCK_HZ SYSTEM_TB_CLOCK_HZ
+#define configTICK_RATE_HZ 1000
+
+#define configUSE_PREEMPTION 1
+#define configUSE_TIME_SLICING 1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION 0
+
+// The POSIX port ticks off a timer signal, there is no tickless idle
+#define configUSE_TICKLESS_IDLE 0
+
+#define configMAX_PRIORITIES 10
+#define configMINIMAL_STACK_SIZE 1024
+#define configMAX_TASK_NAME_LEN 32
+
+// Matches the port's TickType_t
+#define configTICK_TYPE_WIDTH_IN_BITS TICK_TYPE_WIDTH_64_BITS
+
+#define configIDLE_SHOULD_YIELD 1
+
+#define configUSE_IDLE_HOOK 0
+#define configUSE_TICK_HOOK 0
+#define configUSE_MALLOC_FAILED_HOOK 0
+#define configUSE_DAEMON_TASK_STARTUP_HOOK 0
+
+// Each task runs on its own pthread stack, not the one FreeRTOS hands out
+#define configCHECK_FOR_STACK_OVERFLOW 0
+
+#define configGENERATE_RUN_TIME_STATS 0
+#define configUSE_TRACE_FACILITY 1
+
+// Not assert, tests build optimized and it would go away
+#define configASSERT(x) do { if(!(x)) { fprintf(stderr, "configASSERT at %s:%d\n", __FILE__, __LINE__); abort(); } } while(0)
+
+#define configSUPPORT_STATIC_ALLOCATION 1
+#define configSUPPORT_DYNAMIC_ALLOCATION 1
+#define configKERNEL_PROVIDED_STATIC_MEMORY 1
+
+#define configUSE_TIMERS             1
+#define configTIMER_TASK_PRIORITY    (configMAX_PRIORITIES - 1)
+#define configTIMER_QUEUE_LENGTH     10
+#define configTIMER_TASK_STACK_DEPTH (configMINIMAL_STACK_SIZE * 2)
+
+#define configUSE_TASK_NOTIFICATIONS   1
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES 3 // Same reserved indices as on the Wii
+#define configUSE_MUTEXES              1
+#define configUSE_RECURSIVE_MUTEXES    1
+#define configUSE_COUNTING_SEMAPHORES  1
+#define configUSE_QUEUE_SETS           0
+#define configUSE_APPLICATION_TASK_TAG 0
+#define configUSE_POSIX_ERRNO 0
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS 2
+
+#define INCLUDE_vTaskPrioritySet            1
+#define INCLUDE_uxTaskPriorityGet           1
+#define INCLUDE_vTaskDelete                 1
+#define INCLUDE_vTaskSuspend                1
+#define INCLUDE_vTaskDelayUntil             1
+#define INCLUDE_vTaskDelay                  1
+#define INCLUDE_xTaskGetSchedulerState      1
+#define INCLUDE_xTaskGetCurrentTaskHandle   1
+#define INCLUDE_uxTaskGetStackHighWaterMark 1
+#define INCLUDE_xTaskGetIdleTaskHandle      0
+#define INCLUDE_eTaskGetState               0
+#define INCLUDE_xTimerPendFunctionCall      1
+#define INCLUDE_xTaskAbortDelay             0
+#define INCLUDE_xTaskGetHandle              1
+#define INCLUDE_xTaskResumeFromISR          1
@@ -0,0 +1,40 @@
+/**
+ * @file host_sd.c
+ * @brief SD card drive for host tests, always empty.
+ *
+ * There is no SD slot off the Wii, so drive "0:" never has a card.
+ * Host tests use the image drive instead.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "powerblocks/filesystem/sd.h"
+
+int sd_initialize() {
+    return -1;
+}
+
+void sd_close() {
+}
+
+DSTATUS sd_disk_status() {
+    return STA_NOINIT | STA_NODISK;
+}
+
+DSTATUS sd_disk_initialize() {
+    return sd_disk_status();
+}
+
+DRESULT sd_disk_read(BYTE* buff, LBA_t sector, UINT count) {
+    return RES_NOTRDY;
+}
+
+DRESULT sd_disk_write(const BYTE* buff, LBA_t sector, UINT count) {
+    return RES_NOTRDY;
+}
+
+DRESULT sd_disk_ioctl(BYTE cmd, void* buff) {
+    return RES_NOTRDY;
+}
@@ -0,0 +1,58 @@
+/**
+ * @file host_system.c
+ * @brief What host tests need from the system, without the Wii.
+ *
+ * The time base runs off the host's monotonic clock at the Wii's rate,
+ * caches need no maintenance, and there is no starlet, so IPC requests
+ * fail. Only virtual IOS devices answer. The system heaps are the host's.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "powerblocks/core/system/system.h"
+#include "powerblocks/core/system/exceptions.h"
+#include "powerblocks/core/system/ipc.h"
+#include "powerblocks/core/system/mem.h"
+
+#include "FreeRTOS.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+int32_t exception_isr_context_switch_needed;
+
+uint64_t system_get_time_base_int() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * SYSTEM_TB_CLOCK_HZ + (uint64_t)now.tv_nsec * (SYSTEM_TB_CLOCK_HZ / 1000) / 1000000;
+}
+
+void system_flush_dcache(const void* data, uint32_t size) {
+}
+
+void system_invalidate_dcache(void* data, uint32_t size) {
+}
+
+void ipc_initialize() {
+}
+
+int ipc_request(ipc_message* message, ipc_async_handler_t handler, void* params) {
+    return -1;
+}
+
+void* mem1_aligned_alloc(size_t size, size_t alignment) {
+    void* ptr;
+    if(posix_memalign(&ptr, alignment, size) != 0)
+        return NULL;
+    return ptr;
+}
+
+void mem_free(void* ptr) {
+    free(ptr);
+}
+
+// No SYSCONF to read
+void ios_settings_initialize() {
+}
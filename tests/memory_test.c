@@ -0,0 +1,169 @@
+/**
+ * @file memory_test.c
+ * @brief Fuzz test for memcpy, memmove and memset.
+ *
+ * Runs utils/memory.c on the host against the host's C library over
+ * random sizes, alignments, overlaps and fill values, once down the
+ * integer line copy and once down the FPU one.
+ *
+ * Each call works inside a bigger buffer filled with random bytes, and
+ * the bytes around the range are compared too, so stray writes show up.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// memory.c, renamed so it sits next to the C library
+extern void* memory_memcpy(void* dest, const void* src, size_t n);
+extern void* memory_memmove(void* dest, const void* src, size_t n);
+extern void* memory_memset(void* dest, int c, size_t n);
+extern bool memory_host_use_fpu;
+
+#define TEST_BUFFER_SIZE 8192
+#define TEST_MAX_SIZE    2048
+#define TEST_ITERATIONS  100000
+
+// Bytes either side of a call's range that are checked as well
+#define TEST_GUARD 64
+
+static uint8_t expected[TEST_BUFFER_SIZE] __attribute__((aligned(32)));
+static uint8_t actual[TEST_BUFFER_SIZE] __attribute__((aligned(32)));
+static uint8_t source[TEST_BUFFER_SIZE] __attribute__((aligned(32)));
+
+static uint32_t test_seed = 1;
+
+static uint32_t test_random() {
+    // xorshift32
+    test_seed ^= test_seed << 13;
+    test_seed ^= test_seed >> 17;
+    test_seed ^= test_seed << 5;
+    return test_seed;
+}
+
+// Mostly around the line threshold, sometimes anything up to the max
+static uint32_t test_random_size() {
+    switch(test_random() % 4) {
+        case 0:  return test_random() % 16;
+        case 1:  return 48 + test_random() % 48;
+        case 2:  return test_random() % 512;
+        default: return test_random() % TEST_MAX_SIZE;
+    }
+}
+
+static void test_fill_random(uint8_t* buffer, size_t size) {
+    for(size_t i = 0; i < size; i++)
+        buffer[i] = (uint8_t)test_random();
+}
+
+// Fresh random bytes in both buffers around where a call will write.
+// Everywhere else they already match.
+static void test_prepare(size_t start, size_t end) {
+    start -= TEST_GUARD;
+    end += TEST_GUARD;
+
+    test_fill_random(expected + start, end - start);
+    memcpy(actual + start, expected + start, end - start);
+}
+
+static bool test_compare(const char* name, size_t start, size_t end, size_t dest, size_t n) {
+    start -= TEST_GUARD;
+    end += TEST_GUARD;
+
+    if(memcmp(expected + start, actual + start, end - start) == 0)
+        return true;
+
+    size_t first = start;
+    while(expected[first] == actual[first])
+        first++;
+
+    printf("%s failed, fpu=%d dest=%zu n=%zu, first difference at %zu\n",
+           name, memory_host_use_fpu, dest, n, first);
+    return false;
+}
+
+static bool test_memcpy() {
+    size_t n = test_random_size();
+    size_t dest = 64 + test_random() % 64;
+    size_t src = 64 + test_random() % 64;
+
+    test_prepare(dest, dest + n);
+    test_fill_random(source + src, n);
+
+    memcpy(expected + dest, source + src, n);
+    if(memory_memcpy(actual + dest, source + src, n) != actual + dest) {
+        printf("memcpy returned the wrong pointer\n");
+        return false;
+    }
+
+    return test_compare("memcpy", dest, dest + n, dest, n);
+}
+
+static bool test_memmove() {
+    size_t n = test_random_size();
+    size_t src = TEST_MAX_SIZE + test_random() % 64;
+
+    // Anywhere from a whole copy before the source to a whole copy after,
+    // so most of these overlap
+    size_t dest = src - n + test_random() % (2 * n + 1);
+
+    size_t start = dest < src ? dest : src;
+    size_t end = (dest > src ? dest : src) + n;
+    test_prepare(start, end);
+
+    memmove(expected + dest, expected + src, n);
+    if(memory_memmove(actual + dest, actual + src, n) != actual + dest) {
+        printf("memmove returned the wrong pointer\n");
+        return false;
+    }
+
+    return test_compare("memmove", start, end, dest, n);
+}
+
+static bool test_memset() {
+    size_t n = test_random_size();
+    size_t dest = 64 + test_random() % 64;
+
+    // Zero takes its own path
+    int value = (test_random() % 4 == 0) ? 0 : (int)(test_random() % 512) - 128;
+
+    test_prepare(dest, dest + n);
+
+    memset(expected + dest, value, n);
+    if(memory_memset(actual + dest, value, n) != actual + dest) {
+        printf("memset returned the wrong pointer\n");
+        return false;
+    }
+
+    return test_compare("memset", dest, dest + n, dest, n);
+}
+
+int main(int argc, char** argv) {
+    if(argc > 1)
+        test_seed = (uint32_t)strtoul(argv[1], NULL, 0);
+    if(test_seed == 0)
+        test_seed = 1;
+
+    printf("seed %u\n", test_seed);
+
+    test_fill_random(expected, TEST_BUFFER_SIZE);
+    memcpy(actual, expected, TEST_BUFFER_SIZE);
+
+    for(int fpu = 0; fpu < 2; fpu++) {
+        memory_host_use_fpu = fpu;
+
+        for(int i = 0; i < TEST_ITERATIONS; i++) {
+            if(!test_memcpy() || !test_memmove() || !test_memset())
+                return 1;
+        }
+    }
+
+    printf("%d calls of each passed on both paths\n", TEST_ITERATIONS * 2);
+    return 0;
+}
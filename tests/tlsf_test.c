@@ -0,0 +1,218 @@
+/**
+ * @file tlsf_test.c
+ * @brief Trace replay test for the TLSF allocator.
+ *
+ * Replays a random trace of malloc, memalign, realloc, resize and free
+ * against one heap. Every allocation is filled with a pattern of its own
+ * and checked before it is let go, so overlapping blocks show up.
+ * Alignment, usable size and the counters are checked along the way,
+ * and tlsf_check walks the heap every so often.
+ *
+ * Same trace shape as the MemoryTrace example, which times it on the Wii.
+ *
+ * @author Samuel Fitzsimons (rainbain)
+ * @date 2025
+ * @license MIT (see LICENSE file)
+ */
+
+#include "powerblocks/core/utils/tlsf.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_HEAP_SIZE   (3 * 1024 * 1024) // Small enough that some allocations fail
+#define TEST_LENGTH      400000
+#define TEST_SLOTS       1024
+#define TEST_CHECK_EVERY 1000
+
+// One in this many allocations is large
+#define TEST_LARGE_CHANCE 32
+#define TEST_SMALL_MAX    512
+#define TEST_LARGE_MAX    (256 * 1024)
+
+typedef struct {
+    uint8_t* ptr;
+    uint32_t size;
+    uint8_t pattern;
+} test_slot_t;
+
+static uint8_t test_heap_memory[TEST_HEAP_SIZE] __attribute__((aligned(32)));
+static tlsf_t test_heap;
+static test_slot_t test_slots[TEST_SLOTS];
+
+static uint32_t test_seed = 0x12345678;
+
+static uint32_t test_random() {
+    test_seed = test_seed * 1664525 + 1013904223;
+    return test_seed >> 8;
+}
+
+static void test_fill(test_slot_t* slot, uint32_t from) {
+    for(uint32_t i = from; i < slot->size; i++)
+        slot->ptr[i] = (uint8_t)(slot->pattern + i);
+}
+
+static bool test_verify(const test_slot_t* slot, uint32_t size, int op) {
+    for(uint32_t i = 0; i < size; i++) {
+        if(slot->ptr[i] != (uint8_t)(slot->pattern + i)) {
+            printf("op %d: allocation at %p of %u bytes overwritten at %u\n", op, (void*)slot->ptr, slot->size, i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool test_check_new(const test_slot_t* slot, uint32_t alignment, int op) {
+    if(((uintptr_t)slot->ptr & (alignment - 1)) != 0) {
+        printf("op %d: %p is not aligned to %u\n", op, (void*)slot->ptr, alignment);
+        return false;
+    }
+
+    if(!tlsf_contains(&test_heap, slot->ptr) || tlsf_usable_size(slot->ptr) < slot->size) {
+        printf("op %d: %p does not hold %u bytes in the heap\n", op, (void*)slot->ptr, slot->size);
+        return false;
+    }
+
+    return true;
+}
+
+static uint32_t test_random_size() {
+    uint32_t random = test_random();
+    return (random % TEST_LARGE_CHANCE) == 0 ? random % TEST_LARGE_MAX : random % TEST_SMALL_MAX;
+}
+
+static bool test_allocate(test_slot_t* slot, int op) {
+    uint32_t size = test_random_size();
+    uint32_t alignment = TLSF_ALIGN;
+
+    if(test_random() % 4 == 0) {
+        alignment = 16u << (test_random() % 8);
+        slot->ptr = (uint8_t*)tlsf_memalign(&test_heap, alignment, size);
+    } else {
+        slot->ptr = (uint8_t*)tlsf_malloc(&test_heap, size);
+    }
+
+    // Running out is fine, the trace just carries on
+    if(slot->ptr == NULL)
+        return true;
+
+    slot->size = size;
+    slot->pattern = (uint8_t)test_random();
+    test_fill(slot, 0);
+
+    return test_check_new(slot, alignment, op);
+}
+
+static bool test_reallocate(test_slot_t* slot, int op) {
+    // realloc to 0 frees, that is left to test_free
+    uint32_t size = test_random_size() + 1;
+    uint32_t kept = size < slot->size ? size : slot->size;
+
+    if(!test_verify(slot, slot->size, op))
+        return false;
+
+    if(test_random() % 2 == 0) {
+        // In place or not at all
+        if(!tlsf_resize(&test_heap, slot->ptr, size))
+            return test_verify(slot, slot->size, op);
+    } else {
+        uint8_t* ptr = (uint8_t*)tlsf_realloc(&test_heap, slot->ptr, size);
+        if(ptr == NULL)
+            return test_verify(slot, slot->size, op);
+        slot->ptr = ptr;
+    }
+
+    // Whatever fit has to come along
+    if(!test_verify(slot, kept, op))
+        return false;
+
+    slot->size = size;
+    test_fill(slot, kept);
+
+    return test_check_new(slot, TLSF_ALIGN, op);
+}
+
+static bool test_free(test_slot_t* slot, int op) {
+    if(!test_verify(slot, slot->size, op))
+        return false;
+
+    tlsf_free(&test_heap, slot->ptr);
+    slot->ptr = NULL;
+    return true;
+}
+
+static bool test_counters(int op) {
+    tlsf_stats_t stats;
+    tlsf_get_stats(&test_heap, &stats);
+
+    if(stats.used + stats.free != stats.size || stats.used > stats.peak_used || stats.largest_free > stats.free) {
+        printf("op %d: counters do not add up, used %u free %u size %u peak %u largest %u\n", op,
+               stats.used, stats.free, stats.size, stats.peak_used, stats.largest_free);
+        return false;
+    }
+
+    if(tlsf_check(&test_heap) < 0) {
+        printf("op %d: heap check failed\n", op);
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if(argc > 1)
+        test_seed = (uint32_t)strtoul(argv[1], NULL, 0);
+
+    printf("seed %u\n", test_seed);
+
+    if(tlsf_initialize(&test_heap, test_heap_memory, TEST_HEAP_SIZE) < 0) {
+        printf("Could not create the heap\n");
+        return 1;
+    }
+
+    tlsf_stats_t empty;
+    tlsf_get_stats(&test_heap, &empty);
+
+    uint32_t failures = 0;
+    for(int op = 0; op < TEST_LENGTH; op++) {
+        test_slot_t* slot = &test_slots[test_random() % TEST_SLOTS];
+
+        bool ok;
+        if(slot->ptr == NULL) {
+            ok = test_allocate(slot, op);
+            if(slot->ptr == NULL)
+                failures++;
+        } else if(test_random() % 4 == 0) {
+            ok = test_reallocate(slot, op);
+        } else {
+            ok = test_free(slot, op);
+        }
+
+        if(!ok || (op % TEST_CHECK_EVERY == 0 && !test_counters(op)))
+            return 1;
+    }
+
+    for(int i = 0; i < TEST_SLOTS; i++) {
+        if(test_slots[i].ptr != NULL && !test_free(&test_slots[i], TEST_LENGTH))
+            return 1;
+    }
+
+    if(!test_counters(TEST_LENGTH))
+        return 1;
+
+    // Everything merged back together
+    tlsf_stats_t stats;
+    tlsf_get_stats(&test_heap, &stats);
+    if(stats.used != empty.used || stats.free_blocks != 1 || stats.largest_free != empty.largest_free) {
+        printf("Heap did not come back together, used %u, %u free blocks, largest %u\n",
+               stats.used, stats.free_blocks, stats.largest_free);
+        return 1;
+    }
+
+    printf("%d operations, %u allocations failed, peak %u KB\n", TEST_LENGTH, failures, stats.peak_used / 1024);
+    return 0;
+}
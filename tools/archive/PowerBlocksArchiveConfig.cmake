@@ -0,0 +1,3 @@
+include("${CMAKE_CURRENT_LIST_DIR}/PowerBlocksArchiveMacros.cmake")
+
+set(PowerBlocksArchive_VERSION 1.0.0)
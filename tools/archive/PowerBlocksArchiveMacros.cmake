@@ -0,0 +1,42 @@
+find_package(Python3 REQUIRED COMPONENTS Interpreter)
+
+set(PBARCHIVE_CLI_PATH "${CMAKE_CURRENT_LIST_DIR}/pbarchive_cli.py")
+
+# pack_archive(target_name directory [COMPRESS] [BLOCK_SIZE bytes])
+macro(pack_archive target_name directory)
+    cmake_parse_arguments(PACK_ARCHIVE "COMPRESS" "BLOCK_SIZE" "" ${ARGN})
+
+    get_filename_component(ABS_INPUT ${directory} ABSOLUTE)
+    if(NOT IS_DIRECTORY ${ABS_INPUT})
+        message(FATAL_ERROR "pack_archive for target ${target_name} given ${directory}, which is not a directory")
+    endif()
+
+    set(ARCHIVE_GENERATED_DIR ${CMAKE_CURRENT_BINARY_DIR}/archives)
+    file(MAKE_DIRECTORY ${ARCHIVE_GENERATED_DIR})
+    set(ABS_OUTPUT ${ARCHIVE_GENERATED_DIR}/${target_name}.pba)
+
+    set(PACK_ARCHIVE_FLAGS)
+    if(PACK_ARCHIVE_COMPRESS)
+        list(APPEND PACK_ARCHIVE_FLAGS --compress)
+    endif()
+    if(PACK_ARCHIVE_BLOCK_SIZE)
+        list(APPEND PACK_ARCHIVE_FLAGS --block-size ${PACK_ARCHIVE_BLOCK_SIZE})
+    endif()
+
+    # Repack when any file in the directory changes, CONFIGURE_DEPENDS catches new ones
+    file(GLOB_RECURSE ARCHIVE_SOURCE_FILES CONFIGURE_DEPENDS ${ABS_INPUT}/*)
+
+    add_custom_command(
+        OUTPUT ${ABS_OUTPUT}
+        COMMAND ${Python3_EXECUTABLE} ${PBARCHIVE_CLI_PATH} pack ${ABS_INPUT} -o ${ABS_OUTPUT} ${PACK_ARCHIVE_FLAGS}
+        DEPENDS ${ARCHIVE_SOURCE_FILES} ${PBARCHIVE_CLI_PATH}
+        WORKING_DIRECTORY ${CMAKE_CURRENT_LIST_DIR}
+        COMMENT "Packing archive: ${ABS_INPUT} -> ${ABS_OUTPUT}"
+        VERBATIM
+    )
+
+    add_custom_target(${target_name} ALL DEPENDS ${ABS_OUTPUT})
+
+    # Export path for convenience
+    set(${target_name}_ARCHIVE ${ABS_OUTPUT} CACHE INTERNAL "Packed archive for ${target_name}")
+endmacro()
@@ -0,0 +1,213 @@
+"""
+PowerBlocks Asset Archive
+
+Writes and reads .pba archives.
+
+Layout, everything big endian to match the Wii:
+    Header      32 bytes at offset 0
+    Index       32 bytes per entry, sorted by (hash, name)
+    Names       Null terminated, referenced by the index
+    Data        Each entry 32 byte aligned
+
+A compressed entry is a run of blocks. Each block starts with
+a 32 bit word, the stored size in the low 31 bits, and the top
+bit set if the block was left uncompressed. Every block but the
+last decompresses to exactly block_size bytes.
+
+Author: Samuel Fitzsimons (rainbain)
+File: archive.py
+Date: 2025
+"""
+
+import struct
+from pathlib import Path
+
+from . import lz4
+
+MAGIC = b"PBAR"
+VERSION = 1
+
+HEADER_FORMAT = ">4sHHIIIIII"
+ENTRY_FORMAT = ">IIHHIII8x"
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+ENTRY_SIZE = struct.calcsize(ENTRY_FORMAT)
+
+ALIGNMENT = 32
+DEFAULT_BLOCK_SIZE = 32 * 1024
+
+ENTRY_FLAG_LZ4 = 1 << 0
+BLOCK_STORED = 1 << 31
+
+def name_hash(name):
+    """FNV-1a over the UTF-8 name. Must match archive.c."""
+    value = 0x811C9DC5
+    for byte in name.encode("utf-8"):
+        value ^= byte
+        value = (value * 0x01000193) & 0xFFFFFFFF
+    return value
+
+def _align(value, alignment=ALIGNMENT):
+    return (value + alignment - 1) & ~(alignment - 1)
+
+class Entry:
+    def __init__(self, name, data):
+        self.name = name
+        self.hash = name_hash(name)
+        self.data = data
+        self.stored = data
+        self.flags = 0
+        self.offset = 0
+        self.name_offset = 0
+
+def _compress(data, block_size):
+    out = bytearray()
+    for start in range(0, len(data), block_size):
+        block = data[start:start + block_size]
+        packed = lz4.compress_block(block)
+
+        if len(packed) < len(block):
+            out += struct.pack(">I", len(packed))
+            out += packed
+        else:
+            out += struct.pack(">I", len(block) | BLOCK_STORED)
+            out += block
+    return bytes(out)
+
+def _decompress(stored, size, block_size):
+    out = bytearray()
+    position = 0
+    while len(out) < size:
+        word, = struct.unpack_from(">I", stored, position)
+        position += 4
+
+        length = word & ~BLOCK_STORED
+        block = stored[position:position + length]
+        position += length
+
+        if word & BLOCK_STORED:
+            out += block
+        else:
+            out += lz4.decompress_block(block, min(block_size, size - len(out)))
+    return bytes(out)
+
+def collect(directory):
+    """Gathers every file under a directory, named by their relative path."""
+    directory = Path(directory)
+    files = []
+    for path in sorted(directory.rglob("*")):
+        if path.is_file():
+            files.append((path.relative_to(directory).as_posix(), path.read_bytes()))
+    return files
+
+def pack(files, output, compress=False, block_size=DEFAULT_BLOCK_SIZE):
+    """Writes an archive from a list of (name, data)."""
+    if block_size <= 0 or block_size % ALIGNMENT:
+        raise ValueError(f"Block size must be a multiple of {ALIGNMENT}")
+
+    entries = [Entry(name, data) for name, data in files]
+    entries.sort(key=lambda e: (e.hash, e.name.encode("utf-8")))
+
+    for a, b in zip(entries, entries[1:]):
+        if a.name == b.name:
+            raise ValueError(f"Duplicate entry {a.name}")
+
+    # Only keep compression when it actually helps
+    if compress:
+        for entry in entries:
+            packed = _compress(entry.data, block_size)
+            if len(packed) < len(entry.data):
+                entry.stored = packed
+                entry.flags |= ENTRY_FLAG_LZ4
+
+    names = bytearray()
+    for entry in entries:
+        entry.name_offset = len(names)
+        names += entry.name.encode("utf-8") + b"\0"
+
+    names_offset = HEADER_SIZE + ENTRY_SIZE * len(entries)
+    data_offset = _align(names_offset + len(names))
+
+    position = data_offset
+    for entry in entries:
+        entry.offset = position
+        position = _align(position + len(entry.stored))
+
+    if position > 0xFFFFFFFF:
+        raise ValueError("Archive exceeds 4GB")
+
+    out = bytearray(struct.pack(HEADER_FORMAT, MAGIC, VERSION, 0, len(entries), block_size,
+                                names_offset, len(names), data_offset, 0))
+
+    for entry in entries:
+        out += struct.pack(ENTRY_FORMAT, entry.hash, entry.name_offset, len(entry.name.encode("utf-8")),
+                           entry.flags, entry.offset, len(entry.stored), len(entry.data))
+
+    out += names
+    for entry in entries:
+        out += bytes(entry.offset - len(out))
+        out += entry.stored
+    out += bytes(position - len(out))
+
+    Path(output).write_bytes(out)
+    return entries
+
+class Archive:
+    """Reads back an archive, the same way the target does."""
+
+    def __init__(self, path):
+        self.raw = Path(path).read_bytes()
+
+        magic, version, _, count, self.block_size, names_offset, names_size, _, _ = \
+            struct.unpack_from(HEADER_FORMAT, self.raw, 0)
+
+        if magic != MAGIC:
+            raise ValueError("Not a PowerBlocks archive")
+        if version != VERSION:
+            raise ValueError(f"Unsupported archive version {version}")
+
+        names = self.raw[names_offset:names_offset + names_size]
+
+        self.entries = []
+        for i in range(count):
+            hash, name_offset, name_length, flags, offset, stored_size, size = \
+                struct.unpack_from(ENTRY_FORMAT, self.raw, HEADER_SIZE + i * ENTRY_SIZE)
+            name = names[name_offset:name_offset + name_length].decode("utf-8")
+            self.entries.append((name, hash, flags, offset, stored_size, size))
+
+    def find(self, name):
+        """Binary search on the hash, same as archive_open."""
+        hash = name_hash(name)
+        low, high = 0, len(self.entries)
+        while low < high:
+            middle = (low + high) // 2
+            if self.entries[middle][1] < hash:
+                low = middle + 1
+            else:
+                high = middle
+
+        while low < len(self.entries) and self.entries[low][1] == hash:
+            if self.entries[low][0] == name:
+                return self.entries[low]
+            low += 1
+        return None
+
+    def read(self, entry):
+        name, hash, flags, offset, stored_size, size = entry
+        stored = self.raw[offset:offset + stored_size]
+        if flags & ENTRY_FLAG_LZ4:
+            return _decompress(stored, size, self.block_size)
+        return stored
+
+    def check(self):
+        """Checks the index is sorted, hashed and aligned correctly."""
+        keys = [(e[1], e[0].encode("utf-8")) for e in self.entries]
+        if keys != sorted(keys):
+            raise ValueError("Index is not sorted")
+
+        for name, hash, flags, offset, stored_size, size in self.entries:
+            if hash != name_hash(name):
+                raise ValueError(f"{name}: Hash mismatch")
+            if offset % ALIGNMENT:
+                raise ValueError(f"{name}: Data is not {ALIGNMENT} byte aligned")
+            if offset + stored_size > len(self.raw):
+                raise ValueError(f"{name}: Data runs past the end of the archive")
@@ -0,0 +1,129 @@
+"""
+LZ4 Block Codec
+
+Minimal LZ4 block format compressor and decompressor.
+Only the raw block format is produced, framing is left
+to the archive.
+
+Author: Samuel Fitzsimons (rainbain)
+File: lz4.py
+Date: 2025
+"""
+
+MIN_MATCH = 4
+MAX_OFFSET = 65535
+
+# The format requires the last 5 bytes to be literals,
+# and the last match to start at least 12 bytes from the end.
+LAST_LITERALS = 5
+MATCH_FIND_LIMIT = 12
+
+def _write_length(out, length):
+    while length >= 255:
+        out.append(255)
+        length -= 255
+    out.append(length)
+
+def _emit_sequence(out, literals, offset, match_length):
+    literal_length = len(literals)
+
+    token = min(literal_length, 15) << 4
+    if match_length is not None:
+        token |= min(match_length - MIN_MATCH, 15)
+    out.append(token)
+
+    if literal_length >= 15:
+        _write_length(out, literal_length - 15)
+    out += literals
+
+    # The final sequence is only literals
+    if match_length is None:
+        return
+
+    out.append(offset & 0xFF)
+    out.append(offset >> 8)
+
+    if match_length - MIN_MATCH >= 15:
+        _write_length(out, match_length - MIN_MATCH - 15)
+
+def compress_block(src):
+    """Compresses bytes into a single LZ4 block. Greedy, hash chain of one."""
+    src = bytes(src)
+    size = len(src)
+    out = bytearray()
+
+    anchor = 0
+    position = 0
+    match_limit = size - LAST_LITERALS
+    table = {}
+
+    while position < size - MATCH_FIND_LIMIT:
+        key = src[position:position + MIN_MATCH]
+        candidate = table.get(key)
+        table[key] = position
+
+        if candidate is None or position - candidate > MAX_OFFSET:
+            position += 1
+            continue
+
+        length = MIN_MATCH
+        while position + length < match_limit and src[candidate + length] == src[position + length]:
+            length += 1
+
+        # Pull back into the literals if they match too
+        while position > anchor and candidate > 0 and src[position - 1] == src[candidate - 1]:
+            position -= 1
+            candidate -= 1
+            length += 1
+
+        _emit_sequence(out, src[anchor:position], position - candidate, length)
+
+        position += length
+        anchor = position
+
+    _emit_sequence(out, src[anchor:], 0, None)
+    return bytes(out)
+
+def _read_length(src, position, length):
+    if length != 15:
+        return length, position
+
+    while True:
+        value = src[position]
+        position += 1
+        length += value
+        if value != 255:
+            return length, position
+
+def decompress_block(src, size):
+    """Decompresses a LZ4 block, size is the expected output size."""
+    out = bytearray()
+    position = 0
+
+    while position < len(src):
+        token = src[position]
+        position += 1
+
+        literal_length, position = _read_length(src, position, token >> 4)
+        out += src[position:position + literal_length]
+        position += literal_length
+
+        if position >= len(src):
+            break
+
+        offset = src[position] | (src[position + 1] << 8)
+        position += 2
+        if offset == 0 or offset > len(out):
+            raise ValueError("Invalid LZ4 match offset")
+
+        match_length, position = _read_length(src, position, token & 15)
+        match_length += MIN_MATCH
+
+        start = len(out) - offset
+        for i in range(match_length):
+            out.append(out[start + i])
+
+    if len(out) != size:
+        raise ValueError(f"LZ4 block decompressed to {len(out)} bytes, expected {size}")
+
+    return bytes(out)
@@ -0,0 +1,91 @@
+"""
+PowerBlocks Asset Archive Packer
+
+Packs a directory into a .pba archive for
+powerblocks/filesystem/archive.h, and can list
+or verify existing archives.
+
+Author: Samuel Fitzsimons (rainbain)
+File: pbarchive_cli.py
+Date: 2025
+"""
+#!/usr/bin/env python3
+
+import argparse
+import sys
+import os
+from pathlib import Path
+
+from pbarchive import archive
+
+def command_pack(args):
+    files = archive.collect(args.input)
+    entries = archive.pack(files, args.output, args.compress, args.block_size)
+
+    if args.verbose:
+        for entry in entries:
+            mark = "LZ4" if entry.flags & archive.ENTRY_FLAG_LZ4 else "   "
+            print(f"{mark} {len(entry.data):10d} -> {len(entry.stored):10d}  {entry.name}")
+
+def command_list(args):
+    pack = archive.Archive(args.input)
+    for name, hash, flags, offset, stored_size, size in pack.entries:
+        mark = "LZ4" if flags & archive.ENTRY_FLAG_LZ4 else "   "
+        print(f"{hash:08X} {mark} {offset:10d} {size:10d} {stored_size:10d}  {name}")
+
+def command_verify(args):
+    pack = archive.Archive(args.input)
+    pack.check()
+
+    for entry in pack.entries:
+        name = entry[0]
+        data = pack.read(entry)
+
+        if pack.find(name) is not entry:
+            raise ValueError(f"{name}: Lookup by name failed")
+
+        if args.directory:
+            expected = (args.directory / name).read_bytes()
+            if data != expected:
+                raise ValueError(f"{name}: Contents differ from source")
+
+    print(f"{os.path.basename(args.input)}: {len(pack.entries)} entries OK")
+
+def main():
+    parser = argparse.ArgumentParser(description="PowerBlocks SDK Asset Archive Packer")
+    parser.add_argument("-bt", "--backtrace", help="Enable python backtrace on errors.", action="store_true")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    pack = commands.add_parser("pack", help="Pack a directory into an archive")
+    pack.add_argument("input", type=Path, help="Directory to pack")
+    pack.add_argument("-o", "--output", type=Path, help="Output archive", default="out.pba")
+    pack.add_argument("-c", "--compress", help="LZ4 compress entries where it helps.", action="store_true")
+    pack.add_argument("-b", "--block-size", type=int, help="Decompression block size in bytes.", default=archive.DEFAULT_BLOCK_SIZE)
+    pack.add_argument("-v", "--verbose", help="Print each entry.", action="store_true")
+    pack.set_defaults(run=command_pack)
+
+    listing = commands.add_parser("list", help="List the entries of an archive")
+    listing.add_argument("input", type=Path, help="Archive file")
+    listing.set_defaults(run=command_list)
+
+    verify = commands.add_parser("verify", help="Check an archive decodes, optionally against its source directory")
+    verify.add_argument("input", type=Path, help="Archive file")
+    verify.add_argument("directory", type=Path, nargs="?", help="Directory it was packed from")
+    verify.set_defaults(run=command_verify)
+
+    args = parser.parse_args()
+
+    try:
+        args.run(args)
+    except Exception as e:
+        # If backtrace, send this off to the top
+        if args.backtrace:
+            raise e
+
+        print(f"{os.path.basename(args.input)}: {args.command.capitalize()} Failed")
+        print(f"\t{e}")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()